@@ -0,0 +1,47 @@
+#!/bin/bash -eu
+
+# Standalone microbenchmarks: as the fuzzers, each of them is linked with
+# the few Janus objects it needs, rather than with the whole core, and
+# prints the results of its measurements on stdout. The tree must have
+# been configured already (./autogen.sh && ./configure).
+
+SCRIPTPATH="$( cd "$(dirname "$0")" ; pwd -P )"
+
+# Working paths
+SRC=$(dirname $SCRIPTPATH)
+OUT=${OUT-"$SCRIPTPATH/out"}
+
+# Set compiler and flags from the environment
+# Fallback to an optimized build, as that's what we want to measure
+BENCH_CC=${CC-"cc"}
+BENCH_CFLAGS=${CFLAGS-"-O2 -g"}
+BENCH_LDFLAGS=${LDFLAGS-""}
+
+# Janus objects needed by the benchmarks
+JANUS_OBJECTS="janus-log.o janus-utils.o janus-rtcp.o janus-rtp.o"
+
+# CFLAGS and libraries for the benchmark dependencies
+DEPS_CFLAGS="$(pkg-config --cflags glib-2.0 jansson openssl)"
+DEPS_LIB="$(pkg-config --libs glib-2.0 jansson zlib openssl) -pthread -lm"
+
+# Build and archive necessary Janus objects
+cd $SRC
+# Use this variable to skip Janus objects building
+SKIP_JANUS_BUILD=${SKIP_JANUS_BUILD-"0"}
+if [ "$SKIP_JANUS_BUILD" -eq "0" ]; then
+	echo "Building Janus objects"
+	make -j$(nproc) $JANUS_OBJECTS
+fi
+mkdir -p $OUT
+JANUS_LIB="$OUT/janus-lib.a"
+rm -f $JANUS_LIB
+ar rcs $JANUS_LIB $JANUS_OBJECTS
+cd -
+
+# Build benchmarks
+benchmarks=$(find $SCRIPTPATH -maxdepth 1 -name "*.c")
+for sourceFile in $benchmarks; do
+	name=$(basename $sourceFile .c)
+	echo "Building benchmark: $name"
+	$BENCH_CC $BENCH_CFLAGS $DEPS_CFLAGS -I$SRC $sourceFile -o $OUT/$name $BENCH_LDFLAGS $JANUS_LIB $DEPS_LIB
+done
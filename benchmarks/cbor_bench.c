@@ -0,0 +1,154 @@
+/*
+ * Microbenchmark for the CBOR encoding of Janus API messages: compares
+ * encoding and decoding some representative messages (requests, responses,
+ * plugin events with and without a JSEP offer, trickle candidates) as
+ * compact JSON, the smallest the core can be configured to send, and as
+ * CBOR, using the helpers in utils.c. Each message is also checked to make
+ * it through both formats unchanged.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+#include <jansson.h>
+#include "../debug.h"
+#include "../utils.h"
+
+int janus_log_level = LOG_NONE;
+gboolean janus_log_timestamps = FALSE;
+gboolean janus_log_colors = FALSE;
+char *janus_log_global_prefix = NULL;
+int lock_debug = 0;
+
+#define ITERATIONS	200000
+
+/* Messages as they're usually exchanged with the core */
+static const char *bench_messages[][2] = {
+	{ "keepalive request",
+		"{\"janus\":\"keepalive\",\"session_id\":8126340526723164,\"transaction\":\"sBJNyUhH6Vc6\"}" },
+	{ "attach request",
+		"{\"janus\":\"attach\",\"plugin\":\"janus.plugin.videoroom\",\"opaque_id\":\"videoroomtest-Xbd9Iz3JpCmg\","
+		"\"session_id\":8126340526723164,\"transaction\":\"Bs4qk7TWXyQT\"}" },
+	{ "success response",
+		"{\"janus\":\"success\",\"session_id\":8126340526723164,\"transaction\":\"Bs4qk7TWXyQT\","
+		"\"data\":{\"id\":2954732418720394}}" },
+	{ "trickle request",
+		"{\"janus\":\"trickle\",\"candidate\":{\"candidate\":\"candidate:1467250027 1 udp 2122260223 192.168.0.196 "
+		"46243 typ host generation 0 ufrag 3LxP network-id 1\",\"sdpMid\":\"0\",\"sdpMLineIndex\":0},"
+		"\"session_id\":8126340526723164,\"handle_id\":2954732418720394,\"transaction\":\"hMMPVQwPQ3Ku\"}" },
+	{ "videoroom event",
+		"{\"janus\":\"event\",\"session_id\":8126340526723164,\"sender\":2954732418720394,"
+		"\"plugindata\":{\"plugin\":\"janus.plugin.videoroom\",\"data\":{\"videoroom\":\"event\",\"room\":1234,"
+		"\"publishers\":[{\"id\":5478301625891873,\"display\":\"Alice\",\"audio_codec\":\"opus\",\"video_codec\":\"vp8\","
+		"\"simulcast\":true,\"talking\":false}]}}}" },
+	{ "videoroom event with jsep",
+		"{\"janus\":\"event\",\"session_id\":8126340526723164,\"transaction\":\"Q0rNHJ2ycAbF\",\"sender\":2954732418720394,"
+		"\"plugindata\":{\"plugin\":\"janus.plugin.videoroom\",\"data\":{\"videoroom\":\"attached\",\"room\":1234,"
+		"\"id\":5478301625891873,\"display\":\"Alice\"}},\"jsep\":{\"type\":\"offer\",\"sdp\":"
+		"\"v=0\\r\\no=- 1603294512914737 1 IN IP4 192.168.0.196\\r\\ns=VideoRoom 1234\\r\\nt=0 0\\r\\n"
+		"a=group:BUNDLE 0 1\\r\\na=msid-semantic: WMS janus\\r\\n"
+		"m=audio 9 UDP/TLS/RTP/SAVPF 111\\r\\nc=IN IP4 192.168.0.196\\r\\na=sendonly\\r\\na=mid:0\\r\\n"
+		"a=rtcp-mux\\r\\na=ice-ufrag:9bqL\\r\\na=ice-pwd:XuBDN1wyLUpXNrlnAF4G6q\\r\\na=ice-options:trickle\\r\\n"
+		"a=fingerprint:sha-256 D2:B9:31:8F:DF:24:D8:0E:ED:D2:EF:25:9E:AF:6F:B8:34:AE:53:9C:E6:F3:8F:F2:64:15:FA:E8:7F:53:2D:38\\r\\n"
+		"a=setup:actpass\\r\\na=rtpmap:111 opus/48000/2\\r\\na=extmap:1 urn:ietf:params:rtp-hdrext:sdes:mid\\r\\n"
+		"a=msid:janus janusa0\\r\\na=ssrc:1838272621 cname:janus\\r\\n"
+		"a=candidate:1 1 udp 2015363327 192.168.0.196 43122 typ host\\r\\na=end-of-candidates\\r\\n"
+		"m=video 9 UDP/TLS/RTP/SAVPF 96 97\\r\\nc=IN IP4 192.168.0.196\\r\\na=sendonly\\r\\na=mid:1\\r\\n"
+		"a=rtcp-mux\\r\\na=ice-ufrag:9bqL\\r\\na=ice-pwd:XuBDN1wyLUpXNrlnAF4G6q\\r\\na=ice-options:trickle\\r\\n"
+		"a=fingerprint:sha-256 D2:B9:31:8F:DF:24:D8:0E:ED:D2:EF:25:9E:AF:6F:B8:34:AE:53:9C:E6:F3:8F:F2:64:15:FA:E8:7F:53:2D:38\\r\\n"
+		"a=setup:actpass\\r\\na=rtpmap:96 VP8/90000\\r\\na=rtcp-fb:96 ccm fir\\r\\na=rtcp-fb:96 nack\\r\\n"
+		"a=rtcp-fb:96 nack pli\\r\\na=rtcp-fb:96 goog-remb\\r\\na=rtcp-fb:96 transport-cc\\r\\n"
+		"a=rtpmap:97 rtx/90000\\r\\na=fmtp:97 apt=96\\r\\na=extmap:1 urn:ietf:params:rtp-hdrext:sdes:mid\\r\\n"
+		"a=extmap:3 http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01\\r\\n"
+		"a=ssrc-group:FID 2425961423 3361328476\\r\\na=msid:janus janusv0\\r\\n"
+		"a=ssrc:2425961423 cname:janus\\r\\na=ssrc:3361328476 cname:janus\\r\\n"
+		"a=candidate:1 1 udp 2015363327 192.168.0.196 43122 typ host\\r\\na=end-of-candidates\\r\\n\"}}" },
+	{ NULL, NULL }
+};
+
+static gint64 bench_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * G_GINT64_CONSTANT(1000000000)) + ts.tv_nsec;
+}
+
+/* Prevents the compiler from optimizing the loops away */
+static volatile size_t sink = 0;
+
+static void bench_run(const char *name, const char *text, size_t format) {
+	json_error_t error;
+	json_t *message = json_loads(text, 0, &error);
+	if(message == NULL) {
+		printf("%s: invalid JSON (%s)\n", name, error.text);
+		exit(1);
+	}
+	/* Make sure the message makes it through both formats unchanged */
+	char *json = json_dumps(message, format);
+	size_t json_len = strlen(json);
+	size_t cbor_len = 0;
+	char *cbor = janus_cbor_encode(message, &cbor_len);
+	if(cbor == NULL || !janus_cbor_is_message(cbor, cbor_len)) {
+		printf("%s: couldn't encode the message as CBOR\n", name);
+		exit(1);
+	}
+	json_t *from_json = json_loadb(json, json_len, 0, &error);
+	json_t *from_cbor = janus_cbor_decode(cbor, cbor_len, &error);
+	if(!json_equal(message, from_json) || !json_equal(message, from_cbor)) {
+		printf("%s: the decoded message doesn't match the original one!\n", name);
+		exit(1);
+	}
+	json_decref(from_json);
+	json_decref(from_cbor);
+	int i = 0;
+	size_t check = 0;
+	gint64 start = bench_now();
+	for(i=0; i<ITERATIONS; i++) {
+		char *payload = json_dumps(message, format);
+		check += (unsigned char)payload[i % json_len];
+		free(payload);
+	}
+	gint64 json_encode_ns = bench_now() - start;
+	start = bench_now();
+	for(i=0; i<ITERATIONS; i++) {
+		size_t len = 0;
+		char *payload = janus_cbor_encode(message, &len);
+		check += (unsigned char)payload[i % len];
+		g_free(payload);
+	}
+	gint64 cbor_encode_ns = bench_now() - start;
+	start = bench_now();
+	for(i=0; i<ITERATIONS; i++) {
+		json_t *decoded = json_loadb(json, json_len, 0, &error);
+		check += json_object_size(decoded);
+		json_decref(decoded);
+	}
+	gint64 json_decode_ns = bench_now() - start;
+	start = bench_now();
+	for(i=0; i<ITERATIONS; i++) {
+		json_t *decoded = janus_cbor_decode(cbor, cbor_len, &error);
+		check += json_object_size(decoded);
+		json_decref(decoded);
+	}
+	gint64 cbor_decode_ns = bench_now() - start;
+	sink += check;
+	printf("%-26s JSON %5zu bytes, encode %7.0f ns, decode %7.0f ns | CBOR %5zu bytes, encode %7.0f ns, decode %7.0f ns\n",
+		name, json_len, (double)json_encode_ns/ITERATIONS, (double)json_decode_ns/ITERATIONS,
+		cbor_len, (double)cbor_encode_ns/ITERATIONS, (double)cbor_decode_ns/ITERATIONS);
+	free(json);
+	g_free(cbor);
+	json_decref(message);
+}
+
+int main(int argc, char *argv[]) {
+	/* The most efficient JSON the core can send (json = "compact" in janus.jcfg) */
+	size_t format = janus_json_format_parse("compact");
+	int i = 0;
+	for(i=0; bench_messages[i][0] != NULL; i++)
+		bench_run(bench_messages[i][0], bench_messages[i][1], format);
+	return 0;
+}
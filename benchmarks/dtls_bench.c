@@ -0,0 +1,254 @@
+/*
+ * Microbenchmark for DTLS-SRTP handshakes: measures how long it takes for
+ * two in-memory DTLS stacks, configured as the core configures its own, to
+ * complete a handshake and export the SRTP keys (which is when media can
+ * start flowing), both one at a time and on a pool of handshake workers, as
+ * the core does when handshake workers are enabled. It also measures how
+ * quickly a thread waiting for a handshake worker to give a DTLS stack back
+ * (as janus_dtls_srtp_destroy does) notices it, polling or waiting on a
+ * condition. The certificates and keys are generated as in dtls.c.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/ec.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+
+#include "../debug.h"
+#include "../mutex.h"
+#include "../utils.h"
+
+int janus_log_level = LOG_NONE;
+gboolean janus_log_timestamps = FALSE;
+gboolean janus_log_colors = FALSE;
+char *janus_log_global_prefix = NULL;
+int lock_debug = 0;
+
+#define HANDSHAKES	500
+#define GIVEBACKS	2000
+#define DTLS_MTU	1200
+
+/* Certificate and key (same as janus_dtls_generate_keys, without error checking) */
+static void bench_generate_keys(X509 **certificate, EVP_PKEY **private_key, gboolean rsa) {
+	*private_key = EVP_PKEY_new();
+	if(rsa) {
+		BIGNUM *bne = BN_new();
+		BN_set_word(bne, RSA_F4);
+		RSA *rsa_key = RSA_new();
+		RSA_generate_key_ex(rsa_key, 2048, bne, NULL);
+		EVP_PKEY_assign_RSA(*private_key, rsa_key);
+		BN_free(bne);
+	} else {
+		EC_KEY *ecc_key = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+		EC_KEY_set_asn1_flag(ecc_key, OPENSSL_EC_NAMED_CURVE);
+		EC_KEY_generate_key(ecc_key);
+		EVP_PKEY_assign_EC_KEY(*private_key, ecc_key);
+	}
+	*certificate = X509_new();
+	X509_set_version(*certificate, 2);
+	ASN1_INTEGER_set(X509_get_serialNumber(*certificate), (long)g_random_int());
+	X509_gmtime_adj(X509_get_notBefore(*certificate), -1 * 60*60*24*365);
+	X509_gmtime_adj(X509_get_notAfter(*certificate), 60*60*24*365);
+	X509_set_pubkey(*certificate, *private_key);
+	X509_NAME *cert_name = X509_get_subject_name(*certificate);
+	X509_NAME_add_entry_by_txt(cert_name, "O", MBSTRING_ASC, (const unsigned char*)"Janus", -1, -1, 0);
+	X509_NAME_add_entry_by_txt(cert_name, "CN", MBSTRING_ASC, (const unsigned char*)"Janus", -1, -1, 0);
+	X509_set_issuer_name(*certificate, cert_name);
+	X509_sign(*certificate, *private_key, EVP_sha256());
+}
+
+static int bench_verify_callback(int preverify_ok, X509_STORE_CTX *ctx) {
+	/* We just use the verify_callback to request a certificate from the client */
+	return 1;
+}
+
+static SSL_CTX *bench_context(gboolean rsa) {
+	SSL_CTX *ctx = SSL_CTX_new(DTLS_method());
+	SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, bench_verify_callback);
+	SSL_CTX_set_tlsext_use_srtp(ctx, "SRTP_AES128_CM_SHA1_80:SRTP_AES128_CM_SHA1_32");
+	X509 *certificate = NULL;
+	EVP_PKEY *private_key = NULL;
+	bench_generate_keys(&certificate, &private_key, rsa);
+	SSL_CTX_use_certificate(ctx, certificate);
+	SSL_CTX_use_PrivateKey(ctx, private_key);
+	X509_free(certificate);
+	EVP_PKEY_free(private_key);
+	SSL_CTX_set_cipher_list(ctx, "DEFAULT:!NULL:!aNULL:!SHA256:!SHA384:!aECDH:!AESGCM+AES256:!aPSK");
+	return ctx;
+}
+
+static SSL *bench_endpoint(SSL_CTX *ctx, gboolean client) {
+	SSL *ssl = SSL_new(ctx);
+	/* Memory BIOs can't tell us the MTU, so we set one as dtls-bio.c does */
+	SSL_set_options(ssl, SSL_OP_NO_QUERY_MTU);
+	SSL_set_mtu(ssl, DTLS_MTU);
+	SSL_set_bio(ssl, BIO_new(BIO_s_mem()), BIO_new(BIO_s_mem()));
+	EC_KEY *ecdh = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+	SSL_set_options(ssl, SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3 | SSL_OP_NO_COMPRESSION | SSL_OP_SINGLE_ECDH_USE);
+	SSL_set_tmp_ecdh(ssl, ecdh);
+	EC_KEY_free(ecdh);
+	if(client)
+		SSL_set_connect_state(ssl);
+	else
+		SSL_set_accept_state(ssl);
+	return ssl;
+}
+
+/* Move what an endpoint wrote to what the other will read */
+static void bench_shuttle(SSL *from, SSL *to) {
+	char buffer[4096];
+	int len = 0;
+	while((len = BIO_read(SSL_get_wbio(from), buffer, sizeof(buffer))) > 0)
+		BIO_write(SSL_get_rbio(to), buffer, len);
+}
+
+/* A whole handshake, up to the SRTP keys: returns the time it took, in us */
+static gint64 bench_handshake(SSL_CTX *ctx) {
+	gint64 start = janus_get_monotonic_time();
+	SSL *client = bench_endpoint(ctx, TRUE), *server = bench_endpoint(ctx, FALSE);
+	int rounds = 0;
+	while((!SSL_is_init_finished(client) || !SSL_is_init_finished(server)) && rounds < 20) {
+		SSL_do_handshake(client);
+		bench_shuttle(client, server);
+		SSL_do_handshake(server);
+		bench_shuttle(server, client);
+		rounds++;
+	}
+	if(!SSL_is_init_finished(client) || !SSL_is_init_finished(server)) {
+		char error[200];
+		ERR_error_string_n(ERR_get_error(), error, sizeof(error));
+		printf("Handshake failed: %s\n", error);
+		exit(1);
+	}
+	/* Media can flow as soon as both sides have the SRTP keys */
+	unsigned char material[60], peer_material[60];
+	if(!SSL_export_keying_material(server, material, sizeof(material), "EXTRACTOR-dtls_srtp", 19, NULL, 0, 0) ||
+			!SSL_export_keying_material(client, peer_material, sizeof(peer_material), "EXTRACTOR-dtls_srtp", 19, NULL, 0, 0) ||
+			memcmp(material, peer_material, sizeof(material))) {
+		printf("Keying material mismatch\n");
+		exit(1);
+	}
+	gint64 elapsed = janus_get_monotonic_time() - start;
+	SSL_free(client);
+	SSL_free(server);
+	return elapsed;
+}
+
+static int bench_compare(gconstpointer a, gconstpointer b) {
+	gint64 x = *(const gint64 *)a, y = *(const gint64 *)b;
+	return (x > y) - (x < y);
+}
+
+/* Handshakes on a pool of workers, as with handshake workers in the core */
+typedef struct bench_pool_data {
+	SSL_CTX *ctx;
+	gint64 *latencies;
+	volatile gint next;
+} bench_pool_data;
+static void bench_pool_worker(gpointer data, gpointer user_data) {
+	bench_pool_data *pd = (bench_pool_data *)user_data;
+	gint64 elapsed = bench_handshake(pd->ctx);
+	pd->latencies[g_atomic_int_add(&pd->next, 1)] = elapsed;
+}
+
+static void bench_handshakes(const char *name, gboolean rsa, int workers) {
+	SSL_CTX *ctx = bench_context(rsa);
+	bench_pool_data pd = { .ctx = ctx, .latencies = g_malloc0(sizeof(gint64) * HANDSHAKES), .next = 0 };
+	gint64 start = janus_get_monotonic_time();
+	if(workers < 2) {
+		int i = 0;
+		for(i=0; i<HANDSHAKES; i++)
+			bench_pool_worker(NULL, &pd);
+	} else {
+		GThreadPool *pool = g_thread_pool_new(bench_pool_worker, &pd, workers, FALSE, NULL);
+		int i = 0;
+		for(i=0; i<HANDSHAKES; i++)
+			g_thread_pool_push(pool, GINT_TO_POINTER(i+1), NULL);
+		g_thread_pool_free(pool, FALSE, TRUE);
+	}
+	gint64 total = janus_get_monotonic_time() - start;
+	qsort(pd.latencies, HANDSHAKES, sizeof(gint64), (int (*)(const void *, const void *))bench_compare);
+	printf("%-6s %2d worker(s): %7.1f handshakes/s, time to first media median %6.2f ms, p99 %6.2f ms\n",
+		name, workers, (double)HANDSHAKES * G_USEC_PER_SEC / total,
+		(double)pd.latencies[HANDSHAKES/2] / 1000, (double)pd.latencies[(HANDSHAKES*99)/100] / 1000);
+	g_free(pd.latencies);
+	SSL_CTX_free(ctx);
+}
+
+/* A worker giving a stack back, and somebody waiting for it (see janus_dtls_srtp_destroy) */
+typedef struct bench_giveback {
+	volatile gint offloaded;
+	gboolean condition;
+	janus_mutex mutex;
+	janus_condition cond;
+	gint64 released;
+} bench_giveback;
+static gpointer bench_giveback_worker(gpointer data) {
+	bench_giveback *gb = (bench_giveback *)data;
+	/* Pretend we're done with the handshake after a while */
+	g_usleep(50);
+	janus_mutex_lock(&gb->mutex);
+	gb->released = janus_get_monotonic_time();
+	g_atomic_int_set(&gb->offloaded, 0);
+	if(gb->condition)
+		janus_condition_broadcast(&gb->cond);
+	janus_mutex_unlock(&gb->mutex);
+	return NULL;
+}
+
+static void bench_givebacks(const char *name, gboolean condition) {
+	bench_giveback gb;
+	janus_mutex_init(&gb.mutex);
+	janus_condition_init(&gb.cond);
+	gb.condition = condition;
+	gint64 total = 0, worst = 0;
+	int i = 0;
+	for(i=0; i<GIVEBACKS; i++) {
+		g_atomic_int_set(&gb.offloaded, 1);
+		GThread *thread = g_thread_new("giveback", bench_giveback_worker, &gb);
+		if(condition) {
+			janus_mutex_lock(&gb.mutex);
+			while(g_atomic_int_get(&gb.offloaded))
+				janus_condition_wait(&gb.cond, &gb.mutex);
+			janus_mutex_unlock(&gb.mutex);
+		} else {
+			while(g_atomic_int_get(&gb.offloaded))
+				g_usleep(100);
+		}
+		gint64 noticed = janus_get_monotonic_time();
+		g_thread_join(thread);
+		gint64 delay = noticed - gb.released;
+		total += delay;
+		if(delay > worst)
+			worst = delay;
+	}
+	printf("%-24s wakeup after give back: mean %6.1f us, worst %6"SCNi64" us\n",
+		name, (double)total / GIVEBACKS, worst);
+	janus_mutex_destroy(&gb.mutex);
+	janus_condition_destroy(&gb.cond);
+}
+
+int main(int argc, char *argv[]) {
+	SSL_library_init();
+	SSL_load_error_strings();
+	int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if(cpus < 1)
+		cpus = 1;
+	bench_handshakes("ECDSA", FALSE, 1);
+	bench_handshakes("ECDSA", FALSE, cpus);
+	bench_handshakes("RSA", TRUE, 1);
+	bench_handshakes("RSA", TRUE, cpus);
+	bench_givebacks("Polling (100us sleeps)", FALSE);
+	bench_givebacks("Condition", TRUE);
+	return 0;
+}
@@ -0,0 +1,281 @@
+/*
+ * Microbenchmark for the RTP extensions the core adds to outgoing packets:
+ * compares building the extensions block for each packet, as the core used
+ * to do in janus_ice_relay_rtp, with copying the block precompiled at
+ * negotiation time, with and without the reference the relaying thread
+ * takes to the compiled instance. The core structures and helpers can't be
+ * linked here without libnice, so the relevant code from ice.c is replicated
+ * below: keep it in sync when changing that code.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <glib.h>
+#include "../debug.h"
+#include "../refcount.h"
+#include "../rtp.h"
+#include "../plugins/plugin.h"
+
+int janus_log_level = LOG_NONE;
+gboolean janus_log_timestamps = FALSE;
+gboolean janus_log_colors = FALSE;
+char *janus_log_global_prefix = NULL;
+int lock_debug = 0;
+int refcount_debug = 0;
+
+#define ITERATIONS	10000000
+
+/* What we negotiated (same fields as in janus_ice_stream and janus_ice_handle) */
+typedef struct bench_stream {
+	int transport_wide_cc_ext_id, mid_ext_id, audiolevel_ext_id, videoorientation_ext_id;
+	char *audio_mid, *video_mid;
+} bench_stream;
+
+/* Per-packet extensions, as janus_ice_relay_rtp used to build them */
+static uint16_t bench_legacy_build(bench_stream *stream, janus_plugin_rtp *packet, char *extensions) {
+	uint16_t extlen = 0;
+	if((packet->video && stream->transport_wide_cc_ext_id > 0) || stream->mid_ext_id > 0 ||
+			(!packet->video && packet->extensions.audio_level != -1 && stream->audiolevel_ext_id > 0) ||
+			(packet->video && packet->extensions.video_rotation != -1 && stream->videoorientation_ext_id > 0)) {
+		memset(extensions, 0, 50);
+		janus_rtp_header_extension *extheader = (janus_rtp_header_extension *)extensions;
+		extheader->type = htons(0xBEDE);
+		extheader->length = 0;
+		char *index = extensions + 4;
+		if(packet->video && stream->transport_wide_cc_ext_id > 0) {
+			*index = (stream->transport_wide_cc_ext_id << 4) + 1;
+			memset(index+1, 0, 2);
+			index += 3;
+			extlen += 3;
+		}
+		if(stream->mid_ext_id > 0) {
+			char *mid = packet->video ? stream->video_mid : stream->audio_mid;
+			if(mid != NULL) {
+				size_t midlen = strlen(mid) & 0x0F;
+				*index = (stream->mid_ext_id << 4) + (midlen ? midlen-1 : 0);
+				memcpy(index+1, mid, midlen);
+				index += (midlen + 1);
+				extlen += (midlen + 1);
+			}
+		}
+		if(!packet->video && packet->extensions.audio_level != -1 && stream->audiolevel_ext_id > 0) {
+			*index = (stream->audiolevel_ext_id << 4);
+			*(index+1) = (packet->extensions.audio_level_vad << 7) + (packet->extensions.audio_level & 0x7F);
+			index += 2;
+			extlen += 2;
+		}
+		if(packet->video && packet->extensions.video_rotation != -1 && stream->videoorientation_ext_id > 0) {
+			*index = (stream->videoorientation_ext_id << 4);
+			gboolean c = packet->extensions.video_back_camera,
+				f = packet->extensions.video_flipped, r1 = FALSE, r0 = FALSE;
+			switch(packet->extensions.video_rotation) {
+				case 270:
+					r1 = TRUE;
+					r0 = TRUE;
+					break;
+				case 180:
+					r1 = TRUE;
+					r0 = FALSE;
+					break;
+				case 90:
+					r1 = FALSE;
+					r0 = TRUE;
+					break;
+				case 0:
+				default:
+					r1 = FALSE;
+					r0 = FALSE;
+					break;
+			}
+			*(index+1) = (c<<3) + (f<<2) + (r1<<1) + r0;
+			index += 2;
+			extlen += 2;
+		}
+		uint16_t words = extlen/4;
+		if(extlen%4 != 0)
+			words++;
+		extheader->length = htons(words);
+		extlen = 4 + (words*4);
+	}
+	return extlen;
+}
+
+/* Precompiled extensions (same as janus_ice_extensions_template and janus_ice_extensions) */
+#define JANUS_ICE_EXTENSIONS_TEMPLATE_SIZE	32
+typedef struct bench_template {
+	char buffer[2][JANUS_ICE_EXTENSIONS_TEMPLATE_SIZE];
+	guint16 length[2];
+	guint16 twcc_offset;
+	guint16 optional_offset;
+} bench_template;
+typedef struct bench_extensions {
+	bench_template outgoing[2];
+	janus_refcount ref;
+} bench_extensions;
+
+static void bench_template_compile(bench_template *template,
+		gboolean video, int twcc_ext_id, int mid_ext_id, const char *mid, int optional_ext_id) {
+	memset(template, 0, sizeof(*template));
+	char elements[JANUS_ICE_EXTENSIONS_TEMPLATE_SIZE];
+	uint16_t extlen = 0;
+	if(video && twcc_ext_id > 0) {
+		elements[extlen] = (twcc_ext_id << 4) + 1;
+		memset(elements + extlen + 1, 0, 2);
+		template->twcc_offset = 4 + extlen + 1;
+		extlen += 3;
+	}
+	if(mid_ext_id > 0 && mid != NULL) {
+		size_t midlen = strlen(mid) & 0x0F;
+		elements[extlen] = (mid_ext_id << 4) + (midlen ? midlen-1 : 0);
+		memcpy(elements + extlen + 1, mid, midlen);
+		extlen += (midlen + 1);
+	}
+	int i = 0;
+	for(i=0; i<2; i++) {
+		char *block = template->buffer[i];
+		uint16_t len = extlen;
+		memcpy(block + 4, elements, extlen);
+		if(i == 1 && optional_ext_id > 0) {
+			block[4 + len] = (optional_ext_id << 4);
+			template->optional_offset = 4 + len + 1;
+			len += 2;
+		}
+		if(len == 0)
+			continue;
+		uint16_t words = len/4;
+		if(len%4 != 0)
+			words++;
+		janus_rtp_header_extension *extheader = (janus_rtp_header_extension *)block;
+		extheader->type = htons(0xBEDE);
+		extheader->length = htons(words);
+		template->length[i] = 4 + (words*4);
+	}
+}
+
+static uint16_t bench_template_apply(const bench_template *template, janus_plugin_rtp *packet, char *dst) {
+	int variant = 0;
+	if(template->optional_offset > 0 && ((!packet->video && packet->extensions.audio_level != -1) ||
+			(packet->video && packet->extensions.video_rotation != -1)))
+		variant = 1;
+	memcpy(dst, template->buffer[variant], template->length[variant]);
+	if(variant == 0)
+		return template->length[variant];
+	if(!packet->video) {
+		dst[template->optional_offset] = (packet->extensions.audio_level_vad << 7) + (packet->extensions.audio_level & 0x7F);
+	} else {
+		gboolean c = packet->extensions.video_back_camera,
+			f = packet->extensions.video_flipped, r1 = FALSE, r0 = FALSE;
+		switch(packet->extensions.video_rotation) {
+			case 270:
+				r1 = TRUE;
+				r0 = TRUE;
+				break;
+			case 180:
+				r1 = TRUE;
+				r0 = FALSE;
+				break;
+			case 90:
+				r1 = FALSE;
+				r0 = TRUE;
+				break;
+			case 0:
+			default:
+				r1 = FALSE;
+				r0 = FALSE;
+				break;
+		}
+		dst[template->optional_offset] = (c<<3) + (f<<2) + (r1<<1) + r0;
+	}
+	return template->length[variant];
+}
+
+static void bench_extensions_free(const janus_refcount *ext_ref) {
+	bench_extensions *extensions = janus_refcount_containerof(ext_ref, bench_extensions, ref);
+	g_free(extensions);
+}
+
+static gint64 bench_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * G_GINT64_CONSTANT(1000000000)) + ts.tv_nsec;
+}
+
+/* Prevents the compiler from optimizing the loops away */
+static volatile guint32 sink = 0;
+
+static void bench_run(const char *name, bench_stream *stream, janus_plugin_rtp *packet) {
+	bench_extensions *extensions = g_malloc0(sizeof(bench_extensions));
+	janus_refcount_init(&extensions->ref, bench_extensions_free);
+	bench_template_compile(&extensions->outgoing[0], FALSE,
+		0, stream->mid_ext_id, stream->audio_mid, stream->audiolevel_ext_id);
+	bench_template_compile(&extensions->outgoing[1], TRUE,
+		stream->transport_wide_cc_ext_id, stream->mid_ext_id, stream->video_mid, stream->videoorientation_ext_id);
+	bench_extensions *published = extensions;
+	const bench_template *template = &extensions->outgoing[packet->video ? 1 : 0];
+	/* Make sure both approaches produce the same bytes */
+	char legacy[50], compiled[JANUS_ICE_EXTENSIONS_TEMPLATE_SIZE];
+	uint16_t legacy_len = bench_legacy_build(stream, packet, legacy);
+	uint16_t compiled_len = bench_template_apply(template, packet, compiled);
+	if(legacy_len != compiled_len || memcmp(legacy, compiled, legacy_len)) {
+		printf("%s: the precompiled extensions don't match the legacy ones!\n", name);
+		exit(1);
+	}
+	int i = 0;
+	guint32 check = 0;
+	gint64 start = bench_now();
+	for(i=0; i<ITERATIONS; i++) {
+		check += bench_legacy_build(stream, packet, legacy);
+		check += (guint8)legacy[i & 0x0F];
+	}
+	gint64 legacy_ns = bench_now() - start;
+	start = bench_now();
+	for(i=0; i<ITERATIONS; i++) {
+		check += bench_template_apply(template, packet, compiled);
+		check += (guint8)compiled[i & 0x0F];
+	}
+	gint64 compiled_ns = bench_now() - start;
+	start = bench_now();
+	for(i=0; i<ITERATIONS; i++) {
+		/* As janus_ice_relay_rtp does, via janus_ice_extensions_get */
+		bench_extensions *current = g_atomic_pointer_get(&published);
+		janus_refcount_increase_nodebug(&current->ref);
+		check += bench_template_apply(&current->outgoing[packet->video ? 1 : 0], packet, compiled);
+		check += (guint8)compiled[i & 0x0F];
+		janus_refcount_decrease_nodebug(&current->ref);
+	}
+	gint64 referenced_ns = bench_now() - start;
+	sink += check;
+	printf("%-28s legacy %6.2f ns/packet, precompiled %6.2f ns/packet, precompiled+ref %6.2f ns/packet (%u bytes)\n",
+		name, (double)legacy_ns/ITERATIONS, (double)compiled_ns/ITERATIONS,
+		(double)referenced_ns/ITERATIONS, (unsigned int)compiled_len);
+	janus_refcount_decrease(&extensions->ref);
+}
+
+int main(int argc, char *argv[]) {
+	bench_stream stream = {
+		.transport_wide_cc_ext_id = 3, .mid_ext_id = 4,
+		.audiolevel_ext_id = 1, .videoorientation_ext_id = 13,
+		.audio_mid = (char *)"0", .video_mid = (char *)"1"
+	};
+	janus_plugin_rtp packet;
+	memset(&packet, 0, sizeof(packet));
+	packet.extensions.audio_level = -1;
+	packet.extensions.video_rotation = -1;
+	/* Audio, with mid only */
+	packet.video = FALSE;
+	bench_run("audio (mid)", &stream, &packet);
+	/* Audio, with mid and audio level */
+	packet.extensions.audio_level = 42;
+	packet.extensions.audio_level_vad = TRUE;
+	bench_run("audio (mid, audio-level)", &stream, &packet);
+	/* Video, with transport-wide CC and mid */
+	packet.video = TRUE;
+	bench_run("video (twcc, mid)", &stream, &packet);
+	/* Video, with transport-wide CC, mid and video orientation */
+	packet.extensions.video_rotation = 90;
+	bench_run("video (twcc, mid, rotation)", &stream, &packet);
+	return 0;
+}
@@ -0,0 +1,350 @@
+/*! \file    bwe.c
+ * \author   Lorenzo Miniero <lorenzo@meetecho.com>
+ * \copyright GNU General Public License v3
+ * \brief    Send-side bandwidth estimation
+ * \details  Implementation of a send-side bandwidth estimator, loosely
+ * based on Google Congestion Control (GCC, draft-ietf-rmcat-gcc-02).
+ * Janus adds a transport-wide sequence number to the video packets it
+ * sends, and keeps track of when each of them was sent and how large it
+ * was: the transport-wide CC feedback the peer sends back then tells
+ * us when (and if) those packets were received. This information is
+ * used by two controllers: a delay-based one, that looks at how the
+ * one-way delay variation between groups of packets evolves over time
+ * (using a trendline filter and an adaptive threshold to detect overuse),
+ * and a loss-based one, that looks at the fraction of packets the peer
+ * reported as lost. The estimate is the lower of the two.
+ *
+ * \ingroup protocols
+ * \ref protocols
+ */
+
+#include <math.h>
+
+#include "bwe.h"
+#include "debug.h"
+#include "utils.h"
+
+/* Packets sent within this interval (us) belong to the same group */
+#define JANUS_BWE_BURST_TIME		5000
+/* Smoothing coefficient and gain of the trendline filter */
+#define JANUS_BWE_SMOOTHING			0.9
+#define JANUS_BWE_THRESHOLD_GAIN	4.0
+/* Adaptive threshold: initial value, bounds and coefficients */
+#define JANUS_BWE_THRESHOLD_START	12.5
+#define JANUS_BWE_THRESHOLD_MIN		6.0
+#define JANUS_BWE_THRESHOLD_MAX		600.0
+#define JANUS_BWE_THRESHOLD_K_UP	0.0087
+#define JANUS_BWE_THRESHOLD_K_DOWN	0.039
+/* For how long (ms) we need to detect overuse before acting on it */
+#define JANUS_BWE_OVERUSE_TIME		10.0
+/* Multiplicative increase (per second) and decrease factors of the rate controller */
+#define JANUS_BWE_INCREASE_FACTOR	1.08
+#define JANUS_BWE_DECREASE_FACTOR	0.85
+/* Don't decrease the estimate more often than this (us) */
+#define JANUS_BWE_DECREASE_INTERVAL	200000
+/* Window for the acknowledged bitrate (us) */
+#define JANUS_BWE_ACKED_WINDOW		500000
+/* Interval for loss-based updates (us), and minimum number of packets to look at */
+#define JANUS_BWE_LOSS_INTERVAL		G_USEC_PER_SEC
+#define JANUS_BWE_LOSS_MIN_PACKETS	20
+/* Increases can't bring the estimate above this much the acknowledged bitrate (plus
+ * some headroom), or an application-limited sender would see it grow indefinitely */
+#define JANUS_BWE_ACKED_CAP_FACTOR	1.5
+#define JANUS_BWE_ACKED_CAP_EXTRA	10000
+/* How often we notify increases of the estimate (us) */
+#define JANUS_BWE_NOTIFY_INTERVAL	G_USEC_PER_SEC
+
+
+const char *janus_bwe_usage_description(janus_bwe_usage usage) {
+	switch(usage) {
+		case janus_bwe_usage_normal:
+			return "normal";
+		case janus_bwe_usage_underuse:
+			return "underuse";
+		case janus_bwe_usage_overuse:
+			return "overuse";
+		default:
+			break;
+	}
+	return NULL;
+}
+
+const char *janus_bwe_state_description(janus_bwe_state state) {
+	switch(state) {
+		case janus_bwe_state_hold:
+			return "hold";
+		case janus_bwe_state_increase:
+			return "increase";
+		case janus_bwe_state_decrease:
+			return "decrease";
+		default:
+			break;
+	}
+	return NULL;
+}
+
+janus_bwe_context *janus_bwe_context_create(void) {
+	janus_bwe_context *bwe = g_malloc0(sizeof(janus_bwe_context));
+	bwe->threshold = JANUS_BWE_THRESHOLD_START;
+	bwe->overuse_time = -1;
+	bwe->usage = janus_bwe_usage_normal;
+	bwe->state = janus_bwe_state_hold;
+	bwe->delay_estimate = JANUS_BWE_START_BITRATE;
+	bwe->loss_estimate = JANUS_BWE_START_BITRATE;
+	bwe->estimate = JANUS_BWE_START_BITRATE;
+	return bwe;
+}
+
+void janus_bwe_context_destroy(janus_bwe_context *bwe) {
+	g_free(bwe);
+}
+
+void janus_bwe_context_add_sent_packet(janus_bwe_context *bwe, guint16 seq, guint16 size, gint64 now) {
+	if(bwe == NULL)
+		return;
+	janus_bwe_sent_packet *p = &bwe->history[seq & (JANUS_BWE_HISTORY_SIZE-1)];
+	p->seq = seq;
+	p->size = size;
+	p->acked = FALSE;
+	p->lost = FALSE;
+	p->sent = now;
+}
+
+/* Overuse detector: compare the modified trend to the adaptive threshold */
+static void janus_bwe_detect(janus_bwe_context *bwe, double send_delta_ms, gint64 arrival) {
+	if(bwe->deltas < 2) {
+		bwe->usage = janus_bwe_usage_normal;
+		return;
+	}
+	double trend = bwe->trend;
+	if(trend > bwe->threshold) {
+		if(bwe->overuse_time < 0)
+			bwe->overuse_time = send_delta_ms/2;
+		else
+			bwe->overuse_time += send_delta_ms;
+		bwe->overuse_count++;
+		if(bwe->overuse_time > JANUS_BWE_OVERUSE_TIME && bwe->overuse_count > 1 && trend >= bwe->prev_trend) {
+			bwe->overuse_time = 0;
+			bwe->overuse_count = 0;
+			bwe->usage = janus_bwe_usage_overuse;
+		}
+	} else if(trend < -bwe->threshold) {
+		bwe->overuse_time = -1;
+		bwe->overuse_count = 0;
+		bwe->usage = janus_bwe_usage_underuse;
+	} else {
+		bwe->overuse_time = -1;
+		bwe->overuse_count = 0;
+		bwe->usage = janus_bwe_usage_normal;
+	}
+	bwe->prev_trend = trend;
+	/* Update the adaptive threshold, unless this was a spike */
+	double abs_trend = fabs(trend);
+	if(bwe->threshold_ts == 0)
+		bwe->threshold_ts = arrival;
+	if(abs_trend > bwe->threshold + 15.0) {
+		bwe->threshold_ts = arrival;
+		return;
+	}
+	double k = abs_trend < bwe->threshold ? JANUS_BWE_THRESHOLD_K_DOWN : JANUS_BWE_THRESHOLD_K_UP;
+	double dt = (double)(arrival - bwe->threshold_ts)/1000;
+	if(dt > 100)
+		dt = 100;
+	else if(dt < 0)
+		dt = 0;
+	bwe->threshold += k * (abs_trend - bwe->threshold) * dt;
+	if(bwe->threshold < JANUS_BWE_THRESHOLD_MIN)
+		bwe->threshold = JANUS_BWE_THRESHOLD_MIN;
+	else if(bwe->threshold > JANUS_BWE_THRESHOLD_MAX)
+		bwe->threshold = JANUS_BWE_THRESHOLD_MAX;
+	bwe->threshold_ts = arrival;
+}
+
+/* Trendline filter: estimate the slope of the smoothed accumulated delay variation */
+static void janus_bwe_trendline_update(janus_bwe_context *bwe, double delay_ms, double send_delta_ms, gint64 arrival) {
+	bwe->deltas++;
+	bwe->accumulated_delay += delay_ms;
+	bwe->smoothed_delay = JANUS_BWE_SMOOTHING * bwe->smoothed_delay +
+		(1 - JANUS_BWE_SMOOTHING) * bwe->accumulated_delay;
+	if(bwe->first_arrival == 0)
+		bwe->first_arrival = arrival;
+	bwe->trend_x[bwe->trend_index] = (double)(arrival - bwe->first_arrival)/1000;
+	bwe->trend_y[bwe->trend_index] = bwe->smoothed_delay;
+	bwe->trend_index = (bwe->trend_index + 1) % JANUS_BWE_TRENDLINE_WINDOW;
+	if(bwe->trend_samples < JANUS_BWE_TRENDLINE_WINDOW)
+		bwe->trend_samples++;
+	if(bwe->trend_samples == JANUS_BWE_TRENDLINE_WINDOW) {
+		/* Linear regression on the samples we have */
+		double avg_x = 0, avg_y = 0;
+		guint i = 0;
+		for(i=0; i<JANUS_BWE_TRENDLINE_WINDOW; i++) {
+			avg_x += bwe->trend_x[i];
+			avg_y += bwe->trend_y[i];
+		}
+		avg_x /= JANUS_BWE_TRENDLINE_WINDOW;
+		avg_y /= JANUS_BWE_TRENDLINE_WINDOW;
+		double num = 0, den = 0;
+		for(i=0; i<JANUS_BWE_TRENDLINE_WINDOW; i++) {
+			num += (bwe->trend_x[i] - avg_x) * (bwe->trend_y[i] - avg_y);
+			den += (bwe->trend_x[i] - avg_x) * (bwe->trend_x[i] - avg_x);
+		}
+		if(den != 0) {
+			guint deltas = bwe->deltas < 60 ? bwe->deltas : 60;
+			bwe->trend = (num / den) * deltas * JANUS_BWE_THRESHOLD_GAIN;
+		}
+	}
+	janus_bwe_detect(bwe, send_delta_ms, arrival);
+}
+
+void janus_bwe_context_handle_feedback(void *data, uint16_t seq, gboolean received, int64_t arrival) {
+	janus_bwe_context *bwe = (janus_bwe_context *)data;
+	if(bwe == NULL)
+		return;
+	janus_bwe_sent_packet *p = &bwe->history[seq & (JANUS_BWE_HISTORY_SIZE-1)];
+	if(p->sent == 0 || p->seq != seq || p->acked) {
+		/* Unknown packet, or we got feedback for it already */
+		return;
+	}
+	if(!received) {
+		if(!p->lost) {
+			p->lost = TRUE;
+			bwe->fb_lost++;
+		}
+		return;
+	}
+	if(p->lost) {
+		/* We thought this was lost, but it arrived after all */
+		p->lost = FALSE;
+		if(bwe->fb_lost > 0)
+			bwe->fb_lost--;
+	}
+	p->acked = TRUE;
+	bwe->fb_received++;
+	bwe->acked_bytes += p->size;
+	/* Group packets by send time */
+	if(bwe->group_packets == 0) {
+		bwe->group_first_sent = p->sent;
+		bwe->group_last_sent = p->sent;
+		bwe->group_last_arrival = arrival;
+		bwe->group_packets = 1;
+		return;
+	}
+	if(p->sent < bwe->group_first_sent) {
+		/* Reordered, ignore it for delay purposes */
+		return;
+	}
+	if(p->sent - bwe->group_first_sent <= JANUS_BWE_BURST_TIME) {
+		/* Same group */
+		if(p->sent > bwe->group_last_sent)
+			bwe->group_last_sent = p->sent;
+		if(arrival > bwe->group_last_arrival)
+			bwe->group_last_arrival = arrival;
+		bwe->group_packets++;
+		return;
+	}
+	/* New group: compare the one that just completed to the previous one */
+	if(bwe->prev_group_packets > 0) {
+		double send_delta_ms = (double)(bwe->group_last_sent - bwe->prev_group_sent)/1000;
+		double arrival_delta_ms = (double)(bwe->group_last_arrival - bwe->prev_group_arrival)/1000;
+		janus_bwe_trendline_update(bwe, arrival_delta_ms - send_delta_ms, send_delta_ms, bwe->group_last_arrival);
+	}
+	bwe->prev_group_sent = bwe->group_last_sent;
+	bwe->prev_group_arrival = bwe->group_last_arrival;
+	bwe->prev_group_packets = bwe->group_packets;
+	bwe->group_first_sent = p->sent;
+	bwe->group_last_sent = p->sent;
+	bwe->group_last_arrival = arrival;
+	bwe->group_packets = 1;
+}
+
+/* Helper to apply an increase to an estimate, capped to the acknowledged bitrate */
+static guint32 janus_bwe_increase(janus_bwe_context *bwe, guint32 current, double increased) {
+	double cap = JANUS_BWE_MAX_BITRATE;
+	if(bwe->acked_bitrate > 0) {
+		double acked_cap = JANUS_BWE_ACKED_CAP_FACTOR * bwe->acked_bitrate + JANUS_BWE_ACKED_CAP_EXTRA;
+		if(acked_cap < cap)
+			cap = acked_cap;
+	}
+	if(increased > cap)
+		increased = cap;
+	/* We never decrease here, though */
+	return increased > current ? (guint32)increased : current;
+}
+
+guint32 janus_bwe_context_update(janus_bwe_context *bwe, gint64 now) {
+	if(bwe == NULL)
+		return 0;
+	/* Update the acknowledged bitrate */
+	if(bwe->acked_ts == 0)
+		bwe->acked_ts = now;
+	if(now - bwe->acked_ts >= JANUS_BWE_ACKED_WINDOW) {
+		bwe->acked_bitrate = (guint32)(((guint64)bwe->acked_bytes * 8 * G_USEC_PER_SEC) / (now - bwe->acked_ts));
+		bwe->acked_bytes = 0;
+		bwe->acked_ts = now;
+	}
+	/* Delay-based controller: the usage drives the state of the rate controller */
+	if(bwe->usage == janus_bwe_usage_overuse) {
+		bwe->state = janus_bwe_state_decrease;
+	} else if(bwe->usage == janus_bwe_usage_underuse) {
+		bwe->state = janus_bwe_state_hold;
+	} else if(bwe->state == janus_bwe_state_hold) {
+		bwe->state = janus_bwe_state_increase;
+	}
+	if(bwe->rate_ts == 0)
+		bwe->rate_ts = now;
+	if(bwe->state == janus_bwe_state_increase) {
+		gint64 elapsed = now - bwe->rate_ts;
+		if(elapsed > G_USEC_PER_SEC)
+			elapsed = G_USEC_PER_SEC;
+		double estimate = bwe->delay_estimate * pow(JANUS_BWE_INCREASE_FACTOR, (double)elapsed/G_USEC_PER_SEC);
+		bwe->delay_estimate = janus_bwe_increase(bwe, bwe->delay_estimate, estimate);
+	} else if(bwe->state == janus_bwe_state_decrease) {
+		if(now - bwe->decrease_ts >= JANUS_BWE_DECREASE_INTERVAL) {
+			guint32 base = bwe->acked_bitrate ? bwe->acked_bitrate : bwe->delay_estimate;
+			guint32 estimate = base * JANUS_BWE_DECREASE_FACTOR;
+			if(estimate < bwe->delay_estimate)
+				bwe->delay_estimate = estimate;
+			bwe->decrease_ts = now;
+			JANUS_LOG(LOG_HUGE, "[BWE] Overuse detected, decreasing estimate to %"SCNu32"\n", bwe->delay_estimate);
+		}
+		bwe->usage = janus_bwe_usage_normal;
+		bwe->state = janus_bwe_state_hold;
+	}
+	bwe->rate_ts = now;
+	/* Loss-based controller */
+	if(bwe->loss_ts == 0)
+		bwe->loss_ts = now;
+	guint32 packets = bwe->fb_received + bwe->fb_lost;
+	if(now - bwe->loss_ts >= JANUS_BWE_LOSS_INTERVAL && packets >= JANUS_BWE_LOSS_MIN_PACKETS) {
+		bwe->loss_ratio = (double)bwe->fb_lost / packets;
+		if(bwe->loss_ratio > 0.1) {
+			/* High losses: decrease, starting from the current estimate */
+			bwe->loss_estimate = bwe->estimate * (1 - 0.5*bwe->loss_ratio);
+			JANUS_LOG(LOG_HUGE, "[BWE] High losses (%.2f), decreasing estimate to %"SCNu32"\n",
+				bwe->loss_ratio, bwe->loss_estimate);
+		} else if(bwe->loss_ratio < 0.02) {
+			/* Low losses: increase */
+			double estimate = bwe->loss_estimate * JANUS_BWE_INCREASE_FACTOR;
+			bwe->loss_estimate = janus_bwe_increase(bwe, bwe->loss_estimate, estimate);
+		}
+		bwe->fb_received = 0;
+		bwe->fb_lost = 0;
+		bwe->loss_ts = now;
+	}
+	/* The estimate is the lower of the two */
+	guint32 estimate = bwe->delay_estimate < bwe->loss_estimate ? bwe->delay_estimate : bwe->loss_estimate;
+	if(estimate < JANUS_BWE_MIN_BITRATE)
+		estimate = JANUS_BWE_MIN_BITRATE;
+	bwe->estimate = estimate;
+	/* Should we notify about this? This is called for each RTCP packet, so
+	 * decreases are notified at most once per decrease interval, while
+	 * increases are notified at most once per second */
+	if(bwe->notified == 0 ||
+			(estimate < bwe->notified * 0.95 && now - bwe->notified_ts >= JANUS_BWE_DECREASE_INTERVAL) ||
+			(estimate > bwe->notified * 1.05 && now - bwe->notified_ts >= JANUS_BWE_NOTIFY_INTERVAL)) {
+		bwe->notified = estimate;
+		bwe->notified_ts = now;
+		return estimate;
+	}
+	return 0;
+}
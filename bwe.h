@@ -0,0 +1,166 @@
+/*! \file    bwe.h
+ * \author   Lorenzo Miniero <lorenzo@meetecho.com>
+ * \copyright GNU General Public License v3
+ * \brief    Send-side bandwidth estimation (headers)
+ * \details  Implementation of a send-side bandwidth estimator, loosely
+ * based on Google Congestion Control (GCC, draft-ietf-rmcat-gcc-02).
+ * Janus adds a transport-wide sequence number to the video packets it
+ * sends, and keeps track of when each of them was sent and how large it
+ * was: the transport-wide CC feedback the peer sends back then tells
+ * us when (and if) those packets were received. This information is
+ * used by two controllers: a delay-based one, that looks at how the
+ * one-way delay variation between groups of packets evolves over time
+ * (using a trendline filter and an adaptive threshold to detect overuse),
+ * and a loss-based one, that looks at the fraction of packets the peer
+ * reported as lost. The estimate is the lower of the two.
+ *
+ * The resulting estimate is what Janus thinks can be sent to the peer
+ * without causing congestion, and is made available to plugins via the
+ * \c estimated_bandwidth callback, so that they can adapt what they
+ * send accordingly (e.g., by picking a different simulcast substream).
+ *
+ * \ingroup protocols
+ * \ref protocols
+ */
+
+#ifndef JANUS_BWE_H
+#define JANUS_BWE_H
+
+#include <glib.h>
+
+/*! \brief Initial bandwidth estimate, until we get some feedback (bps) */
+#define JANUS_BWE_START_BITRATE		300000
+/*! \brief Minimum bandwidth estimate (bps) */
+#define JANUS_BWE_MIN_BITRATE		30000
+/*! \brief Maximum bandwidth estimate (bps) */
+#define JANUS_BWE_MAX_BITRATE		20000000
+/*! \brief Number of sent packets we keep track of (must be a power of two) */
+#define JANUS_BWE_HISTORY_SIZE		2048
+/*! \brief Number of delay samples the trendline filter works on */
+#define JANUS_BWE_TRENDLINE_WINDOW	20
+
+/*! \brief Usage of the network, as detected by the delay-based controller */
+typedef enum janus_bwe_usage {
+	/*! \brief Delay is not increasing nor decreasing */
+	janus_bwe_usage_normal = 0,
+	/*! \brief Delay is decreasing, queues are draining */
+	janus_bwe_usage_underuse,
+	/*! \brief Delay is increasing, we're sending too much */
+	janus_bwe_usage_overuse
+} janus_bwe_usage;
+/*! \brief Helper to return a string description of a network usage
+ * @param[in] usage The usage to describe
+ * @returns A string description */
+const char *janus_bwe_usage_description(janus_bwe_usage usage);
+
+/*! \brief State of the rate controller */
+typedef enum janus_bwe_state {
+	/*! \brief Keep the estimate as it is */
+	janus_bwe_state_hold = 0,
+	/*! \brief Increase the estimate */
+	janus_bwe_state_increase,
+	/*! \brief Decrease the estimate */
+	janus_bwe_state_decrease
+} janus_bwe_state;
+/*! \brief Helper to return a string description of a rate controller state
+ * @param[in] state The state to describe
+ * @returns A string description */
+const char *janus_bwe_state_description(janus_bwe_state state);
+
+/*! \brief Info on a packet we sent with a transport-wide sequence number */
+typedef struct janus_bwe_sent_packet {
+	/*! \brief Transport-wide sequence number */
+	guint16 seq;
+	/*! \brief Size of the packet */
+	guint16 size;
+	/*! \brief Whether the peer reported this packet as received */
+	gboolean acked;
+	/*! \brief Whether the peer reported this packet as lost (it may be received later) */
+	gboolean lost;
+	/*! \brief When we sent the packet (monotonic time) */
+	gint64 sent;
+} janus_bwe_sent_packet;
+
+/*! \brief Send-side bandwidth estimation context */
+typedef struct janus_bwe_context {
+	/*! \brief Ring of packets we sent, indexed by transport-wide sequence number */
+	janus_bwe_sent_packet history[JANUS_BWE_HISTORY_SIZE];
+	/*! \brief Send and arrival times of the first and last packets in the current group */
+	gint64 group_first_sent, group_last_sent, group_last_arrival;
+	/*! \brief Send and arrival times of the previous group */
+	gint64 prev_group_sent, prev_group_arrival;
+	/*! \brief Number of packets in the current and previous group */
+	guint group_packets, prev_group_packets;
+	/*! \brief Arrival time of the first group, used as a base for the trendline filter */
+	gint64 first_arrival;
+	/*! \brief Accumulated and smoothed one-way delay variation (ms) */
+	double accumulated_delay, smoothed_delay;
+	/*! \brief Samples for the trendline filter (arrival time and smoothed delay, in ms) */
+	double trend_x[JANUS_BWE_TRENDLINE_WINDOW], trend_y[JANUS_BWE_TRENDLINE_WINDOW];
+	/*! \brief Number of samples in the trendline filter, and where the next one goes */
+	guint trend_samples, trend_index;
+	/*! \brief Number of delay deltas we computed so far */
+	guint deltas;
+	/*! \brief Current and previous modified trend */
+	double trend, prev_trend;
+	/*! \brief Adaptive threshold for the overuse detector */
+	double threshold;
+	/*! \brief When we last updated the threshold */
+	gint64 threshold_ts;
+	/*! \brief For how long (ms) and how many times in a row we detected overuse */
+	double overuse_time;
+	guint overuse_count;
+	/*! \brief Current network usage, according to the delay-based controller */
+	janus_bwe_usage usage;
+	/*! \brief Current state of the rate controller */
+	janus_bwe_state state;
+	/*! \brief Delay-based and loss-based estimates (bps) */
+	guint32 delay_estimate, loss_estimate;
+	/*! \brief Current estimate (bps) */
+	guint32 estimate;
+	/*! \brief When the rate controller last changed the estimate, and last decreased it */
+	gint64 rate_ts, decrease_ts;
+	/*! \brief Bytes acknowledged by the peer in the current window */
+	guint32 acked_bytes;
+	/*! \brief When the current acknowledged bytes window started */
+	gint64 acked_ts;
+	/*! \brief Bitrate the peer acknowledged receiving (bps) */
+	guint32 acked_bitrate;
+	/*! \brief Packets the peer reported as received and lost since the last loss update */
+	guint32 fb_received, fb_lost;
+	/*! \brief Loss ratio in the latest loss update, as a fraction */
+	double loss_ratio;
+	/*! \brief When we last updated the loss-based estimate */
+	gint64 loss_ts;
+	/*! \brief Last estimate we notified, and when */
+	guint32 notified;
+	gint64 notified_ts;
+} janus_bwe_context;
+
+/*! \brief Create a new bandwidth estimation context
+ * @returns A new janus_bwe_context instance */
+janus_bwe_context *janus_bwe_context_create(void);
+/*! \brief Destroy a bandwidth estimation context
+ * @param[in] bwe The janus_bwe_context instance to destroy */
+void janus_bwe_context_destroy(janus_bwe_context *bwe);
+
+/*! \brief Keep track of a packet we just sent with a transport-wide sequence number
+ * @param[in] bwe The janus_bwe_context instance to update
+ * @param[in] seq The transport-wide sequence number of the packet
+ * @param[in] size The size of the packet
+ * @param[in] now The monotonic time the packet was sent at */
+void janus_bwe_context_add_sent_packet(janus_bwe_context *bwe, guint16 seq, guint16 size, gint64 now);
+/*! \brief Process feedback for a packet we sent, as reported by transport-wide CC feedback
+ * \note This is meant to be used as a janus_rtcp_transport_wide_cc_callback
+ * @param[in] data The janus_bwe_context instance to update
+ * @param[in] seq The transport-wide sequence number of the packet
+ * @param[in] received Whether the peer received this packet or not
+ * @param[in] arrival If received, the arrival time of the packet according to the peer's clock */
+void janus_bwe_context_handle_feedback(void *data, uint16_t seq, gboolean received, int64_t arrival);
+/*! \brief Update the estimate, after one or more feedback messages have been processed
+ * @param[in] bwe The janus_bwe_context instance to update
+ * @param[in] now The current monotonic time
+ * @returns The new estimate, if plugins should be notified about it, or 0 otherwise */
+guint32 janus_bwe_context_update(janus_bwe_context *bwe, gint64 now);
+
+#endif
@@ -149,7 +149,7 @@ static int janus_dtls_bio_agent_write(BIO *bio, const char *in, int inl) {
 		/* FIXME Just a warning for now, this will need to be solved with proper fragmentation */
 		JANUS_LOG(LOG_WARN, "[%"SCNu64"] The DTLS stack is trying to send a packet of %d bytes, this may be larger than the MTU and get dropped!\n", handle->handle_id, inl);
 	}
-	int bytes = nice_agent_send(handle->agent, component->stream_id, component->component_id, inl, in);
+	int bytes = janus_ice_component_send_raw(handle, component, inl, in);
 	if(bytes < inl) {
 		JANUS_LOG(LOG_ERR, "[%"SCNu64"] Error sending DTLS message on component %d of stream %d (%d)\n", handle->handle_id, component->component_id, stream->stream_id, bytes);
 	} else {
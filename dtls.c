@@ -22,6 +22,7 @@
 #include <openssl/bn.h>
 #include <openssl/evp.h>
 #include <openssl/rsa.h>
+#include <openssl/ec.h>
 #include <openssl/asn1.h>
 
 
@@ -117,6 +118,40 @@ static guint16 dtls_timeout_base = 1000;
 static SSL_CTX *ssl_ctx = NULL;
 static X509 *ssl_cert = NULL;
 static EVP_PKEY *ssl_key = NULL;
+static const char *ssl_key_type = NULL;
+const char *janus_dtls_get_key_type(void) {
+	return ssl_key_type;
+}
+
+/* DTLS handshake workers (disabled by default): when enabled, the event loop
+ * of a handle hands the SSL context to a worker as soon as the handshake starts,
+ * and queues the messages it receives for it until the handshake is over, at
+ * which point the worker gives the context back (see janus_ice_dtls_handshake_resume).
+ * A context is only ever owned by one thread at a time, and while a worker owns
+ * it the loop leaves it alone (no retransmissions, no alerts) */
+static GThreadPool *handshake_workers = NULL;
+static int handshake_workers_count = 0;
+static void janus_dtls_handshake_worker(gpointer data, gpointer user_data);
+void janus_dtls_set_handshake_workers(int workers) {
+	if(workers <= 0 || handshake_workers != NULL)
+		return;
+	GError *error = NULL;
+	handshake_workers = g_thread_pool_new(janus_dtls_handshake_worker, NULL, workers, FALSE, &error);
+	if(error != NULL) {
+		JANUS_LOG(LOG_ERR, "Error creating the DTLS handshake workers, will do handshakes in the event loops: %s\n",
+			error->message);
+		g_error_free(error);
+		handshake_workers = NULL;
+		return;
+	}
+	handshake_workers_count = workers;
+	JANUS_LOG(LOG_INFO, "Using %d DTLS handshake workers\n", handshake_workers_count);
+}
+int janus_dtls_get_handshake_workers(void) {
+	return handshake_workers_count;
+}
+static void janus_dtls_srtp_process(janus_dtls_srtp *dtls, janus_ice_handle *handle,
+	janus_ice_component *component, janus_ice_stream *stream, char *buf, uint16_t len);
 
 static gchar local_fingerprint[160];
 gchar *janus_dtls_get_local_fingerprint(void) {
@@ -174,52 +209,77 @@ static void janus_dtls_cb_openssl_lock(int mode, int type, const char *file, int
 #endif
 
 
-static int janus_dtls_generate_keys(X509 **certificate, EVP_PKEY **private_key) {
+static int janus_dtls_generate_keys(X509 **certificate, EVP_PKEY **private_key, gboolean rsa_private_key) {
 	static const int num_bits = 2048;
 	BIGNUM *bne = NULL;
 	RSA *rsa_key = NULL;
+	EC_KEY *ecc_key = NULL;
 	X509_NAME *cert_name = NULL;
 
-	JANUS_LOG(LOG_VERB, "Generating DTLS key / cert\n");
+	JANUS_LOG(LOG_VERB, "Generating DTLS key / cert (%s)\n", rsa_private_key ? "RSA" : "ECDSA");
 
-	/* Create a big number object. */
-	bne = BN_new();
-	if(!bne) {
-		JANUS_LOG(LOG_FATAL, "BN_new() failed\n");
+	/* Create a private key object (needed to hold the RSA or EC key). */
+	*private_key = EVP_PKEY_new();
+	if(!*private_key) {
+		JANUS_LOG(LOG_FATAL, "EVP_PKEY_new() failed\n");
 		goto error;
 	}
 
-	if(!BN_set_word(bne, RSA_F4)) {  /* RSA_F4 == 65537 */
-		JANUS_LOG(LOG_FATAL, "BN_set_word() failed\n");
-		goto error;
-	}
+	if(rsa_private_key) {
+		/* Create a big number object. */
+		bne = BN_new();
+		if(!bne) {
+			JANUS_LOG(LOG_FATAL, "BN_new() failed\n");
+			goto error;
+		}
 
-	/* Generate a RSA key. */
-	rsa_key = RSA_new();
-	if(!rsa_key) {
-		JANUS_LOG(LOG_FATAL, "RSA_new() failed\n");
-		goto error;
-	}
+		if(!BN_set_word(bne, RSA_F4)) {  /* RSA_F4 == 65537 */
+			JANUS_LOG(LOG_FATAL, "BN_set_word() failed\n");
+			goto error;
+		}
 
-	/* This takes some time. */
-	if(!RSA_generate_key_ex(rsa_key, num_bits, bne, NULL)) {
-		JANUS_LOG(LOG_FATAL, "RSA_generate_key_ex() failed\n");
-		goto error;
-	}
+		/* Generate a RSA key. */
+		rsa_key = RSA_new();
+		if(!rsa_key) {
+			JANUS_LOG(LOG_FATAL, "RSA_new() failed\n");
+			goto error;
+		}
 
-	/* Create a private key object (needed to hold the RSA key). */
-	*private_key = EVP_PKEY_new();
-	if(!*private_key) {
-		JANUS_LOG(LOG_FATAL, "EVP_PKEY_new() failed\n");
-		goto error;
-	}
+		/* This takes some time. */
+		if(!RSA_generate_key_ex(rsa_key, num_bits, bne, NULL)) {
+			JANUS_LOG(LOG_FATAL, "RSA_generate_key_ex() failed\n");
+			goto error;
+		}
 
-	if(!EVP_PKEY_assign_RSA(*private_key, rsa_key)) {
-		JANUS_LOG(LOG_FATAL, "EVP_PKEY_assign_RSA() failed\n");
-		goto error;
+		if(!EVP_PKEY_assign_RSA(*private_key, rsa_key)) {
+			JANUS_LOG(LOG_FATAL, "EVP_PKEY_assign_RSA() failed\n");
+			goto error;
+		}
+		/* The RSA key now belongs to the private key, so don't clean it up separately. */
+		rsa_key = NULL;
+	} else {
+		/* Generate an ECDSA key on NIST's P-256: signing with it (which is what
+		 * we do in each handshake) is much cheaper than with RSA-2048 */
+		ecc_key = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+		if(!ecc_key) {
+			JANUS_LOG(LOG_FATAL, "EC_KEY_new_by_curve_name() failed\n");
+			goto error;
+		}
+		/* Only encode the name of the curve in the certificate, not its parameters */
+		EC_KEY_set_asn1_flag(ecc_key, OPENSSL_EC_NAMED_CURVE);
+
+		if(!EC_KEY_generate_key(ecc_key)) {
+			JANUS_LOG(LOG_FATAL, "EC_KEY_generate_key() failed\n");
+			goto error;
+		}
+
+		if(!EVP_PKEY_assign_EC_KEY(*private_key, ecc_key)) {
+			JANUS_LOG(LOG_FATAL, "EVP_PKEY_assign_EC_KEY() failed\n");
+			goto error;
+		}
+		/* The EC key now belongs to the private key, so don't clean it up separately. */
+		ecc_key = NULL;
 	}
-	/* The RSA key now belongs to the private key, so don't clean it up separately. */
-	rsa_key = NULL;
 
 	/* Create the X509 certificate. */
 	*certificate = X509_new();
@@ -260,22 +320,25 @@ static int janus_dtls_generate_keys(X509 **certificate, EVP_PKEY **private_key)
 	}
 
 	/* Sign the certificate with the private key. */
-	if(!X509_sign(*certificate, *private_key, EVP_sha1())) {
+	if(!X509_sign(*certificate, *private_key, EVP_sha256())) {
 		JANUS_LOG(LOG_FATAL, "X509_sign() failed\n");
 		goto error;
 	}
 
 	/* Free stuff and resurn. */
-	BN_free(bne);
+	if(bne)
+		BN_free(bne);
 	return 0;
 
 error:
 	if(bne)
 		BN_free(bne);
-	if(rsa_key && !*private_key)
+	if(rsa_key)
 		RSA_free(rsa_key);
+	if(ecc_key)
+		EC_KEY_free(ecc_key);
 	if(*private_key)
-		EVP_PKEY_free(*private_key);  /* This also frees the RSA key. */
+		EVP_PKEY_free(*private_key);  /* This also frees the RSA/EC key, if assigned. */
 	if(*certificate)
 		X509_free(*certificate);
 	return -1;
@@ -330,7 +393,8 @@ const char *janus_get_ssl_version(void) {
 }
 
 /* DTLS-SRTP initialization */
-gint janus_dtls_srtp_init(const char *server_pem, const char *server_key, const char *password, guint16 timeout) {
+gint janus_dtls_srtp_init(const char *server_pem, const char *server_key, const char *password,
+		gboolean rsa_private_key, guint16 timeout) {
 	const char *crypto_lib = NULL;
 #if JANUS_USE_OPENSSL_PRE_1_1_API
 #if defined(LIBRESSL_VERSION_NUMBER)
@@ -381,7 +445,7 @@ gint janus_dtls_srtp_init(const char *server_pem, const char *server_key, const
 
 	if(!server_pem && !server_key) {
 		JANUS_LOG(LOG_WARN, "No cert/key specified, autogenerating some...\n");
-		if(janus_dtls_generate_keys(&ssl_cert, &ssl_key) != 0) {
+		if(janus_dtls_generate_keys(&ssl_cert, &ssl_key, rsa_private_key) != 0) {
 			JANUS_LOG(LOG_FATAL, "Error generating DTLS key/certificate\n");
 			return -2;
 		}
@@ -405,6 +469,18 @@ gint janus_dtls_srtp_init(const char *server_pem, const char *server_key, const
 		return -6;
 	}
 	SSL_CTX_set_read_ahead(ssl_ctx,1);
+	switch(EVP_PKEY_base_id(ssl_key)) {
+		case EVP_PKEY_RSA:
+			ssl_key_type = "rsa";
+			break;
+		case EVP_PKEY_EC:
+			ssl_key_type = "ecdsa";
+			break;
+		default:
+			ssl_key_type = "other";
+			break;
+	}
+	JANUS_LOG(LOG_INFO, "Type of our DTLS private key: %s\n", ssl_key_type);
 
 	unsigned int size;
 	unsigned char fingerprint[EVP_MAX_MD_SIZE];
@@ -464,6 +540,11 @@ static void janus_dtls_srtp_free(const janus_refcount *dtls_ref) {
 		}
 		/* FIXME What about dtls->remote_policy and dtls->local_policy? */
 	}
+	GBytes *msg = NULL;
+	while((msg = g_queue_pop_head(&dtls->pending)) != NULL)
+		g_bytes_unref(msg);
+	janus_mutex_destroy(&dtls->mutex);
+	janus_condition_destroy(&dtls->cond);
 	g_free(dtls);
 	dtls = NULL;
 }
@@ -506,6 +587,9 @@ janus_dtls_srtp *janus_dtls_srtp_create(void *ice_component, janus_dtls_role rol
 	janus_dtls_srtp *dtls = g_malloc0(sizeof(janus_dtls_srtp));
 	g_atomic_int_set(&dtls->destroyed, 0);
 	janus_refcount_init(&dtls->ref, janus_dtls_srtp_free);
+	g_queue_init(&dtls->pending);
+	janus_mutex_init(&dtls->mutex);
+	janus_condition_init(&dtls->cond);
 	/* Create SSL context, at last */
 	dtls->srtp_valid = 0;
 	dtls->ssl = SSL_new(ssl_ctx);
@@ -557,6 +641,8 @@ janus_dtls_srtp *janus_dtls_srtp_create(void *ice_component, janus_dtls_role rol
 #endif
 	dtls->ready = 0;
 	dtls->retransmissions = 0;
+	g_atomic_int_set(&dtls->offloaded, 0);
+	dtls->kick = FALSE;
 #ifdef HAVE_SCTP
 	dtls->sctp = NULL;
 #endif
@@ -566,6 +652,82 @@ janus_dtls_srtp *janus_dtls_srtp_create(void *ice_component, janus_dtls_role rol
 	return dtls;
 }
 
+/* Hand a DTLS context to a handshake worker: only called by the event loop of
+ * the handle, with the mutex of the stack locked. As janus_dtls_srtp_destroy waits
+ * for the worker to be done, the component, stream and handle are still there for
+ * as long as the worker owns the stack */
+static void janus_dtls_srtp_offload(janus_dtls_srtp *dtls) {
+	g_atomic_int_set(&dtls->offloaded, 1);
+	janus_refcount_increase(&dtls->ref);
+	g_thread_pool_push(handshake_workers, dtls, NULL);
+}
+/* Give a DTLS context back to the event loop: only called by the handshake
+ * worker, with the mutex of the stack locked; janus_dtls_srtp_destroy may be
+ * waiting for this to happen */
+static void janus_dtls_srtp_giveback(janus_dtls_srtp *dtls) {
+	g_atomic_int_set(&dtls->offloaded, 0);
+	janus_condition_broadcast(&dtls->cond);
+}
+static void janus_dtls_handshake_worker(gpointer data, gpointer user_data) {
+	janus_dtls_srtp *dtls = (janus_dtls_srtp *)data;
+	janus_ice_component *component = (janus_ice_component *)dtls->component;
+	janus_ice_stream *stream = component ? component->stream : NULL;
+	janus_ice_handle *handle = stream ? stream->handle : NULL;
+	if(handle == NULL) {
+		/* The stack is being destroyed */
+		janus_mutex_lock(&dtls->mutex);
+		janus_dtls_srtp_giveback(dtls);
+		janus_mutex_unlock(&dtls->mutex);
+		janus_refcount_decrease(&dtls->ref);
+		return;
+	}
+	/* We may need the handle after giving the stack back */
+	janus_refcount_increase(&handle->ref);
+	gboolean finished = FALSE;
+	while(!finished && !g_atomic_int_get(&dtls->destroyed) &&
+			!janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_ALERT)) {
+		janus_mutex_lock(&dtls->mutex);
+		gboolean kick = dtls->kick;
+		dtls->kick = FALSE;
+		GBytes *msg = kick ? NULL : g_queue_pop_head(&dtls->pending);
+		if(!kick && msg == NULL) {
+			/* Nothing to do for now: the next message will need a new worker */
+			janus_dtls_srtp_giveback(dtls);
+			janus_mutex_unlock(&dtls->mutex);
+			janus_refcount_decrease(&handle->ref);
+			janus_refcount_decrease(&dtls->ref);
+			return;
+		}
+		janus_mutex_unlock(&dtls->mutex);
+		if(msg != NULL) {
+			gsize size = 0;
+			const char *buf = g_bytes_get_data(msg, &size);
+			int written = BIO_write(dtls->read_bio, buf, size);
+			if(written != (int)size) {
+				JANUS_LOG(LOG_WARN, "[%"SCNu64"]     Only written %d/%"SCNu64" of those bytes on the read BIO...\n",
+					handle->handle_id, written, (guint64)size);
+			}
+			g_bytes_unref(msg);
+		}
+		/* This is where the expensive part happens (key exchange, signatures) */
+		int res = SSL_do_handshake(dtls->ssl);
+		if(res <= 0 && SSL_get_error(dtls->ssl, res) == SSL_ERROR_SSL) {
+			char error[200];
+			ERR_error_string_n(ERR_get_error(), error, 200);
+			JANUS_LOG(LOG_ERR, "[%"SCNu64"] Handshake error: %s\n", handle->handle_id, error);
+		}
+		finished = SSL_is_init_finished(dtls->ssl);
+	}
+	/* The handshake is over (or the stack is going away): the loop takes it from here */
+	janus_mutex_lock(&dtls->mutex);
+	janus_dtls_srtp_giveback(dtls);
+	janus_mutex_unlock(&dtls->mutex);
+	if(finished && !g_atomic_int_get(&dtls->destroyed))
+		janus_ice_dtls_handshake_resume(handle);
+	janus_refcount_decrease(&handle->ref);
+	janus_refcount_decrease(&dtls->ref);
+}
+
 void janus_dtls_srtp_handshake(janus_dtls_srtp *dtls) {
 	if(dtls == NULL || dtls->ssl == NULL)
 		return;
@@ -579,7 +741,16 @@ void janus_dtls_srtp_handshake(janus_dtls_srtp *dtls) {
 		}
 		dtls->dtls_state = JANUS_DTLS_STATE_TRYING;
 	}
-	SSL_do_handshake(dtls->ssl);
+	if(handshake_workers != NULL) {
+		/* Let a handshake worker take care of this */
+		janus_mutex_lock(&dtls->mutex);
+		dtls->kick = TRUE;
+		if(!g_atomic_int_get(&dtls->offloaded))
+			janus_dtls_srtp_offload(dtls);
+		janus_mutex_unlock(&dtls->mutex);
+	} else if(!g_atomic_int_get(&dtls->offloaded)) {
+		SSL_do_handshake(dtls->ssl);
+	}
 
 	/* Notify event handlers */
 	janus_dtls_notify_state_change(dtls);
@@ -644,11 +815,69 @@ void janus_dtls_srtp_incoming_msg(janus_dtls_srtp *dtls, char *buf, uint16_t len
 		/* Handshake not started yet: maybe we're still waiting for the answer and the DTLS role? */
 		return;
 	}
-	int written = BIO_write(dtls->read_bio, buf, len);
-	if(written != len) {
-		JANUS_LOG(LOG_WARN, "[%"SCNu64"]     Only written %d/%d of those bytes on the read BIO...\n", handle->handle_id, written, len);
-	} else {
-		JANUS_LOG(LOG_HUGE, "[%"SCNu64"]     Written %d bytes on the read BIO...\n", handle->handle_id, written);
+	if(handshake_workers != NULL && !dtls->ready) {
+		janus_mutex_lock(&dtls->mutex);
+		if(g_atomic_int_get(&dtls->offloaded) || !g_queue_is_empty(&dtls->pending) ||
+				(dtls->dtls_state == JANUS_DTLS_STATE_TRYING && !SSL_is_init_finished(dtls->ssl))) {
+			/* Still handshaking: either a worker takes care of this message, or
+			 * we process it after those that came before it (see below) */
+			g_queue_push_tail(&dtls->pending, g_bytes_new(buf, len));
+			if(g_atomic_int_get(&dtls->offloaded)) {
+				janus_mutex_unlock(&dtls->mutex);
+				return;
+			}
+			if(dtls->dtls_state == JANUS_DTLS_STATE_TRYING && !SSL_is_init_finished(dtls->ssl)) {
+				janus_dtls_srtp_offload(dtls);
+				janus_mutex_unlock(&dtls->mutex);
+				return;
+			}
+			janus_mutex_unlock(&dtls->mutex);
+			janus_dtls_srtp_resume(dtls);
+			return;
+		}
+		janus_mutex_unlock(&dtls->mutex);
+	}
+	janus_dtls_srtp_process(dtls, handle, component, stream, buf, len);
+}
+
+void janus_dtls_srtp_resume(janus_dtls_srtp *dtls) {
+	if(dtls == NULL || g_atomic_int_get(&dtls->destroyed) || g_atomic_int_get(&dtls->offloaded))
+		return;
+	janus_ice_component *component = (janus_ice_component *)dtls->component;
+	janus_ice_stream *stream = component ? component->stream : NULL;
+	janus_ice_handle *handle = stream ? stream->handle : NULL;
+	if(!handle || !handle->agent || !dtls->ssl)
+		return;
+	/* If a worker completed the handshake, set SRTP up as we'd do ourselves */
+	if(!dtls->ready && dtls->dtls_state == JANUS_DTLS_STATE_TRYING && SSL_is_init_finished(dtls->ssl))
+		janus_dtls_srtp_process(dtls, handle, component, stream, NULL, 0);
+	/* Then process, in order, the messages that arrived in the meanwhile */
+	janus_mutex_lock(&dtls->mutex);
+	GBytes *msg = NULL;
+	while(!g_atomic_int_get(&dtls->offloaded) && (msg = g_queue_pop_head(&dtls->pending)) != NULL) {
+		janus_mutex_unlock(&dtls->mutex);
+		gsize size = 0;
+		char *buf = (char *)g_bytes_get_data(msg, &size);
+		if(!janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_ALERT))
+			janus_dtls_srtp_process(dtls, handle, component, stream, buf, size);
+		g_bytes_unref(msg);
+		janus_mutex_lock(&dtls->mutex);
+	}
+	janus_mutex_unlock(&dtls->mutex);
+}
+
+/* Feed a DTLS message, if any, to the stack: only ever called by the event loop of the
+ * handle, when no handshake worker owns the SSL context; a NULL buffer just checks whether
+ * the handshake has completed, and if so sets SRTP up */
+static void janus_dtls_srtp_process(janus_dtls_srtp *dtls, janus_ice_handle *handle,
+		janus_ice_component *component, janus_ice_stream *stream, char *buf, uint16_t len) {
+	if(buf != NULL) {
+		int written = BIO_write(dtls->read_bio, buf, len);
+		if(written != len) {
+			JANUS_LOG(LOG_WARN, "[%"SCNu64"]     Only written %d/%d of those bytes on the read BIO...\n", handle->handle_id, written, len);
+		} else {
+			JANUS_LOG(LOG_HUGE, "[%"SCNu64"]     Written %d bytes on the read BIO...\n", handle->handle_id, written);
+		}
 	}
 	/* Try to read data */
 	char data[1500];	/* FIXME */
@@ -908,7 +1137,7 @@ void janus_dtls_srtp_send_alert(janus_dtls_srtp *dtls) {
 		return;
 	/* Send alert */
 	janus_refcount_increase(&dtls->ref);
-	if(dtls != NULL && dtls->ssl != NULL) {
+	if(dtls != NULL && dtls->ssl != NULL && !g_atomic_int_get(&dtls->offloaded)) {
 		SSL_shutdown(dtls->ssl);
 	}
 	janus_refcount_decrease(&dtls->ref);
@@ -917,6 +1146,11 @@ void janus_dtls_srtp_send_alert(janus_dtls_srtp *dtls) {
 void janus_dtls_srtp_destroy(janus_dtls_srtp *dtls) {
 	if(!dtls || !g_atomic_int_compare_and_exchange(&dtls->destroyed, 0, 1))
 		return;
+	/* If a handshake worker owns the stack, wait for it to give it back */
+	janus_mutex_lock(&dtls->mutex);
+	while(g_atomic_int_get(&dtls->offloaded))
+		janus_condition_wait(&dtls->cond, &dtls->mutex);
+	janus_mutex_unlock(&dtls->mutex);
 	dtls->ready = 0;
 	dtls->retransmissions = 0;
 #ifdef HAVE_SCTP
@@ -1031,6 +1265,10 @@ gboolean janus_dtls_retry(gpointer stack) {
 		janus_ice_webrtc_hangup(handle, "DTLS timeout");
 		goto stoptimer;
 	}
+	if(g_atomic_int_get(&dtls->offloaded)) {
+		/* A handshake worker owns the stack right now, try again on next iter */
+		return TRUE;
+	}
 	struct timeval timeout = {0};
 	if(DTLSv1_get_timeout(dtls->ssl, &timeout) == 0) {
 		/* failed to get timeout. try again on next iter */
@@ -22,6 +22,7 @@
 #include "rtpsrtp.h"
 #include "sctp.h"
 #include "refcount.h"
+#include "mutex.h"
 #include "dtls-bio.h"
 
 /*! \brief Helper method to return info on the crypto library and its version
@@ -32,13 +33,30 @@ const char *janus_get_ssl_version(void);
  * @param[in] server_pem Path to the certificate to use
  * @param[in] server_key Path to the key to use
  * @param[in] password Password needed to use the key, if any
+ * @param[in] rsa_private_key Whether the key to autogenerate, if no certificate is provided, should be RSA-2048 rather than ECDSA P-256
  * @param[in] timeout DTLS timeout base, in ms, to use for retransmissions (ignored if not using BoringSSL)
  * @returns 0 in case of success, a negative integer on errors */
-gint janus_dtls_srtp_init(const char *server_pem, const char *server_key, const char *password, guint16 timeout);
+gint janus_dtls_srtp_init(const char *server_pem, const char *server_key, const char *password,
+	gboolean rsa_private_key, guint16 timeout);
 /*! \brief Method to cleanup DTLS stuff before exiting */
 void janus_dtls_srtp_cleanup(void);
 /*! \brief Method to return a string representation (SHA-256) of the certificate fingerprint */
 gchar *janus_dtls_get_local_fingerprint(void);
+/*! \brief Method to create a pool of threads that take care of the DTLS handshakes
+ * \details By default, the expensive part of a DTLS handshake (key exchange,
+ * signing, verifying the certificate of the peer) happens in the event loop of
+ * the handle, which also serves media to all the other handles on that loop.
+ * When enabled, the handshake messages are processed by this pool instead: a
+ * DTLS context is owned by a single worker at a time, and once the handshake
+ * is over, the event loop takes over again to set SRTP up and exchange data
+ * @param[in] workers Number of handshake workers to create (0 disables them) */
+void janus_dtls_set_handshake_workers(int workers);
+/*! \brief Method to get the number of handshake workers
+ * @returns The number of handshake workers, or 0 if handshakes are done in the event loops */
+int janus_dtls_get_handshake_workers(void);
+/*! \brief Method to return the type of the private key used for DTLS
+ * @returns "ecdsa", "rsa", or "other" if we're using a certificate of a different type */
+const char *janus_dtls_get_key_type(void);
 
 
 /*! \brief DTLS roles */
@@ -90,6 +108,16 @@ typedef struct janus_dtls_srtp {
 	int ready;
 	/*! \brief The number of retransmissions that have occurred for this DTLS instance so far */
 	int retransmissions;
+	/*! \brief Whether a handshake worker currently owns the SSL context (see janus_dtls_set_handshake_workers) */
+	volatile gint offloaded;
+	/*! \brief Whether the handshake worker should (re)start the handshake, rather than just feed it messages */
+	gboolean kick;
+	/*! \brief DTLS messages received while a handshake worker owns the SSL context, as GBytes */
+	GQueue pending;
+	/*! \brief Mutex to lock/unlock the pending messages and the offloaded flag */
+	janus_mutex mutex;
+	/*! \brief Condition signalled when a handshake worker gives the SSL context back */
+	janus_condition cond;
 #ifdef HAVE_SCTP
 	/*! \brief SCTP association, if DataChannels are involved */
 	janus_sctp_association *sctp;
@@ -121,6 +149,10 @@ int janus_dtls_srtp_create_sctp(janus_dtls_srtp *dtls);
  * @param[in] buf The DTLS message data
  * @param[in] len The DTLS message data lenght */
 void janus_dtls_srtp_incoming_msg(janus_dtls_srtp *dtls, char *buf, uint16_t len);
+/*! \brief Take over a DTLS context again after a handshake worker is done with it
+ * \note To be called by the event loop of the handle, after janus_ice_dtls_handshake_resume
+ * @param[in] dtls The janus_dtls_srtp instance to resume */
+void janus_dtls_srtp_resume(janus_dtls_srtp *dtls);
 /*! \brief Send an alert on a janus_dtls_srtp instance
  * @param[in] dtls The janus_dtls_srtp instance to send the alert on */
 void janus_dtls_srtp_send_alert(janus_dtls_srtp *dtls);
@@ -0,0 +1,38 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include <glib.h>
+#include <jansson.h>
+#include "../debug.h"
+#include "../utils.h"
+
+int janus_log_level = LOG_NONE;
+gboolean janus_log_timestamps = FALSE;
+gboolean janus_log_colors = FALSE;
+char *janus_log_global_prefix = NULL;
+int lock_debug = 0;
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+	/* Decode the CBOR message: most inputs will be rejected here */
+	json_error_t error;
+	json_t *message = janus_cbor_decode((const char *)data, size, &error);
+	if(message == NULL)
+		return 0;
+	/* Whatever we could decode, we must be able to encode back... */
+	size_t length = 0;
+	char *encoded = janus_cbor_encode(message, &length);
+	if(encoded == NULL)
+		abort();
+	/* ... and decoding that must give us the same message again */
+	json_t *decoded = janus_cbor_decode(encoded, length, &error);
+	if(decoded == NULL || !json_equal(message, decoded))
+		abort();
+
+	/* Free resources */
+	json_decref(decoded);
+	json_decref(message);
+	g_free(encoded);
+
+	return 0;
+}
@@ -73,6 +73,14 @@ int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
 	janus_rtp_header_extension_parse_mid((char *)data, size, 1, sdes_item, sizeof(sdes_item));
 	janus_rtp_header_extension_parse_transport_wide_cc((char *)data, size, 1, &transport_seq_num);
 	janus_rtp_header_extension_parse_framemarking((char *)data, size, 1, JANUS_VIDEOCODEC_NONE, &temporal_layer_id);
+	/* Single pass parser, with a different extension on each ID */
+	janus_rtp_extmap extmap;
+	janus_rtp_extension_values values;
+	janus_rtp_extmap_reset(&extmap);
+	int id = 0;
+	for(id=1; id<=JANUS_RTP_EXTENSION_FRAMEMARKING; id++)
+		janus_rtp_extmap_set(&extmap, id, id);
+	janus_rtp_header_extensions_parse((char *)data, size, &extmap, &values);
 
 	/* Extract codec payload */
 	int plen = 0;
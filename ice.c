@@ -19,9 +19,16 @@
 #include <net/if.h>
 #include <sys/socket.h>
 #include <sys/time.h>
+#include <netinet/udp.h>
+#include <arpa/inet.h>
+#include <errno.h>
 #include <netdb.h>
 #include <fcntl.h>
+#ifdef HAVE_SCHED_SETAFFINITY
+#include <sched.h>
+#endif
 #include <stun/usages/bind.h>
+#include <stun/usages/ice.h>
 #include <nice/debug.h>
 
 #include "janus.h"
@@ -106,16 +113,826 @@ gboolean janus_is_opaqueid_in_api_enabled(void) {
 	return opaqueid_in_api;
 }
 
+/* Batched egress (disabled by default): when enabled, all the packets a handle
+ * has queued are protected into a scratch area owned by the event loop, and
+ * then handed to the kernel at once with sendmmsg or, when all packets have
+ * the same size, as a single UDP GSO super-packet. Since this bypasses
+ * nice_agent_send, it's only done when the selected pair is plain UDP */
+static gboolean egress_batching = FALSE;
+#ifdef HAVE_SENDMMSG
+#ifndef SOL_UDP
+#define SOL_UDP		17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT	103
+#endif
+#define JANUS_ICE_EGRESS_BATCH_MAX		64
+#define JANUS_ICE_EGRESS_SLOT_SIZE		(1500+SRTP_MAX_TAG_LEN)
+#define JANUS_ICE_EGRESS_GSO_MAX_SIZE	65000
+static volatile gint egress_gso = 1;
+#endif
+#define JANUS_ICE_EGRESS_HISTOGRAM_SIZE	7
+struct janus_ice_egress_batch {
+#ifdef HAVE_SENDMMSG
+	/* Scratch area for the packets to send, and related metadata */
+	char slots[JANUS_ICE_EGRESS_BATCH_MAX][JANUS_ICE_EGRESS_SLOT_SIZE];
+	struct iovec iov[JANUS_ICE_EGRESS_BATCH_MAX];
+	struct mmsghdr msgs[JANUS_ICE_EGRESS_BATCH_MAX];
+	int count;
+	/* Component the packets in the batch are meant for */
+	janus_ice_component *component;
+#endif
+	/* Statistics (only updated by the thread owning the loop) */
+	guint64 batches, packets, syscalls, gso, dropped;
+	/* Histogram of batch sizes (1, 2, 3-4, 5-8, 9-16, 17-32, 33-64) */
+	guint64 histogram[JANUS_ICE_EGRESS_HISTOGRAM_SIZE];
+};
+static const char *janus_ice_egress_histogram_labels[JANUS_ICE_EGRESS_HISTOGRAM_SIZE] = {
+	"1", "2", "3-4", "5-8", "9-16", "17-32", "33-64"
+};
+void janus_ice_enable_egress_batching(void) {
+#ifndef HAVE_SENDMMSG
+	JANUS_LOG(LOG_WARN, "Batched egress not supported (needs sendmmsg and libnice >= 0.1.5), ignoring\n");
+#else
+	JANUS_LOG(LOG_VERB, "Enabling batched egress\n");
+	egress_batching = TRUE;
+#endif
+}
+gboolean janus_ice_is_egress_batching_enabled(void) {
+	return egress_batching;
+}
+static janus_ice_egress_batch *janus_ice_egress_batch_new(void) {
+	if(!egress_batching)
+		return NULL;
+	return g_malloc0(sizeof(janus_ice_egress_batch));
+}
+static json_t *janus_ice_egress_batch_summary(janus_ice_egress_batch *batch) {
+	if(batch == NULL)
+		return NULL;
+	json_t *egress = json_object();
+	json_object_set_new(egress, "batches", json_integer(batch->batches));
+	json_object_set_new(egress, "packets", json_integer(batch->packets));
+	json_object_set_new(egress, "syscalls", json_integer(batch->syscalls));
+	json_object_set_new(egress, "gso", json_integer(batch->gso));
+	json_object_set_new(egress, "dropped", json_integer(batch->dropped));
+	json_t *histogram = json_object();
+	int i = 0;
+	for(i=0; i<JANUS_ICE_EGRESS_HISTOGRAM_SIZE; i++)
+		json_object_set_new(histogram, janus_ice_egress_histogram_labels[i], json_integer(batch->histogram[i]));
+	json_object_set_new(egress, "histogram", histogram);
+	return egress;
+}
+json_t *janus_ice_handle_egress_summary(janus_ice_handle *handle) {
+	if(handle == NULL)
+		return NULL;
+	return janus_ice_egress_batch_summary(handle->egress);
+}
+
+/* Batched ingress (disabled by default): once the selected pair is plain UDP and
+ * not relayed, we stop libnice from reading from its socket, and read from it
+ * ourselves with recvmmsg instead, many datagrams per dispatch. Since there's no
+ * way to feed libnice packets it didn't read, the connectivity checks we get on
+ * that socket (e.g., consent freshness) are answered by us as well */
+static gboolean ingress_batching = FALSE;
+void janus_ice_enable_ingress_batching(void) {
+#ifndef HAVE_RECVMMSG
+	JANUS_LOG(LOG_WARN, "Batched ingress not supported (needs recvmmsg and libnice >= 0.1.5), ignoring\n");
+#else
+	JANUS_LOG(LOG_VERB, "Enabling batched ingress\n");
+	ingress_batching = TRUE;
+#endif
+}
+gboolean janus_ice_is_ingress_batching_enabled(void) {
+	return ingress_batching;
+}
+#ifdef HAVE_RECVMMSG
+static void janus_ice_component_update_ingress(janus_ice_handle *handle, janus_ice_component *component);
+static gboolean janus_ice_mux_address_equal(gconstpointer a, gconstpointer b);
+#endif
+static void janus_ice_component_release_ingress(janus_ice_handle *handle, janus_ice_component *component, gboolean reattach);
+
+#ifdef HAVE_SENDMMSG
+static void janus_ice_egress_batch_flush(janus_ice_handle *handle, janus_ice_egress_batch *batch) {
+	if(batch == NULL || batch->count == 0)
+		return;
+	janus_ice_component *component = batch->component;
+	int count = batch->count, sent = 0, i = 0;
+	batch->count = 0;
+	/* Update the stats first */
+	int bucket = 0;
+	while(bucket < JANUS_ICE_EGRESS_HISTOGRAM_SIZE-1 && (1 << bucket) < count)
+		bucket++;
+	batch->histogram[bucket]++;
+	batch->batches++;
+	batch->packets += count;
+	if(component == NULL || component->egress_socket == NULL || g_socket_is_closed(component->egress_socket)) {
+		batch->dropped += count;
+		return;
+	}
+	int fd = g_socket_get_fd(component->egress_socket);
+	if(count > 1 && g_atomic_int_get(&egress_gso)) {
+		/* We can only send a single GSO super-packet if all packets have
+		 * the same size (the last one is allowed to be smaller, though) */
+		size_t segment = batch->iov[0].iov_len, total = 0;
+		gboolean gso = TRUE;
+		for(i=0; i<count; i++) {
+			total += batch->iov[i].iov_len;
+			if((i < count-1 && batch->iov[i].iov_len != segment) || batch->iov[i].iov_len > segment) {
+				gso = FALSE;
+				break;
+			}
+		}
+		if(gso && total <= JANUS_ICE_EGRESS_GSO_MAX_SIZE) {
+			char control[CMSG_SPACE(sizeof(uint16_t))];
+			memset(control, 0, sizeof(control));
+			struct msghdr msg = { 0 };
+			msg.msg_name = &component->egress_addr;
+			msg.msg_namelen = component->egress_addrlen;
+			msg.msg_iov = batch->iov;
+			msg.msg_iovlen = count;
+			msg.msg_control = control;
+			msg.msg_controllen = sizeof(control);
+			struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+			cm->cmsg_level = SOL_UDP;
+			cm->cmsg_type = UDP_SEGMENT;
+			cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+			uint16_t gso_size = segment;
+			memcpy(CMSG_DATA(cm), &gso_size, sizeof(gso_size));
+			batch->syscalls++;
+			if(sendmsg(fd, &msg, 0) >= 0) {
+				batch->gso++;
+				return;
+			}
+			if(errno != EIO && errno != EINVAL && errno != ENOPROTOOPT && errno != EOPNOTSUPP) {
+				/* Not a GSO issue, don't bother trying again */
+				JANUS_LOG(LOG_DBG, "[%"SCNu64"] ... GSO send error (%d, %s)\n", handle->handle_id, errno, g_strerror(errno));
+				batch->dropped += count;
+				return;
+			}
+			/* Either the kernel or the NIC can't do GSO, stop trying */
+			JANUS_LOG(LOG_WARN, "[%"SCNu64"] UDP GSO not available (%d, %s), falling back to sendmmsg\n",
+				handle->handle_id, errno, g_strerror(errno));
+			g_atomic_int_set(&egress_gso, 0);
+		}
+	}
+	for(i=0; i<count; i++) {
+		memset(&batch->msgs[i], 0, sizeof(struct mmsghdr));
+		batch->msgs[i].msg_hdr.msg_name = &component->egress_addr;
+		batch->msgs[i].msg_hdr.msg_namelen = component->egress_addrlen;
+		batch->msgs[i].msg_hdr.msg_iov = &batch->iov[i];
+		batch->msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+	while(sent < count) {
+		batch->syscalls++;
+		int res = sendmmsg(fd, batch->msgs + sent, count - sent, 0);
+		if(res < 0) {
+			if(errno == EINTR)
+				continue;
+			/* Just as libnice would, we drop what we couldn't send */
+			JANUS_LOG(LOG_DBG, "[%"SCNu64"] ... sendmmsg error (%d, %s), dropping %d packets\n",
+				handle->handle_id, errno, g_strerror(errno), count - sent);
+			batch->dropped += (count - sent);
+			break;
+		}
+		sent += res;
+	}
+}
+#endif
+
+/* Pacing of outgoing video (disabled by default): when enabled, video packets
+ * don't leave as soon as the plugin relays them, but go through a leaky bucket
+ * in the outgoing traffic source of the handle, drained at a multiple of the
+ * current bitrate (the bandwidth estimate, if we have one); audio and RTCP are
+ * never paced, and so always get priority. Packets that waited longer than the
+ * queue-time cap are sent anyway, to avoid adding too much latency */
+static gboolean pacing = FALSE;
+static double pacing_multiplier = DEFAULT_PACING_MULTIPLIER;
+static guint pacing_max_queue = DEFAULT_PACING_MAX_QUEUE;
+/* Minimum rate we pace at (bps), and how many ms of budget can accumulate when idle */
+#define JANUS_ICE_PACER_MIN_RATE	300000
+#define JANUS_ICE_PACER_BURST		5
+#define JANUS_ICE_PACER_HISTOGRAM_SIZE	7
+struct janus_ice_pacer {
+	/* Video packets waiting to be sent, and their size */
+	GQueue queue;
+	guint queued_bytes;
+	/* Leaky bucket: bytes we can send right now (negative if we're in debt) */
+	gint64 budget;
+	gint64 last_ts;
+	/* Rate we're currently pacing at (bps) */
+	guint32 rate;
+	/* Statistics (only updated by the thread owning the loop) */
+	guint64 packets, bytes, overdue;
+	gint64 max_delay;
+	/* Histogram of queue delays (0-5ms, 5-10ms, 10-20ms, 20-50ms, 50-100ms, 100-250ms, 250ms+) */
+	guint64 histogram[JANUS_ICE_PACER_HISTOGRAM_SIZE];
+};
+static const char *janus_ice_pacer_histogram_labels[JANUS_ICE_PACER_HISTOGRAM_SIZE] = {
+	"0-5ms", "5-10ms", "10-20ms", "20-50ms", "50-100ms", "100-250ms", "250ms+"
+};
+static const gint64 janus_ice_pacer_histogram_bounds[JANUS_ICE_PACER_HISTOGRAM_SIZE-1] = {
+	5000, 10000, 20000, 50000, 100000, 250000
+};
+void janus_ice_enable_pacing(double multiplier, guint max_queue) {
+	if(multiplier < 1.0) {
+		JANUS_LOG(LOG_WARN, "Invalid pacing multiplier %.2f, using %.2f\n", multiplier, DEFAULT_PACING_MULTIPLIER);
+		multiplier = DEFAULT_PACING_MULTIPLIER;
+	}
+	if(max_queue == 0 || max_queue >= 1000) {
+		/* Packets older than a second are discarded when sending, so stay below that */
+		JANUS_LOG(LOG_WARN, "Invalid pacing queue cap %u (should be 1-999ms), using %dms\n", max_queue, DEFAULT_PACING_MAX_QUEUE);
+		max_queue = DEFAULT_PACING_MAX_QUEUE;
+	}
+	JANUS_LOG(LOG_VERB, "Enabling pacing of outgoing video (multiplier %.2f, max queue %ums)\n", multiplier, max_queue);
+	pacing_multiplier = multiplier;
+	pacing_max_queue = max_queue;
+	pacing = TRUE;
+}
+gboolean janus_ice_is_pacing_enabled(void) {
+	return pacing;
+}
+double janus_ice_get_pacing_multiplier(void) {
+	return pacing_multiplier;
+}
+guint janus_ice_get_pacing_max_queue(void) {
+	return pacing_max_queue;
+}
+json_t *janus_ice_handle_pacer_summary(janus_ice_handle *handle) {
+	if(handle == NULL || handle->pacer == NULL)
+		return NULL;
+	janus_ice_pacer *pacer = handle->pacer;
+	json_t *info = json_object();
+	json_object_set_new(info, "rate", json_integer(pacer->rate));
+	json_object_set_new(info, "queued-packets", json_integer(g_queue_get_length(&pacer->queue)));
+	json_object_set_new(info, "queued-bytes", json_integer(pacer->queued_bytes));
+	json_object_set_new(info, "packets", json_integer(pacer->packets));
+	json_object_set_new(info, "bytes", json_integer(pacer->bytes));
+	json_object_set_new(info, "overdue", json_integer(pacer->overdue));
+	json_object_set_new(info, "max-delay", json_integer(pacer->max_delay));
+	json_t *histogram = json_object();
+	int i = 0;
+	for(i=0; i<JANUS_ICE_PACER_HISTOGRAM_SIZE; i++)
+		json_object_set_new(histogram, janus_ice_pacer_histogram_labels[i], json_integer(pacer->histogram[i]));
+	json_object_set_new(info, "histogram", histogram);
+	return info;
+}
+
+/* SRTP crypto workers (disabled by default): when enabled, the loop of a handle
+ * still prepares the RTP packets it has queued as usual, but instead of calling
+ * srtp_protect for each of them it hands them, in batches, to a small pool of
+ * threads; when a batch comes back, the loop sends its packets in the same order.
+ * A handle only ever has a single batch in flight, and in the meanwhile its loop
+ * leaves its SRTP context (and queue) alone, which keeps everything in order */
+static GThreadPool *srtp_workers = NULL;
+static int srtp_workers_count = 0;
+#define JANUS_ICE_CRYPTO_BATCH_MAX	64
+struct janus_ice_crypto_batch {
+	/* Handle the packets belong to */
+	janus_ice_handle *handle;
+	/* DTLS stack whose SRTP context the worker uses (we hold a reference while it's in flight) */
+	janus_dtls_srtp *dtls;
+	/* Prepared packets waiting to be protected (or sent, if the worker is done) */
+	GQueue packets;
+	/* Whether the batch has been handed to a worker, and whether it's done */
+	volatile gint inflight, done;
+	/* Used to wait for the worker to be done, when getting rid of the batch */
+	janus_mutex mutex;
+	janus_condition cond;
+	/* Statistics (only updated by the thread owning the loop) */
+	guint64 batches, packets, max_batch;
+};
+static void janus_ice_crypto_worker(gpointer data, gpointer user_data);
+void janus_ice_set_srtp_workers(int workers) {
+	if(workers <= 0 || srtp_workers != NULL)
+		return;
+	GError *error = NULL;
+	srtp_workers = g_thread_pool_new(janus_ice_crypto_worker, NULL, workers, FALSE, &error);
+	if(error != NULL) {
+		JANUS_LOG(LOG_ERR, "Error creating the SRTP crypto workers, will protect packets in the event loops: %s\n",
+			error->message);
+		g_error_free(error);
+		srtp_workers = NULL;
+		return;
+	}
+	srtp_workers_count = workers;
+	JANUS_LOG(LOG_INFO, "Using %d SRTP crypto workers\n", srtp_workers_count);
+}
+int janus_ice_get_srtp_workers(void) {
+	return srtp_workers_count;
+}
+json_t *janus_ice_handle_crypto_summary(janus_ice_handle *handle) {
+	if(handle == NULL || handle->crypto == NULL)
+		return NULL;
+	janus_ice_crypto_batch *crypto = handle->crypto;
+	json_t *info = json_object();
+	json_object_set_new(info, "batches", json_integer(crypto->batches));
+	json_object_set_new(info, "packets", json_integer(crypto->packets));
+	json_object_set_new(info, "max-batch", json_integer(crypto->max_batch));
+	json_object_set_new(info, "in-flight", g_atomic_int_get(&crypto->inflight) ? json_true() : json_false());
+	return info;
+}
+
+/* Pools of MTU-sized blocks, one per event loop, used for both the packets we
+ * queue for sending and the ones we keep in the NACK buffers: this keeps malloc,
+ * and contention on the glibc arenas across loops, out of the media path. The
+ * pool of a loop is shared with the plugin threads queueing packets, which is
+ * why it's protected by a mutex; larger packets still use g_malloc instead */
+#define JANUS_ICE_POOL_SLOT_SIZE	(1500+SRTP_MAX_TAG_LEN+2)
+#define JANUS_ICE_POOL_MAX_FREE		1024
+typedef struct janus_ice_pool_block {
+	struct janus_ice_pool_block *next;
+} janus_ice_pool_block;
+typedef struct janus_ice_pool_list {
+	janus_ice_pool_block *free;
+	guint available, used, hwm;
+	guint64 hits, misses;
+} janus_ice_pool_list;
+struct janus_ice_pool {
+	/* Queued packets (with their data) and NACK buffer packets */
+	janus_ice_pool_list packets, nacks;
+	janus_mutex mutex;
+	janus_refcount ref;
+};
+static void janus_ice_pool_list_clear(janus_ice_pool_list *list) {
+	janus_ice_pool_block *block = list->free;
+	while(block != NULL) {
+		janus_ice_pool_block *next = block->next;
+		g_free(block);
+		block = next;
+	}
+	list->free = NULL;
+	list->available = 0;
+}
+static void janus_ice_pool_free(const janus_refcount *pool_ref) {
+	janus_ice_pool *pool = janus_refcount_containerof(pool_ref, janus_ice_pool, ref);
+	janus_ice_pool_list_clear(&pool->packets);
+	janus_ice_pool_list_clear(&pool->nacks);
+	janus_mutex_destroy(&pool->mutex);
+	g_free(pool);
+}
+static janus_ice_pool *janus_ice_pool_new(void) {
+	janus_ice_pool *pool = g_malloc0(sizeof(janus_ice_pool));
+	janus_mutex_init(&pool->mutex);
+	janus_refcount_init(&pool->ref, janus_ice_pool_free);
+	return pool;
+}
+static gpointer janus_ice_pool_get(janus_ice_pool *pool, janus_ice_pool_list *list, gsize size) {
+	janus_mutex_lock_nodebug(&pool->mutex);
+	janus_ice_pool_block *block = list->free;
+	if(block != NULL) {
+		list->free = block->next;
+		list->available--;
+		list->hits++;
+	} else {
+		list->misses++;
+	}
+	list->used++;
+	if(list->used > list->hwm)
+		list->hwm = list->used;
+	janus_mutex_unlock_nodebug(&pool->mutex);
+	return block ? (gpointer)block : g_malloc(size);
+}
+static void janus_ice_pool_put(janus_ice_pool *pool, janus_ice_pool_list *list, gpointer data) {
+	janus_ice_pool_block *block = (janus_ice_pool_block *)data;
+	janus_mutex_lock_nodebug(&pool->mutex);
+	list->used--;
+	if(list->available < JANUS_ICE_POOL_MAX_FREE) {
+		/* Keep it for later */
+		block->next = list->free;
+		list->free = block;
+		list->available++;
+		block = NULL;
+	}
+	janus_mutex_unlock_nodebug(&pool->mutex);
+	g_free(block);
+}
+static json_t *janus_ice_pool_list_summary(janus_ice_pool_list *list) {
+	json_t *info = json_object();
+	json_object_set_new(info, "in-use", json_integer(list->used));
+	json_object_set_new(info, "available", json_integer(list->available));
+	json_object_set_new(info, "high-water-mark", json_integer(list->hwm));
+	json_object_set_new(info, "hits", json_integer(list->hits));
+	json_object_set_new(info, "misses", json_integer(list->misses));
+	return info;
+}
+static json_t *janus_ice_pool_summary(janus_ice_pool *pool) {
+	if(pool == NULL)
+		return NULL;
+	json_t *info = json_object();
+	janus_mutex_lock(&pool->mutex);
+	json_object_set_new(info, "packets", janus_ice_pool_list_summary(&pool->packets));
+	json_object_set_new(info, "nacks", janus_ice_pool_list_summary(&pool->nacks));
+	janus_mutex_unlock(&pool->mutex);
+	return info;
+}
+json_t *janus_ice_handle_pool_summary(janus_ice_handle *handle) {
+	if(handle == NULL)
+		return NULL;
+	return janus_ice_pool_summary(handle->pool);
+}
+
+/* Hierarchical timer wheel, one per event loop (or per handle, when static loops
+ * are disabled), for short-lived per-handle timers: rather than attaching a new
+ * GSource to the loop for each of them, timers are put in a slot of the wheel,
+ * and all the timers in a slot are expired at once. The first level has 256
+ * slots of 10ms each; the second level has 64 slots of 2.56s each, which are
+ * cascaded to the first level when their time comes. The wheel is a GSource
+ * itself, which only wakes the loop up when there's something scheduled.
+ * Expired timers are detached to a separate list, and their callbacks are
+ * invoked without the lock of the wheel held, so that they can schedule
+ * new timers (or cancel existing ones) themselves */
+#define JANUS_ICE_TIMER_WHEEL_TICK		10	/* ms */
+#define JANUS_ICE_TIMER_WHEEL_L0_BITS	8
+#define JANUS_ICE_TIMER_WHEEL_L0_SIZE	(1 << JANUS_ICE_TIMER_WHEEL_L0_BITS)
+#define JANUS_ICE_TIMER_WHEEL_L1_SIZE	64
+#define JANUS_ICE_TIMER_WHEEL_MAX_TICKS	(JANUS_ICE_TIMER_WHEEL_L0_SIZE * (JANUS_ICE_TIMER_WHEEL_L1_SIZE-1))
+struct janus_ice_timer {
+	janus_ice_timer *prev, *next;
+	guint64 expires;
+	janus_ice_handle *handle;
+	janus_ice_timer_callback callback;
+	gpointer data;
+	GDestroyNotify destroy;
+};
+struct janus_ice_timer_wheel {
+	GSource parent;
+	janus_ice_timer *level0[JANUS_ICE_TIMER_WHEEL_L0_SIZE];
+	janus_ice_timer *level1[JANUS_ICE_TIMER_WHEEL_L1_SIZE];
+	/* Timers that expired and whose callbacks still need to be invoked */
+	janus_ice_timer *expiring;
+	/* Timer whose callback is being invoked right now, if any, and by which thread */
+	janus_ice_timer *running;
+	GThread *dispatcher;
+	/* Current tick, and monotonic time it refers to */
+	guint64 current;
+	gint64 current_ts;
+	/* Number of scheduled timers (only updated with the lock, but read atomically) */
+	volatile gint pending;
+	/* Statistics */
+	guint64 scheduled, expired, cancelled;
+	janus_mutex mutex;
+	janus_condition cond;
+};
+static void janus_ice_timer_link(janus_ice_timer **head, janus_ice_timer *timer) {
+	timer->prev = NULL;
+	timer->next = *head;
+	if(*head != NULL)
+		(*head)->prev = timer;
+	*head = timer;
+}
+static void janus_ice_timer_unlink(janus_ice_timer **head, janus_ice_timer *timer) {
+	if(timer->prev != NULL)
+		timer->prev->next = timer->next;
+	else
+		*head = timer->next;
+	if(timer->next != NULL)
+		timer->next->prev = timer->prev;
+	timer->prev = timer->next = NULL;
+}
+static janus_ice_timer **janus_ice_timer_wheel_slot(janus_ice_timer_wheel *wheel, guint64 expires) {
+	if(expires - wheel->current < JANUS_ICE_TIMER_WHEEL_L0_SIZE)
+		return &wheel->level0[expires & (JANUS_ICE_TIMER_WHEEL_L0_SIZE-1)];
+	return &wheel->level1[(expires >> JANUS_ICE_TIMER_WHEEL_L0_BITS) & (JANUS_ICE_TIMER_WHEEL_L1_SIZE-1)];
+}
+/* Helper to iterate on all the lists of timers: the slots of both levels, and the expiring timers */
+static janus_ice_timer **janus_ice_timer_wheel_list(janus_ice_timer_wheel *wheel, int index) {
+	if(index < JANUS_ICE_TIMER_WHEEL_L0_SIZE)
+		return &wheel->level0[index];
+	if(index < JANUS_ICE_TIMER_WHEEL_L0_SIZE+JANUS_ICE_TIMER_WHEEL_L1_SIZE)
+		return &wheel->level1[index-JANUS_ICE_TIMER_WHEEL_L0_SIZE];
+	return &wheel->expiring;
+}
+static void janus_ice_timer_free(janus_ice_timer *timer) {
+	if(timer->destroy != NULL)
+		timer->destroy(timer->data);
+	g_free(timer);
+}
+static void janus_ice_timer_wheel_schedule(janus_ice_timer_wheel *wheel, janus_ice_handle *handle, guint ms,
+		janus_ice_timer_callback callback, gpointer data, GDestroyNotify destroy) {
+	janus_ice_timer *timer = g_malloc0(sizeof(janus_ice_timer));
+	timer->handle = handle;
+	timer->callback = callback;
+	timer->data = data;
+	timer->destroy = destroy;
+	guint64 ticks = (ms + JANUS_ICE_TIMER_WHEEL_TICK - 1) / JANUS_ICE_TIMER_WHEEL_TICK;
+	if(ticks == 0)
+		ticks = 1;
+	else if(ticks > JANUS_ICE_TIMER_WHEEL_MAX_TICKS)
+		ticks = JANUS_ICE_TIMER_WHEEL_MAX_TICKS;
+	janus_mutex_lock_nodebug(&wheel->mutex);
+	gboolean wakeup = (g_atomic_int_get(&wheel->pending) == 0);
+	if(wakeup) {
+		/* The wheel was idle: restart counting from now */
+		wheel->current_ts = janus_get_monotonic_time();
+	}
+	timer->expires = wheel->current + ticks;
+	janus_ice_timer_link(janus_ice_timer_wheel_slot(wheel, timer->expires), timer);
+	g_atomic_int_inc(&wheel->pending);
+	wheel->scheduled++;
+	janus_mutex_unlock_nodebug(&wheel->mutex);
+	if(wakeup) {
+		/* Make sure the loop notices it has to wake up for the wheel now */
+		GMainContext *context = g_source_get_context((GSource *)wheel);
+		if(context != NULL)
+			g_main_context_wakeup(context);
+	}
+}
+/* Wait for the callback of a timer of this handle to return, if one is being
+ * invoked by another thread right now (called with the lock) */
+static void janus_ice_timer_wheel_wait(janus_ice_timer_wheel *wheel, janus_ice_handle *handle) {
+	while(wheel->running != NULL && wheel->running->handle == handle && wheel->dispatcher != g_thread_self())
+		janus_condition_wait(&wheel->cond, &wheel->mutex);
+}
+/* Cancel all the timers of a handle: once this returns, it's guaranteed none of
+ * them is running, unless this is called by one of their callbacks */
+static void janus_ice_timer_wheel_cancel(janus_ice_timer_wheel *wheel, janus_ice_handle *handle) {
+	if(wheel == NULL)
+		return;
+	GSList *cancelled = NULL;
+	janus_mutex_lock(&wheel->mutex);
+	janus_ice_timer_wheel_wait(wheel, handle);
+	int i = 0;
+	for(i=0; i<=JANUS_ICE_TIMER_WHEEL_L0_SIZE+JANUS_ICE_TIMER_WHEEL_L1_SIZE; i++) {
+		janus_ice_timer **head = janus_ice_timer_wheel_list(wheel, i);
+		janus_ice_timer *timer = *head;
+		while(timer != NULL) {
+			janus_ice_timer *next = timer->next;
+			if(timer->handle == handle) {
+				janus_ice_timer_unlink(head, timer);
+				cancelled = g_slist_prepend(cancelled, timer);
+				if(head != &wheel->expiring)
+					g_atomic_int_add(&wheel->pending, -1);
+				wheel->cancelled++;
+			}
+			timer = next;
+		}
+	}
+	janus_mutex_unlock(&wheel->mutex);
+	g_slist_free_full(cancelled, (GDestroyNotify)janus_ice_timer_free);
+}
+/* Move all the timers of a handle to another wheel (e.g., because the handle
+ * is moving to another event loop), preserving the time they have left */
+static void janus_ice_timer_wheel_move(janus_ice_timer_wheel *wheel, janus_ice_timer_wheel *target, janus_ice_handle *handle) {
+	if(wheel == NULL || target == NULL || wheel == target)
+		return;
+	GSList *moved = NULL;
+	janus_mutex_lock(&wheel->mutex);
+	janus_ice_timer_wheel_wait(wheel, handle);
+	int i = 0;
+	for(i=0; i<=JANUS_ICE_TIMER_WHEEL_L0_SIZE+JANUS_ICE_TIMER_WHEEL_L1_SIZE; i++) {
+		janus_ice_timer **head = janus_ice_timer_wheel_list(wheel, i);
+		janus_ice_timer *timer = *head;
+		while(timer != NULL) {
+			janus_ice_timer *next = timer->next;
+			if(timer->handle == handle) {
+				janus_ice_timer_unlink(head, timer);
+				/* Keep track of how many ticks were left, rather than the expiration */
+				timer->expires = (timer->expires > wheel->current) ? (timer->expires - wheel->current) : 1;
+				moved = g_slist_prepend(moved, timer);
+				if(head != &wheel->expiring)
+					g_atomic_int_add(&wheel->pending, -1);
+			}
+			timer = next;
+		}
+	}
+	janus_mutex_unlock(&wheel->mutex);
+	GSList *l = moved;
+	while(l) {
+		janus_ice_timer *timer = (janus_ice_timer *)l->data;
+		janus_ice_timer_wheel_schedule(target, handle, timer->expires * JANUS_ICE_TIMER_WHEEL_TICK,
+			timer->callback, timer->data, timer->destroy);
+		g_free(timer);
+		l = l->next;
+	}
+	g_slist_free(moved);
+}
+/* Advance the wheel by a tick, cascading the second level when needed, and
+ * move all the timers in the current slot to the expiring list (called with the lock) */
+static void janus_ice_timer_wheel_advance(janus_ice_timer_wheel *wheel) {
+	wheel->current++;
+	guint64 index = wheel->current & (JANUS_ICE_TIMER_WHEEL_L0_SIZE-1);
+	if(index == 0) {
+		janus_ice_timer **head = &wheel->level1[(wheel->current >> JANUS_ICE_TIMER_WHEEL_L0_BITS) & (JANUS_ICE_TIMER_WHEEL_L1_SIZE-1)];
+		janus_ice_timer *timer = *head;
+		*head = NULL;
+		while(timer != NULL) {
+			janus_ice_timer *next = timer->next;
+			janus_ice_timer_link(&wheel->level0[timer->expires & (JANUS_ICE_TIMER_WHEEL_L0_SIZE-1)], timer);
+			timer = next;
+		}
+	}
+	janus_ice_timer *timer = wheel->level0[index];
+	wheel->level0[index] = NULL;
+	while(timer != NULL) {
+		janus_ice_timer *next = timer->next;
+		janus_ice_timer_link(&wheel->expiring, timer);
+		g_atomic_int_add(&wheel->pending, -1);
+		timer = next;
+	}
+}
+static gboolean janus_ice_timer_wheel_prepare(GSource *source, gint *timeout) {
+	janus_ice_timer_wheel *wheel = (janus_ice_timer_wheel *)source;
+	if(g_atomic_int_get(&wheel->pending) == 0) {
+		*timeout = -1;
+		return FALSE;
+	}
+	janus_mutex_lock_nodebug(&wheel->mutex);
+	gint64 next = wheel->current_ts + JANUS_ICE_TIMER_WHEEL_TICK*1000;
+	janus_mutex_unlock_nodebug(&wheel->mutex);
+	gint64 now = janus_get_monotonic_time();
+	if(now >= next) {
+		*timeout = 0;
+		return TRUE;
+	}
+	*timeout = (gint)((next - now + 999) / 1000);
+	return FALSE;
+}
+static gboolean janus_ice_timer_wheel_check(GSource *source) {
+	janus_ice_timer_wheel *wheel = (janus_ice_timer_wheel *)source;
+	if(g_atomic_int_get(&wheel->pending) == 0)
+		return FALSE;
+	janus_mutex_lock_nodebug(&wheel->mutex);
+	gint64 next = wheel->current_ts + JANUS_ICE_TIMER_WHEEL_TICK*1000;
+	janus_mutex_unlock_nodebug(&wheel->mutex);
+	return janus_get_monotonic_time() >= next;
+}
+static gboolean janus_ice_timer_wheel_dispatch(GSource *source, GSourceFunc callback, gpointer user_data) {
+	janus_ice_timer_wheel *wheel = (janus_ice_timer_wheel *)source;
+	gint64 now = janus_get_monotonic_time();
+	janus_mutex_lock(&wheel->mutex);
+	/* Catch up with all the ticks we missed, if any */
+	while(g_atomic_int_get(&wheel->pending) > 0 && now >= wheel->current_ts + JANUS_ICE_TIMER_WHEEL_TICK*1000) {
+		wheel->current_ts += JANUS_ICE_TIMER_WHEEL_TICK*1000;
+		janus_ice_timer_wheel_advance(wheel);
+	}
+	/* Invoke the callbacks of the expired timers one by one, without the lock */
+	wheel->dispatcher = g_thread_self();
+	janus_ice_timer *timer = NULL;
+	while((timer = wheel->expiring) != NULL) {
+		janus_ice_timer_unlink(&wheel->expiring, timer);
+		wheel->running = timer;
+		wheel->expired++;
+		janus_mutex_unlock(&wheel->mutex);
+		if(timer->callback != NULL)
+			timer->callback(timer->handle, timer->data);
+		janus_ice_timer_free(timer);
+		janus_mutex_lock(&wheel->mutex);
+		wheel->running = NULL;
+		janus_condition_broadcast(&wheel->cond);
+	}
+	wheel->dispatcher = NULL;
+	janus_mutex_unlock(&wheel->mutex);
+	return G_SOURCE_CONTINUE;
+}
+static void janus_ice_timer_wheel_finalize(GSource *source) {
+	janus_ice_timer_wheel *wheel = (janus_ice_timer_wheel *)source;
+	int i = 0;
+	for(i=0; i<=JANUS_ICE_TIMER_WHEEL_L0_SIZE+JANUS_ICE_TIMER_WHEEL_L1_SIZE; i++) {
+		janus_ice_timer *timer = *janus_ice_timer_wheel_list(wheel, i);
+		while(timer != NULL) {
+			janus_ice_timer *next = timer->next;
+			janus_ice_timer_free(timer);
+			timer = next;
+		}
+	}
+	janus_mutex_destroy(&wheel->mutex);
+	janus_condition_destroy(&wheel->cond);
+}
+static GSourceFuncs janus_ice_timer_wheel_funcs = {
+	janus_ice_timer_wheel_prepare,
+	janus_ice_timer_wheel_check,
+	janus_ice_timer_wheel_dispatch,
+	janus_ice_timer_wheel_finalize,
+	NULL, NULL
+};
+static janus_ice_timer_wheel *janus_ice_timer_wheel_create(GMainContext *context, const char *name) {
+	GSource *source = g_source_new(&janus_ice_timer_wheel_funcs, sizeof(janus_ice_timer_wheel));
+	janus_ice_timer_wheel *wheel = (janus_ice_timer_wheel *)source;
+	janus_mutex_init(&wheel->mutex);
+	janus_condition_init(&wheel->cond);
+	wheel->current_ts = janus_get_monotonic_time();
+	g_source_set_name(source, name);
+	g_source_set_priority(source, G_PRIORITY_DEFAULT);
+	g_source_attach(source, context);
+	return wheel;
+}
+static void janus_ice_timer_wheel_destroy(janus_ice_timer_wheel *wheel) {
+	if(wheel == NULL)
+		return;
+	g_source_destroy((GSource *)wheel);
+	g_source_unref((GSource *)wheel);
+}
+static json_t *janus_ice_timer_wheel_summary(janus_ice_timer_wheel *wheel) {
+	if(wheel == NULL)
+		return NULL;
+	json_t *info = json_object();
+	janus_mutex_lock(&wheel->mutex);
+	json_object_set_new(info, "pending", json_integer(g_atomic_int_get(&wheel->pending)));
+	json_object_set_new(info, "scheduled", json_integer(wheel->scheduled));
+	json_object_set_new(info, "expired", json_integer(wheel->expired));
+	json_object_set_new(info, "cancelled", json_integer(wheel->cancelled));
+	janus_mutex_unlock(&wheel->mutex);
+	return info;
+}
+int janus_ice_handle_add_timer(janus_ice_handle *handle, guint ms,
+		janus_ice_timer_callback callback, gpointer data, GDestroyNotify destroy) {
+	if(handle == NULL || handle->timers == NULL || callback == NULL)
+		return -1;
+	janus_ice_timer_wheel_schedule(handle->timers, handle, ms, callback, data, destroy);
+	return 0;
+}
+
 /* Only needed in case we're using static event loops spawned at startup (disabled by default) */
-typedef struct janus_ice_static_event_loop {
+struct janus_ice_static_event_loop {
 	int id;
 	GMainContext *mainctx;
 	GMainLoop *mainloop;
 	GThread *thread;
-} janus_ice_static_event_loop;
+	janus_ice_egress_batch *egress;
+	janus_ice_pool *pool;
+	janus_ice_timer_wheel *timers;
+	/* CPU this loop is pinned to, if any (-1 otherwise) */
+	int cpu;
+	/* Source we use to measure the load of the loop */
+	GSource *load_source;
+	/* Number of handles in this loop */
+	volatile gint handles;
+	/* Packets handled by this loop (only updated by the loop thread) */
+	guint64 packets, last_packets;
+	/* Packets per second, and lag (us) of the loop in the last second */
+	guint32 pps;
+	gint64 lag, max_lag;
+	/* When we last ticked, and last updated the statistics */
+	gint64 tick_ts, stats_ts;
+};
 static int static_event_loops = 0;
 static GSList *event_loops = NULL, *current_loop = NULL;
 static janus_mutex event_loops_mutex = JANUS_MUTEX_INITIALIZER;
+/* Whether new handles should be added to the least loaded loop, rather than round robin */
+static gboolean event_loops_load_aware = TRUE;
+/* The load of a loop is measured with a periodic tick: how late the tick fires
+ * tells us how busy the loop is (lag), which we use along with the packets per
+ * second and the number of handles to pick a loop when a new handle is created */
+#define JANUS_ICE_LOOP_TICK			100	/* ms */
+#define JANUS_ICE_LOOP_HANDLE_WEIGHT	100	/* A handle counts as 100 packets per second */
+#define JANUS_ICE_LOOP_LAG_WEIGHT		200	/* Each ms of lag counts as 200 packets per second */
+static gboolean janus_ice_static_event_loop_tick(gpointer user_data) {
+	janus_ice_static_event_loop *loop = (janus_ice_static_event_loop *)user_data;
+	gint64 now = janus_get_monotonic_time();
+	if(loop->tick_ts > 0) {
+		gint64 lag = now - loop->tick_ts - JANUS_ICE_LOOP_TICK*1000;
+		if(lag > loop->max_lag)
+			loop->max_lag = lag;
+	}
+	loop->tick_ts = now;
+	if(loop->stats_ts == 0) {
+		loop->stats_ts = now;
+	} else if(now - loop->stats_ts >= G_USEC_PER_SEC) {
+		loop->pps = ((loop->packets - loop->last_packets) * G_USEC_PER_SEC) / (now - loop->stats_ts);
+		loop->last_packets = loop->packets;
+		loop->lag = loop->max_lag;
+		loop->max_lag = 0;
+		loop->stats_ts = now;
+	}
+	return G_SOURCE_CONTINUE;
+}
+static guint64 janus_ice_static_event_loop_load(janus_ice_static_event_loop *loop) {
+	return (guint64)loop->pps + (guint64)g_atomic_int_get(&loop->handles) * JANUS_ICE_LOOP_HANDLE_WEIGHT +
+		(guint64)(loop->lag/1000) * JANUS_ICE_LOOP_LAG_WEIGHT;
+}
+/* Pick a loop for a new handle (called with event_loops_mutex held) */
+static janus_ice_static_event_loop *janus_ice_static_event_loop_pick(void) {
+	janus_ice_static_event_loop *loop = (janus_ice_static_event_loop *)current_loop->data;
+	if(event_loops_load_aware) {
+		/* Look for the least loaded loop, starting from the next in line
+		 * so that equally loaded loops are still picked round robin */
+		guint64 load = janus_ice_static_event_loop_load(loop);
+		GSList *l = current_loop->next ? current_loop->next : event_loops;
+		while(l != current_loop) {
+			janus_ice_static_event_loop *candidate = (janus_ice_static_event_loop *)l->data;
+			guint64 candidate_load = janus_ice_static_event_loop_load(candidate);
+			if(candidate_load < load) {
+				loop = candidate;
+				load = candidate_load;
+			}
+			l = l->next ? l->next : event_loops;
+		}
+	}
+	current_loop = g_slist_find(event_loops, loop)->next;
+	if(current_loop == NULL)
+		current_loop = event_loops;
+	return loop;
+}
+static janus_ice_static_event_loop *janus_ice_static_event_loop_find(int id) {
+	GSList *l = event_loops;
+	while(l) {
+		janus_ice_static_event_loop *loop = (janus_ice_static_event_loop *)l->data;
+		if(loop->id == id)
+			return loop;
+		l = l->next;
+	}
+	return NULL;
+}
 static void *janus_ice_static_event_loop_thread(void *data) {
 	janus_ice_static_event_loop *loop = data;
 	JANUS_LOG(LOG_VERB, "[loop#%d] Event loop thread started\n", loop->id);
@@ -124,6 +941,20 @@ static void *janus_ice_static_event_loop_thread(void *data) {
 		g_thread_unref(g_thread_self());
 		return NULL;
 	}
+#ifdef HAVE_SCHED_SETAFFINITY
+	if(loop->cpu >= 0) {
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(loop->cpu, &cpus);
+		if(sched_setaffinity(0, sizeof(cpus), &cpus) < 0) {
+			JANUS_LOG(LOG_WARN, "[loop#%d] Couldn't pin the loop to CPU %d: %d (%s)\n",
+				loop->id, loop->cpu, errno, g_strerror(errno));
+			loop->cpu = -1;
+		} else {
+			JANUS_LOG(LOG_VERB, "[loop#%d] Pinned to CPU %d\n", loop->id, loop->cpu);
+		}
+	}
+#endif
 	JANUS_LOG(LOG_DBG, "[loop#%d] Looping...\n", loop->id);
 	g_main_loop_run(loop->mainloop);
 	/* When the loop quits, we can unref it */
@@ -132,31 +963,90 @@ static void *janus_ice_static_event_loop_thread(void *data) {
 	JANUS_LOG(LOG_VERB, "[loop#%d] Event loop thread ended!\n", loop->id);
 	return NULL;
 }
+/* Parse the CPUs to pin loops to: either "auto" (one CPU per loop, in order),
+ * or a list of CPUs and ranges, e.g., "0-3,8,10" (reused if there are more loops) */
+static GArray *janus_ice_static_event_loops_parse_affinity(const char *affinity) {
+	if(affinity == NULL)
+		return NULL;
+	GArray *cpus = g_array_new(FALSE, FALSE, sizeof(int));
+	if(!strcasecmp(affinity, "auto")) {
+		long online = sysconf(_SC_NPROCESSORS_ONLN);
+		int i = 0;
+		for(i=0; i<online; i++)
+			g_array_append_val(cpus, i);
+	} else {
+		gchar **items = g_strsplit(affinity, ",", -1);
+		int i = 0;
+		for(i=0; items[i] != NULL; i++) {
+			int first = -1, last = -1;
+			int n = sscanf(items[i], "%d-%d", &first, &last);
+			if(n == 1)
+				last = first;
+			if(n < 1 || first < 0 || last < first) {
+				JANUS_LOG(LOG_WARN, "Invalid CPU '%s' in event loops affinity, skipping\n", items[i]);
+				continue;
+			}
+			int cpu = 0;
+			for(cpu=first; cpu<=last; cpu++)
+				g_array_append_val(cpus, cpu);
+		}
+		g_strfreev(items);
+	}
+	if(cpus->len == 0) {
+		g_array_free(cpus, TRUE);
+		return NULL;
+	}
+	return cpus;
+}
 int janus_ice_get_static_event_loops(void) {
 	return static_event_loops;
 }
-void janus_ice_set_static_event_loops(int loops) {
+void janus_ice_set_static_event_loops(int loops, gboolean load_aware, const char *affinity) {
 	if(loops == 0)
 		return;
 	else if(loops < 1) {
 		JANUS_LOG(LOG_WARN, "Invalid number of static event loops (%d), disabling\n", loops);
 		return;
 	}
+	event_loops_load_aware = load_aware;
+	GArray *cpus = janus_ice_static_event_loops_parse_affinity(affinity);
+#ifndef HAVE_SCHED_SETAFFINITY
+	if(cpus != NULL) {
+		JANUS_LOG(LOG_WARN, "CPU affinity not supported on this platform, ignoring\n");
+		g_array_free(cpus, TRUE);
+		cpus = NULL;
+	}
+#endif
 	/* Create a pool of new event loops */
 	int i = 0;
 	for(i=0; i<loops; i++) {
 		janus_ice_static_event_loop *loop = g_malloc0(sizeof(janus_ice_static_event_loop));
 		loop->id = static_event_loops;
+		loop->cpu = cpus ? g_array_index(cpus, int, loop->id % cpus->len) : -1;
 		loop->mainctx = g_main_context_new();
 		loop->mainloop = g_main_loop_new(loop->mainctx, FALSE);
+		loop->egress = janus_ice_egress_batch_new();
+		loop->pool = janus_ice_pool_new();
+		char wname[32];
+		g_snprintf(wname, sizeof(wname), "timers-loop-%d", loop->id);
+		loop->timers = janus_ice_timer_wheel_create(loop->mainctx, wname);
+		loop->load_source = g_timeout_source_new(JANUS_ICE_LOOP_TICK);
+		g_source_set_priority(loop->load_source, G_PRIORITY_DEFAULT);
+		g_source_set_callback(loop->load_source, janus_ice_static_event_loop_tick, loop, NULL);
+		g_source_attach(loop->load_source, loop->mainctx);
 		/* Now spawn a thread for this loop */
 		GError *error = NULL;
 		char tname[16];
 		g_snprintf(tname, sizeof(tname), "hloop %d", loop->id);
 		loop->thread = g_thread_try_new(tname, &janus_ice_static_event_loop_thread, loop, &error);
 		if(error != NULL) {
+			g_source_destroy(loop->load_source);
+			g_source_unref(loop->load_source);
+			janus_ice_timer_wheel_destroy(loop->timers);
 			g_main_loop_unref(loop->mainloop);
 			g_main_context_unref(loop->mainctx);
+			g_free(loop->egress);
+			janus_refcount_decrease(&loop->pool->ref);
 			g_free(loop);
 			JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch a new event loop thread...\n",
 				error->code, error->message ? error->message : "??");
@@ -165,8 +1055,11 @@ void janus_ice_set_static_event_loops(int loops) {
 			static_event_loops++;
 		}
 	}
+	if(cpus != NULL)
+		g_array_free(cpus, TRUE);
 	current_loop = event_loops;
-	JANUS_LOG(LOG_INFO, "Spawned %d static event loops (handles won't have a dedicated loop)\n", static_event_loops);
+	JANUS_LOG(LOG_INFO, "Spawned %d static event loops (handles won't have a dedicated loop, placement: %s)\n",
+		static_event_loops, event_loops_load_aware ? "load" : "round-robin");
 	return;
 }
 void janus_ice_stop_static_event_loops(void) {
@@ -177,14 +1070,53 @@ void janus_ice_stop_static_event_loops(void) {
 	GSList *l = event_loops;
 	while(l) {
 		janus_ice_static_event_loop *loop = (janus_ice_static_event_loop *)l->data;
+		g_source_destroy(loop->load_source);
+		g_source_unref(loop->load_source);
+		loop->load_source = NULL;
+		janus_ice_timer_wheel_destroy(loop->timers);
+		loop->timers = NULL;
 		if(loop->mainloop != NULL && g_main_loop_is_running(loop->mainloop))
 			g_main_loop_quit(loop->mainloop);
 		g_thread_join(loop->thread);
+		g_free(loop->egress);
+		janus_refcount_decrease(&loop->pool->ref);
 		l = l->next;
 	}
 	g_slist_free_full(event_loops, (GDestroyNotify)g_free);
 	janus_mutex_unlock(&event_loops_mutex);
 }
+json_t *janus_ice_static_event_loops_info(void) {
+	json_t *list = json_array();
+	if(static_event_loops < 1)
+		return list;
+	janus_mutex_lock(&event_loops_mutex);
+	GSList *l = event_loops;
+	while(l) {
+		janus_ice_static_event_loop *loop = (janus_ice_static_event_loop *)l->data;
+		json_t *info = json_object();
+		json_object_set_new(info, "id", json_integer(loop->id));
+		if(loop->cpu >= 0)
+			json_object_set_new(info, "cpu", json_integer(loop->cpu));
+		json_object_set_new(info, "handles", json_integer(g_atomic_int_get(&loop->handles)));
+		json_object_set_new(info, "packets-per-second", json_integer(loop->pps));
+		json_object_set_new(info, "lag", json_integer(loop->lag));
+		json_object_set_new(info, "load", json_integer(janus_ice_static_event_loop_load(loop)));
+		json_t *egress = janus_ice_egress_batch_summary(loop->egress);
+		if(egress != NULL)
+			json_object_set_new(info, "egress", egress);
+		json_object_set_new(info, "pool", janus_ice_pool_summary(loop->pool));
+		json_object_set_new(info, "timers", janus_ice_timer_wheel_summary(loop->timers));
+		json_array_append_new(list, info);
+		l = l->next;
+	}
+	janus_mutex_unlock(&event_loops_mutex);
+	return list;
+}
+int janus_ice_handle_get_loop(janus_ice_handle *handle) {
+	if(handle == NULL || handle->loop == NULL)
+		return -1;
+	return handle->loop->id;
+}
 
 /* libnice debugging */
 static gboolean janus_ice_debugging_enabled;
@@ -297,7 +1229,9 @@ uint16_t rtp_range_max = 0;
 #define JANUS_ICE_PACKET_TEXT	2
 #define JANUS_ICE_PACKET_BINARY	3
 #define JANUS_ICE_PACKET_SCTP	4
+#define JANUS_ICE_PACKET_MUX	5
 /* Janus enqueued (S)RTP/(S)RTCP packet to send */
+#define JANUS_ICE_OVERLAY_SIZE	64
 typedef struct janus_ice_queued_packet {
 	char *data;
 	char *label;
@@ -307,29 +1241,118 @@ typedef struct janus_ice_queued_packet {
 	gboolean retransmission;
 	gboolean encrypted;
 	gint64 added;
+	/* In case the plugin provided a shared payload, we only keep our own RTP
+	 * header and extensions here, and only put the actual packet together
+	 * in a scratch buffer of the loop when it's time to encrypt it */
+	janus_plugin_rtp_payload *payload;
+	char overlay[JANUS_ICE_OVERLAY_SIZE];
+	gint overlay_length;
+	gboolean scratch;
+	/* Where the transport-wide sequence number goes in the packet, if we
+	 * added the extensions from a precompiled template (0 otherwise) */
+	gint twcc_offset;
+	/* If a crypto worker is protecting the packet, the copy to add to the
+	 * NACK buffer for retransmissions (if any), and the outcome of srtp_protect */
+	janus_rtp_packet *nack_copy;
+	gint protected_length;
+	gint srtp_res;
+	/* Pool this packet was taken from, if any: in that case, the data may be
+	 * in the same block, right after the struct (see janus_ice_queued_packet_slot) */
+	janus_ice_pool *pool;
 } janus_ice_queued_packet;
+#define janus_ice_queued_packet_slot(pkt) ((char *)(pkt) + sizeof(janus_ice_queued_packet))
 /* A few static, fake, messages we use as a trigger: e.g., to start a
- * new DTLS handshake, hangup a PeerConnection or close a handle */
-static janus_ice_queued_packet janus_ice_dtls_handshake,
-	janus_ice_hangup_peerconnection, janus_ice_detach_handle;
-
-/* Janus NACKed packet we're tracking (to avoid duplicates) */
-typedef struct janus_ice_nacked_packet {
-	janus_ice_handle *handle;
-	int vindex;
-	guint16 seq_number;
-} janus_ice_nacked_packet;
-static gboolean janus_ice_nacked_packet_cleanup(gpointer user_data) {
-	janus_ice_nacked_packet *pkt = (janus_ice_nacked_packet *)user_data;
+ * new DTLS handshake, take over a DTLS stack a handshake worker is done
+ * with, hangup a PeerConnection, close a handle or move it to a different
+ * static event loop */
+static janus_ice_queued_packet janus_ice_dtls_handshake, janus_ice_dtls_resume,
+	janus_ice_hangup_peerconnection, janus_ice_detach_handle,
+	janus_ice_migrate_handle;
+/* Enqueue something for the loop of a handle, at the head of the queue if
+ * it's urgent: the loop is only woken up if nobody did already, that is if
+ * the loop hasn't started draining the queue yet (see janus_ice_queue_packet) */
+static void janus_ice_handle_enqueue(janus_ice_handle *handle, janus_ice_queued_packet *pkt, gboolean front) {
+#if GLIB_CHECK_VERSION(2, 46, 0)
+	if(front)
+		g_async_queue_push_front(handle->queued_packets, pkt);
+	else
+#endif
+		g_async_queue_push(handle->queued_packets, pkt);
+	if(g_atomic_int_compare_and_exchange(&handle->wakeup_pending, 0, 1)) {
+		g_atomic_pointer_add(&handle->wakeups_count, 1);
+		g_main_context_wakeup(handle->mainctx);
+	}
+}
 
-	if(pkt->handle->stream){
+/* Janus NACKed packet we're tracking (to avoid duplicates): we don't need to
+ * allocate anything, as the vindex and sequence number fit in the timer data */
+#define janus_ice_nacked_packet_data(vindex, seq) GUINT_TO_POINTER(((guint)(vindex) << 16) | (seq))
+static void janus_ice_nacked_packet_cleanup(janus_ice_handle *handle, gpointer data) {
+	int vindex = GPOINTER_TO_UINT(data) >> 16;
+	guint16 seq_number = GPOINTER_TO_UINT(data) & 0xFFFF;
+	if(handle->stream && handle->stream->rtx_nacked[vindex]) {
 		JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Cleaning up NACKed packet %"SCNu16" (SSRC %"SCNu32", vindex %d)...\n",
-			pkt->handle->handle_id, pkt->seq_number, pkt->handle->stream->video_ssrc_peer[pkt->vindex], pkt->vindex);
-		g_hash_table_remove(pkt->handle->stream->rtx_nacked[pkt->vindex], GUINT_TO_POINTER(pkt->seq_number));
+			handle->handle_id, seq_number, handle->stream->video_ssrc_peer[vindex], vindex);
+		g_hash_table_remove(handle->stream->rtx_nacked[vindex], GUINT_TO_POINTER(seq_number));
 	}
+}
 
-	return G_SOURCE_REMOVE;
+/* Single-port media multiplexing (ICE-Lite only, disabled by default): rather than
+ * having libnice gather candidates and bind sockets for each PeerConnection, all
+ * of them advertise the same host candidate(s), and we demultiplex what we receive
+ * on the shared socket(s) ourselves, by looking at the USERNAME of connectivity
+ * checks first, and at the address the peer nominated then. With static event
+ * loops each loop has its own socket bound to the port (SO_REUSEPORT), otherwise
+ * a single socket is served by a dedicated thread. When a packet is received by
+ * a loop other than the one of the handle, it's handed to the right loop via the
+ * queue of the handle, so that all the state is only touched by one thread */
+static uint16_t mux_port = 0;
+typedef struct janus_ice_mux_socket {
+	GSocket *socket;
+	GMainContext *mainctx;
+	GSource *source;
+} janus_ice_mux_socket;
+static GSList *mux_sockets = NULL;
+static GMainContext *mux_context = NULL;
+static GMainLoop *mux_loop = NULL;
+static GThread *mux_thread = NULL;
+/* Components indexed by local ufrag and by nominated address (both hold a reference) */
+static GHashTable *mux_ufrags = NULL, *mux_addresses = NULL;
+static janus_mutex mux_mutex = JANUS_MUTEX_INITIALIZER;
+/* Where a multiplexed packet handed to another loop came from: this goes in
+ * the data of the queued packet, right before the packet itself */
+typedef struct janus_ice_mux_from {
+	janus_ice_mux_socket *msock;
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
+} janus_ice_mux_from;
+gboolean janus_ice_is_mux_enabled(void) {
+	return mux_port > 0;
+}
+uint16_t janus_ice_get_mux_port(void) {
+	return mux_port;
+}
+/* As ICE-Lite we never send connectivity checks ourselves, so the checks the peer
+ * keeps on sending on the selected pair are all we have to know it still wants
+ * media (consent freshness, RFC 7675): if they stop, we close the PeerConnection */
+#define DEFAULT_MUX_CONSENT_TIMEOUT	30
+#define JANUS_ICE_MUX_CONSENT_CHECK	1000
+static uint mux_consent_timeout = DEFAULT_MUX_CONSENT_TIMEOUT;
+void janus_ice_set_mux_consent_timeout(uint timeout) {
+	mux_consent_timeout = timeout;
+	if(mux_consent_timeout == 0)
+		JANUS_LOG(LOG_VERB, "Disabling consent freshness checks on the shared port\n");
+	else
+		JANUS_LOG(LOG_VERB, "Setting consent timeout on the shared port to %us\n", mux_consent_timeout);
 }
+uint janus_ice_get_mux_consent_timeout(void) {
+	return mux_consent_timeout;
+}
+static void janus_ice_mux_register(janus_ice_component *component);
+static void janus_ice_mux_unregister(janus_ice_component *component);
+static void janus_ice_mux_candidates_to_sdp(janus_ice_handle *handle, janus_ice_component *component, janus_sdp_mline *mline);
+static void janus_ice_mux_incoming(janus_ice_handle *handle, janus_ice_mux_socket *msock,
+	char *buf, int len, struct sockaddr_storage *addr, socklen_t addrlen);
 
 /* Deallocation helpers for handles and related structs */
 static void janus_ice_handle_free(const janus_refcount *handle_ref);
@@ -337,34 +1360,238 @@ static void janus_ice_webrtc_free(janus_ice_handle *handle);
 static void janus_ice_plugin_session_free(const janus_refcount *app_handle_ref);
 static void janus_ice_stream_free(const janus_refcount *handle_ref);
 static void janus_ice_component_free(const janus_refcount *handle_ref);
+static janus_ice_extensions *janus_ice_extensions_get(janus_ice_stream *stream);
+static void janus_ice_extensions_unref(janus_ice_extensions *extensions);
 
 /* Custom GSource for outgoing traffic */
 typedef struct janus_ice_outgoing_traffic {
 	GSource parent;
 	janus_ice_handle *handle;
 	GDestroyNotify destroy;
+	/* Whether the handle moved to another loop, and so to another source */
+	gboolean migrated;
 } janus_ice_outgoing_traffic;
 static gboolean janus_ice_outgoing_rtcp_handle(gpointer user_data);
 static gboolean janus_ice_outgoing_stats_handle(gpointer user_data);
 static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janus_ice_queued_packet *pkt);
+static gboolean janus_ice_handle_migrate_loop(janus_ice_handle *handle);
+static void janus_ice_free_queued_packet(janus_ice_queued_packet *pkt);
+#define janus_ice_crypto_pending(handle) \
+	((handle)->crypto != NULL && !g_queue_is_empty(&(handle)->crypto->packets))
+static void janus_ice_crypto_submit(janus_ice_handle *handle);
+static void janus_ice_crypto_complete(janus_ice_handle *handle);
+
+/* Pacer helpers: they're only ever used by the thread owning the loop of the handle */
+static void janus_ice_pacer_enqueue(janus_ice_handle *handle, janus_ice_queued_packet *pkt) {
+	if(handle->pacer == NULL)
+		handle->pacer = g_malloc0(sizeof(janus_ice_pacer));
+	janus_ice_pacer *pacer = handle->pacer;
+	g_queue_push_tail(&pacer->queue, pkt);
+	pacer->queued_bytes += pkt->length;
+}
+/* Update the pacing rate, and refill the bucket according to the time that passed */
+static void janus_ice_pacer_refill(janus_ice_handle *handle, janus_ice_pacer *pacer, gint64 now) {
+	guint32 bitrate = 0;
+	janus_ice_stream *stream = handle->stream;
+	if(stream != NULL && stream->bwe != NULL) {
+		bitrate = stream->bwe->estimate;
+	} else if(stream != NULL && stream->component != NULL) {
+		bitrate = stream->component->out_stats.video[0].bytes_lastsec * 8;
+	}
+	if(bitrate < JANUS_ICE_PACER_MIN_RATE)
+		bitrate = JANUS_ICE_PACER_MIN_RATE;
+	pacer->rate = bitrate * pacing_multiplier;
+	if(pacer->last_ts > 0 && now > pacer->last_ts)
+		pacer->budget += ((gint64)pacer->rate * (now - pacer->last_ts)) / (8*G_USEC_PER_SEC);
+	pacer->last_ts = now;
+	gint64 burst = ((gint64)pacer->rate * JANUS_ICE_PACER_BURST) / 8000;
+	if(pacer->budget > burst)
+		pacer->budget = burst;
+}
+/* How long (ms) we can wait before the next paced packet needs to go out: 0 means now, -1 forever */
+static gint janus_ice_pacer_wait(janus_ice_pacer *pacer, gint64 now) {
+	if(pacer == NULL || g_queue_is_empty(&pacer->queue) || pacer->rate == 0)
+		return -1;
+	janus_ice_queued_packet *pkt = g_queue_peek_head(&pacer->queue);
+	gint64 budget = pacer->budget + ((gint64)pacer->rate * (now - pacer->last_ts)) / (8*G_USEC_PER_SEC);
+	gint64 overdue = pkt->added + (gint64)pacing_max_queue*1000 - now;
+	if(budget > 0 || overdue <= 0)
+		return 0;
+	gint64 wait = (-budget * 8 * G_USEC_PER_SEC) / pacer->rate;
+	if(wait > overdue)
+		wait = overdue;
+	return (gint)(wait/1000) + 1;
+}
+/* Send the paced packets the bucket allows for (or all of them, if flushing) */
+static void janus_ice_pacer_process(janus_ice_handle *handle, gboolean flush) {
+	janus_ice_pacer *pacer = handle->pacer;
+	if(pacer == NULL || g_queue_is_empty(&pacer->queue))
+		return;
+	gint64 now = janus_get_monotonic_time();
+	janus_ice_pacer_refill(handle, pacer, now);
+	janus_ice_queued_packet *pkt = NULL;
+	while((pkt = g_queue_peek_head(&pacer->queue)) != NULL) {
+		gint64 delay = now - pkt->added;
+		gboolean overdue = (delay >= (gint64)pacing_max_queue*1000);
+		if(!flush && !overdue && pacer->budget <= 0)
+			break;
+		g_queue_pop_head(&pacer->queue);
+		pacer->queued_bytes -= pkt->length;
+		pacer->budget -= pkt->length;
+		/* Update the stats */
+		pacer->packets++;
+		pacer->bytes += pkt->length;
+		if(overdue)
+			pacer->overdue++;
+		if(delay > pacer->max_delay)
+			pacer->max_delay = delay;
+		int bucket = 0;
+		while(bucket < JANUS_ICE_PACER_HISTOGRAM_SIZE-1 && delay >= janus_ice_pacer_histogram_bounds[bucket])
+			bucket++;
+		pacer->histogram[bucket]++;
+		janus_ice_outgoing_traffic_handle(handle, pkt);
+	}
+}
+/* Get rid of the paced packets without sending them */
+static void janus_ice_pacer_clear(janus_ice_pacer *pacer) {
+	if(pacer == NULL)
+		return;
+	janus_ice_queued_packet *pkt = NULL;
+	while((pkt = g_queue_pop_head(&pacer->queue)) != NULL)
+		janus_ice_free_queued_packet(pkt);
+	pacer->queued_bytes = 0;
+	pacer->budget = 0;
+	pacer->last_ts = 0;
+}
+
 static gboolean janus_ice_outgoing_traffic_prepare(GSource *source, gint *timeout) {
 	janus_ice_outgoing_traffic *t = (janus_ice_outgoing_traffic *)source;
-	return (g_async_queue_length(t->handle->queued_packets) > 0);
+	/* If a crypto worker is protecting our packets, we only care about when it's done */
+	janus_ice_crypto_batch *crypto = t->handle->crypto;
+	if(crypto != NULL && g_atomic_int_get(&crypto->inflight))
+		return g_atomic_int_get(&crypto->done);
+	if(g_async_queue_length(t->handle->queued_packets) > 0)
+		return TRUE;
+	/* If we're pacing, wake up when the next video packet can be sent */
+	gint wait = janus_ice_pacer_wait(t->handle->pacer, janus_get_monotonic_time());
+	if(wait == 0)
+		return TRUE;
+	if(wait > 0 && (*timeout < 0 || wait < *timeout))
+		*timeout = wait;
+	return FALSE;
+}
+static gboolean janus_ice_outgoing_traffic_check(GSource *source) {
+	janus_ice_outgoing_traffic *t = (janus_ice_outgoing_traffic *)source;
+	janus_ice_crypto_batch *crypto = t->handle->crypto;
+	if(crypto != NULL && g_atomic_int_get(&crypto->inflight))
+		return g_atomic_int_get(&crypto->done);
+	return (g_async_queue_length(t->handle->queued_packets) > 0 ||
+		janus_ice_pacer_wait(t->handle->pacer, janus_get_monotonic_time()) == 0);
 }
 static gboolean janus_ice_outgoing_traffic_dispatch(GSource *source, GSourceFunc callback, gpointer user_data) {
 	janus_ice_outgoing_traffic *t = (janus_ice_outgoing_traffic *)source;
 	int ret = G_SOURCE_CONTINUE;
 	janus_ice_queued_packet *pkt = NULL;
+	janus_ice_crypto_batch *crypto = t->handle->crypto;
+	/* Whatever is queued from now on needs a new wakeup (see janus_ice_handle_enqueue) */
+	g_atomic_int_set(&t->handle->wakeup_pending, 0);
+	if(crypto != NULL && g_atomic_int_get(&crypto->inflight) && !g_atomic_int_get(&crypto->done))
+		return G_SOURCE_CONTINUE;
+#ifdef HAVE_SENDMMSG
+	/* If we can do batched egress, drain the queue in the loop batch first */
+	janus_ice_egress_batch *batch = t->handle->egress;
+	janus_ice_component *component = t->handle->stream ? t->handle->stream->component : NULL;
+	if(batch != NULL && component != NULL && component->egress_socket != NULL) {
+		janus_refcount_increase(&component->ref);
+		batch->component = component;
+	} else {
+		batch = NULL;
+	}
+#endif
+	/* If a crypto worker protected a batch of packets for us, send them first */
+	if(crypto != NULL && g_atomic_int_get(&crypto->inflight))
+		janus_ice_crypto_complete(t->handle);
 	while((pkt = g_async_queue_try_pop(t->handle->queued_packets)) != NULL) {
+		if(janus_ice_crypto_pending(t->handle) && pkt->type != JANUS_ICE_PACKET_MUX && (pkt->control || pkt->encrypted ||
+				(pkt->type != JANUS_ICE_PACKET_AUDIO && pkt->type != JANUS_ICE_PACKET_VIDEO) ||
+				pkt == &janus_ice_dtls_handshake || pkt == &janus_ice_hangup_peerconnection ||
+				pkt == &janus_ice_detach_handle || pkt == &janus_ice_migrate_handle)) {
+			/* We need the packets waiting for a crypto worker to go out before
+			 * this one: put it back, we'll get to it when they're done */
+			g_async_queue_push_front(t->handle->queued_packets, pkt);
+			break;
+		}
+		if(pkt == &janus_ice_migrate_handle) {
+			/* Send what we have on this loop, and then move to the new one: as
+			 * the handle will have a new source there, this one can go away */
+#ifdef HAVE_SENDMMSG
+			if(batch != NULL) {
+				janus_ice_egress_batch_flush(t->handle, batch);
+				batch->component = NULL;
+			}
+#endif
+			if(janus_ice_handle_migrate_loop(t->handle)) {
+				t->migrated = TRUE;
+				ret = G_SOURCE_REMOVE;
+				break;
+			}
+			continue;
+		}
+		if(pacing && pkt->type == JANUS_ICE_PACKET_VIDEO && !pkt->control &&
+				pkt != &janus_ice_dtls_handshake && pkt != &janus_ice_hangup_peerconnection &&
+				pkt != &janus_ice_detach_handle) {
+			/* Video goes through the pacer */
+			janus_ice_pacer_enqueue(t->handle, pkt);
+			continue;
+		}
+		if(pkt == &janus_ice_dtls_handshake || pkt == &janus_ice_hangup_peerconnection ||
+				pkt == &janus_ice_detach_handle) {
+			/* Send what we have before handling any state change */
+			janus_ice_pacer_process(t->handle, TRUE);
+			if(janus_ice_crypto_pending(t->handle)) {
+				/* The paced packets need protecting first, come back later */
+				g_async_queue_push_front(t->handle->queued_packets, pkt);
+				break;
+			}
+#ifdef HAVE_SENDMMSG
+			if(batch != NULL) {
+				janus_ice_egress_batch_flush(t->handle, batch);
+				batch->component = NULL;
+			}
+#endif
+		}
 		if(janus_ice_outgoing_traffic_handle(t->handle, pkt) == G_SOURCE_REMOVE)
 			ret = G_SOURCE_REMOVE;
+		if(t->handle->crypto != NULL && g_queue_get_length(&t->handle->crypto->packets) >= JANUS_ICE_CRYPTO_BATCH_MAX)
+			break;
+	}
+	/* Producers that queued something while we were draining set the flag too, and
+	 * their wakeup may find an empty queue, in which case we wouldn't be dispatched
+	 * to clear it: clear it now, anything still queued will be seen by prepare */
+	if(!t->migrated)
+		g_atomic_int_set(&t->handle->wakeup_pending, 0);
+	/* Send the paced packets that can go out now, if any */
+	if(ret != G_SOURCE_REMOVE) {
+		janus_ice_pacer_process(t->handle, FALSE);
+		/* Hand the packets we prepared to a crypto worker, if any */
+		if(janus_ice_crypto_pending(t->handle))
+			janus_ice_crypto_submit(t->handle);
+	}
+#ifdef HAVE_SENDMMSG
+	if(batch != NULL) {
+		janus_ice_egress_batch_flush(t->handle, batch);
+		batch->component = NULL;
+		janus_refcount_decrease(&component->ref);
 	}
+#endif
 	return ret;
 }
 static void janus_ice_outgoing_traffic_finalize(GSource *source) {
 	janus_ice_outgoing_traffic *t = (janus_ice_outgoing_traffic *)source;
 	JANUS_LOG(LOG_VERB, "[%"SCNu64"] Finalizing loop source\n", t->handle->handle_id);
-	if(static_event_loops > 0) {
+	if(t->migrated) {
+		/* The handle lives on in another loop, only get rid of the reference of the source */
+	} else if(static_event_loops > 0) {
 		/* This handle was sharing an event loop with others */
 		janus_ice_webrtc_free(t->handle);
 		janus_refcount_decrease(&t->handle->ref);
@@ -376,7 +1603,7 @@ static void janus_ice_outgoing_traffic_finalize(GSource *source) {
 }
 static GSourceFuncs janus_ice_outgoing_traffic_funcs = {
 	janus_ice_outgoing_traffic_prepare,
-	NULL,	/* We don't need check */
+	janus_ice_outgoing_traffic_check,	/* Needed for waking up when pacing */
 	janus_ice_outgoing_traffic_dispatch,
 	janus_ice_outgoing_traffic_finalize,
 	NULL, NULL
@@ -425,6 +1652,9 @@ uint janus_get_slowlink_threshold(void) {
 
 /* Period, in milliseconds, to refer to for sending TWCC feedback */
 #define DEFAULT_TWCC_PERIOD		200
+/* Size of the ring of received transport wide sequence numbers: it must be a power of two,
+ * and large enough for all the packets we can receive in a period (2048 is ~10k pps) */
+#define JANUS_ICE_TWCC_RING_SIZE	2048
 static uint twcc_period = DEFAULT_TWCC_PERIOD;
 void janus_set_twcc_period(uint period) {
 	twcc_period = period;
@@ -440,23 +1670,188 @@ uint janus_get_twcc_period(void) {
 }
 
 
-static inline void janus_ice_free_rtp_packet(janus_rtp_packet *pkt) {
+/* Packets in the NACK buffers come from the pool of the component, when they fit:
+ * we keep track of which pool, since the component may move to another event
+ * loop (and so to another pool) while the packet is still in the buffers */
+static janus_rtp_packet *janus_ice_new_rtp_packet(janus_ice_component *component, gint length) {
+	janus_rtp_packet *pkt = NULL;
+	janus_ice_pool *pool = component ? component->pool : NULL;
+	if(pool != NULL && length <= JANUS_ICE_POOL_SLOT_SIZE) {
+		pkt = janus_ice_pool_get(pool, &pool->nacks, sizeof(janus_rtp_packet) + JANUS_ICE_POOL_SLOT_SIZE);
+		pkt->data = (char *)pkt + sizeof(janus_rtp_packet);
+		pkt->pool = pool;
+	} else {
+		pkt = g_malloc(sizeof(janus_rtp_packet));
+		pkt->data = g_malloc(length);
+		pkt->pool = NULL;
+	}
+	pkt->length = length;
+	return pkt;
+}
+
+static inline void janus_ice_free_rtp_packet(janus_ice_component *component, janus_rtp_packet *pkt) {
 	if(pkt == NULL) {
 		return;
 	}
-
+	if(pkt->pool != NULL) {
+		janus_ice_pool *pool = (janus_ice_pool *)pkt->pool;
+		janus_ice_pool_put(pool, &pool->nacks, pkt);
+		return;
+	}
 	g_free(pkt->data);
 	g_free(pkt);
 }
 
-static void janus_ice_free_queued_packet(janus_ice_queued_packet *pkt) {
-	if(pkt == NULL || pkt == &janus_ice_dtls_handshake ||
-			pkt == &janus_ice_hangup_peerconnection || pkt == &janus_ice_detach_handle) {
-		return;
+/* Queued packets come from the pool of the handle, and so do their data when they fit */
+static janus_ice_queued_packet *janus_ice_new_queued_packet(janus_ice_handle *handle, gint length) {
+	janus_ice_queued_packet *pkt = NULL;
+	janus_ice_pool *pool = handle ? handle->pool : NULL;
+	if(pool != NULL) {
+		pkt = janus_ice_pool_get(pool, &pool->packets, sizeof(janus_ice_queued_packet) + JANUS_ICE_POOL_SLOT_SIZE);
+		memset(pkt, 0, sizeof(janus_ice_queued_packet));
+		pkt->pool = pool;
+		if(length > 0 && length <= JANUS_ICE_POOL_SLOT_SIZE)
+			pkt->data = janus_ice_queued_packet_slot(pkt);
+	} else {
+		pkt = g_malloc0(sizeof(janus_ice_queued_packet));
 	}
-	g_free(pkt->data);
+	if(length > 0 && pkt->data == NULL)
+		pkt->data = g_malloc(length);
+	return pkt;
+}
+
+static void janus_ice_free_queued_packet(janus_ice_queued_packet *pkt) {
+	if(pkt == NULL || pkt == &janus_ice_dtls_handshake || pkt == &janus_ice_dtls_resume ||
+			pkt == &janus_ice_hangup_peerconnection || pkt == &janus_ice_detach_handle ||
+			pkt == &janus_ice_migrate_handle) {
+		return;
+	}
+	if(!pkt->scratch && (pkt->pool == NULL || pkt->data != janus_ice_queued_packet_slot(pkt)))
+		g_free(pkt->data);
+	janus_plugin_rtp_payload_unref(pkt->payload);
 	g_free(pkt->label);
-	g_free(pkt);
+	if(pkt->pool != NULL)
+		janus_ice_pool_put(pkt->pool, &pkt->pool->packets, pkt);
+	else
+		g_free(pkt);
+}
+
+/* Per-thread (and so per-loop) scratch buffer, to put together packets with a shared payload */
+#define JANUS_ICE_SCRATCH_SIZE	(65535+SRTP_MAX_TAG_LEN)
+static GPrivate janus_ice_scratch = G_PRIVATE_INIT(g_free);
+static char *janus_ice_get_scratch(janus_ice_handle *handle, janus_ice_component *component, int length) {
+#ifdef HAVE_SENDMMSG
+	/* If we're batching, we can use the next slot directly and save a copy */
+	janus_ice_egress_batch *batch = handle->egress;
+	if(batch != NULL && batch->component != NULL && batch->component == component &&
+			length + SRTP_MAX_TAG_LEN <= JANUS_ICE_EGRESS_SLOT_SIZE)
+		return batch->slots[batch->count];
+#endif
+	char *scratch = g_private_get(&janus_ice_scratch);
+	if(scratch == NULL) {
+		scratch = g_malloc(JANUS_ICE_SCRATCH_SIZE);
+		g_private_set(&janus_ice_scratch, scratch);
+	}
+	return scratch;
+}
+
+/* Crypto worker helpers: apart from janus_ice_crypto_worker, they're only ever
+ * used by the thread owning the loop of the handle */
+static void janus_ice_outgoing_rtp_protected(janus_ice_handle *handle, janus_ice_queued_packet *pkt,
+		janus_rtp_packet *p, int res, int protected);
+static gboolean janus_ice_crypto_defer(janus_ice_handle *handle, janus_ice_queued_packet *pkt, janus_rtp_packet *p) {
+	if(srtp_workers == NULL || !janus_is_webrtc_encryption_enabled())
+		return FALSE;
+	if(handle->crypto == NULL) {
+		handle->crypto = g_malloc0(sizeof(janus_ice_crypto_batch));
+		handle->crypto->handle = handle;
+		janus_mutex_init(&handle->crypto->mutex);
+		janus_condition_init(&handle->crypto->cond);
+	}
+	pkt->nack_copy = p;
+	g_queue_push_tail(&handle->crypto->packets, pkt);
+	return TRUE;
+}
+static void janus_ice_crypto_submit(janus_ice_handle *handle) {
+	janus_ice_crypto_batch *crypto = handle->crypto;
+	guint count = g_queue_get_length(&crypto->packets);
+	crypto->batches++;
+	crypto->packets += count;
+	if(count > crypto->max_batch)
+		crypto->max_batch = count;
+	g_atomic_int_set(&crypto->done, 0);
+	g_atomic_int_set(&crypto->inflight, 1);
+	/* The worker holds a reference to the handle and the DTLS stack until it's done */
+	janus_refcount_increase(&handle->ref);
+	janus_ice_component *component = handle->stream ? handle->stream->component : NULL;
+	crypto->dtls = component ? component->dtls : NULL;
+	if(crypto->dtls != NULL)
+		janus_refcount_increase(&crypto->dtls->ref);
+	g_thread_pool_push(srtp_workers, crypto, NULL);
+}
+static void janus_ice_crypto_worker(gpointer data, gpointer user_data) {
+	janus_ice_crypto_batch *crypto = (janus_ice_crypto_batch *)data;
+	janus_ice_handle *handle = crypto->handle;
+	janus_dtls_srtp *dtls = crypto->dtls;
+	srtp_t srtp_out = dtls ? dtls->srtp_out : NULL;
+	GList *l = crypto->packets.head;
+	while(l) {
+		janus_ice_queued_packet *pkt = (janus_ice_queued_packet *)l->data;
+		pkt->protected_length = pkt->length;
+		pkt->srtp_res = srtp_out ? srtp_protect(srtp_out, pkt->data, &pkt->protected_length) : srtp_err_status_no_ctx;
+		l = l->next;
+	}
+	crypto->dtls = NULL;
+	if(dtls != NULL)
+		janus_refcount_decrease(&dtls->ref);
+	/* Once we signal we're done, the batch may be freed: don't touch it anymore */
+	janus_mutex_lock(&crypto->mutex);
+	g_atomic_int_set(&crypto->done, 1);
+	janus_condition_broadcast(&crypto->cond);
+	janus_mutex_unlock(&crypto->mutex);
+	g_main_context_wakeup(handle->mainctx);
+	janus_refcount_decrease(&handle->ref);
+}
+static void janus_ice_crypto_complete(janus_ice_handle *handle) {
+	janus_ice_crypto_batch *crypto = handle->crypto;
+	g_atomic_int_set(&crypto->inflight, 0);
+	janus_ice_component *component = handle->stream ? handle->stream->component : NULL;
+	janus_ice_queued_packet *pkt = NULL;
+	while((pkt = g_queue_pop_head(&crypto->packets)) != NULL) {
+		if(component != NULL)
+			janus_ice_outgoing_rtp_protected(handle, pkt, pkt->nack_copy, pkt->srtp_res, pkt->protected_length);
+		janus_ice_free_queued_packet(pkt);
+	}
+}
+/* Get rid of the packets waiting for (or coming back from) a crypto worker without sending them */
+static void janus_ice_crypto_clear(janus_ice_handle *handle) {
+	janus_ice_crypto_batch *crypto = handle->crypto;
+	if(crypto == NULL)
+		return;
+	/* Wait for the worker, if there's one, to be done with the batch */
+	janus_mutex_lock(&crypto->mutex);
+	while(g_atomic_int_get(&crypto->inflight) && !g_atomic_int_get(&crypto->done))
+		janus_condition_wait(&crypto->cond, &crypto->mutex);
+	janus_mutex_unlock(&crypto->mutex);
+	g_atomic_int_set(&crypto->inflight, 0);
+	janus_ice_component *component = handle->stream ? handle->stream->component : NULL;
+	janus_ice_queued_packet *pkt = NULL;
+	while((pkt = g_queue_pop_head(&crypto->packets)) != NULL) {
+		if(pkt->nack_copy != NULL)
+			janus_ice_free_rtp_packet(component, pkt->nack_copy);
+		janus_ice_free_queued_packet(pkt);
+	}
+}
+/* Get rid of the batch altogether, once it has been cleared */
+static void janus_ice_crypto_free(janus_ice_handle *handle) {
+	janus_ice_crypto_batch *crypto = handle->crypto;
+	if(crypto == NULL)
+		return;
+	janus_ice_crypto_clear(handle);
+	janus_mutex_destroy(&crypto->mutex);
+	janus_condition_destroy(&crypto->cond);
+	g_free(crypto);
+	handle->crypto = NULL;
 }
 
 /* Minimum and maximum value, in milliseconds, for the NACK queue/retransmissions (default=200ms/1000ms) */
@@ -476,37 +1871,105 @@ void janus_set_min_nack_queue(uint16_t mnq) {
 uint16_t janus_get_min_nack_queue(void) {
 	return min_nack_queue;
 }
-/* Helper to clean old NACK packets in the buffer when they exceed the queue time limit */
+/* NACK rings are sized separately for audio and video: they start small, and
+ * grow (never shrink) according to the packet rate we observe and how long
+ * we're supposed to keep packets around. Expiry is checked lazily on lookup */
+#define JANUS_ICE_NACK_RING_AUDIO_SIZE	64
+#define JANUS_ICE_NACK_RING_VIDEO_SIZE	256
+#define JANUS_ICE_NACK_RING_MAX_SIZE	16384
+static void janus_ice_nack_ring_release(janus_ice_component *component, janus_ice_nack_ring *ring) {
+	if(ring->slots == NULL)
+		return;
+	guint i = 0;
+	for(i=0; i<=ring->mask; i++) {
+		if(ring->slots[i].packet != NULL) {
+			janus_ice_free_rtp_packet(component, ring->slots[i].packet);
+			ring->slots[i].packet = NULL;
+		}
+	}
+}
+static void janus_ice_nack_ring_destroy(janus_ice_component *component, janus_ice_nack_ring *ring) {
+	janus_ice_nack_ring_release(component, ring);
+	g_free(ring->slots);
+	memset(ring, 0, sizeof(*ring));
+}
+static void janus_ice_nack_ring_resize(janus_ice_nack_ring *ring, guint size) {
+	janus_ice_nack_slot *slots = g_malloc0(size * sizeof(janus_ice_nack_slot));
+	guint mask = size-1;
+	if(ring->slots != NULL) {
+		/* Move the packets we have to the new ring */
+		guint i = 0;
+		for(i=0; i<=ring->mask; i++) {
+			janus_ice_nack_slot *slot = &ring->slots[i];
+			if(slot->packet == NULL)
+				continue;
+			/* Since we only grow, there can't be any collision */
+			slots[slot->seq & mask] = *slot;
+		}
+		g_free(ring->slots);
+	}
+	ring->slots = slots;
+	ring->mask = mask;
+}
+static void janus_ice_nack_ring_store(janus_ice_component *component, janus_ice_nack_ring *ring,
+		gboolean video, uint16_t nack_queue_ms, guint16 seq, janus_rtp_packet *p, gint64 now) {
+	if(ring->slots == NULL)
+		janus_ice_nack_ring_resize(ring, video ? JANUS_ICE_NACK_RING_VIDEO_SIZE : JANUS_ICE_NACK_RING_AUDIO_SIZE);
+	/* Every second, check if the ring is still large enough for the packet rate */
+	ring->rate_count++;
+	if(ring->rate_ts == 0) {
+		ring->rate_ts = now;
+	} else if(now - ring->rate_ts >= G_USEC_PER_SEC) {
+		ring->pps = (guint)(((gint64)ring->rate_count * G_USEC_PER_SEC) / (now - ring->rate_ts));
+		ring->rate_count = 0;
+		ring->rate_ts = now;
+		/* We want room for twice the packets the queue time would need */
+		guint needed = 2 * ring->pps * nack_queue_ms / 1000, size = ring->mask+1;
+		while(size < needed && size < JANUS_ICE_NACK_RING_MAX_SIZE)
+			size *= 2;
+		if(size > ring->mask+1) {
+			JANUS_LOG(LOG_VERB, "Growing %s NACK ring from %u to %u slots (%u pps, %"SCNu16"ms)\n",
+				video ? "video" : "audio", ring->mask+1, size, ring->pps, nack_queue_ms);
+			janus_ice_nack_ring_resize(ring, size);
+		}
+	}
+	janus_ice_nack_slot *slot = &ring->slots[seq & ring->mask];
+	if(slot->packet != NULL)
+		janus_ice_free_rtp_packet(component, slot->packet);
+	slot->packet = p;
+	slot->created = now;
+	slot->seq = seq;
+	ring->last_stored = now;
+}
+static janus_rtp_packet *janus_ice_nack_ring_lookup(janus_ice_nack_ring *ring,
+		uint16_t nack_queue_ms, guint16 seq, gint64 now) {
+	if(ring->slots == NULL)
+		return NULL;
+	janus_ice_nack_slot *slot = &ring->slots[seq & ring->mask];
+	if(slot->packet == NULL || slot->seq != seq)
+		return NULL;
+	/* Packets that are too old, or older than the last flush, are expired: we
+	 * don't free them here, as they'll be replaced by newer packets anyway */
+	if(slot->created < ring->flushed || now - slot->created >= (gint64)nack_queue_ms*1000)
+		return NULL;
+	return slot->packet;
+}
+/* Helper to clean the NACK buffers: if now is 0 we flush them (e.g., after a
+ * keyframe), which only means marking what's in them as expired; otherwise we
+ * just release the packets of rings that haven't been used for a while */
 static void janus_cleanup_nack_buffer(gint64 now, janus_ice_stream *stream, gboolean audio, gboolean video) {
 	if(stream && stream->component) {
 		janus_ice_component *component = stream->component;
-		if(audio && component->audio_retransmit_buffer) {
-			janus_rtp_packet *p = (janus_rtp_packet *)g_queue_peek_head(component->audio_retransmit_buffer);
-			while(p && (!now || (now - p->created >= (gint64)stream->nack_queue_ms*1000))) {
-				/* Packet is too old, get rid of it */
-				g_queue_pop_head(component->audio_retransmit_buffer);
-				/* Remove from hashtable too */
-				janus_rtp_header *header = (janus_rtp_header *)p->data;
-				guint16 seq = ntohs(header->seq_number);
-				g_hash_table_remove(component->audio_retransmit_seqs, GUINT_TO_POINTER(seq));
-				/* Free the packet */
-				janus_ice_free_rtp_packet(p);
-				p = (janus_rtp_packet *)g_queue_peek_head(component->audio_retransmit_buffer);
-			}
-		}
-		if(video && component->video_retransmit_buffer) {
-			janus_rtp_packet *p = (janus_rtp_packet *)g_queue_peek_head(component->video_retransmit_buffer);
-			while(p && (!now || (now - p->created >= (gint64)stream->nack_queue_ms*1000))) {
-				/* Packet is too old, get rid of it */
-				g_queue_pop_head(component->video_retransmit_buffer);
-				/* Remove from hashtable too */
-				janus_rtp_header *header = (janus_rtp_header *)p->data;
-				guint16 seq = ntohs(header->seq_number);
-				g_hash_table_remove(component->video_retransmit_seqs, GUINT_TO_POINTER(seq));
-				/* Free the packet */
-				janus_ice_free_rtp_packet(p);
-				p = (janus_rtp_packet *)g_queue_peek_head(component->video_retransmit_buffer);
-			}
+		janus_ice_nack_ring *rings[2] = { audio ? &component->audio_nack_ring : NULL, video ? &component->video_nack_ring : NULL };
+		int i = 0;
+		for(i=0; i<2; i++) {
+			janus_ice_nack_ring *ring = rings[i];
+			if(ring == NULL || ring->slots == NULL)
+				continue;
+			if(!now)
+				ring->flushed = janus_get_monotonic_time();
+			else if(now - ring->last_stored >= (gint64)stream->nack_queue_ms*1000)
+				janus_ice_nack_ring_release(component, ring);
 		}
 	}
 }
@@ -514,52 +1977,97 @@ static void janus_cleanup_nack_buffer(gint64 now, janus_ice_stream *stream, gboo
 
 #define SEQ_MISSING_WAIT 12000 /*  12ms */
 #define SEQ_NACKED_WAIT 155000 /* 155ms */
-/* janus_seq_info list functions */
-static void janus_seq_append(janus_seq_info **head, janus_seq_info *new_seq) {
-	if(*head == NULL) {
-		new_seq->prev = new_seq;
-		new_seq->next = new_seq;
-		*head = new_seq;
-	} else {
-		janus_seq_info *last_seq = (*head)->prev;
-		new_seq->prev = last_seq;
-		new_seq->next = *head;
-		(*head)->prev = new_seq;
-		last_seq->next = new_seq;
-	}
-}
-static janus_seq_info *janus_seq_pop_head(janus_seq_info **head) {
-	janus_seq_info *pop_seq = *head;
-	if(pop_seq) {
-		janus_seq_info *new_head = pop_seq->next;
-		if(pop_seq == new_head || new_head == NULL) {
-			*head = NULL;
-		} else {
-			*head = new_head;
-			new_head->prev = pop_seq->prev;
-			new_head->prev->next = new_head;
-		}
-	}
-	return pop_seq;
+/* How often we look for sequence numbers to NACK, at most */
+#define SEQ_WINDOW_TICK	5000 /*   5ms */
+#define SEQ_WINDOW_MASK	(JANUS_SEQ_WINDOW_SIZE-1)
+/* janus_seq_window functions */
+void janus_seq_window_reset(janus_seq_window *window) {
+	if(window != NULL)
+		memset(window, 0, sizeof(*window));
 }
-void janus_seq_list_free(janus_seq_info **head) {
-	if(!*head)
-		return;
-	janus_seq_info *cur = *head;
-	do {
-		janus_seq_info *next = cur->next;
-		g_free(cur);
-		cur = next;
-	} while(cur != *head);
-	*head = NULL;
+static void janus_seq_window_set(janus_seq_window *window, guint16 seq, guint8 state, gint64 now) {
+	guint16 slot = seq & SEQ_WINDOW_MASK;
+	window->state[slot] = state;
+	window->ts[slot] = now;
+	if(state == SEQ_MISSING || state == SEQ_NACKED)
+		window->pending[slot/64] |= (G_GUINT64_CONSTANT(1) << (slot%64));
+	else
+		window->pending[slot/64] &= ~(G_GUINT64_CONSTANT(1) << (slot%64));
+}
+#define JANUS_SEQ_WINDOW_JUMP		-1
+#define JANUS_SEQ_WINDOW_IN_ORDER	0
+#define JANUS_SEQ_WINDOW_RECOVERED	1
+/* Update the window with a sequence number we just received: we mark any gap
+ * as missing, which is the only per-packet work, as NACKs are generated later */
+static int janus_seq_window_update(janus_seq_window *window, guint16 seq, gint64 now) {
+	int res = JANUS_SEQ_WINDOW_IN_ORDER;
+	if(window->span > 0) {
+		int16_t diff = (int16_t)(seq - window->highest);	/* Can wrap */
+		if(diff <= 0 && -diff < window->span) {
+			/* Duplicate, or a packet we may have marked as missing */
+			guint16 slot = seq & SEQ_WINDOW_MASK;
+			if(window->state[slot] == SEQ_RECVED)
+				return JANUS_SEQ_WINDOW_IN_ORDER;
+			janus_seq_window_set(window, seq, SEQ_RECVED, now);
+			return JANUS_SEQ_WINDOW_RECOVERED;
+		} else if(diff <= 0 && diff > -1000) {
+			/* Too old for us to care */
+			return JANUS_SEQ_WINDOW_IN_ORDER;
+		} else if(diff > 0 && diff < JANUS_SEQ_WINDOW_SIZE) {
+			/* Mark everything in between as missing */
+			guint16 cur = window->highest + 1;
+			while(cur != seq) {
+				janus_seq_window_set(window, cur, SEQ_MISSING, now);
+				cur++;
+			}
+			janus_seq_window_set(window, seq, SEQ_RECVED, now);
+			window->highest = seq;
+			window->span = MIN(window->span + diff, JANUS_SEQ_WINDOW_SIZE);
+			return JANUS_SEQ_WINDOW_IN_ORDER;
+		}
+		/* Jump too big, start fresh */
+		janus_seq_window_reset(window);
+		res = JANUS_SEQ_WINDOW_JUMP;
+	}
+	/* First sequence number in the window */
+	janus_seq_window_set(window, seq, SEQ_RECVED, now);
+	window->highest = seq;
+	window->span = 1;
+	return res;
 }
-static int janus_seq_in_range(guint16 seqn, guint16 start, guint16 len) {
-	/* Supports wrapping sequence (easier with int range) */
-	int n = seqn;
-	int nh = (1<<16) + n;
-	int s = start;
-	int e = s + len;
-	return (s <= n && n < e) || (s <= nh && nh < e);
+/* Single pass on the window, from the oldest to the most recent sequence number,
+ * to find what we should NACK for the first or second time: the bitmap allows
+ * us to skip what we're not waiting for 64 slots at a time. The sequence numbers
+ * we NACK for the first time are also added to the "first" list, if provided */
+static GSList *janus_seq_window_get_nacks(janus_seq_window *window, gint64 now, GSList **first) {
+	GSList *nacks = NULL;
+	guint16 oldest = window->highest - window->span + 1;	/* Can wrap */
+	guint i = 0;
+	while(i < window->span) {
+		guint16 seq = oldest + i;
+		guint16 slot = seq & SEQ_WINDOW_MASK;
+		guint64 bits = window->pending[slot/64] >> (slot%64);
+		if(bits == 0) {
+			/* Nothing pending in the rest of this word */
+			i += 64 - (slot%64);
+			continue;
+		}
+		i++;
+		if(!(bits & 1))
+			continue;
+		if(window->state[slot] == SEQ_MISSING && now - window->ts[slot] > SEQ_MISSING_WAIT) {
+			nacks = g_slist_prepend(nacks, GUINT_TO_POINTER(seq));
+			if(first != NULL)
+				*first = g_slist_prepend(*first, GUINT_TO_POINTER(seq));
+			window->state[slot] = SEQ_NACKED;
+		} else if(window->state[slot] == SEQ_NACKED && now - window->ts[slot] > SEQ_NACKED_WAIT) {
+			nacks = g_slist_prepend(nacks, GUINT_TO_POINTER(seq));
+			janus_seq_window_set(window, seq, SEQ_GIVEUP, window->ts[slot]);
+		}
+	}
+	if(first != NULL)
+		*first = g_slist_reverse(*first);
+	return g_slist_reverse(nacks);
 }
 
 
@@ -834,7 +2342,13 @@ void janus_ice_init(gboolean ice_lite, gboolean ice_tcp, gboolean full_trickle,
 
 }
 
+static void janus_ice_disable_mux(void);
 void janus_ice_deinit(void) {
+	janus_ice_disable_mux();
+	if(srtp_workers != NULL) {
+		g_thread_pool_free(srtp_workers, FALSE, TRUE);
+		srtp_workers = NULL;
+	}
 #ifdef HAVE_TURNRESTAPI
 	janus_turnrest_deinit();
 #endif
@@ -1194,17 +2708,26 @@ gint janus_ice_handle_attach_plugin(void *core_session, janus_ice_handle *handle
 	if(static_event_loops == 0) {
 		handle->mainctx = g_main_context_new();
 		handle->mainloop = g_main_loop_new(handle->mainctx, FALSE);
+		handle->egress = janus_ice_egress_batch_new();
+		handle->pool = janus_ice_pool_new();
+		char wname[32];
+		g_snprintf(wname, sizeof(wname), "timers-%"SCNu64, handle->handle_id);
+		handle->timers = janus_ice_timer_wheel_create(handle->mainctx, wname);
 	} else {
 		/* We're actually using static event loops, pick one from the list */
 		janus_refcount_increase(&handle->ref);
 		janus_mutex_lock(&event_loops_mutex);
-		janus_ice_static_event_loop *loop = (janus_ice_static_event_loop *)current_loop->data;
+		janus_ice_static_event_loop *loop = janus_ice_static_event_loop_pick();
+		handle->loop = loop;
+		g_atomic_int_inc(&loop->handles);
 		handle->mainctx = loop->mainctx;
 		handle->mainloop = loop->mainloop;
-		current_loop = current_loop->next;
-		if(current_loop == NULL)
-			current_loop = event_loops;
+		handle->egress = loop->egress;
+		handle->pool = loop->pool;
+		janus_refcount_increase(&handle->pool->ref);
+		handle->timers = loop->timers;
 		janus_mutex_unlock(&event_loops_mutex);
+		JANUS_LOG(LOG_VERB, "[%"SCNu64"] Handle added to static event loop #%d\n", handle->handle_id, loop->id);
 	}
 	handle->rtp_source = janus_ice_outgoing_traffic_create(handle, (GDestroyNotify)g_free);
 	g_source_set_priority(handle->rtp_source, G_PRIORITY_DEFAULT);
@@ -1273,8 +2796,7 @@ gint janus_ice_handle_destroy(void *core_session, janus_ice_handle *handle) {
 	if(g_atomic_int_compare_and_exchange(&handle->app_handle->stopped, 0, 1)) {
 		/* Notify the plugin that the session's over (the plugin will
 		 * remove the other reference to the plugin session handle) */
-		g_async_queue_push(handle->queued_packets, &janus_ice_detach_handle);
-		g_main_context_wakeup(handle->mainctx);
+		janus_ice_handle_enqueue(handle, &janus_ice_detach_handle, FALSE);
 	}
 	/* Get rid of the handle now */
 	if(g_atomic_int_compare_and_exchange(&handle->dump_packets, 1, 0)) {
@@ -1304,6 +2826,24 @@ static void janus_ice_handle_free(const janus_refcount *handle_ref) {
 		g_main_context_unref(handle->mainctx);
 		handle->mainctx = NULL;
 	}
+	if(static_event_loops == 0) {
+		g_free(handle->egress);
+		janus_ice_timer_wheel_destroy(handle->timers);
+	} else {
+		janus_ice_timer_wheel_cancel(handle->timers, handle);
+	}
+	handle->egress = NULL;
+	handle->timers = NULL;
+	if(handle->loop != NULL)
+		g_atomic_int_dec_and_test(&handle->loop->handles);
+	handle->loop = NULL;
+	janus_ice_pacer_clear(handle->pacer);
+	g_free(handle->pacer);
+	handle->pacer = NULL;
+	janus_ice_crypto_free(handle);
+	if(handle->pool != NULL)
+		janus_refcount_decrease(&handle->pool->ref);
+	handle->pool = NULL;
 	janus_mutex_unlock(&handle->mutex);
 	janus_ice_webrtc_free(handle);
 	JANUS_LOG(LOG_INFO, "[%"SCNu64"] Handle and related resources freed; %p %p\n", handle->handle_id, handle, handle->session);
@@ -1350,12 +2890,7 @@ void janus_ice_webrtc_hangup(janus_ice_handle *handle, const char *reason) {
 	}
 	/* Let's message the loop, we'll notify the plugin from there */
 	if(handle->queued_packets != NULL) {
-#if GLIB_CHECK_VERSION(2, 46, 0)
-		g_async_queue_push_front(handle->queued_packets, &janus_ice_hangup_peerconnection);
-#else
-		g_async_queue_push(handle->queued_packets, &janus_ice_hangup_peerconnection);
-#endif
-		g_main_context_wakeup(handle->mainctx);
+		janus_ice_handle_enqueue(handle, &janus_ice_hangup_peerconnection, TRUE);
 	}
 }
 
@@ -1372,7 +2907,16 @@ static void janus_ice_webrtc_free(janus_ice_handle *handle) {
 		return;
 	}
 	handle->agent_created = 0;
+	/* Cancel the timers we may still have pending for this PeerConnection */
+	janus_ice_timer_wheel_cancel(handle->timers, handle);
+	/* Drop the video we may still have in the pacer */
+	janus_ice_pacer_clear(handle->pacer);
+	/* Same for the packets a crypto worker may be protecting */
+	janus_ice_crypto_clear(handle);
 	if(handle->stream != NULL) {
+		/* Stop receiving on the shared port, if media was multiplexed, or on the socket we took over */
+		janus_ice_mux_unregister(handle->stream->component);
+		janus_ice_component_release_ingress(handle, handle->stream->component, FALSE);
 		janus_ice_stream_destroy(handle->stream);
 		handle->stream = NULL;
 	}
@@ -1436,6 +2980,9 @@ static void janus_ice_stream_free(const janus_refcount *stream_ref) {
 	janus_ice_stream *stream = janus_refcount_containerof(stream_ref, janus_ice_stream, ref);
 	/* This stream can be destroyed, free all the resources */
 	stream->handle = NULL;
+	if(stream->extensions != NULL)
+		janus_ice_extensions_unref(stream->extensions);
+	stream->extensions = NULL;
 	g_free(stream->remote_hashing);
 	stream->remote_hashing = NULL;
 	g_free(stream->remote_fingerprint);
@@ -1481,8 +3028,10 @@ static void janus_ice_stream_free(const janus_refcount *stream_ref) {
 	if(stream->rtx_nacked[2])
 		g_hash_table_destroy(stream->rtx_nacked[2]);
 	stream->rtx_nacked[2] = NULL;
-	g_slist_free_full(stream->transport_wide_received_seq_nums, (GDestroyNotify)g_free);
-	stream->transport_wide_received_seq_nums = NULL;
+	g_free(stream->transport_wide_cc_ring);
+	stream->transport_wide_cc_ring = NULL;
+	janus_bwe_context_destroy(stream->bwe);
+	stream->bwe = NULL;
 	stream->audio_first_ntp_ts = 0;
 	stream->audio_first_rtp_ts = 0;
 	stream->video_first_ntp_ts[0] = 0;
@@ -1526,31 +3075,16 @@ static void janus_ice_component_free(const janus_refcount *component_ref) {
 		janus_refcount_decrease(&component->dtls->ref);
 		component->dtls = NULL;
 	}
-	if(component->audio_retransmit_buffer != NULL) {
-		janus_rtp_packet *p = NULL;
-		while((p = (janus_rtp_packet *)g_queue_pop_head(component->audio_retransmit_buffer)) != NULL) {
-			/* Remove from hashtable too */
-			janus_rtp_header *header = (janus_rtp_header *)p->data;
-			guint16 seq = ntohs(header->seq_number);
-			g_hash_table_remove(component->audio_retransmit_seqs, GUINT_TO_POINTER(seq));
-			/* Free the packet */
-			janus_ice_free_rtp_packet(p);
-		}
-		g_queue_free(component->audio_retransmit_buffer);
-		g_hash_table_destroy(component->audio_retransmit_seqs);
-	}
-	if(component->video_retransmit_buffer != NULL) {
-		janus_rtp_packet *p = NULL;
-		while((p = (janus_rtp_packet *)g_queue_pop_head(component->video_retransmit_buffer)) != NULL) {
-			/* Remove from hashtable too */
-			janus_rtp_header *header = (janus_rtp_header *)p->data;
-			guint16 seq = ntohs(header->seq_number);
-			g_hash_table_remove(component->video_retransmit_seqs, GUINT_TO_POINTER(seq));
-			/* Free the packet */
-			janus_ice_free_rtp_packet(p);
-		}
-		g_queue_free(component->video_retransmit_buffer);
-		g_hash_table_destroy(component->video_retransmit_seqs);
+	if(component->egress_socket != NULL) {
+		g_object_unref(component->egress_socket);
+		component->egress_socket = NULL;
+	}
+	janus_ice_component_release_ingress(NULL, component, FALSE);
+	janus_ice_nack_ring_destroy(component, &component->audio_nack_ring);
+	janus_ice_nack_ring_destroy(component, &component->video_nack_ring);
+	if(component->pool != NULL) {
+		janus_refcount_decrease(&component->pool->ref);
+		component->pool = NULL;
 	}
 	if(component->candidates != NULL) {
 		GSList *i = NULL, *candidates = component->candidates;
@@ -1587,14 +3121,6 @@ static void janus_ice_component_free(const janus_refcount *component_ref) {
 	component->remote_candidates = NULL;
 	g_free(component->selected_pair);
 	component->selected_pair = NULL;
-	if(component->last_seqs_audio)
-		janus_seq_list_free(&component->last_seqs_audio);
-	if(component->last_seqs_video[0])
-		janus_seq_list_free(&component->last_seqs_video[0]);
-	if(component->last_seqs_video[1])
-		janus_seq_list_free(&component->last_seqs_video[1]);
-	if(component->last_seqs_video[2])
-		janus_seq_list_free(&component->last_seqs_video[2]);
 	g_free(component);
 	//~ janus_mutex_unlock(&handle->mutex);
 }
@@ -1787,6 +3313,34 @@ static void janus_ice_cb_component_state_changed(NiceAgent *agent, guint stream_
 	}
 }
 
+#ifdef HAVE_SENDMMSG
+/* Helper to check if we can send packets on the selected pair ourselves (batched egress) */
+static void janus_ice_component_update_egress(janus_ice_handle *handle, janus_ice_component *component) {
+	if(component->egress_socket != NULL) {
+		g_object_unref(component->egress_socket);
+		component->egress_socket = NULL;
+	}
+	/* libnice only returns a socket if the selected pair is UDP and not relayed */
+	GSocket *socket = nice_agent_get_selected_socket(handle->agent, component->stream_id, component->component_id);
+	if(socket == NULL) {
+		JANUS_LOG(LOG_VERB, "[%"SCNu64"] Selected pair can't be used for batched egress, will use libnice\n", handle->handle_id);
+		return;
+	}
+	NiceCandidate *local = NULL, *remote = NULL;
+	if(!nice_agent_get_selected_pair(handle->agent, component->stream_id, component->component_id, &local, &remote) || remote == NULL) {
+		JANUS_LOG(LOG_WARN, "[%"SCNu64"] Couldn't get the selected pair, will use libnice\n", handle->handle_id);
+		g_object_unref(socket);
+		return;
+	}
+	memset(&component->egress_addr, 0, sizeof(component->egress_addr));
+	nice_address_copy_to_sockaddr(&remote->addr, (struct sockaddr *)&component->egress_addr);
+	component->egress_addrlen = nice_address_ip_version(&remote->addr) == 6 ?
+		sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+	component->egress_socket = socket;
+	JANUS_LOG(LOG_VERB, "[%"SCNu64"] Using batched egress on the selected pair\n", handle->handle_id);
+}
+#endif
+
 #ifndef HAVE_LIBNICE_TCP
 static void janus_ice_cb_new_selected_pair (NiceAgent *agent, guint stream_id, guint component_id, gchar *local, gchar *remote, gpointer ice) {
 #else
@@ -1896,6 +3450,16 @@ static void janus_ice_cb_new_selected_pair (NiceAgent *agent, guint stream_id, g
 		janus_events_notify_handlers(JANUS_EVENT_TYPE_WEBRTC, JANUS_EVENT_SUBTYPE_WEBRTC_PAIR,
 			session->session_id, handle->handle_id, handle->opaque_id, info);
 	}
+#ifdef HAVE_SENDMMSG
+	/* If batched egress is enabled, check if the new pair allows us to bypass libnice */
+	if(egress_batching)
+		janus_ice_component_update_egress(handle, component);
+#endif
+#ifdef HAVE_RECVMMSG
+	/* If batched ingress is enabled, check if we can read from the socket ourselves */
+	if(ingress_batching)
+		janus_ice_component_update_ingress(handle, component);
+#endif
 	/* Have we been here before? (might happen, when trickling) */
 	if(component->component_connected > 0)
 		return;
@@ -1905,12 +3469,7 @@ static void janus_ice_cb_new_selected_pair (NiceAgent *agent, guint stream_id, g
 	JANUS_LOG(LOG_VERB, "[%"SCNu64"]   Component is ready enough, starting DTLS handshake...\n", handle->handle_id);
 	component->component_connected = janus_get_monotonic_time();
 	/* Start the DTLS handshake, at last */
-#if GLIB_CHECK_VERSION(2, 46, 0)
-	g_async_queue_push_front(handle->queued_packets, &janus_ice_dtls_handshake);
-#else
-	g_async_queue_push(handle->queued_packets, &janus_ice_dtls_handshake);
-#endif
-	g_main_context_wakeup(handle->mainctx);
+	janus_ice_handle_enqueue(handle, &janus_ice_dtls_handshake, TRUE);
 }
 
 /* Candidates management */
@@ -2174,6 +3733,9 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 		return;
 	}
 	janus_session *session = (janus_session *)handle->session;
+	/* Account for this packet in the load of the loop we're in, if static */
+	if(handle->loop != NULL)
+		handle->loop->packets++;
 	if(!component->dtls) {	/* Still waiting for the DTLS stack */
 		JANUS_LOG(LOG_VERB, "[%"SCNu64"] Still waiting for the DTLS stack for component %d in stream %d...\n", handle->handle_id, component_id, stream_id);
 		return;
@@ -2198,6 +3760,16 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 			guint32 packet_ssrc = ntohl(header->ssrc);
 			/* Is this audio or video? */
 			int video = 0, vindex = 0, rtx = 0;
+			/* Parse all the RTP extensions we negotiated at once: the header is
+			 * not encrypted, and the values are copied, so we only do this once,
+			 * using the map of IDs we compiled when negotiating */
+			janus_ice_extensions *extensions = janus_ice_extensions_get(stream);
+			janus_rtp_extension_values ext;
+			ext.found = 0;
+			if(extensions != NULL) {
+				janus_rtp_header_extensions_parse(buf, len, &extensions->incoming, &ext);
+				janus_ice_extensions_unref(extensions);
+			}
 			/* Bundled streams, check SSRC */
 			video = ((stream->video_ssrc_peer[0] == packet_ssrc
 				|| stream->video_ssrc_peer_rtx[0] == packet_ssrc
@@ -2208,68 +3780,67 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 			if(!video && stream->audio_ssrc_peer != packet_ssrc) {
 				/* Apparently we were not told the peer SSRCs, try the RTP mid extension (or payload types) */
 				gboolean found = FALSE;
-				if(handle->stream->mid_ext_id > 0) {
-					char sdes_item[16];
-					if(janus_rtp_header_extension_parse_mid(buf, len, handle->stream->mid_ext_id, sdes_item, sizeof(sdes_item)) == 0) {
-						if(handle->audio_mid && !strcmp(handle->audio_mid, sdes_item)) {
-							/* It's audio */
-							JANUS_LOG(LOG_VERB, "[%"SCNu64"] Unadvertized SSRC (%"SCNu32") is audio! (mid %s)\n", handle->handle_id, packet_ssrc, sdes_item);
-							video = 0;
-							stream->audio_ssrc_peer = packet_ssrc;
+				if(janus_rtp_extension_found(&ext, JANUS_RTP_EXTENSION_MID)) {
+					const char *sdes_item = ext.mid;
+					if(handle->audio_mid && !strcmp(handle->audio_mid, sdes_item)) {
+						/* It's audio */
+						JANUS_LOG(LOG_VERB, "[%"SCNu64"] Unadvertized SSRC (%"SCNu32") is audio! (mid %s)\n", handle->handle_id, packet_ssrc, sdes_item);
+						video = 0;
+						stream->audio_ssrc_peer = packet_ssrc;
+						found = TRUE;
+					} else if(handle->video_mid && !strcmp(handle->video_mid, sdes_item)) {
+						/* It's video */
+						JANUS_LOG(LOG_VERB, "[%"SCNu64"] Unadvertized SSRC (%"SCNu32") is video! (mid %s)\n", handle->handle_id, packet_ssrc, sdes_item);
+						video = 1;
+						/* Check if simulcasting is involved */
+						if(stream->rid[0] == NULL || stream->rid_ext_id < 1) {
+							stream->video_ssrc_peer[0] = packet_ssrc;
 							found = TRUE;
-						} else if(handle->video_mid && !strcmp(handle->video_mid, sdes_item)) {
-							/* It's video */
-							JANUS_LOG(LOG_VERB, "[%"SCNu64"] Unadvertized SSRC (%"SCNu32") is video! (mid %s)\n", handle->handle_id, packet_ssrc, sdes_item);
-							video = 1;
-							/* Check if simulcasting is involved */
-							if(stream->rid[0] == NULL || stream->rid_ext_id < 1) {
-								stream->video_ssrc_peer[0] = packet_ssrc;
-								found = TRUE;
-							} else {
-								if(janus_rtp_header_extension_parse_rid(buf, len, stream->rid_ext_id, sdes_item, sizeof(sdes_item)) == 0) {
-									/* Try the RTP stream ID */
-									if(stream->rid[2] != NULL && !strcmp(stream->rid[2], sdes_item)) {
-										JANUS_LOG(LOG_VERB, "[%"SCNu64"]  -- Simulcasting: rid=%s\n", handle->handle_id, sdes_item);
-										stream->video_ssrc_peer[0] = packet_ssrc;
-										vindex = 0;
-										found = TRUE;
-									} else if(stream->rid[1] != NULL && !strcmp(stream->rid[1], sdes_item)) {
-										JANUS_LOG(LOG_VERB, "[%"SCNu64"]  -- Simulcasting #1: rid=%s\n", handle->handle_id, sdes_item);
-										stream->video_ssrc_peer[1] = packet_ssrc;
-										vindex = 1;
-										found = TRUE;
-									} else if(stream->rid[0] != NULL && !strcmp(stream->rid[0], sdes_item)) {
-										JANUS_LOG(LOG_VERB, "[%"SCNu64"]  -- Simulcasting #2: rid=%s\n", handle->handle_id, sdes_item);
-										stream->video_ssrc_peer[2] = packet_ssrc;
-										vindex = 2;
-										found = TRUE;
-									} else {
-										JANUS_LOG(LOG_WARN, "[%"SCNu64"]  -- Simulcasting: unknown rid %s..?\n", handle->handle_id, sdes_item);
-									}
-								} else if(stream->ridrtx_ext_id > 0 &&
-										janus_rtp_header_extension_parse_rid(buf, len, stream->ridrtx_ext_id, sdes_item, sizeof(sdes_item)) == 0) {
-									/* Try the repaired RTP stream ID */
-									if(stream->rid[2] != NULL && !strcmp(stream->rid[2], sdes_item)) {
-										JANUS_LOG(LOG_VERB, "[%"SCNu64"]  -- Simulcasting: rid=%s (rtx)\n", handle->handle_id, sdes_item);
-										stream->video_ssrc_peer_rtx[0] = packet_ssrc;
-										vindex = 0;
-										rtx = 1;
-										found = TRUE;
-									} else if(stream->rid[1] != NULL && !strcmp(stream->rid[1], sdes_item)) {
-										JANUS_LOG(LOG_VERB, "[%"SCNu64"]  -- Simulcasting #1: rid=%s (rtx)\n", handle->handle_id, sdes_item);
-										stream->video_ssrc_peer_rtx[1] = packet_ssrc;
-										vindex = 1;
-										rtx = 1;
-										found = TRUE;
-									} else if(stream->rid[0] != NULL && !strcmp(stream->rid[0], sdes_item)) {
-										JANUS_LOG(LOG_VERB, "[%"SCNu64"]  -- Simulcasting #2: rid=%s (rtx)\n", handle->handle_id, sdes_item);
-										stream->video_ssrc_peer_rtx[2] = packet_ssrc;
-										vindex = 2;
-										rtx = 1;
-										found = TRUE;
-									} else {
-										JANUS_LOG(LOG_WARN, "[%"SCNu64"]  -- Simulcasting: unknown rid %s..?\n", handle->handle_id, sdes_item);
-									}
+						} else {
+							if(janus_rtp_extension_found(&ext, JANUS_RTP_EXTENSION_RID)) {
+								/* Try the RTP stream ID */
+								sdes_item = ext.rid;
+								if(stream->rid[2] != NULL && !strcmp(stream->rid[2], sdes_item)) {
+									JANUS_LOG(LOG_VERB, "[%"SCNu64"]  -- Simulcasting: rid=%s\n", handle->handle_id, sdes_item);
+									stream->video_ssrc_peer[0] = packet_ssrc;
+									vindex = 0;
+									found = TRUE;
+								} else if(stream->rid[1] != NULL && !strcmp(stream->rid[1], sdes_item)) {
+									JANUS_LOG(LOG_VERB, "[%"SCNu64"]  -- Simulcasting #1: rid=%s\n", handle->handle_id, sdes_item);
+									stream->video_ssrc_peer[1] = packet_ssrc;
+									vindex = 1;
+									found = TRUE;
+								} else if(stream->rid[0] != NULL && !strcmp(stream->rid[0], sdes_item)) {
+									JANUS_LOG(LOG_VERB, "[%"SCNu64"]  -- Simulcasting #2: rid=%s\n", handle->handle_id, sdes_item);
+									stream->video_ssrc_peer[2] = packet_ssrc;
+									vindex = 2;
+									found = TRUE;
+								} else {
+									JANUS_LOG(LOG_WARN, "[%"SCNu64"]  -- Simulcasting: unknown rid %s..?\n", handle->handle_id, sdes_item);
+								}
+							} else if(janus_rtp_extension_found(&ext, JANUS_RTP_EXTENSION_REPAIRED_RID)) {
+								/* Try the repaired RTP stream ID */
+								sdes_item = ext.repaired_rid;
+								if(stream->rid[2] != NULL && !strcmp(stream->rid[2], sdes_item)) {
+									JANUS_LOG(LOG_VERB, "[%"SCNu64"]  -- Simulcasting: rid=%s (rtx)\n", handle->handle_id, sdes_item);
+									stream->video_ssrc_peer_rtx[0] = packet_ssrc;
+									vindex = 0;
+									rtx = 1;
+									found = TRUE;
+								} else if(stream->rid[1] != NULL && !strcmp(stream->rid[1], sdes_item)) {
+									JANUS_LOG(LOG_VERB, "[%"SCNu64"]  -- Simulcasting #1: rid=%s (rtx)\n", handle->handle_id, sdes_item);
+									stream->video_ssrc_peer_rtx[1] = packet_ssrc;
+									vindex = 1;
+									rtx = 1;
+									found = TRUE;
+								} else if(stream->rid[0] != NULL && !strcmp(stream->rid[0], sdes_item)) {
+									JANUS_LOG(LOG_VERB, "[%"SCNu64"]  -- Simulcasting #2: rid=%s (rtx)\n", handle->handle_id, sdes_item);
+									stream->video_ssrc_peer_rtx[2] = packet_ssrc;
+									vindex = 2;
+									rtx = 1;
+									found = TRUE;
+								} else {
+									JANUS_LOG(LOG_WARN, "[%"SCNu64"]  -- Simulcasting: unknown rid %s..?\n", handle->handle_id, sdes_item);
 								}
 							}
 						}
@@ -2369,14 +3940,9 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 				}
 				/* Check if we need to handle transport wide cc */
 				if(stream->do_transport_wide_cc) {
-					guint16 transport_seq_num;
 					/* Get transport wide seq num */
-					if(janus_rtp_header_extension_parse_transport_wide_cc(buf, buflen, stream->transport_wide_cc_ext_id, &transport_seq_num)==0) {
-						/* Get current timestamp */
-						struct timeval now;
-						gettimeofday(&now,0);
-						/* Create <seq num, time> pair */
-						janus_rtcp_transport_wide_cc_stats *stats = g_malloc0(sizeof(janus_rtcp_transport_wide_cc_stats));
+					if(janus_rtp_extension_found(&ext, JANUS_RTP_EXTENSION_TRANSPORT_WIDE_CC)) {
+						guint16 transport_seq_num = ext.transport_seq_num;
 						/* Check if we have a sequence wrap */
 						if(transport_seq_num<0x0FFF && (stream->transport_wide_cc_last_seq_num&0xFFFF)>0xF000) {
 							/* Increase cycles */
@@ -2386,12 +3952,18 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 						guint32 transport_ext_seq_num = stream->transport_wide_cc_cycles<<16 | transport_seq_num;
 						/* Store last received transport seq num */
 						stream->transport_wide_cc_last_seq_num = transport_seq_num;
-						/* Set stats values */
-						stats->transport_seq_num = transport_ext_seq_num;
-						stats->timestamp = (((guint64)now.tv_sec)*1E6+now.tv_usec);
-						/* Lock and append to received list */
+						/* Lock and store the <seq num, time> pair in the ring */
 						janus_mutex_lock(&stream->mutex);
-						stream->transport_wide_received_seq_nums = g_slist_prepend(stream->transport_wide_received_seq_nums, stats);
+						if(stream->transport_wide_cc_ring == NULL)
+							stream->transport_wide_cc_ring = g_malloc0(JANUS_ICE_TWCC_RING_SIZE * sizeof(janus_rtcp_transport_wide_cc_stats));
+						janus_rtcp_transport_wide_cc_stats *stats =
+							&stream->transport_wide_cc_ring[transport_ext_seq_num & (JANUS_ICE_TWCC_RING_SIZE-1)];
+						stats->transport_seq_num = transport_ext_seq_num;
+						stats->timestamp = janus_get_monotonic_time();
+						if(!stream->transport_wide_cc_received ||
+								(gint32)(transport_ext_seq_num - stream->transport_wide_cc_highest_seq_num) > 0)
+							stream->transport_wide_cc_highest_seq_num = transport_ext_seq_num;
+						stream->transport_wide_cc_received = TRUE;
 						janus_mutex_unlock(&stream->mutex);
 					}
 				}
@@ -2468,31 +4040,26 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 				/* Prepare the data to pass to the responsible plugin */
 				janus_plugin_rtp rtp = { .video = video, .buffer = buf, .length = buflen };
 				janus_plugin_rtp_extensions_reset(&rtp.extensions);
-				/* Parse RTP extensions before involving the plugin */
-				if(stream->audiolevel_ext_id != -1) {
-					gboolean vad = FALSE;
-					int level = -1;
-					if(janus_rtp_header_extension_parse_audio_level(buf, buflen,
-							stream->audiolevel_ext_id, &vad, &level) == 0) {
-						rtp.extensions.audio_level = level;
-						rtp.extensions.audio_level_vad = vad;
-					}
+				/* Pass the RTP extensions we parsed to the plugin, so that it doesn't need to */
+				if(janus_rtp_extension_found(&ext, JANUS_RTP_EXTENSION_AUDIO_LEVEL)) {
+					rtp.extensions.audio_level = ext.audio_level;
+					rtp.extensions.audio_level_vad = ext.audio_level_vad;
 				}
-				if(stream->videoorientation_ext_id != -1) {
-					gboolean c = FALSE, f = FALSE, r1 = FALSE, r0 = FALSE;
-					if(janus_rtp_header_extension_parse_video_orientation(buf, buflen,
-							stream->videoorientation_ext_id, &c, &f, &r1, &r0) == 0) {
-						rtp.extensions.video_rotation = 0;
-						if(r1 && r0)
-							rtp.extensions.video_rotation = 270;
-						else if(r1)
-							rtp.extensions.video_rotation = 180;
-						else if(r0)
-							rtp.extensions.video_rotation = 90;
-						rtp.extensions.video_back_camera = c;
-						rtp.extensions.video_flipped = f;
-					}
+				if(janus_rtp_extension_found(&ext, JANUS_RTP_EXTENSION_VIDEO_ORIENTATION)) {
+					rtp.extensions.video_rotation = ext.video_rotation;
+					rtp.extensions.video_back_camera = ext.video_back_camera;
+					rtp.extensions.video_flipped = ext.video_flipped;
 				}
+				if(janus_rtp_extension_found(&ext, JANUS_RTP_EXTENSION_TRANSPORT_WIDE_CC))
+					rtp.extensions.transport_seq_num = ext.transport_seq_num;
+				if(janus_rtp_extension_found(&ext, JANUS_RTP_EXTENSION_FRAMEMARKING))
+					rtp.extensions.framemarking_tid = ext.framemarking_tid;
+				if(janus_rtp_extension_found(&ext, JANUS_RTP_EXTENSION_MID))
+					g_strlcpy(rtp.extensions.mid, ext.mid, sizeof(rtp.extensions.mid));
+				if(janus_rtp_extension_found(&ext, JANUS_RTP_EXTENSION_RID))
+					g_strlcpy(rtp.extensions.rid, ext.rid, sizeof(rtp.extensions.rid));
+				else if(rtx && janus_rtp_extension_found(&ext, JANUS_RTP_EXTENSION_REPAIRED_RID))
+					g_strlcpy(rtp.extensions.rid, ext.repaired_rid, sizeof(rtp.extensions.rid));
 				/* Pass the packet to the plugin */
 				janus_plugin *plugin = (janus_plugin *)handle->app;
 				if(plugin && plugin->incoming_rtp && handle->app_handle &&
@@ -2566,95 +4133,44 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 					if(stream->video_is_keyframe(payload, plen)) {
 						if(rtcp_ctx && (int16_t)(new_seqn - rtcp_ctx->max_seq_nr) > 0) {
 							JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Keyframe received with a highest sequence number, resetting NACK queue\n", handle->handle_id);
-							janus_seq_list_free(&component->last_seqs_video[vindex]);
+							janus_seq_window_reset(&component->video_seq_window[vindex]);
 						}
 					}
 				}
-				guint16 cur_seqn;
-				int last_seqs_len = 0;
 				janus_mutex_lock(&component->mutex);
-				janus_seq_info **last_seqs = video ? &component->last_seqs_video[vindex] : &component->last_seqs_audio;
-				janus_seq_info *cur_seq = *last_seqs;
-				if(cur_seq) {
-					cur_seq = cur_seq->prev;
-					cur_seqn = cur_seq->seq;
-				} else {
-					/* First seq, set up to add one seq */
-					cur_seqn = new_seqn - (guint16)1; /* Can wrap */
-				}
-				if(!janus_seq_in_range(new_seqn, cur_seqn, LAST_SEQS_MAX_LEN) &&
-						!janus_seq_in_range(cur_seqn, new_seqn, 1000)) {
-					/* Jump too big, start fresh */
+				janus_seq_window *window = video ? &component->video_seq_window[vindex] : &component->audio_seq_window;
+				guint16 prev_seqn = window->highest;
+				gint64 now = janus_get_monotonic_time();
+				int update = janus_seq_window_update(window, new_seqn, now);
+				if(update == JANUS_SEQ_WINDOW_JUMP) {
 					JANUS_LOG(LOG_WARN, "[%"SCNu64"] Big sequence number jump %hu -> %hu (%s stream #%d)\n",
-						handle->handle_id, cur_seqn, new_seqn, video ? "video" : "audio", vindex);
-					janus_seq_list_free(last_seqs);
-					cur_seq = NULL;
-					cur_seqn = new_seqn - (guint16)1;
+						handle->handle_id, prev_seqn, new_seqn, video ? "video" : "audio", vindex);
+				} else if(update == JANUS_SEQ_WINDOW_RECOVERED) {
+					JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Received missed sequence number %"SCNu16" (%s stream #%d)\n",
+						handle->handle_id, new_seqn, video ? "video" : "audio", vindex);
 				}
-
-				GSList *nacks = NULL;
-				gint64 now = janus_get_monotonic_time();
-
-				if(janus_seq_in_range(new_seqn, cur_seqn, LAST_SEQS_MAX_LEN)) {
-					/* Add new seq objs forward */
-					while(cur_seqn != new_seqn) {
-						cur_seqn += (guint16)1; /* can wrap */
-						janus_seq_info *seq_obj = g_malloc0(sizeof(janus_seq_info));
-						seq_obj->seq = cur_seqn;
-						seq_obj->ts = now;
-						seq_obj->state = (cur_seqn == new_seqn) ? SEQ_RECVED : SEQ_MISSING;
-						janus_seq_append(last_seqs, seq_obj);
-						last_seqs_len++;
-					}
+				/* We don't look for what to NACK on every packet, but on a short tick */
+				GSList *nacks = NULL, *first_nacks = NULL;
+				if(now - window->last_scan >= SEQ_WINDOW_TICK) {
+					window->last_scan = now;
+					gboolean track_rtx = video && janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_RFC4588_RTX);
+					nacks = janus_seq_window_get_nacks(window, now, track_rtx ? &first_nacks : NULL);
 				}
-				if(cur_seq) {
-					/* Scan old seq objs backwards */
-					while(cur_seq != NULL) {
-						last_seqs_len++;
-						if(cur_seq->seq == new_seqn) {
-							JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Received missed sequence number %"SCNu16" (%s stream #%d)\n",
-								handle->handle_id, cur_seq->seq, video ? "video" : "audio", vindex);
-							cur_seq->state = SEQ_RECVED;
-						} else if(cur_seq->state == SEQ_MISSING && now - cur_seq->ts > SEQ_MISSING_WAIT) {
-							JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Missed sequence number %"SCNu16" (%s stream #%d), sending 1st NACK\n",
-								handle->handle_id, cur_seq->seq, video ? "video" : "audio", vindex);
-							nacks = g_slist_prepend(nacks, GUINT_TO_POINTER(cur_seq->seq));
-							cur_seq->state = SEQ_NACKED;
-							if(video && janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_RFC4588_RTX)) {
-								/* Keep track of this sequence number, we need to avoid duplicates */
-								JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Tracking NACKed packet %"SCNu16" (SSRC %"SCNu32", vindex %d)...\n",
-									handle->handle_id, cur_seq->seq, packet_ssrc, vindex);
-								if(stream->rtx_nacked[vindex] == NULL)
-									stream->rtx_nacked[vindex] = g_hash_table_new(NULL, NULL);
-								g_hash_table_insert(stream->rtx_nacked[vindex], GUINT_TO_POINTER(cur_seq->seq), GINT_TO_POINTER(1));
-								/* We don't track it forever, though: add a timed source to remove it in a few seconds */
-								janus_ice_nacked_packet *np = g_malloc(sizeof(janus_ice_nacked_packet));
-								np->handle = handle;
-								np->seq_number = cur_seq->seq;
-								np->vindex = vindex;
-								GSource *timeout_source = g_timeout_source_new_seconds(5);
-								g_source_set_callback(timeout_source, janus_ice_nacked_packet_cleanup, np, (GDestroyNotify)g_free);
-								g_source_attach(timeout_source, handle->mainctx);
-								g_source_unref(timeout_source);
-							}
-						} else if(cur_seq->state == SEQ_NACKED  && now - cur_seq->ts > SEQ_NACKED_WAIT) {
-							JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Missed sequence number %"SCNu16" (%s stream #%d), sending 2nd NACK\n",
-								handle->handle_id, cur_seq->seq, video ? "video" : "audio", vindex);
-							nacks = g_slist_prepend(nacks, GUINT_TO_POINTER(cur_seq->seq));
-							cur_seq->state = SEQ_GIVEUP;
-						}
-						if(cur_seq == *last_seqs) {
-							/* Just processed head */
-							break;
-						}
-						cur_seq = cur_seq->prev;
-					}
-				}
-				while(last_seqs_len > LAST_SEQS_MAX_LEN) {
-					janus_seq_info *node = janus_seq_pop_head(last_seqs);
-					g_free(node);
-					last_seqs_len--;
+				GSList *fn = first_nacks;
+				while(fn != NULL) {
+					guint16 seqn = GPOINTER_TO_UINT(fn->data);
+					/* Keep track of this sequence number, we need to avoid duplicates */
+					JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Tracking NACKed packet %"SCNu16" (SSRC %"SCNu32", vindex %d)...\n",
+						handle->handle_id, seqn, packet_ssrc, vindex);
+					if(stream->rtx_nacked[vindex] == NULL)
+						stream->rtx_nacked[vindex] = g_hash_table_new(NULL, NULL);
+					g_hash_table_insert(stream->rtx_nacked[vindex], GUINT_TO_POINTER(seqn), GINT_TO_POINTER(1));
+					/* We don't track it forever, though: schedule a timer to remove it in a few seconds */
+					janus_ice_handle_add_timer(handle, 5000, janus_ice_nacked_packet_cleanup,
+						janus_ice_nacked_packet_data(vindex, seqn), NULL);
+					fn = fn->next;
 				}
+				g_slist_free(first_nacks);
 
 				guint nacks_count = g_slist_length(nacks);
 				if(nacks_count) {
@@ -2778,10 +4294,25 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 				/* Let's process this RTCP (compound?) packet, and update the RTCP context for this stream in case */
 				rtcp_context *rtcp_ctx = video ? stream->video_rtcp_ctx[vindex] : stream->audio_rtcp_ctx;
 				uint32_t rtt = rtcp_ctx ? rtcp_ctx->rtt : 0;
+				if(rtcp_ctx && stream->bwe) {
+					/* Any transport wide cc feedback will be passed to the bandwidth estimator */
+					rtcp_ctx->twcc_callback = janus_bwe_context_handle_feedback;
+					rtcp_ctx->twcc_callback_data = stream->bwe;
+				}
 				if(janus_rtcp_parse(rtcp_ctx, buf, buflen) < 0) {
 					/* Drop the packet if the parsing function returns with an error */
 					return;
 				}
+				if(stream->bwe) {
+					/* Check if the estimate changed, and if so notify the plugin */
+					guint32 estimate = janus_bwe_context_update(stream->bwe, janus_get_monotonic_time());
+					janus_plugin *plugin = (janus_plugin *)handle->app;
+					if(estimate > 0 && plugin && plugin->estimated_bandwidth && janus_plugin_session_is_alive(handle->app_handle) &&
+							!g_atomic_int_get(&handle->destroyed)) {
+						JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Estimated bandwidth: %"SCNu32"\n", handle->handle_id, estimate);
+						plugin->estimated_bandwidth(handle->app_handle, estimate);
+					}
+				}
 				if(rtcp_ctx && rtcp_ctx->rtt != rtt) {
 					/* Check the current RTT, to see if we need to update the size of the queue: we take
 					 * the highest RTT (audio or video) and add 100ms just to be conservative */
@@ -2808,8 +4339,8 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 				if(nacks_count && ((!video && component->do_audio_nacks) || (video && component->do_video_nacks))) {
 					/* Handle NACK */
 					JANUS_LOG(LOG_HUGE, "[%"SCNu64"]     Just got some NACKS (%d) we should handle...\n", handle->handle_id, nacks_count);
-					GHashTable *retransmit_seqs = (video ? component->video_retransmit_seqs : component->audio_retransmit_seqs);
-					GSList *list = (retransmit_seqs != NULL ? nacks : NULL);
+					janus_ice_nack_ring *nack_ring = (video ? &component->video_nack_ring : &component->audio_nack_ring);
+					GSList *list = (nack_ring->slots != NULL ? nacks : NULL);
 					int retransmits_cnt = 0;
 					janus_mutex_lock(&component->mutex);
 					while(list) {
@@ -2817,7 +4348,7 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 						JANUS_LOG(LOG_DBG, "[%"SCNu64"]   >> %u\n", handle->handle_id, seqnr);
 						int in_rb = 0;
 						/* Check if we have the packet */
-						janus_rtp_packet *p = g_hash_table_lookup(retransmit_seqs, GUINT_TO_POINTER(seqnr));
+						janus_rtp_packet *p = janus_ice_nack_ring_lookup(nack_ring, stream->nack_queue_ms, seqnr, now);
 						if(p == NULL) {
 							JANUS_LOG(LOG_HUGE, "[%"SCNu64"]   >> >> Can't retransmit packet %u, we don't have it...\n", handle->handle_id, seqnr);
 						} else {
@@ -2832,8 +4363,7 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 							p->last_retransmit = now;
 							retransmits_cnt++;
 							/* Enqueue it */
-							janus_ice_queued_packet *pkt = g_malloc(sizeof(janus_ice_queued_packet));
-							pkt->data = g_malloc(p->length+SRTP_MAX_TAG_LEN);
+							janus_ice_queued_packet *pkt = janus_ice_new_queued_packet(handle, p->length+SRTP_MAX_TAG_LEN);
 							memcpy(pkt->data, p->data, p->length);
 							pkt->length = p->length;
 							pkt->type = video ? JANUS_ICE_PACKET_VIDEO : JANUS_ICE_PACKET_AUDIO;
@@ -2855,12 +4385,7 @@ static void janus_ice_cb_nice_recv(NiceAgent *agent, guint stream_id, guint comp
 								header->seq_number = htons(component->rtx_seq_number);
 							}
 							if(handle->queued_packets != NULL) {
-#if GLIB_CHECK_VERSION(2, 46, 0)
-								g_async_queue_push_front(handle->queued_packets, pkt);
-#else
-								g_async_queue_push(handle->queued_packets, pkt);
-#endif
-								g_main_context_wakeup(handle->mainctx);
+								janus_ice_handle_enqueue(handle, pkt, TRUE);
 							}
 						}
 						if(rtcp_ctx != NULL && in_rb) {
@@ -3108,6 +4633,11 @@ void janus_ice_candidates_to_sdp(janus_ice_handle *handle, janus_sdp_mline *mlin
 		JANUS_LOG(LOG_ERR, "[%"SCNu64"]     No component %d in stream %d??\n", handle->handle_id, component_id, stream_id);
 		return;
 	}
+	if(component->mux_ufrag != NULL) {
+		/* Media is multiplexed on a single port, libnice has no candidates */
+		janus_ice_mux_candidates_to_sdp(handle, component, mline);
+		return;
+	}
 	NiceAgent *agent = handle->agent;
 	/* Iterate on all */
 	gchar buffer[200];
@@ -3149,6 +4679,11 @@ void janus_ice_setup_remote_candidates(janus_ice_handle *handle, guint stream_id
 		JANUS_LOG(LOG_VERB, "[%"SCNu64"] Component %d in stream %d has already been set up\n", handle->handle_id, component_id, stream_id);
 		return;
 	}
+	if(component->mux_ufrag != NULL) {
+		/* Media is multiplexed on a single port: we just wait for the connectivity checks of the peer */
+		component->process_started = TRUE;
+		return;
+	}
 	if(!component->candidates || !component->candidates->data) {
 		if(!janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_TRICKLE)
 				|| janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_ALL_TRICKLES)) {
@@ -3451,19 +4986,30 @@ int janus_ice_setup_local(janus_ice_handle *handle, int offer, int audio, int vi
 	component->stream_id = stream->stream_id;
 	component->component_id = 1;
 	janus_mutex_init(&component->mutex);
+	component->pool = handle->pool;
+	if(component->pool != NULL)
+		janus_refcount_increase(&component->pool->ref);
 	stream->component = component;
+	if(mux_port > 0) {
+		/* Media is multiplexed on a single port: there's nothing to gather, we
+		 * only need credentials to validate the connectivity checks we'll get */
+		janus_ice_mux_register(component);
+		stream->cdone = 1;
+		handle->cdone = 1;
+	} else {
 #ifdef HAVE_PORTRANGE
-	/* FIXME: libnice supports this since 0.1.0, but the 0.1.3 on Fedora fails with an undefined reference! */
-	nice_agent_set_port_range(handle->agent, handle->stream_id, 1, rtp_range_min, rtp_range_max);
+		/* FIXME: libnice supports this since 0.1.0, but the 0.1.3 on Fedora fails with an undefined reference! */
+		nice_agent_set_port_range(handle->agent, handle->stream_id, 1, rtp_range_min, rtp_range_max);
 #endif
-	if(!nice_agent_gather_candidates(handle->agent, handle->stream_id)) {
-		JANUS_LOG(LOG_ERR, "[%"SCNu64"] Error gathering candidates...\n", handle->handle_id);
-		janus_flags_clear(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_HAS_AGENT);
-		janus_ice_webrtc_hangup(handle, "Gathering error");
-		return -1;
+		if(!nice_agent_gather_candidates(handle->agent, handle->stream_id)) {
+			JANUS_LOG(LOG_ERR, "[%"SCNu64"] Error gathering candidates...\n", handle->handle_id);
+			janus_flags_clear(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_HAS_AGENT);
+			janus_ice_webrtc_hangup(handle, "Gathering error");
+			return -1;
+		}
+		nice_agent_attach_recv(handle->agent, handle->stream_id, 1, g_main_loop_get_context(handle->mainloop),
+			janus_ice_cb_nice_recv, component);
 	}
-	nice_agent_attach_recv(handle->agent, handle->stream_id, 1, g_main_loop_get_context(handle->mainloop),
-		janus_ice_cb_nice_recv, component);
 #ifdef HAVE_TURNRESTAPI
 	if(turnrest_credentials != NULL) {
 		janus_turnrest_response_destroy(turnrest_credentials);
@@ -3486,6 +5032,14 @@ int janus_ice_setup_local(janus_ice_handle *handle, int offer, int audio, int vi
 void janus_ice_restart(janus_ice_handle *handle) {
 	if(!handle || !handle->agent || !handle->stream)
 		return;
+	if(handle->stream->component != NULL && handle->stream->component->mux_ufrag != NULL) {
+		/* Just pick new credentials: we'll keep on using the nominated address until the peer nominates a new one */
+		janus_ice_mux_register(handle->stream->component);
+		janus_flags_clear(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_ICE_RESTART);
+		return;
+	}
+	/* libnice will need to read the connectivity checks itself again */
+	janus_ice_component_release_ingress(handle, handle->stream->component, TRUE);
 	/* Restart ICE */
 	if(nice_agent_restart(handle->agent) == FALSE) {
 		JANUS_LOG(LOG_WARN, "[%"SCNu64"] ICE restart failed...\n", handle->handle_id);
@@ -3524,9 +5078,6 @@ void janus_ice_resend_trickles(janus_ice_handle *handle) {
 	janus_ice_notify_trickle(handle, NULL);
 }
 
-static gint rtcp_transport_wide_cc_stats_comparator(gconstpointer item1, gconstpointer item2) {
-	return ((rtcp_transport_wide_cc_stats*)item1)->transport_seq_num - ((rtcp_transport_wide_cc_stats*)item2)->transport_seq_num;
-}
 static gboolean janus_ice_outgoing_transport_wide_cc_feedback(gpointer user_data) {
 	janus_ice_handle *handle = (janus_ice_handle *)user_data;
 	janus_ice_stream *stream = handle->stream;
@@ -3534,81 +5085,57 @@ static gboolean janus_ice_outgoing_transport_wide_cc_feedback(gpointer user_data
 		/* Create a transport wide feedback message */
 		size_t size = 1300;
 		char rtcpbuf[1300];
-		/* Order packet list */
-		stream->transport_wide_received_seq_nums = g_slist_sort(stream->transport_wide_received_seq_nums,
-			rtcp_transport_wide_cc_stats_comparator);
-		/* Create full stats queue */
-		GQueue *packets = g_queue_new();
-		/* For all packets */
-		GSList *it = NULL;
-		for(it = stream->transport_wide_received_seq_nums; it; it = it->next) {
-			/* Get stat */
-			janus_rtcp_transport_wide_cc_stats *stats = (janus_rtcp_transport_wide_cc_stats *)it->data;
-			/* Get transport seq */
-			guint32 transport_seq_num = stats->transport_seq_num;
-			/* Check if it is an out of order  */
-			if(transport_seq_num < stream->transport_wide_cc_last_feedback_seq_num) {
-				/* Skip, it was already reported as lost */
-				g_free(stats);
-				continue;
+		/* We walk the ring in order, from the first sequence number we didn't
+		 * report yet to the highest we received, up to 400 packets at a time:
+		 * slots that don't contain the sequence number we expect are lost */
+		janus_rtcp_transport_wide_cc_stats packets[400];
+		while(TRUE) {
+			guint count = 0;
+			janus_mutex_lock(&stream->mutex);
+			if(stream->transport_wide_cc_ring == NULL || !stream->transport_wide_cc_received) {
+				janus_mutex_unlock(&stream->mutex);
+				break;
 			}
-			/* If not first */
-			if(stream->transport_wide_cc_last_feedback_seq_num) {
-				/* For each lost */
-				guint32 i = 0;
-				for(i = stream->transport_wide_cc_last_feedback_seq_num+1; i<transport_seq_num; ++i) {
-					/* Create new stat */
-					janus_rtcp_transport_wide_cc_stats *missing = g_malloc(sizeof(janus_rtcp_transport_wide_cc_stats));
-					/* Add missing packet */
-					missing->transport_seq_num = i;
-					missing->timestamp = 0;
-					/* Add it */
-					g_queue_push_tail(packets, missing);
+			guint32 highest = stream->transport_wide_cc_highest_seq_num;
+			guint32 first = stream->transport_wide_cc_last_feedback_seq_num + 1;
+			if(!stream->transport_wide_cc_feedback_sent ||
+					(gint32)(highest - first) >= JANUS_ICE_TWCC_RING_SIZE) {
+				/* First feedback, or we fell behind the ring: start from the
+				 * oldest packet we have, skipping what we don't know about */
+				first = highest - (JANUS_ICE_TWCC_RING_SIZE-1);
+				while(first != highest) {
+					janus_rtcp_transport_wide_cc_stats *oldest = &stream->transport_wide_cc_ring[first & (JANUS_ICE_TWCC_RING_SIZE-1)];
+					if(oldest->timestamp > 0 && oldest->transport_seq_num == first)
+						break;
+					first++;
 				}
 			}
-			/* Store last */
-			stream->transport_wide_cc_last_feedback_seq_num = transport_seq_num;
-			/* Add this one */
-			g_queue_push_tail(packets, stats);
-		}
-		/* Free and reset stats list */
-		g_slist_free(stream->transport_wide_received_seq_nums);
-		stream->transport_wide_received_seq_nums = NULL;
-		/* Create and enqueue RTCP packets */
-		guint packets_len = 0;
-		while((packets_len = g_queue_get_length(packets)) > 0) {
-			GQueue *packets_to_process;
-			/* If we have more than 400 packets to acknowledge, let's send more than one message */
-			if(packets_len > 400) {
-				/* Split the queue into two */
-				GList *new_head = g_queue_peek_nth_link(packets, 400);
-				GList *new_tail = new_head->prev;
-				new_head->prev = NULL;
-				new_tail->next = NULL;
-				packets_to_process = g_queue_new();
-				packets_to_process->head = packets->head;
-				packets_to_process->tail = new_tail;
-				packets_to_process->length = 400;
-				packets->head = new_head;
-				/* packets->tail is unchanged */
-				packets->length = packets_len - 400;
-			} else {
-				packets_to_process = packets;
+			guint32 seq = first;
+			while(count < 400 && (gint32)(highest - seq) >= 0) {
+				janus_rtcp_transport_wide_cc_stats *stats = &stream->transport_wide_cc_ring[seq & (JANUS_ICE_TWCC_RING_SIZE-1)];
+				packets[count].transport_seq_num = seq;
+				packets[count].timestamp = (stats->transport_seq_num == seq) ? stats->timestamp : 0;
+				count++;
+				seq++;
 			}
+			if(count > 0) {
+				stream->transport_wide_cc_last_feedback_seq_num = seq - 1;
+				stream->transport_wide_cc_feedback_sent = TRUE;
+			}
+			janus_mutex_unlock(&stream->mutex);
+			if(count == 0)
+				break;
 			/* Get feedback packet count and increase it for next one */
 			guint8 feedback_packet_count = stream->transport_wide_cc_feedback_count++;
 			/* Create RTCP packet */
 			int len = janus_rtcp_transport_wide_cc_feedback(rtcpbuf, size,
-				stream->video_ssrc, stream->video_ssrc_peer[0], feedback_packet_count, packets_to_process);
+				stream->video_ssrc, stream->video_ssrc_peer[0], feedback_packet_count, packets, count);
 			/* Enqueue it, we'll send it later */
 			janus_plugin_rtcp rtcp = { .video = TRUE, .buffer = rtcpbuf, .length = len };
 			janus_ice_relay_rtcp_internal(handle, &rtcp, FALSE);
-			if(packets_to_process != packets) {
-				g_queue_free(packets_to_process);
-			}
+			if(count < 400)
+				break;
 		}
-		/* Free mem */
-		g_queue_free(packets);
 	}
 	return G_SOURCE_CONTINUE;
 }
@@ -3899,6 +5426,283 @@ static gboolean janus_ice_outgoing_stats_handle(gpointer user_data) {
 	return G_SOURCE_CONTINUE;
 }
 
+/* Helper to send a (S)RTP/(S)RTCP packet on a component: when batched egress is
+ * in use for the current dispatch the packet is copied to the loop batch, and
+ * sent later on, otherwise it's sent via libnice right away */
+static int janus_ice_component_send(janus_ice_handle *handle, janus_ice_component *component, int len, const gchar *buf) {
+#ifdef HAVE_SENDMMSG
+	janus_ice_egress_batch *batch = handle->egress;
+	if(batch != NULL && batch->component != NULL && batch->component == component) {
+		if(len <= JANUS_ICE_EGRESS_SLOT_SIZE) {
+			/* The packet may have been put together in the slot already */
+			if(buf != batch->slots[batch->count])
+				memcpy(batch->slots[batch->count], buf, len);
+			batch->iov[batch->count].iov_base = batch->slots[batch->count];
+			batch->iov[batch->count].iov_len = len;
+			batch->count++;
+			if(batch->count == JANUS_ICE_EGRESS_BATCH_MAX)
+				janus_ice_egress_batch_flush(handle, batch);
+			return len;
+		}
+		/* Too large for a slot: preserve the order of what we queued so far */
+		janus_ice_egress_batch_flush(handle, batch);
+	}
+#endif
+	return janus_ice_component_send_raw(handle, component, len, buf);
+}
+int janus_ice_component_send_raw(janus_ice_handle *handle, janus_ice_component *component, int len, const gchar *buf) {
+	if(component->mux_addr != NULL && component->egress_socket != NULL) {
+		/* Media is multiplexed on a single port, libnice doesn't know about this peer */
+		return sendto(g_socket_get_fd(component->egress_socket), buf, len, 0,
+			(struct sockaddr *)&component->egress_addr, component->egress_addrlen);
+	}
+	return nice_agent_send(handle->agent, component->stream_id, component->component_id, len, buf);
+}
+
+/* Recurring sources of a PeerConnection: RTCP, stats and, optionally, TWCC feedback */
+static void janus_ice_handle_create_sources(janus_ice_handle *handle) {
+	handle->rtcp_source = g_timeout_source_new_seconds(1);
+	g_source_set_priority(handle->rtcp_source, G_PRIORITY_DEFAULT);
+	g_source_set_callback(handle->rtcp_source, janus_ice_outgoing_rtcp_handle, handle, NULL);
+	g_source_attach(handle->rtcp_source, handle->mainctx);
+	if(twcc_period != 1000) {
+		/* The Transport Wide CC feedback period is different, create another source */
+		handle->twcc_source = g_timeout_source_new(twcc_period);
+		g_source_set_priority(handle->twcc_source, G_PRIORITY_DEFAULT);
+		g_source_set_callback(handle->twcc_source, janus_ice_outgoing_transport_wide_cc_feedback, handle, NULL);
+		g_source_attach(handle->twcc_source, handle->mainctx);
+	}
+	handle->stats_source = g_timeout_source_new_seconds(1);
+	g_source_set_callback(handle->stats_source, janus_ice_outgoing_stats_handle, handle, NULL);
+	g_source_set_priority(handle->stats_source, G_PRIORITY_DEFAULT);
+	g_source_attach(handle->stats_source, handle->mainctx);
+}
+static void janus_ice_handle_destroy_sources(janus_ice_handle *handle) {
+	if(handle->rtcp_source) {
+		g_source_destroy(handle->rtcp_source);
+		g_source_unref(handle->rtcp_source);
+		handle->rtcp_source = NULL;
+	}
+	if(handle->twcc_source) {
+		g_source_destroy(handle->twcc_source);
+		g_source_unref(handle->twcc_source);
+		handle->twcc_source = NULL;
+	}
+	if(handle->stats_source) {
+		g_source_destroy(handle->stats_source);
+		g_source_unref(handle->stats_source);
+		handle->stats_source = NULL;
+	}
+}
+
+/* Move a handle to the static event loop it's been asked to move to: this is
+ * always done by the thread of the loop the handle is currently in, from its
+ * outgoing traffic source, so that nothing else is running for the handle */
+static gboolean janus_ice_handle_migrate_loop(janus_ice_handle *handle) {
+	janus_ice_static_event_loop *from = handle->loop,
+		*to = (janus_ice_static_event_loop *)g_atomic_pointer_get(&handle->migrate_to);
+	g_atomic_pointer_set(&handle->migrate_to, NULL);
+	if(from == NULL || to == NULL || from == to)
+		return FALSE;
+	if(g_atomic_int_get(&handle->destroyed) || handle->app_handle == NULL ||
+			janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_CLEANING)) {
+		JANUS_LOG(LOG_WARN, "[%"SCNu64"] Handle is going away, not moving it to static event loop #%d\n",
+			handle->handle_id, to->id);
+		return FALSE;
+	}
+	JANUS_LOG(LOG_INFO, "[%"SCNu64"] Moving handle from static event loop #%d to #%d\n",
+		handle->handle_id, from->id, to->id);
+	janus_mutex_lock(&handle->mutex);
+	/* Move the timers and switch to the resources of the new loop */
+	janus_ice_timer_wheel_move(from->timers, to->timers, handle);
+	janus_ice_component *component = handle->stream ? handle->stream->component : NULL;
+	if(component != NULL && component->pool == handle->pool) {
+		janus_refcount_increase(&to->pool->ref);
+		janus_refcount_decrease(&component->pool->ref);
+		component->pool = to->pool;
+	}
+	janus_refcount_increase(&to->pool->ref);
+	janus_refcount_decrease(&handle->pool->ref);
+	handle->pool = to->pool;
+	handle->egress = to->egress;
+	handle->timers = to->timers;
+	handle->mainloop = to->mainloop;
+	handle->mainctx = to->mainctx;
+	handle->loop = to;
+	g_atomic_int_dec_and_test(&from->handles);
+	g_atomic_int_inc(&to->handles);
+	/* Incoming media will be received in the new loop too: notice that the libnice
+	 * agent still runs its own timers (connectivity checks, keepalives) in the
+	 * context it was created with, as that can't be changed after the fact */
+	if(handle->agent != NULL && handle->stream_id > 0 && component != NULL) {
+		gboolean ingress = (component->ingress_source != NULL);
+		nice_agent_attach_recv(handle->agent, handle->stream_id, 1, to->mainctx,
+			janus_ice_cb_nice_recv, component);
+#ifdef HAVE_RECVMMSG
+		/* If we were reading from the socket ourselves, do that in the new loop */
+		if(ingress)
+			janus_ice_component_update_ingress(handle, component);
+#else
+		(void)ingress;
+#endif
+	}
+	/* Recreate the sources we had attached to the old loop */
+	if(component != NULL && component->icestate_source != NULL) {
+		g_source_destroy(component->icestate_source);
+		g_source_unref(component->icestate_source);
+		component->icestate_source = g_timeout_source_new(500);
+		g_source_set_callback(component->icestate_source, janus_ice_check_failed, component, NULL);
+		g_source_attach(component->icestate_source, handle->mainctx);
+	}
+	if(component != NULL && component->dtlsrt_source != NULL) {
+		g_source_destroy(component->dtlsrt_source);
+		g_source_unref(component->dtlsrt_source);
+		component->dtlsrt_source = g_timeout_source_new(50);
+		g_source_set_callback(component->dtlsrt_source, janus_dtls_retry, component->dtls, NULL);
+		g_source_attach(component->dtlsrt_source, handle->mainctx);
+	}
+	if(handle->rtcp_source != NULL) {
+		janus_ice_handle_destroy_sources(handle);
+		janus_ice_handle_create_sources(handle);
+	}
+	/* Finally, a new outgoing traffic source: the one we're in will be removed when we return */
+	GSource *source = handle->rtp_source;
+	handle->rtp_source = janus_ice_outgoing_traffic_create(handle, (GDestroyNotify)g_free);
+	g_source_set_priority(handle->rtp_source, G_PRIORITY_DEFAULT);
+	janus_mutex_unlock(&handle->mutex);
+	g_source_attach(handle->rtp_source, to->mainctx);
+	if(source != NULL)
+		g_source_unref(source);
+	/* Producers may have woken up the old loop in the meanwhile: make sure the next one wakes the new loop */
+	g_atomic_int_set(&handle->wakeup_pending, 0);
+	g_main_context_wakeup(to->mainctx);
+	return TRUE;
+}
+int janus_ice_handle_migrate(janus_ice_handle *handle, int loop_id) {
+	if(handle == NULL || handle->loop == NULL || handle->queued_packets == NULL)
+		return -1;
+	janus_mutex_lock(&event_loops_mutex);
+	janus_ice_static_event_loop *loop = janus_ice_static_event_loop_find(loop_id);
+	janus_mutex_unlock(&event_loops_mutex);
+	if(loop == NULL)
+		return -2;
+	if(loop == handle->loop)
+		return 0;
+	if(!g_atomic_pointer_compare_and_exchange(&handle->migrate_to, NULL, loop))
+		return -3;
+	/* The loop the handle is in will take care of the migration */
+	janus_ice_handle_enqueue(handle, &janus_ice_migrate_handle, FALSE);
+	return 0;
+}
+
+/* What to do with an RTP packet after trying to protect it: send it, update the
+ * stats and store it for retransmissions (the caller still owns the packet) */
+static void janus_ice_outgoing_rtp_protected(janus_ice_handle *handle, janus_ice_queued_packet *pkt,
+		janus_rtp_packet *p, int res, int protected) {
+	janus_ice_stream *stream = handle->stream;
+	janus_ice_component *component = stream->component;
+	int video = (pkt->type == JANUS_ICE_PACKET_VIDEO);
+	if(res != srtp_err_status_ok) {
+		/* We don't spam the logs for every SRTP error: just take note of this, and print a summary later */
+		handle->srtp_errors_count++;
+		handle->last_srtp_error = res;
+		/* If we're debugging, though, print every occurrence */
+		janus_rtp_header *header = (janus_rtp_header *)pkt->data;
+		guint32 timestamp = ntohl(header->timestamp);
+		guint16 seq = ntohs(header->seq_number);
+		JANUS_LOG(LOG_DBG, "[%"SCNu64"] ... SRTP protect error... %s (len=%d-->%d, ts=%"SCNu32", seq=%"SCNu16")...\n",
+			handle->handle_id, janus_srtp_error_str(res), pkt->length, protected, timestamp, seq);
+		janus_ice_free_rtp_packet(component, p);
+	} else {
+		/* Shoot! */
+		int sent = janus_ice_component_send(handle, component, protected, pkt->data);
+		if(sent < protected) {
+			JANUS_LOG(LOG_ERR, "[%"SCNu64"] ... only sent %d bytes? (was %d)\n", handle->handle_id, sent, protected);
+		}
+		/* Update stats */
+		if(sent > 0) {
+			/* Update the RTCP context as well */
+			janus_rtp_header *header = (janus_rtp_header *)pkt->data;
+			guint32 timestamp = ntohl(header->timestamp);
+			if(pkt->type == JANUS_ICE_PACKET_AUDIO) {
+				component->out_stats.audio.packets++;
+				component->out_stats.audio.bytes += pkt->length;
+				/* Last second outgoing audio */
+				gint64 now = janus_get_monotonic_time();
+				if(component->out_stats.audio.updated == 0)
+					component->out_stats.audio.updated = now;
+				if(now > component->out_stats.audio.updated &&
+						now - component->out_stats.audio.updated >= G_USEC_PER_SEC) {
+					component->out_stats.audio.bytes_lastsec = component->out_stats.audio.bytes_lastsec_temp;
+					component->out_stats.audio.bytes_lastsec_temp = 0;
+					component->out_stats.audio.updated = now;
+				}
+				component->out_stats.audio.bytes_lastsec_temp += pkt->length;
+				stream->audio_last_ts = timestamp;
+				if(stream->audio_first_ntp_ts == 0) {
+					struct timeval tv;
+					gettimeofday(&tv, NULL);
+					stream->audio_first_ntp_ts = (gint64)tv.tv_sec*G_USEC_PER_SEC + tv.tv_usec;
+					stream->audio_first_rtp_ts = timestamp;
+				}
+				/* Let's check if this is not Opus: in case we may need to change the timestamp base */
+				rtcp_context *rtcp_ctx = stream->audio_rtcp_ctx;
+				int pt = header->type;
+				uint32_t clock_rate = stream->clock_rates ?
+					GPOINTER_TO_UINT(g_hash_table_lookup(stream->clock_rates, GINT_TO_POINTER(pt))) : 48000;
+				if(rtcp_ctx->tb != clock_rate)
+					rtcp_ctx->tb = clock_rate;
+			} else if(pkt->type == JANUS_ICE_PACKET_VIDEO) {
+				component->out_stats.video[0].packets++;
+				component->out_stats.video[0].bytes += pkt->length;
+				/* Last second outgoing video */
+				gint64 now = janus_get_monotonic_time();
+				if(component->out_stats.video[0].updated == 0)
+					component->out_stats.video[0].updated = now;
+				if(now > component->out_stats.video[0].updated &&
+						now - component->out_stats.video[0].updated >= G_USEC_PER_SEC) {
+					component->out_stats.video[0].bytes_lastsec = component->out_stats.video[0].bytes_lastsec_temp;
+					component->out_stats.video[0].bytes_lastsec_temp = 0;
+					component->out_stats.video[0].updated = now;
+				}
+				component->out_stats.video[0].bytes_lastsec_temp += pkt->length;
+				stream->video_last_ts = timestamp;
+				if(stream->video_first_ntp_ts[0] == 0) {
+					struct timeval tv;
+					gettimeofday(&tv, NULL);
+					stream->video_first_ntp_ts[0] = (gint64)tv.tv_sec*G_USEC_PER_SEC + tv.tv_usec;
+					stream->video_first_rtp_ts[0] = timestamp;
+				}
+			}
+			/* Update sent packets counter */
+			rtcp_context *rtcp_ctx = video ? stream->video_rtcp_ctx[0] : stream->audio_rtcp_ctx;
+			if(rtcp_ctx)
+				g_atomic_int_inc(&rtcp_ctx->sent_packets_since_last_rr);
+		}
+		if(stream->nack_queue_ms > 0 && !pkt->retransmission) {
+			/* Save the packet for retransmissions that may be needed later */
+			if((pkt->type == JANUS_ICE_PACKET_AUDIO && !component->do_audio_nacks) ||
+					(pkt->type == JANUS_ICE_PACKET_VIDEO && !component->do_video_nacks)) {
+				/* ... unless NACKs are disabled for this medium */
+				return;
+			}
+			if(p == NULL) {
+				/* If we're not doing RFC4588, we're saving the SRTP packet as it is */
+				p = janus_ice_new_rtp_packet(component, protected);
+				memcpy(p->data, pkt->data, protected);
+			}
+			p->created = janus_get_monotonic_time();
+			p->last_retransmit = 0;
+			janus_rtp_header *header = (janus_rtp_header *)pkt->data;
+			guint16 seq = ntohs(header->seq_number);
+			janus_ice_nack_ring_store(component, video ? &component->video_nack_ring : &component->audio_nack_ring,
+				video, stream->nack_queue_ms, seq, p, p->created);
+		} else {
+			janus_ice_free_rtp_packet(component, p);
+		}
+	}
+}
+
 static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janus_ice_queued_packet *pkt) {
 	janus_session *session = (janus_session *)handle->session;
 	janus_ice_stream *stream = handle->stream;
@@ -3920,6 +5724,11 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 		guint id = g_source_attach(component->dtlsrt_source, handle->mainctx);
 		JANUS_LOG(LOG_VERB, "[%"SCNu64"] Creating retransmission timer with ID %u\n", handle->handle_id, id);
 		return G_SOURCE_CONTINUE;
+	} else if(pkt == &janus_ice_dtls_resume) {
+		/* A handshake worker is done with our DTLS stack, take it from here */
+		if(component != NULL)
+			janus_dtls_srtp_resume(component->dtls);
+		return G_SOURCE_CONTINUE;
 	} else if(pkt == &janus_ice_hangup_peerconnection) {
 		/* The media session is over, send an alert on all streams and components */
 		if(handle->stream && handle->stream->component && janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_READY)) {
@@ -3933,21 +5742,7 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 			plugin->hangup_media(handle->app_handle);
 		}
 		/* Get rid of the attached sources */
-		if(handle->rtcp_source) {
-			g_source_destroy(handle->rtcp_source);
-			g_source_unref(handle->rtcp_source);
-			handle->rtcp_source = NULL;
-		}
-		if(handle->twcc_source) {
-			g_source_destroy(handle->twcc_source);
-			g_source_unref(handle->twcc_source);
-			handle->twcc_source = NULL;
-		}
-		if(handle->stats_source) {
-			g_source_destroy(handle->stats_source);
-			g_source_unref(handle->stats_source);
-			handle->stats_source = NULL;
-		}
+		janus_ice_handle_destroy_sources(handle);
 		/* If event handlers are active, send stats one last time */
 		if(janus_events_is_enabled()) {
 			handle->last_event_stats = janus_ice_event_stats_period;
@@ -3987,6 +5782,13 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 				session->session_id, handle->handle_id, "detached",
 				plugin ? plugin->get_package() : NULL, handle->opaque_id);
 		return G_SOURCE_REMOVE;
+	} else if(pkt != NULL && pkt->type == JANUS_ICE_PACKET_MUX) {
+		/* Not something to send, but a packet another loop received for us on the shared port */
+		janus_ice_mux_from *from = (janus_ice_mux_from *)pkt->data;
+		janus_ice_mux_incoming(handle, from->msock, pkt->data + sizeof(janus_ice_mux_from),
+			pkt->length, &from->addr, from->addrlen);
+		janus_ice_free_queued_packet(pkt);
+		return G_SOURCE_CONTINUE;
 	}
 	if(!janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_READY)) {
 		janus_ice_free_queued_packet(pkt);
@@ -3995,7 +5797,9 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 	/* Now let's get on with the packet */
 	if(pkt == NULL)
 		return G_SOURCE_CONTINUE;
-	if(pkt->data == NULL || stream == NULL) {
+	if(handle->loop != NULL)
+		handle->loop->packets++;
+	if((pkt->data == NULL && pkt->payload == NULL) || stream == NULL) {
 		janus_ice_free_queued_packet(pkt);
 		return G_SOURCE_CONTINUE;
 	}
@@ -4029,7 +5833,7 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 		component->noerrorlog = FALSE;
 		if(pkt->encrypted) {
 			/* Already SRTCP */
-			int sent = nice_agent_send(handle->agent, stream->stream_id, component->component_id, pkt->length, (const gchar *)pkt->data);
+			int sent = janus_ice_component_send(handle, component, pkt->length, (const gchar *)pkt->data);
 			if(sent < pkt->length) {
 				JANUS_LOG(LOG_ERR, "[%"SCNu64"] ... only sent %d bytes? (was %d)\n", handle->handle_id, sent, pkt->length);
 			}
@@ -4057,11 +5861,12 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 						remb->ssrc[2] = htonl(stream->video_ssrc_peer[2]);
 					}
 				}
-				/* Free old packet and update */
+				/* Free old packet (unless it's in the pool block) and update */
 				char *prev_data = pkt->data;
 				pkt->data = rtcpbuf;
 				pkt->length = rrlen+pkt->length;
-				g_clear_pointer(&prev_data, g_free);
+				if(pkt->pool == NULL || prev_data != janus_ice_queued_packet_slot(pkt))
+					g_clear_pointer(&prev_data, g_free);
 			}
 			/* Do we need to dump this packet for debugging? */
 			if(g_atomic_int_get(&handle->dump_packets))
@@ -4079,7 +5884,7 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 				JANUS_LOG(LOG_DBG, "[%"SCNu64"] ... SRTCP protect error... %s (len=%d-->%d)...\n", handle->handle_id, janus_srtp_error_str(res), pkt->length, protected);
 			} else {
 				/* Shoot! */
-				int sent = nice_agent_send(handle->agent, stream->stream_id, component->component_id, protected, pkt->data);
+				int sent = janus_ice_component_send(handle, component, protected, pkt->data);
 				if(sent < protected) {
 					JANUS_LOG(LOG_ERR, "[%"SCNu64"] ... only sent %d bytes? (was %d)\n", handle->handle_id, sent, protected);
 				}
@@ -4109,11 +5914,27 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 				/* Already RTP (probably a retransmission?) */
 				janus_rtp_header *header = (janus_rtp_header *)pkt->data;
 				JANUS_LOG(LOG_HUGE, "[%"SCNu64"] ... Retransmitting seq.nr %"SCNu16"\n\n", handle->handle_id, ntohs(header->seq_number));
-				int sent = nice_agent_send(handle->agent, stream->stream_id, component->component_id, pkt->length, (const gchar *)pkt->data);
+				int sent = janus_ice_component_send(handle, component, pkt->length, (const gchar *)pkt->data);
 				if(sent < pkt->length) {
 					JANUS_LOG(LOG_ERR, "[%"SCNu64"] ... only sent %d bytes? (was %d)\n", handle->handle_id, sent, pkt->length);
 				}
 			} else {
+				if(pkt->payload != NULL && pkt->data == NULL && srtp_workers != NULL && janus_is_webrtc_encryption_enabled()) {
+					/* The payload is shared, but a crypto worker will protect the packet
+					 * later, so we can't use the scratch buffer of the loop for this */
+					if(pkt->pool != NULL && pkt->length + SRTP_MAX_TAG_LEN <= JANUS_ICE_POOL_SLOT_SIZE)
+						pkt->data = janus_ice_queued_packet_slot(pkt);
+					else
+						pkt->data = g_malloc(pkt->length + SRTP_MAX_TAG_LEN);
+					memcpy(pkt->data, pkt->overlay, pkt->overlay_length);
+					memcpy(pkt->data + pkt->overlay_length, pkt->payload->buffer, pkt->payload->length);
+				} else if(pkt->payload != NULL && pkt->data == NULL) {
+					/* The payload is shared, so this is where we put the packet together */
+					pkt->data = janus_ice_get_scratch(handle, component, pkt->length);
+					pkt->scratch = TRUE;
+					memcpy(pkt->data, pkt->overlay, pkt->overlay_length);
+					memcpy(pkt->data + pkt->overlay_length, pkt->payload->buffer, pkt->payload->length);
+				}
 				/* Overwrite SSRC */
 				janus_rtp_header *header = (janus_rtp_header *)pkt->data;
 				if(!pkt->retransmission) {
@@ -4123,9 +5944,23 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 				/* Set the transport-wide sequence number, if needed */
 				if(video && stream->transport_wide_cc_ext_id > 0) {
 					stream->transport_wide_cc_out_seq_num++;
-					if(janus_rtp_header_extension_set_transport_wide_cc(pkt->data, pkt->length,
-							stream->transport_wide_cc_ext_id, stream->transport_wide_cc_out_seq_num) < 0) {
+					int res = 0;
+					if(pkt->twcc_offset > 0 && pkt->twcc_offset + 2 <= pkt->length) {
+						/* We added the extensions ourselves, so we know where the sequence number goes */
+						guint16 twcc_seq = htons(stream->transport_wide_cc_out_seq_num);
+						memcpy(pkt->data + pkt->twcc_offset, &twcc_seq, sizeof(twcc_seq));
+					} else {
+						res = janus_rtp_header_extension_set_transport_wide_cc(pkt->data, pkt->length,
+							stream->transport_wide_cc_ext_id, stream->transport_wide_cc_out_seq_num);
+					}
+					if(res < 0) {
 						JANUS_LOG(LOG_ERR, "[%"SCNu64"] Error setting transport wide CC sequence number...\n", handle->handle_id);
+					} else {
+						/* Keep track of when we sent this, for bandwidth estimation purposes */
+						if(stream->bwe == NULL)
+							stream->bwe = janus_bwe_context_create();
+						janus_bwe_context_add_sent_packet(stream->bwe, stream->transport_wide_cc_out_seq_num,
+							pkt->length, janus_get_monotonic_time());
 					}
 				}
 				/* Keep track of payload types too */
@@ -4177,17 +6012,15 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 						janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_RFC4588_RTX)) {
 					/* Save the packet for retransmissions that may be needed later: start by
 					 * making room for two more bytes to store the original sequence number */
-					p = g_malloc(sizeof(janus_rtp_packet));
+					p = janus_ice_new_rtp_packet(component, pkt->length+2);
 					janus_rtp_header *header = (janus_rtp_header *)pkt->data;
 					guint16 original_seq = header->seq_number;
-					p->data = g_malloc(pkt->length+2);
-					p->length = pkt->length+2;
 					/* Check where the payload starts */
 					int plen = 0;
 					char *payload = janus_rtp_payload(pkt->data, pkt->length, &plen);
 					if(plen == 0) {
 						JANUS_LOG(LOG_WARN, "[%"SCNu64"] Discarding outgoing empty RTP packet\n", handle->handle_id);
-						janus_ice_free_rtp_packet(p);
+						janus_ice_free_rtp_packet(component, p);
 						janus_ice_free_queued_packet(pkt);
 						return G_SOURCE_CONTINUE;
 					}
@@ -4199,127 +6032,13 @@ static gboolean janus_ice_outgoing_traffic_handle(janus_ice_handle *handle, janu
 					/* Copy the payload */
 					memcpy(p->data+hsize+2, payload, pkt->length - hsize);
 				}
-				/* Encrypt SRTP */
+				/* Encrypt SRTP, or leave it to a crypto worker, if enabled */
+				if(janus_ice_crypto_defer(handle, pkt, p))
+					return G_SOURCE_CONTINUE;
 				int protected = pkt->length;
 				int res = janus_is_webrtc_encryption_enabled() ?
 					srtp_protect(component->dtls->srtp_out, pkt->data, &protected) : srtp_err_status_ok;
-				if(res != srtp_err_status_ok) {
-					/* We don't spam the logs for every SRTP error: just take note of this, and print a summary later */
-					handle->srtp_errors_count++;
-					handle->last_srtp_error = res;
-					/* If we're debugging, though, print every occurrence */
-					janus_rtp_header *header = (janus_rtp_header *)pkt->data;
-					guint32 timestamp = ntohl(header->timestamp);
-					guint16 seq = ntohs(header->seq_number);
-					JANUS_LOG(LOG_DBG, "[%"SCNu64"] ... SRTP protect error... %s (len=%d-->%d, ts=%"SCNu32", seq=%"SCNu16")...\n",
-						handle->handle_id, janus_srtp_error_str(res), pkt->length, protected, timestamp, seq);
-					janus_ice_free_rtp_packet(p);
-				} else {
-					/* Shoot! */
-					int sent = nice_agent_send(handle->agent, stream->stream_id, component->component_id, protected, pkt->data);
-					if(sent < protected) {
-						JANUS_LOG(LOG_ERR, "[%"SCNu64"] ... only sent %d bytes? (was %d)\n", handle->handle_id, sent, protected);
-					}
-					/* Update stats */
-					if(sent > 0) {
-						/* Update the RTCP context as well */
-						janus_rtp_header *header = (janus_rtp_header *)pkt->data;
-						guint32 timestamp = ntohl(header->timestamp);
-						if(pkt->type == JANUS_ICE_PACKET_AUDIO) {
-							component->out_stats.audio.packets++;
-							component->out_stats.audio.bytes += pkt->length;
-							/* Last second outgoing audio */
-							gint64 now = janus_get_monotonic_time();
-							if(component->out_stats.audio.updated == 0)
-								component->out_stats.audio.updated = now;
-							if(now > component->out_stats.audio.updated &&
-									now - component->out_stats.audio.updated >= G_USEC_PER_SEC) {
-								component->out_stats.audio.bytes_lastsec = component->out_stats.audio.bytes_lastsec_temp;
-								component->out_stats.audio.bytes_lastsec_temp = 0;
-								component->out_stats.audio.updated = now;
-							}
-							component->out_stats.audio.bytes_lastsec_temp += pkt->length;
-							stream->audio_last_ts = timestamp;
-							if(stream->audio_first_ntp_ts == 0) {
-								struct timeval tv;
-								gettimeofday(&tv, NULL);
-								stream->audio_first_ntp_ts = (gint64)tv.tv_sec*G_USEC_PER_SEC + tv.tv_usec;
-								stream->audio_first_rtp_ts = timestamp;
-							}
-							/* Let's check if this is not Opus: in case we may need to change the timestamp base */
-							rtcp_context *rtcp_ctx = stream->audio_rtcp_ctx;
-							int pt = header->type;
-							uint32_t clock_rate = stream->clock_rates ?
-								GPOINTER_TO_UINT(g_hash_table_lookup(stream->clock_rates, GINT_TO_POINTER(pt))) : 48000;
-							if(rtcp_ctx->tb != clock_rate)
-								rtcp_ctx->tb = clock_rate;
-						} else if(pkt->type == JANUS_ICE_PACKET_VIDEO) {
-							component->out_stats.video[0].packets++;
-							component->out_stats.video[0].bytes += pkt->length;
-							/* Last second outgoing video */
-							gint64 now = janus_get_monotonic_time();
-							if(component->out_stats.video[0].updated == 0)
-								component->out_stats.video[0].updated = now;
-							if(now > component->out_stats.video[0].updated &&
-									now - component->out_stats.video[0].updated >= G_USEC_PER_SEC) {
-								component->out_stats.video[0].bytes_lastsec = component->out_stats.video[0].bytes_lastsec_temp;
-								component->out_stats.video[0].bytes_lastsec_temp = 0;
-								component->out_stats.video[0].updated = now;
-							}
-							component->out_stats.video[0].bytes_lastsec_temp += pkt->length;
-							stream->video_last_ts = timestamp;
-							if(stream->video_first_ntp_ts[0] == 0) {
-								struct timeval tv;
-								gettimeofday(&tv, NULL);
-								stream->video_first_ntp_ts[0] = (gint64)tv.tv_sec*G_USEC_PER_SEC + tv.tv_usec;
-								stream->video_first_rtp_ts[0] = timestamp;
-							}
-						}
-						/* Update sent packets counter */
-						rtcp_context *rtcp_ctx = video ? stream->video_rtcp_ctx[0] : stream->audio_rtcp_ctx;
-						if(rtcp_ctx)
-							g_atomic_int_inc(&rtcp_ctx->sent_packets_since_last_rr);
-					}
-					if(stream->nack_queue_ms > 0 && !pkt->retransmission) {
-						/* Save the packet for retransmissions that may be needed later */
-						if((pkt->type == JANUS_ICE_PACKET_AUDIO && !component->do_audio_nacks) ||
-								(pkt->type == JANUS_ICE_PACKET_VIDEO && !component->do_video_nacks)) {
-							/* ... unless NACKs are disabled for this medium */
-							janus_ice_free_queued_packet(pkt);
-							return G_SOURCE_CONTINUE;
-						}
-						if(p == NULL) {
-							/* If we're not doing RFC4588, we're saving the SRTP packet as it is */
-							p = g_malloc(sizeof(janus_rtp_packet));
-							p->data = g_malloc(protected);
-							memcpy(p->data, pkt->data, protected);
-							p->length = protected;
-						}
-						p->created = janus_get_monotonic_time();
-						p->last_retransmit = 0;
-						janus_rtp_header *header = (janus_rtp_header *)pkt->data;
-						guint16 seq = ntohs(header->seq_number);
-						if(!video) {
-							if(component->audio_retransmit_buffer == NULL) {
-								component->audio_retransmit_buffer = g_queue_new();
-								component->audio_retransmit_seqs = g_hash_table_new(NULL, NULL);
-							}
-							g_queue_push_tail(component->audio_retransmit_buffer, p);
-							/* Insert in the table too, for quick lookup */
-							g_hash_table_insert(component->audio_retransmit_seqs, GUINT_TO_POINTER(seq), p);
-						} else {
-							if(component->video_retransmit_buffer == NULL) {
-								component->video_retransmit_buffer = g_queue_new();
-								component->video_retransmit_seqs = g_hash_table_new(NULL, NULL);
-							}
-							g_queue_push_tail(component->video_retransmit_buffer, p);
-							/* Insert in the table too, for quick lookup */
-							g_hash_table_insert(component->video_retransmit_seqs, GUINT_TO_POINTER(seq), p);
-						}
-					} else {
-						janus_ice_free_rtp_packet(p);
-					}
-				}
+				janus_ice_outgoing_rtp_protected(handle, pkt, p, res, protected);
 			}
 		} else if(pkt->type == JANUS_ICE_PACKET_TEXT || pkt->type == JANUS_ICE_PACKET_BINARY) {
 			/* Data */
@@ -4371,13 +6090,853 @@ static void janus_ice_queue_packet(janus_ice_handle *handle, janus_ice_queued_pa
 	/* TODO: There is a potential race condition where the "queued_packets"
 	 * could get released between the condition and pushing the packet. */
 	if(handle->queued_packets != NULL) {
-		g_async_queue_push(handle->queued_packets, pkt);
-		g_main_context_wakeup(handle->mainctx);
+		g_atomic_pointer_add(&handle->queued_count, 1);
+		janus_ice_handle_enqueue(handle, pkt, FALSE);
 	} else {
 		janus_ice_free_queued_packet(pkt);
 	}
 }
 
+/* Connectivity checks we answer ourselves, rather than libnice (e.g., on the shared port) */
+typedef struct janus_ice_stun_credentials {
+	const char *ufrag, *pwd;
+} janus_ice_stun_credentials;
+static bool janus_ice_stun_credentials_validate(StunAgent *agent, StunMessage *message,
+		uint8_t *username, uint16_t username_len, uint8_t **password, size_t *password_len, void *user_data) {
+	janus_ice_stun_credentials *credentials = (janus_ice_stun_credentials *)user_data;
+	if(credentials->ufrag == NULL || credentials->pwd == NULL)
+		return false;
+	/* The USERNAME of connectivity checks is "<our ufrag>:<their ufrag>" */
+	size_t ufrag_len = strlen(credentials->ufrag);
+	if(username_len <= ufrag_len || username[ufrag_len] != ':' || memcmp(username, credentials->ufrag, ufrag_len))
+		return false;
+	*password = (uint8_t *)credentials->pwd;
+	*password_len = strlen(credentials->pwd);
+	return true;
+}
+static gboolean janus_ice_is_stun(char *buf, int len) {
+	/* RFC 7983: the first byte of STUN messages is 0-3 */
+	return len >= 20 && (guint8)buf[0] < 4 &&
+		stun_message_validate_buffer_length((uint8_t *)buf, len, TRUE) == len;
+}
+/* Validate a connectivity check, and send a response on the socket it came from: returns
+ * 1 if the peer nominated the pair, 0 if it didn't, and -1 if this wasn't a valid check */
+static int janus_ice_stun_answer(janus_ice_handle *handle, int fd, janus_ice_stun_credentials *credentials,
+		char *buf, int len, struct sockaddr_storage *addr, socklen_t addrlen) {
+	StunAgent agent;
+	stun_agent_init(&agent, STUN_ALL_KNOWN_ATTRIBUTES, STUN_COMPATIBILITY_RFC5389,
+		STUN_AGENT_USAGE_SHORT_TERM_CREDENTIALS | STUN_AGENT_USAGE_USE_FINGERPRINT);
+	StunMessage request, response;
+	uint8_t rbuf[1280];
+	size_t rlen = sizeof(rbuf);
+	bool control = false;
+	StunValidationStatus valid = stun_agent_validate(&agent, &request, (uint8_t *)buf, len,
+		janus_ice_stun_credentials_validate, credentials);
+	if(valid != STUN_VALIDATION_SUCCESS || stun_message_get_class(&request) != STUN_REQUEST ||
+			stun_message_get_method(&request) != STUN_BINDING) {
+		JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Ignoring STUN message (validation: %d)\n", handle->handle_id, valid);
+		return -1;
+	}
+	/* As we're never controlling, role conflicts are for the peer to solve */
+	StunUsageIceReturn ret = stun_usage_ice_conncheck_create_reply(&agent, &request, &response, rbuf, &rlen,
+		addr, addrlen, &control, janus_random_uint64(), STUN_USAGE_ICE_COMPATIBILITY_RFC5245);
+	if((ret != STUN_USAGE_ICE_RETURN_SUCCESS && ret != STUN_USAGE_ICE_RETURN_ROLE_CONFLICT) || rlen == 0) {
+		JANUS_LOG(LOG_WARN, "[%"SCNu64"] Error preparing the response to a connectivity check (%d)\n", handle->handle_id, ret);
+		return -1;
+	}
+	if(sendto(fd, rbuf, rlen, 0, (struct sockaddr *)addr, addrlen) < 0) {
+		JANUS_LOG(LOG_WARN, "[%"SCNu64"] Error sending the response to a connectivity check: %d (%s)\n",
+			handle->handle_id, errno, strerror(errno));
+	}
+	return stun_usage_ice_conncheck_use_candidate(&request) ? 1 : 0;
+}
+
+#ifdef HAVE_RECVMMSG
+/* Per-thread (and so per-loop) scratch area for batched ingress */
+#define JANUS_ICE_INGRESS_BATCH_MAX		32
+#define JANUS_ICE_INGRESS_SLOT_SIZE		2048
+typedef struct janus_ice_ingress_scratch {
+	char slots[JANUS_ICE_INGRESS_BATCH_MAX][JANUS_ICE_INGRESS_SLOT_SIZE];
+	struct iovec iov[JANUS_ICE_INGRESS_BATCH_MAX];
+	struct mmsghdr msgs[JANUS_ICE_INGRESS_BATCH_MAX];
+	struct sockaddr_storage addrs[JANUS_ICE_INGRESS_BATCH_MAX];
+} janus_ice_ingress_scratch;
+static GPrivate janus_ice_ingress = G_PRIVATE_INIT(g_free);
+/* Read as many datagrams as we can with a single syscall: returns how many, or -1 */
+static int janus_ice_ingress_read(int fd, janus_ice_ingress_scratch **result) {
+	janus_ice_ingress_scratch *scratch = g_private_get(&janus_ice_ingress);
+	if(scratch == NULL) {
+		scratch = g_malloc(sizeof(janus_ice_ingress_scratch));
+		g_private_set(&janus_ice_ingress, scratch);
+	}
+	int i = 0;
+	for(i=0; i<JANUS_ICE_INGRESS_BATCH_MAX; i++) {
+		scratch->iov[i].iov_base = scratch->slots[i];
+		scratch->iov[i].iov_len = JANUS_ICE_INGRESS_SLOT_SIZE;
+		memset(&scratch->msgs[i], 0, sizeof(scratch->msgs[i]));
+		scratch->msgs[i].msg_hdr.msg_name = &scratch->addrs[i];
+		scratch->msgs[i].msg_hdr.msg_namelen = sizeof(scratch->addrs[i]);
+		scratch->msgs[i].msg_hdr.msg_iov = &scratch->iov[i];
+		scratch->msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+	*result = scratch;
+	return recvmmsg(fd, scratch->msgs, JANUS_ICE_INGRESS_BATCH_MAX, MSG_DONTWAIT, NULL);
+}
+static gboolean janus_ice_ingress_readable(GSocket *socket, GIOCondition condition, gpointer user_data) {
+	janus_ice_component *component = (janus_ice_component *)user_data;
+	janus_ice_stream *stream = component->stream;
+	janus_ice_handle *handle = stream ? stream->handle : NULL;
+	if(handle == NULL)
+		return G_SOURCE_CONTINUE;
+	int fd = g_socket_get_fd(socket);
+	janus_ice_ingress_scratch *scratch = NULL;
+	int count = janus_ice_ingress_read(fd, &scratch), i = 0;
+	if(count <= 0) {
+		if(count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			JANUS_LOG(LOG_WARN, "[%"SCNu64"] Error receiving media: %d (%s)\n", handle->handle_id, errno, strerror(errno));
+		return G_SOURCE_CONTINUE;
+	}
+	component->ingress_batches++;
+	component->ingress_packets += count;
+	if((guint)count > component->ingress_max_batch)
+		component->ingress_max_batch = count;
+	/* Where media is allowed to come from (it may change if the peer nominates another pair) */
+	struct sockaddr_storage selected;
+	memcpy(&selected, &component->ingress_addr, sizeof(selected));
+	gboolean released = FALSE;
+	for(i=0; i<count; i++) {
+		char *buf = scratch->slots[i];
+		int len = scratch->msgs[i].msg_len;
+		struct sockaddr_storage *addr = &scratch->addrs[i];
+		socklen_t addrlen = scratch->msgs[i].msg_hdr.msg_namelen;
+		if(len == 0 || (scratch->msgs[i].msg_hdr.msg_flags & MSG_TRUNC)) {
+			JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Dropping empty or truncated datagram\n", handle->handle_id);
+			continue;
+		}
+		if(janus_ice_is_stun(buf, len)) {
+			/* Once we gave the socket back, libnice will get the next checks */
+			if(released)
+				continue;
+			/* libnice isn't reading this socket anymore, answer connectivity checks ourselves */
+			gchar *ufrag = NULL, *pwd = NULL;
+			nice_agent_get_local_credentials(handle->agent, component->stream_id, &ufrag, &pwd);
+			janus_ice_stun_credentials credentials = { ufrag, pwd };
+			int res = janus_ice_stun_answer(handle, fd, &credentials, buf, len, addr, addrlen);
+			g_free(ufrag);
+			g_free(pwd);
+			if(res > 0 && !janus_ice_mux_address_equal(&selected, addr)) {
+				/* The peer nominated a different pair, which libnice doesn't know about as
+				 * it isn't seeing the checks: give it the socket back, so that it can select
+				 * the new pair, and have media follow right away if we send it ourselves */
+				JANUS_LOG(LOG_VERB, "[%"SCNu64"] Peer nominated a different pair, handing the socket back to libnice\n",
+					handle->handle_id);
+				memcpy(&selected, addr, addrlen);
+				if(component->egress_socket != NULL && g_socket_get_fd(component->egress_socket) == fd) {
+					memcpy(&component->egress_addr, addr, addrlen);
+					component->egress_addrlen = addrlen;
+				}
+				janus_ice_component_release_ingress(handle, component, TRUE);
+				released = TRUE;
+			}
+			continue;
+		}
+		/* We only accept DTLS, SRTP and SRTCP from the selected pair */
+		if(!janus_ice_mux_address_equal(&selected, addr)) {
+			JANUS_LOG(LOG_HUGE, "[%"SCNu64"] Dropping datagram of %d bytes from an address that wasn't selected\n",
+				handle->handle_id, len);
+			continue;
+		}
+		janus_ice_cb_nice_recv(handle->agent, component->stream_id, component->component_id, len, buf, component);
+	}
+	return released ? G_SOURCE_REMOVE : G_SOURCE_CONTINUE;
+}
+/* Take the socket of the selected pair over from libnice, if it's plain UDP and not relayed */
+static void janus_ice_component_update_ingress(janus_ice_handle *handle, janus_ice_component *component) {
+	janus_ice_component_release_ingress(handle, component, TRUE);
+	GSocket *socket = nice_agent_get_selected_socket(handle->agent, component->stream_id, component->component_id);
+	if(socket == NULL) {
+		JANUS_LOG(LOG_VERB, "[%"SCNu64"] Selected pair can't be used for batched ingress, will use libnice\n", handle->handle_id);
+		return;
+	}
+	/* We'll only accept media from the remote address of the pair */
+	NiceCandidate *local = NULL, *remote = NULL;
+	if(!nice_agent_get_selected_pair(handle->agent, component->stream_id, component->component_id, &local, &remote) || remote == NULL) {
+		JANUS_LOG(LOG_WARN, "[%"SCNu64"] Couldn't get the selected pair, will use libnice\n", handle->handle_id);
+		g_object_unref(socket);
+		return;
+	}
+	memset(&component->ingress_addr, 0, sizeof(component->ingress_addr));
+	nice_address_copy_to_sockaddr(&remote->addr, (struct sockaddr *)&component->ingress_addr);
+	/* Stop libnice from reading from the socket, we'll do that */
+	nice_agent_attach_recv(handle->agent, component->stream_id, component->component_id, handle->mainctx, NULL, NULL);
+	GSource *source = g_socket_create_source(socket, G_IO_IN, NULL);
+	g_source_set_priority(source, G_PRIORITY_DEFAULT);
+	g_source_set_callback(source, (GSourceFunc)janus_ice_ingress_readable, component, NULL);
+	g_source_attach(source, handle->mainctx);
+	janus_mutex_lock(&component->mutex);
+	component->ingress_socket = socket;
+	component->ingress_source = source;
+	janus_mutex_unlock(&component->mutex);
+	JANUS_LOG(LOG_VERB, "[%"SCNu64"] Using batched ingress on the selected pair\n", handle->handle_id);
+}
+#endif
+/* Stop reading from the socket of the selected pair ourselves, and give it back to libnice if needed */
+static void janus_ice_component_release_ingress(janus_ice_handle *handle, janus_ice_component *component, gboolean reattach) {
+	if(component == NULL)
+		return;
+	janus_mutex_lock(&component->mutex);
+	GSource *source = component->ingress_source;
+	GSocket *socket = component->ingress_socket;
+	component->ingress_source = NULL;
+	component->ingress_socket = NULL;
+	janus_mutex_unlock(&component->mutex);
+	if(source == NULL)
+		return;
+	g_source_destroy(source);
+	g_source_unref(source);
+	if(socket != NULL)
+		g_object_unref(socket);
+	if(reattach && handle != NULL && handle->agent != NULL) {
+		nice_agent_attach_recv(handle->agent, component->stream_id, component->component_id, handle->mainctx,
+			janus_ice_cb_nice_recv, component);
+	}
+}
+
+/* Single-port media multiplexing helpers */
+#define JANUS_ICE_MUX_BUFSIZE		4096
+#define JANUS_ICE_MUX_READ_MAX		64
+#define JANUS_ICE_MUX_RCVBUF		(4*1024*1024)
+static guint janus_ice_mux_address_hash(gconstpointer key) {
+	const struct sockaddr_storage *addr = (const struct sockaddr_storage *)key;
+	if(addr->ss_family == AF_INET) {
+		const struct sockaddr_in *sin = (const struct sockaddr_in *)addr;
+		return sin->sin_addr.s_addr ^ ((guint)sin->sin_port << 16);
+	} else if(addr->ss_family == AF_INET6) {
+		const struct sockaddr_in6 *sin6 = (const struct sockaddr_in6 *)addr;
+		guint32 words[4];
+		memcpy(words, &sin6->sin6_addr, sizeof(words));
+		return words[0] ^ words[1] ^ words[2] ^ words[3] ^ ((guint)sin6->sin6_port << 16);
+	}
+	return 0;
+}
+static gboolean janus_ice_mux_address_equal(gconstpointer a, gconstpointer b) {
+	const struct sockaddr_storage *addr1 = (const struct sockaddr_storage *)a;
+	const struct sockaddr_storage *addr2 = (const struct sockaddr_storage *)b;
+	if(addr1->ss_family != addr2->ss_family)
+		return FALSE;
+	if(addr1->ss_family == AF_INET) {
+		const struct sockaddr_in *sin1 = (const struct sockaddr_in *)addr1;
+		const struct sockaddr_in *sin2 = (const struct sockaddr_in *)addr2;
+		return sin1->sin_port == sin2->sin_port && sin1->sin_addr.s_addr == sin2->sin_addr.s_addr;
+	} else if(addr1->ss_family == AF_INET6) {
+		const struct sockaddr_in6 *sin61 = (const struct sockaddr_in6 *)addr1;
+		const struct sockaddr_in6 *sin62 = (const struct sockaddr_in6 *)addr2;
+		return sin61->sin6_port == sin62->sin6_port &&
+			!memcmp(&sin61->sin6_addr, &sin62->sin6_addr, sizeof(sin61->sin6_addr));
+	}
+	return FALSE;
+}
+static void janus_ice_mux_address_to_string(struct sockaddr_storage *addr, char *buffer, size_t buflen, int *port) {
+	buffer[0] = '\0';
+	*port = 0;
+	if(addr->ss_family == AF_INET) {
+		struct sockaddr_in *sin = (struct sockaddr_in *)addr;
+		inet_ntop(AF_INET, &sin->sin_addr, buffer, buflen);
+		*port = ntohs(sin->sin_port);
+	} else if(addr->ss_family == AF_INET6) {
+		struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)addr;
+		inet_ntop(AF_INET6, &sin6->sin6_addr, buffer, buflen);
+		*port = ntohs(sin6->sin6_port);
+	}
+}
+static void janus_ice_mux_component_unref(gpointer data) {
+	janus_ice_component *component = (janus_ice_component *)data;
+	janus_refcount_decrease(&component->ref);
+}
+/* Remove a component from the address index, unless someone else took the address over (mux_mutex held) */
+static void janus_ice_mux_forget_address(janus_ice_component *component) {
+	if(component->mux_addr == NULL)
+		return;
+	if(g_hash_table_lookup(mux_addresses, component->mux_addr) == component)
+		g_hash_table_remove(mux_addresses, component->mux_addr);
+}
+static void janus_ice_mux_random_string(char *buffer, int len) {
+	static const char chars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789+/";
+	int i = 0;
+	for(i=0; i<len; i++)
+		buffer[i] = chars[janus_random_uint32() % (sizeof(chars)-1)];
+	buffer[len] = '\0';
+}
+static void janus_ice_mux_register(janus_ice_component *component) {
+	if(component == NULL || mux_ufrags == NULL)
+		return;
+	janus_mutex_lock(&mux_mutex);
+	if(component->mux_ufrag != NULL) {
+		/* ICE restart: get rid of the old credentials first */
+		if(g_hash_table_lookup(mux_ufrags, component->mux_ufrag) == component)
+			g_hash_table_remove(mux_ufrags, component->mux_ufrag);
+		g_free(component->mux_ufrag);
+		g_free(component->mux_pwd);
+	}
+	/* All PeerConnections share the port, so the ufrag must be unique */
+	char ufrag[9], pwd[25];
+	do {
+		janus_ice_mux_random_string(ufrag, sizeof(ufrag)-1);
+	} while(g_hash_table_contains(mux_ufrags, ufrag));
+	janus_ice_mux_random_string(pwd, sizeof(pwd)-1);
+	component->mux_ufrag = g_strdup(ufrag);
+	component->mux_pwd = g_strdup(pwd);
+	janus_refcount_increase(&component->ref);
+	g_hash_table_insert(mux_ufrags, component->mux_ufrag, component);
+	janus_mutex_unlock(&mux_mutex);
+}
+static void janus_ice_mux_unregister(janus_ice_component *component) {
+	if(component == NULL || component->mux_ufrag == NULL)
+		return;
+	janus_mutex_lock(&mux_mutex);
+	if(g_hash_table_lookup(mux_ufrags, component->mux_ufrag) == component)
+		g_hash_table_remove(mux_ufrags, component->mux_ufrag);
+	janus_ice_mux_forget_address(component);
+	g_free(component->mux_ufrag);
+	component->mux_ufrag = NULL;
+	g_free(component->mux_pwd);
+	component->mux_pwd = NULL;
+	g_free(component->mux_addr);
+	component->mux_addr = NULL;
+	janus_mutex_unlock(&mux_mutex);
+}
+void janus_ice_get_local_credentials(janus_ice_handle *handle, gchar **ufrag, gchar **pwd) {
+	*ufrag = NULL;
+	*pwd = NULL;
+	if(handle == NULL || handle->stream == NULL)
+		return;
+	janus_ice_component *component = handle->stream->component;
+	if(component != NULL && component->mux_ufrag != NULL) {
+		janus_mutex_lock(&mux_mutex);
+		*ufrag = g_strdup(component->mux_ufrag);
+		*pwd = g_strdup(component->mux_pwd);
+		janus_mutex_unlock(&mux_mutex);
+		return;
+	}
+	nice_agent_get_local_credentials(handle->agent, handle->stream->stream_id, ufrag, pwd);
+}
+static void janus_ice_mux_candidates_to_sdp(janus_ice_handle *handle, janus_ice_component *component, janus_sdp_mline *mline) {
+	/* We advertise the public address, and the local one too if it's different */
+	const char *ips[2] = { janus_get_public_ip(), janus_get_local_ip() };
+	gboolean log_candidates = (component->local_candidates == NULL);
+	char buffer[200];
+	int i = 0;
+	for(i=0; i<2; i++) {
+		if(ips[i] == NULL || (i == 1 && ips[0] != NULL && !strcmp(ips[0], ips[1])))
+			continue;
+		if(strchr(ips[i], ':') != NULL && !janus_ipv6_enabled)
+			continue;
+		g_snprintf(buffer, sizeof(buffer), "%d 1 udp %u %s %"SCNu16" typ host", i+1, 2130706431-i, ips[i], mux_port);
+		JANUS_LOG(LOG_VERB, "[%"SCNu64"]     %s\n", handle->handle_id, buffer);
+		janus_sdp_attribute *a = janus_sdp_attribute_create("candidate", "%s", buffer);
+		mline->attributes = g_list_append(mline->attributes, a);
+		if(log_candidates)
+			component->local_candidates = g_slist_append(component->local_candidates, g_strdup(buffer));
+	}
+}
+static janus_ice_mux_socket *janus_ice_mux_socket_for_context(GMainContext *mainctx) {
+	GSList *l = mux_sockets;
+	while(l) {
+		janus_ice_mux_socket *msock = (janus_ice_mux_socket *)l->data;
+		if(msock->mainctx == mainctx)
+			return msock;
+		l = l->next;
+	}
+	return NULL;
+}
+/* Timer callback to check whether the peer is still sending connectivity checks */
+static void janus_ice_mux_consent_check(janus_ice_handle *handle, gpointer data) {
+	janus_ice_component *component = handle->stream ? handle->stream->component : NULL;
+	if(component == NULL || component->mux_ufrag == NULL || mux_consent_timeout == 0 ||
+			janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_ALERT))
+		return;
+	if(janus_get_monotonic_time() - component->mux_last_stun >= (gint64)mux_consent_timeout*G_USEC_PER_SEC) {
+		JANUS_LOG(LOG_WARN, "[%"SCNu64"] No connectivity check on the shared port in %us, consent expired\n",
+			handle->handle_id, mux_consent_timeout);
+		janus_ice_webrtc_hangup(handle, "Consent expired");
+		return;
+	}
+	janus_ice_handle_add_timer(handle, JANUS_ICE_MUX_CONSENT_CHECK, janus_ice_mux_consent_check, NULL, NULL);
+}
+/* The peer nominated an address (or sent its first check): that's where we'll send media to */
+static void janus_ice_mux_bind(janus_ice_handle *handle, janus_ice_component *component,
+		janus_ice_mux_socket *msock, struct sockaddr_storage *addr, socklen_t addrlen) {
+	janus_mutex_lock(&mux_mutex);
+	if(component->mux_addr != NULL)
+		janus_ice_mux_forget_address(component);
+	else
+		component->mux_addr = g_malloc0(sizeof(struct sockaddr_storage));
+	memcpy(component->mux_addr, addr, addrlen);
+	janus_refcount_increase(&component->ref);
+	g_hash_table_replace(mux_addresses, component->mux_addr, component);
+	janus_mutex_unlock(&mux_mutex);
+	/* Any socket bound to the port will do, but the one of our loop is better */
+	janus_ice_mux_socket *esock = janus_ice_mux_socket_for_context(handle->mainctx);
+	if(esock == NULL)
+		esock = msock;
+	if(component->egress_socket != NULL)
+		g_object_unref(component->egress_socket);
+	component->egress_socket = g_object_ref(esock->socket);
+	memcpy(&component->egress_addr, addr, addrlen);
+	component->egress_addrlen = addrlen;
+	component->state = NICE_COMPONENT_STATE_READY;
+	char address[INET6_ADDRSTRLEN];
+	int port = 0;
+	janus_ice_mux_address_to_string(addr, address, sizeof(address), &port);
+	char sp[200];
+	g_snprintf(sp, sizeof(sp), "%s:%"SCNu16" [host,udp] <-> %s:%d [prflx,udp]",
+		janus_get_public_ip(), mux_port, address, port);
+	JANUS_LOG(LOG_VERB, "[%"SCNu64"] New selected pair on the shared port: %s\n", handle->handle_id, sp);
+	gchar *prev_selected_pair = component->selected_pair;
+	component->selected_pair = g_strdup(sp);
+	g_clear_pointer(&prev_selected_pair, g_free);
+	/* Notify event handlers */
+	if(janus_events_is_enabled()) {
+		janus_session *session = (janus_session *)handle->session;
+		json_t *info = json_object();
+		json_object_set_new(info, "selected-pair", json_string(sp));
+		json_object_set_new(info, "stream_id", json_integer(component->stream_id));
+		json_object_set_new(info, "component_id", json_integer(component->component_id));
+		janus_events_notify_handlers(JANUS_EVENT_TYPE_WEBRTC, JANUS_EVENT_SUBTYPE_WEBRTC_PAIR,
+			session->session_id, handle->handle_id, handle->opaque_id, info);
+	}
+	/* Have we been here before? */
+	if(component->component_connected > 0)
+		return;
+	JANUS_LOG(LOG_VERB, "[%"SCNu64"]   Component is ready enough, starting DTLS handshake...\n", handle->handle_id);
+	component->component_connected = janus_get_monotonic_time();
+	component->mux_last_stun = component->component_connected;
+	if(mux_consent_timeout > 0)
+		janus_ice_handle_add_timer(handle, JANUS_ICE_MUX_CONSENT_CHECK, janus_ice_mux_consent_check, NULL, NULL);
+	janus_ice_handle_enqueue(handle, &janus_ice_dtls_handshake, TRUE);
+}
+void janus_ice_dtls_handshake_resume(janus_ice_handle *handle) {
+	if(handle == NULL || handle->queued_packets == NULL)
+		return;
+	janus_ice_handle_enqueue(handle, &janus_ice_dtls_resume, FALSE);
+}
+/* Process a packet received on the shared port, in the loop of the handle it's for */
+static void janus_ice_mux_incoming(janus_ice_handle *handle, janus_ice_mux_socket *msock,
+		char *buf, int len, struct sockaddr_storage *addr, socklen_t addrlen) {
+	janus_ice_stream *stream = handle->stream;
+	janus_ice_component *component = stream ? stream->component : NULL;
+	if(component == NULL || component->mux_ufrag == NULL)
+		return;
+	if(!janus_ice_is_stun(buf, len)) {
+		/* DTLS, SRTP or SRTCP: we only accept it from the address the peer nominated */
+		if(component->mux_addr == NULL || !janus_ice_mux_address_equal(component->mux_addr, addr))
+			return;
+		janus_ice_cb_nice_recv(handle->agent, component->stream_id, component->component_id, len, buf, component);
+		return;
+	}
+	/* We only care about connectivity checks: as ICE-Lite, we never send any. Since
+	 * the credentials may change in case of restarts, we keep the lock until we answer */
+	janus_mutex_lock(&mux_mutex);
+	janus_ice_stun_credentials credentials = { component->mux_ufrag, component->mux_pwd };
+	int res = janus_ice_stun_answer(handle, g_socket_get_fd(msock->socket), &credentials, buf, len, addr, addrlen);
+	janus_mutex_unlock(&mux_mutex);
+	if(res < 0)
+		return;
+	/* Use the address of the first check, until the peer nominates one */
+	if(component->mux_addr == NULL || (res > 0 && !janus_ice_mux_address_equal(component->mux_addr, addr)))
+		janus_ice_mux_bind(handle, component, msock, addr, addrlen);
+	/* Checks on the selected pair mean the peer still consents to receive media */
+	if(component->mux_addr != NULL && janus_ice_mux_address_equal(component->mux_addr, addr))
+		component->mux_last_stun = janus_get_monotonic_time();
+}
+/* Find out who a packet received on the shared port is for, and deliver it */
+static void janus_ice_mux_demux(janus_ice_mux_socket *msock, char *buf, int len,
+		struct sockaddr_storage *addr, socklen_t addrlen) {
+	janus_ice_component *component = NULL;
+	janus_ice_handle *handle = NULL;
+	char ufrag[257];
+	ufrag[0] = '\0';
+	if(janus_ice_is_stun(buf, len)) {
+		/* The USERNAME of connectivity checks is "<our ufrag>:<their ufrag>" */
+		StunMessage msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.buffer = (uint8_t *)buf;
+		msg.buffer_len = len;
+		uint16_t ulen = 0;
+		const uint8_t *username = stun_message_find(&msg, STUN_ATTRIBUTE_USERNAME, &ulen);
+		if(username != NULL && ulen < sizeof(ufrag)) {
+			memcpy(ufrag, username, ulen);
+			ufrag[ulen] = '\0';
+			char *colon = strchr(ufrag, ':');
+			if(colon != NULL)
+				*colon = '\0';
+		}
+	}
+	janus_mutex_lock(&mux_mutex);
+	if(ufrag[0] != '\0')
+		component = g_hash_table_lookup(mux_ufrags, ufrag);
+	if(component == NULL)
+		component = g_hash_table_lookup(mux_addresses, addr);
+	if(component != NULL && component->stream != NULL && component->stream->handle != NULL) {
+		handle = component->stream->handle;
+		janus_refcount_increase(&handle->ref);
+	}
+	janus_mutex_unlock(&mux_mutex);
+	if(handle == NULL) {
+		JANUS_LOG(LOG_HUGE, "Dropping packet of %d bytes received on the shared port: unknown peer\n", len);
+		return;
+	}
+	if(handle->mainctx == msock->mainctx) {
+		/* We're already in the loop of the handle */
+		janus_ice_mux_incoming(handle, msock, buf, len, addr, addrlen);
+	} else {
+		/* Hand the packet to the loop of the handle */
+		janus_ice_queued_packet *pkt = janus_ice_new_queued_packet(handle, sizeof(janus_ice_mux_from) + len);
+		janus_ice_mux_from *from = (janus_ice_mux_from *)pkt->data;
+		from->msock = msock;
+		memcpy(&from->addr, addr, addrlen);
+		from->addrlen = addrlen;
+		memcpy(pkt->data + sizeof(janus_ice_mux_from), buf, len);
+		pkt->length = len;
+		pkt->type = JANUS_ICE_PACKET_MUX;
+		pkt->added = janus_get_monotonic_time();
+		janus_ice_queue_packet(handle, pkt);
+	}
+	janus_refcount_decrease(&handle->ref);
+}
+static gboolean janus_ice_mux_socket_readable(GSocket *socket, GIOCondition condition, gpointer user_data) {
+	janus_ice_mux_socket *msock = (janus_ice_mux_socket *)user_data;
+	int fd = g_socket_get_fd(socket);
+#ifdef HAVE_RECVMMSG
+	/* All PeerConnections share the socket, so read as much as we can at once */
+	janus_ice_ingress_scratch *scratch = NULL;
+	int count = janus_ice_ingress_read(fd, &scratch), i = 0;
+	if(count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+		JANUS_LOG(LOG_WARN, "Error receiving on the shared port: %d (%s)\n", errno, strerror(errno));
+	for(i=0; i<count; i++) {
+		if(scratch->msgs[i].msg_len == 0 || (scratch->msgs[i].msg_hdr.msg_flags & MSG_TRUNC))
+			continue;
+		janus_ice_mux_demux(msock, scratch->slots[i], scratch->msgs[i].msg_len,
+			&scratch->addrs[i], scratch->msgs[i].msg_hdr.msg_namelen);
+	}
+#else
+	char buffer[JANUS_ICE_MUX_BUFSIZE];
+	struct sockaddr_storage addr;
+	socklen_t addrlen = 0;
+	int i = 0;
+	/* Don't starve the other sources of the loop if the socket is busy */
+	for(i=0; i<JANUS_ICE_MUX_READ_MAX; i++) {
+		addrlen = sizeof(addr);
+		ssize_t len = recvfrom(fd, buffer, sizeof(buffer), 0, (struct sockaddr *)&addr, &addrlen);
+		if(len < 0) {
+			if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				JANUS_LOG(LOG_WARN, "Error receiving on the shared port: %d (%s)\n", errno, strerror(errno));
+			break;
+		}
+		if(len > 0)
+			janus_ice_mux_demux(msock, buffer, len, &addr, addrlen);
+	}
+#endif
+	return G_SOURCE_CONTINUE;
+}
+static janus_ice_mux_socket *janus_ice_mux_socket_create(uint16_t port, GMainContext *mainctx, gboolean reuseport) {
+	int family = janus_ipv6_enabled ? AF_INET6 : AF_INET;
+	int fd = socket(family, SOCK_DGRAM, 0);
+	if(fd < 0) {
+		JANUS_LOG(LOG_ERR, "Error creating socket for the shared port: %d (%s)\n", errno, strerror(errno));
+		return NULL;
+	}
+	int yes = 1, no = 0;
+	if(reuseport) {
+#ifdef SO_REUSEPORT
+		if(setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) < 0) {
+			JANUS_LOG(LOG_ERR, "Error setting SO_REUSEPORT on the shared port: %d (%s)\n", errno, strerror(errno));
+			close(fd);
+			return NULL;
+		}
+#else
+		JANUS_LOG(LOG_ERR, "SO_REUSEPORT not supported, can't share the port among event loops\n");
+		close(fd);
+		return NULL;
+#endif
+	}
+	/* All PeerConnections share this socket, so a larger buffer helps (best effort) */
+	int rcvbuf = JANUS_ICE_MUX_RCVBUF;
+	if(setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) < 0)
+		JANUS_LOG(LOG_WARN, "Couldn't set the receive buffer of the shared port: %d (%s)\n", errno, strerror(errno));
+	struct sockaddr_storage address;
+	socklen_t addrlen = 0;
+	memset(&address, 0, sizeof(address));
+	if(family == AF_INET6) {
+		/* Accept IPv4 too */
+		if(setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &no, sizeof(no)) < 0)
+			JANUS_LOG(LOG_WARN, "Couldn't make the shared port dual-stack: %d (%s)\n", errno, strerror(errno));
+		struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)&address;
+		sin6->sin6_family = AF_INET6;
+		sin6->sin6_port = htons(port);
+		sin6->sin6_addr = in6addr_any;
+		addrlen = sizeof(struct sockaddr_in6);
+	} else {
+		struct sockaddr_in *sin = (struct sockaddr_in *)&address;
+		sin->sin_family = AF_INET;
+		sin->sin_port = htons(port);
+		sin->sin_addr.s_addr = INADDR_ANY;
+		addrlen = sizeof(struct sockaddr_in);
+	}
+	if(bind(fd, (struct sockaddr *)&address, addrlen) < 0) {
+		JANUS_LOG(LOG_ERR, "Error binding the shared port %"SCNu16": %d (%s)\n", port, errno, strerror(errno));
+		close(fd);
+		return NULL;
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+	GError *error = NULL;
+	GSocket *socket = g_socket_new_from_fd(fd, &error);
+	if(socket == NULL) {
+		JANUS_LOG(LOG_ERR, "Error wrapping the shared port socket: %s\n", error ? error->message : "??");
+		g_clear_error(&error);
+		close(fd);
+		return NULL;
+	}
+	janus_ice_mux_socket *msock = g_malloc0(sizeof(janus_ice_mux_socket));
+	msock->socket = socket;
+	msock->mainctx = mainctx;
+	msock->source = g_socket_create_source(socket, G_IO_IN, NULL);
+	g_source_set_priority(msock->source, G_PRIORITY_DEFAULT);
+	g_source_set_callback(msock->source, (GSourceFunc)janus_ice_mux_socket_readable, msock, NULL);
+	g_source_attach(msock->source, mainctx);
+	return msock;
+}
+static void janus_ice_mux_socket_destroy(janus_ice_mux_socket *msock) {
+	if(msock == NULL)
+		return;
+	g_source_destroy(msock->source);
+	g_source_unref(msock->source);
+	g_object_unref(msock->socket);
+	g_free(msock);
+}
+static void *janus_ice_mux_thread(void *data) {
+	JANUS_LOG(LOG_VERB, "Shared port thread started\n");
+	g_main_loop_run(mux_loop);
+	JANUS_LOG(LOG_VERB, "Shared port thread leaving\n");
+	return NULL;
+}
+int janus_ice_enable_mux(uint16_t port) {
+	if(port == 0)
+		return 0;
+	if(!janus_ice_lite_enabled) {
+		JANUS_LOG(LOG_WARN, "Single-port media multiplexing is only supported in ICE-Lite mode, ignoring\n");
+		return -1;
+	}
+	if(janus_ice_tcp_enabled)
+		JANUS_LOG(LOG_WARN, "ICE-TCP candidates are not supported when multiplexing media on a single port\n");
+	if(static_event_loops > 0) {
+		/* One socket per loop, the kernel will spread incoming packets among them */
+		janus_mutex_lock(&event_loops_mutex);
+		GSList *l = event_loops;
+		while(l) {
+			janus_ice_static_event_loop *loop = (janus_ice_static_event_loop *)l->data;
+			janus_ice_mux_socket *msock = janus_ice_mux_socket_create(port, loop->mainctx, TRUE);
+			if(msock == NULL)
+				break;
+			mux_sockets = g_slist_append(mux_sockets, msock);
+			l = l->next;
+		}
+		janus_mutex_unlock(&event_loops_mutex);
+		if(l != NULL) {
+			g_slist_free_full(mux_sockets, (GDestroyNotify)janus_ice_mux_socket_destroy);
+			mux_sockets = NULL;
+			return -1;
+		}
+	} else {
+		/* A single socket, served by a dedicated thread */
+		mux_context = g_main_context_new();
+		mux_loop = g_main_loop_new(mux_context, FALSE);
+		janus_ice_mux_socket *msock = janus_ice_mux_socket_create(port, mux_context, FALSE);
+		GError *error = NULL;
+		if(msock != NULL)
+			mux_thread = g_thread_try_new("ice mux", &janus_ice_mux_thread, NULL, &error);
+		if(msock == NULL || error != NULL) {
+			if(error != NULL) {
+				JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the shared port thread...\n",
+					error->code, error->message ? error->message : "??");
+				g_error_free(error);
+			}
+			janus_ice_mux_socket_destroy(msock);
+			g_main_loop_unref(mux_loop);
+			mux_loop = NULL;
+			g_main_context_unref(mux_context);
+			mux_context = NULL;
+			return -1;
+		}
+		mux_sockets = g_slist_append(mux_sockets, msock);
+	}
+	mux_ufrags = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, janus_ice_mux_component_unref);
+	mux_addresses = g_hash_table_new_full(janus_ice_mux_address_hash, janus_ice_mux_address_equal,
+		NULL, janus_ice_mux_component_unref);
+	mux_port = port;
+	JANUS_LOG(LOG_INFO, "Multiplexing media on UDP port %"SCNu16" (%d socket(s))\n", mux_port, g_slist_length(mux_sockets));
+	return 0;
+}
+static void janus_ice_disable_mux(void) {
+	if(mux_port == 0)
+		return;
+	mux_port = 0;
+	g_slist_free_full(mux_sockets, (GDestroyNotify)janus_ice_mux_socket_destroy);
+	mux_sockets = NULL;
+	if(mux_thread != NULL) {
+		g_main_loop_quit(mux_loop);
+		g_thread_join(mux_thread);
+		mux_thread = NULL;
+		g_main_loop_unref(mux_loop);
+		mux_loop = NULL;
+		g_main_context_unref(mux_context);
+		mux_context = NULL;
+	}
+	janus_mutex_lock(&mux_mutex);
+	g_hash_table_destroy(mux_ufrags);
+	mux_ufrags = NULL;
+	g_hash_table_destroy(mux_addresses);
+	mux_addresses = NULL;
+	janus_mutex_unlock(&mux_mutex);
+}
+
+/* Precompiled RTP extensions for outgoing packets: the elements we always add
+ * (transport-wide sequence number for video, mid) are compiled once, when the
+ * negotiation changes, in two variants, without and with a placeholder for the
+ * optional element plugins may ask us to add (audio level or video orientation) */
+static void janus_ice_extensions_template_compile(janus_ice_extensions_template *template,
+		gboolean video, int twcc_ext_id, int mid_ext_id, const char *mid, int optional_ext_id) {
+	memset(template, 0, sizeof(*template));
+	char elements[JANUS_ICE_EXTENSIONS_TEMPLATE_SIZE];
+	uint16_t extlen = 0;
+	if(video && twcc_ext_id > 0) {
+		/* We'll actually set the sequence number later, when sending the packet */
+		elements[extlen] = (twcc_ext_id << 4) + 1;
+		memset(elements + extlen + 1, 0, 2);
+		template->twcc_offset = 4 + extlen + 1;
+		extlen += 3;
+	}
+	if(mid_ext_id > 0 && mid != NULL) {
+		size_t midlen = strlen(mid) & 0x0F;
+		elements[extlen] = (mid_ext_id << 4) + (midlen ? midlen-1 : 0);
+		memcpy(elements + extlen + 1, mid, midlen);
+		extlen += (midlen + 1);
+	}
+	int i = 0;
+	for(i=0; i<2; i++) {
+		char *block = template->buffer[i];
+		uint16_t len = extlen;
+		memcpy(block + 4, elements, extlen);
+		if(i == 1 && optional_ext_id > 0) {
+			block[4 + len] = (optional_ext_id << 4);
+			template->optional_offset = 4 + len + 1;
+			len += 2;
+		}
+		if(len == 0)
+			continue;
+		/* Calculate the whole length (taking into account the RFC5285 header) */
+		uint16_t words = len/4;
+		if(len%4 != 0)
+			words++;
+		janus_rtp_header_extension *extheader = (janus_rtp_header_extension *)block;
+		extheader->type = htons(0xBEDE);
+		extheader->length = htons(words);
+		template->length[i] = 4 + (words*4);
+	}
+}
+
+static void janus_ice_extensions_free(const janus_refcount *ext_ref) {
+	janus_ice_extensions *extensions = janus_refcount_containerof(ext_ref, janus_ice_extensions, ref);
+	g_free(extensions);
+}
+/* Get a reference to the extensions currently published for a stream: the
+ * pointer may be swapped right after we read it, but the previous instance
+ * stays referenced by the stream for a while (see below), which is more
+ * than enough for us to take our own reference */
+static janus_ice_extensions *janus_ice_extensions_get(janus_ice_stream *stream) {
+	janus_ice_extensions *extensions = g_atomic_pointer_get(&stream->extensions);
+	if(extensions != NULL)
+		janus_refcount_increase_nodebug(&extensions->ref);
+	return extensions;
+}
+static void janus_ice_extensions_unref(janus_ice_extensions *extensions) {
+	janus_refcount_decrease_nodebug(&extensions->ref);
+}
+/* How long the stream keeps a reference to replaced extensions, in ms */
+#define JANUS_ICE_EXTENSIONS_GRACE	1000
+static void janus_ice_extensions_retire(janus_ice_handle *handle, gpointer data) {
+	/* Nothing to do: the reference is released when the timer is freed,
+	 * which also happens if the timer is cancelled because the handle is going */
+}
+
+void janus_ice_stream_compile_extensions(janus_ice_stream *stream) {
+	if(stream == NULL || stream->handle == NULL)
+		return;
+	janus_ice_handle *handle = stream->handle;
+	/* We compile a new instance, and then publish it: the previous one may still
+	 * be in use by a packet being relayed or received, so we only retire it */
+	janus_ice_extensions *extensions = g_malloc0(sizeof(janus_ice_extensions));
+	janus_refcount_init(&extensions->ref, janus_ice_extensions_free);
+	janus_ice_extensions_template_compile(&extensions->outgoing[0], FALSE,
+		0, stream->mid_ext_id, handle->audio_mid, stream->audiolevel_ext_id);
+	janus_ice_extensions_template_compile(&extensions->outgoing[1], TRUE,
+		stream->transport_wide_cc_ext_id, stream->mid_ext_id, handle->video_mid, stream->videoorientation_ext_id);
+	janus_rtp_extmap_reset(&extensions->incoming);
+	janus_rtp_extmap_set(&extensions->incoming, stream->audiolevel_ext_id, JANUS_RTP_EXTENSION_AUDIO_LEVEL);
+	janus_rtp_extmap_set(&extensions->incoming, stream->videoorientation_ext_id, JANUS_RTP_EXTENSION_VIDEO_ORIENTATION);
+	janus_rtp_extmap_set(&extensions->incoming, stream->transport_wide_cc_ext_id, JANUS_RTP_EXTENSION_TRANSPORT_WIDE_CC);
+	janus_rtp_extmap_set(&extensions->incoming, stream->mid_ext_id, JANUS_RTP_EXTENSION_MID);
+	janus_rtp_extmap_set(&extensions->incoming, stream->rid_ext_id, JANUS_RTP_EXTENSION_RID);
+	janus_rtp_extmap_set(&extensions->incoming, stream->ridrtx_ext_id, JANUS_RTP_EXTENSION_REPAIRED_RID);
+	janus_rtp_extmap_set(&extensions->incoming, stream->framemarking_ext_id, JANUS_RTP_EXTENSION_FRAMEMARKING);
+	janus_ice_extensions *previous = g_atomic_pointer_get(&stream->extensions);
+	g_atomic_pointer_set(&stream->extensions, extensions);
+	if(previous != NULL && janus_ice_handle_add_timer(handle, JANUS_ICE_EXTENSIONS_GRACE,
+			janus_ice_extensions_retire, previous, (GDestroyNotify)janus_ice_extensions_unref) < 0) {
+		/* No loop yet, which means nobody is sending or receiving packets */
+		janus_ice_extensions_unref(previous);
+	}
+	JANUS_LOG(LOG_VERB, "[%"SCNu64"] Compiled RTP extensions for outgoing packets (audio: %"SCNu16"/%"SCNu16" bytes, video: %"SCNu16"/%"SCNu16" bytes)\n",
+		handle->handle_id, extensions->outgoing[0].length[0], extensions->outgoing[0].length[1],
+		extensions->outgoing[1].length[0], extensions->outgoing[1].length[1]);
+}
+
+/* Copy a precompiled extensions block to a packet, patching the optional element if needed */
+static void janus_ice_extensions_template_apply(const janus_ice_extensions_template *template,
+		int variant, janus_plugin_rtp *packet, char *dst) {
+	memcpy(dst, template->buffer[variant], template->length[variant]);
+	if(variant == 0)
+		return;
+	if(!packet->video) {
+		/* Audio level */
+		dst[template->optional_offset] = (packet->extensions.audio_level_vad << 7) + (packet->extensions.audio_level & 0x7F);
+	} else {
+		/* Video orientation */
+		gboolean c = packet->extensions.video_back_camera,
+			f = packet->extensions.video_flipped, r1 = FALSE, r0 = FALSE;
+		switch(packet->extensions.video_rotation) {
+			case 270:
+				r1 = TRUE;
+				r0 = TRUE;
+				break;
+			case 180:
+				r1 = TRUE;
+				r0 = FALSE;
+				break;
+			case 90:
+				r1 = FALSE;
+				r0 = TRUE;
+				break;
+			case 0:
+			default:
+				r1 = FALSE;
+				r0 = FALSE;
+				break;
+		}
+		dst[template->optional_offset] = (c<<3) + (f<<2) + (r1<<1) + r0;
+	}
+}
+
 void janus_ice_relay_rtp(janus_ice_handle *handle, janus_plugin_rtp *packet) {
 	if(!handle || handle->queued_packets == NULL || packet == NULL || packet->buffer == NULL ||
 			!janus_is_rtp(packet->buffer, packet->length))
@@ -4391,99 +6950,49 @@ void janus_ice_relay_rtp(janus_ice_handle *handle, janus_plugin_rtp *packet) {
 	char *payload = janus_rtp_payload(packet->buffer, packet->length, &plen);
 	if(payload != NULL)
 		totlen += plen;
-	/* We need to strip extensions, here, and add those that need to be there manually */
-	uint16_t extlen = 0;
-	char extensions[50];
+	/* We need to strip extensions, here, and add those that need to be there:
+	 * we use the block we precompiled for this medium, and add the optional
+	 * element (audio level or video orientation) only if the plugin set it */
+	static const janus_ice_extensions_template no_extensions = { 0 };
+	janus_ice_stream *stream = handle->stream;
+	janus_ice_extensions *extensions = janus_ice_extensions_get(stream);
+	const janus_ice_extensions_template *template =
+		extensions ? &extensions->outgoing[packet->video ? 1 : 0] : &no_extensions;
+	int variant = 0;
+	if(template->optional_offset > 0 && ((!packet->video && packet->extensions.audio_level != -1) ||
+			(packet->video && packet->extensions.video_rotation != -1)))
+		variant = 1;
+	uint16_t extlen = template->length[variant];
+	totlen += extlen;
 	janus_rtp_header *header = (janus_rtp_header *)packet->buffer;
 	int origext = header->extension;
-	header->extension = 0;
-	/* Add core and plugin extensions, if any */
-	if((packet->video && handle->stream->transport_wide_cc_ext_id > 0) || handle->stream->mid_ext_id > 0 ||
-			(!packet->video && packet->extensions.audio_level != -1 && handle->stream->audiolevel_ext_id > 0) ||
-			(packet->video && packet->extensions.video_rotation != -1 && handle->stream->videoorientation_ext_id > 0)) {
-		header->extension = 1;
-		memset(extensions, 0, sizeof(extensions));
-		janus_rtp_header_extension *extheader = (janus_rtp_header_extension *)extensions;
-		extheader->type = htons(0xBEDE);
-		extheader->length = 0;
-		/* Iterate on all extensions we need */
-		char *index = extensions + 4;
-		/* Check if we need to add the transport-wide CC extension */
-		if(packet->video && handle->stream->transport_wide_cc_ext_id > 0) {
-			*index = (handle->stream->transport_wide_cc_ext_id << 4) + 1;
-			/* We'll actually set the sequence number later, when sending the packet */
-			memset(index+1, 0, 2);
-			index += 3;
-			extlen += 3;
-		}
-		/* Check if we need to add the mid extension */
-		if(handle->stream->mid_ext_id > 0) {
-			char *mid = packet->video ? handle->video_mid : handle->audio_mid;
-			if(mid != NULL) {
-				size_t midlen = strlen(mid) & 0x0F;
-				*index = (handle->stream->mid_ext_id << 4) + (midlen ? midlen-1 : 0);
-				memcpy(index+1, mid, midlen);
-				index += (midlen + 1);
-				extlen += (midlen + 1);
-			}
-		}
-		/* Check if the plugin (or source) included other extensions */
-		if(!packet->video && packet->extensions.audio_level != -1 && handle->stream->audiolevel_ext_id > 0) {
-			/* Add audio-level extension */
-			*index = (handle->stream->audiolevel_ext_id << 4);
-			*(index+1) = (packet->extensions.audio_level_vad << 7) + (packet->extensions.audio_level & 0x7F);
-			index += 2;
-			extlen += 2;
-		}
-		if(packet->video && packet->extensions.video_rotation != -1 && handle->stream->videoorientation_ext_id > 0) {
-			/* Add video-orientation extension */
-			*index = (handle->stream->videoorientation_ext_id << 4);
-			gboolean c = packet->extensions.video_back_camera,
-				f = packet->extensions.video_flipped, r1 = FALSE, r0 = FALSE;
-			switch(packet->extensions.video_rotation) {
-				case 270:
-					r1 = TRUE;
-					r0 = TRUE;
-					break;
-				case 180:
-					r1 = TRUE;
-					r0 = FALSE;
-					break;
-				case 90:
-					r1 = FALSE;
-					r0 = TRUE;
-					break;
-				case 0:
-				default:
-					r1 = FALSE;
-					r0 = FALSE;
-					break;
-			}
-			*(index+1) = (c<<3) + (f<<2) + (r1<<1) + r0;
-			index += 2;
-			extlen += 2;
-		}
-		/* Calculate the whole length */
-		uint16_t words = extlen/4;
-		if(extlen%4 != 0)
-			words++;
-		extheader->length = htons(words);
-		/* Update lengths (taking into account the RFC5285 header) */
-		extlen = 4 + (words*4);
-		totlen += extlen;
-	}
+	header->extension = (extlen > 0);
 	/* Queue this packet */
-	janus_ice_queued_packet *pkt = g_malloc(sizeof(janus_ice_queued_packet));
-	pkt->data = g_malloc(totlen + SRTP_MAX_TAG_LEN);
-	/* RTP header first */
-	memcpy(pkt->data, packet->buffer, RTP_HEADER_SIZE);
-	/* Then RTP extensions, if any */
-	if(extlen > 0)
-		memcpy(pkt->data + RTP_HEADER_SIZE, extensions, extlen);
-	/* Finally the RTP payload, if available */
-	if(payload != NULL && plen > 0)
-		memcpy(pkt->data + RTP_HEADER_SIZE + extlen, payload, plen);
+	gboolean shared = (packet->payload != NULL && plen > 0 && packet->payload->length == plen &&
+		RTP_HEADER_SIZE + extlen <= JANUS_ICE_OVERLAY_SIZE);
+	janus_ice_queued_packet *pkt = janus_ice_new_queued_packet(handle, shared ? 0 : totlen + SRTP_MAX_TAG_LEN);
+	if(shared) {
+		/* The plugin shared the payload with us: we only keep our own header
+		 * and extensions, and will put the packet together when sending it */
+		memcpy(pkt->overlay, packet->buffer, RTP_HEADER_SIZE);
+		if(extlen > 0)
+			janus_ice_extensions_template_apply(template, variant, packet, pkt->overlay + RTP_HEADER_SIZE);
+		pkt->overlay_length = RTP_HEADER_SIZE + extlen;
+		janus_refcount_increase(&packet->payload->ref);
+		pkt->payload = packet->payload;
+	} else {
+		/* RTP header first */
+		memcpy(pkt->data, packet->buffer, RTP_HEADER_SIZE);
+		/* Then RTP extensions, if any */
+		if(extlen > 0)
+			janus_ice_extensions_template_apply(template, variant, packet, pkt->data + RTP_HEADER_SIZE);
+		/* Finally the RTP payload, if available */
+		if(payload != NULL && plen > 0)
+			memcpy(pkt->data + RTP_HEADER_SIZE + extlen, payload, plen);
+	}
 	pkt->length = totlen;
+	if(packet->video && extlen > 0 && template->twcc_offset > 0)
+		pkt->twcc_offset = RTP_HEADER_SIZE + template->twcc_offset;
 	pkt->type = packet->video ? JANUS_ICE_PACKET_VIDEO : JANUS_ICE_PACKET_AUDIO;
 	pkt->control = FALSE;
 	pkt->encrypted = FALSE;
@@ -4493,6 +7002,8 @@ void janus_ice_relay_rtp(janus_ice_handle *handle, janus_plugin_rtp *packet) {
 	janus_ice_queue_packet(handle, pkt);
 	/* Restore the extension flag to what the plugin set it to */
 	header->extension = origext;
+	if(extensions != NULL)
+		janus_ice_extensions_unref(extensions);
 }
 
 void janus_ice_relay_rtcp_internal(janus_ice_handle *handle, janus_plugin_rtcp *packet, gboolean filter_rtcp) {
@@ -4523,8 +7034,7 @@ void janus_ice_relay_rtcp_internal(janus_ice_handle *handle, janus_plugin_rtcp *
 			packet->video ? stream->video_ssrc_peer[0] : stream->audio_ssrc_peer);
 	}
 	/* Queue this packet */
-	janus_ice_queued_packet *pkt = g_malloc(sizeof(janus_ice_queued_packet));
-	pkt->data = g_malloc(rtcp_len+SRTP_MAX_TAG_LEN+4);
+	janus_ice_queued_packet *pkt = janus_ice_new_queued_packet(handle, rtcp_len+SRTP_MAX_TAG_LEN+4);
 	memcpy(pkt->data, rtcp_buf, rtcp_len);
 	pkt->length = rtcp_len;
 	pkt->type = packet->video ? JANUS_ICE_PACKET_VIDEO : JANUS_ICE_PACKET_AUDIO;
@@ -4588,8 +7098,7 @@ void janus_ice_relay_data(janus_ice_handle *handle, janus_plugin_data *packet) {
 	if(!handle || handle->queued_packets == NULL || packet == NULL || packet->buffer == NULL || packet->length < 1)
 		return;
 	/* Queue this packet */
-	janus_ice_queued_packet *pkt = g_malloc(sizeof(janus_ice_queued_packet));
-	pkt->data = g_malloc(packet->length);
+	janus_ice_queued_packet *pkt = janus_ice_new_queued_packet(handle, packet->length);
 	memcpy(pkt->data, packet->buffer, packet->length);
 	pkt->length = packet->length;
 	pkt->type = packet->binary ? JANUS_ICE_PACKET_BINARY : JANUS_ICE_PACKET_TEXT;
@@ -4607,8 +7116,7 @@ void janus_ice_relay_sctp(janus_ice_handle *handle, char *buffer, int length) {
 	if(!handle || handle->queued_packets == NULL || buffer == NULL || length < 1)
 		return;
 	/* Queue this packet */
-	janus_ice_queued_packet *pkt = g_malloc(sizeof(janus_ice_queued_packet));
-	pkt->data = g_malloc(length);
+	janus_ice_queued_packet *pkt = janus_ice_new_queued_packet(handle, length);
 	memcpy(pkt->data, buffer, length);
 	pkt->length = length;
 	pkt->type = JANUS_ICE_PACKET_SCTP;
@@ -4643,23 +7151,9 @@ void janus_ice_dtls_handshake_done(janus_ice_handle *handle, janus_ice_component
 	}
 	janus_flags_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_READY);
 	/* Create a source for RTCP and one for stats */
-	handle->rtcp_source = g_timeout_source_new_seconds(1);
-	g_source_set_priority(handle->rtcp_source, G_PRIORITY_DEFAULT);
-	g_source_set_callback(handle->rtcp_source, janus_ice_outgoing_rtcp_handle, handle, NULL);
-	g_source_attach(handle->rtcp_source, handle->mainctx);
-	if(twcc_period != 1000) {
-		/* The Transport Wide CC feedback period is different, create another source */
-		handle->twcc_source = g_timeout_source_new(twcc_period);
-		g_source_set_priority(handle->twcc_source, G_PRIORITY_DEFAULT);
-		g_source_set_callback(handle->twcc_source, janus_ice_outgoing_transport_wide_cc_feedback, handle, NULL);
-		g_source_attach(handle->twcc_source, handle->mainctx);
-	}
 	handle->last_event_stats = 0;
 	handle->last_srtp_summary = -1;
-	handle->stats_source = g_timeout_source_new_seconds(1);
-	g_source_set_callback(handle->stats_source, janus_ice_outgoing_stats_handle, handle, NULL);
-	g_source_set_priority(handle->stats_source, G_PRIORITY_DEFAULT);
-	g_source_attach(handle->stats_source, handle->mainctx);
+	janus_ice_handle_create_sources(handle);
 	janus_mutex_unlock(&handle->mutex);
 	JANUS_LOG(LOG_INFO, "[%"SCNu64"] The DTLS handshake has been completed\n", handle->handle_id);
 	/* Notify the plugin that the WebRTC PeerConnection is ready to be used */
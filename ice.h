@@ -24,6 +24,7 @@
 #include "dtls.h"
 #include "sctp.h"
 #include "rtcp.h"
+#include "bwe.h"
 #include "text2pcap.h"
 #include "utils.h"
 #include "ip-utils.h"
@@ -164,6 +165,71 @@ void janus_enable_opaqueid_in_api(void);
 /*! \brief Method to check whether opaque ID have to be added to Janus API responses/events
  * @returns TRUE if they need to be present, FALSE otherwise */
 gboolean janus_is_opaqueid_in_api_enabled(void);
+/*! \brief Method to enable batched egress, i.e., sending all the packets queued
+ * for a PeerConnection with a single sendmmsg (or UDP GSO) call rather than one
+ * syscall per packet (only works if the selected pair is UDP and not relayed) */
+void janus_ice_enable_egress_batching(void);
+/*! \brief Method to check whether batched egress is enabled
+ * @returns TRUE if batched egress is enabled, FALSE otherwise */
+gboolean janus_ice_is_egress_batching_enabled(void);
+/*! \brief Method to enable batched ingress, i.e., reading incoming media with
+ * recvmmsg, many datagrams at a time, rather than having libnice read them one
+ * by one (only works if the selected pair is UDP and not relayed) */
+void janus_ice_enable_ingress_batching(void);
+/*! \brief Method to check whether batched ingress is enabled
+ * @returns TRUE if batched ingress is enabled, FALSE otherwise */
+gboolean janus_ice_is_ingress_batching_enabled(void);
+/*! \brief Default pacing multiplier, i.e., how much faster than the current bitrate we pace */
+#define DEFAULT_PACING_MULTIPLIER	2.5
+/*! \brief Default cap (ms) on the time a packet can wait in the pacer */
+#define DEFAULT_PACING_MAX_QUEUE	250
+/*! \brief Method to enable pacing of outgoing video, i.e., spreading the packets
+ * plugins relay (e.g., keyframes) over time with a leaky bucket, rather than
+ * sending them all at once; audio and RTCP are never paced
+ * @param[in] multiplier How much faster than the current bitrate (or bandwidth estimate) video should be paced
+ * @param[in] max_queue Maximum time, in milliseconds, a packet can wait in the pacer before being sent anyway */
+void janus_ice_enable_pacing(double multiplier, guint max_queue);
+/*! \brief Method to check whether pacing of outgoing video is enabled
+ * @returns TRUE if pacing is enabled, FALSE otherwise */
+gboolean janus_ice_is_pacing_enabled(void);
+/*! \brief Method to get the pacing rate multiplier
+ * @returns The pacing rate multiplier */
+double janus_ice_get_pacing_multiplier(void);
+/*! \brief Method to get the maximum time packets can wait in the pacer
+ * @returns The pacer queue-time cap, in milliseconds */
+guint janus_ice_get_pacing_max_queue(void);
+/*! \brief Method to create a pool of threads to offload SRTP encryption to: rather
+ * than protecting packets one by one in the event loop of the handle, batches of
+ * prepared packets are protected by the pool, and then sent, in order, by the loop
+ * \note Useful when a single loop serves many subscribers of a popular publisher
+ * @param[in] workers Number of crypto workers to create (0 disables them) */
+void janus_ice_set_srtp_workers(int workers);
+/*! \brief Method to get the number of crypto workers
+ * @returns The number of crypto workers, or 0 if SRTP encryption is done in the event loops */
+int janus_ice_get_srtp_workers(void);
+/*! \brief Method to multiplex the media of all PeerConnections on a single UDP port
+ * \details Only available in ICE-Lite mode: libnice won't gather candidates nor
+ * bind sockets for PeerConnections anymore, and all of them will advertise the
+ * same host candidate(s) on the provided port instead. Incoming packets are
+ * demultiplexed using the ICE username of connectivity checks first, and the
+ * source address then. With static event loops, each loop gets its own socket
+ * bound to the port (SO_REUSEPORT), otherwise a single socket is used.
+ * @param[in] port The UDP port to bind to (0 leaves multiplexing disabled)
+ * @returns 0 in case of success, a negative integer otherwise */
+int janus_ice_enable_mux(uint16_t port);
+/*! \brief Method to check whether single-port media multiplexing is enabled
+ * @returns TRUE if multiplexing is enabled, FALSE otherwise */
+gboolean janus_ice_is_mux_enabled(void);
+/*! \brief Method to get the UDP port media is multiplexed on
+ * @returns The UDP port, or 0 if multiplexing is disabled */
+uint16_t janus_ice_get_mux_port(void);
+/*! \brief Method to modify how long a peer on the shared port can go without sending
+ * connectivity checks before we consider its consent expired, and hangup the PeerConnection
+ * @param[in] timeout The new timeout, in seconds (0 disables the check) */
+void janus_ice_set_mux_consent_timeout(uint timeout);
+/*! \brief Method to get the current consent timeout on the shared port (see above)
+ * @returns The current consent timeout, in seconds */
+uint janus_ice_get_mux_consent_timeout(void);
 
 
 /*! \brief Helper method to get a string representation of a libnice ICE state
@@ -180,6 +246,22 @@ typedef struct janus_ice_stream janus_ice_stream;
 typedef struct janus_ice_component janus_ice_component;
 /*! \brief Helper to handle pending trickle candidates (e.g., when we're still waiting for an offer) */
 typedef struct janus_ice_trickle janus_ice_trickle;
+/*! \brief Scratch area and statistics for batched egress, owned by an event loop */
+typedef struct janus_ice_egress_batch janus_ice_egress_batch;
+/*! \brief Pool of packet buffers of an event loop */
+typedef struct janus_ice_pool janus_ice_pool;
+/*! \brief Hierarchical timer wheel of an event loop */
+typedef struct janus_ice_timer_wheel janus_ice_timer_wheel;
+/*! \brief Leaky bucket pacer for the outgoing video of a handle */
+typedef struct janus_ice_pacer janus_ice_pacer;
+/*! \brief Batch of packets of a handle that a crypto worker protects, if enabled */
+typedef struct janus_ice_crypto_batch janus_ice_crypto_batch;
+/*! \brief Static event loop handles can be added to, if enabled */
+typedef struct janus_ice_static_event_loop janus_ice_static_event_loop;
+/*! \brief Timer scheduled in the timer wheel of an event loop */
+typedef struct janus_ice_timer janus_ice_timer;
+/*! \brief Callback to invoke when a timer scheduled for a handle fires */
+typedef void (*janus_ice_timer_callback)(janus_ice_handle *handle, gpointer data);
 
 #define JANUS_ICE_HANDLE_WEBRTC_PROCESSING_OFFER	(1 << 0)
 #define JANUS_ICE_HANDLE_WEBRTC_START				(1 << 1)
@@ -247,15 +329,28 @@ void janus_ice_notify_hangup(janus_ice_handle *handle, const char *reason);
 gboolean janus_plugin_session_is_alive(janus_plugin_session *plugin_session);
 
 
-/*! \brief A helper struct for determining when to send NACKs */
-typedef struct janus_seq_info {
-	gint64 ts;
-	guint16 seq;
-	guint16 state;
-	struct janus_seq_info *next;
-	struct janus_seq_info *prev;
-} janus_seq_info;
-void janus_seq_list_free(janus_seq_info **head);
+/*! \brief Size of the window of recent sequence numbers we track for NACKs (must be a power of two) */
+#define JANUS_SEQ_WINDOW_SIZE	256
+/*! \brief A helper struct for determining when to send NACKs: a window of the
+ * most recent sequence numbers, indexed by seq & (JANUS_SEQ_WINDOW_SIZE-1), with
+ * a bitmap of the ones we're still waiting for, and the state of each slot */
+typedef struct janus_seq_window {
+	/*! \brief Bitmap of the sequence numbers we may still NACK (missing or NACKed once) */
+	guint64 pending[JANUS_SEQ_WINDOW_SIZE/64];
+	/*! \brief State of each slot */
+	guint8 state[JANUS_SEQ_WINDOW_SIZE];
+	/*! \brief When we noticed the sequence number in each slot was missing */
+	gint64 ts[JANUS_SEQ_WINDOW_SIZE];
+	/*! \brief Highest sequence number we received */
+	guint16 highest;
+	/*! \brief How many sequence numbers (up to the highest) the window covers, 0 if empty */
+	guint16 span;
+	/*! \brief When we last looked for sequence numbers to NACK */
+	gint64 last_scan;
+} janus_seq_window;
+/*! \brief Helper method to reset a window of sequence numbers
+ * @param[in] window The window to reset */
+void janus_seq_window_reset(janus_seq_window *window);
 enum {
 	SEQ_MISSING,
 	SEQ_NACKED,
@@ -320,6 +415,24 @@ struct janus_ice_handle {
 	GList *pending_trickles;
 	/*! \brief Queue of events in the loop and outgoing packets to send */
 	GAsyncQueue *queued_packets;
+	/*! \brief Whether the loop was woken up already, and hasn't started draining the queue yet */
+	volatile gint wakeup_pending;
+	/*! \brief Packets queued so far, and how many times that needed waking the loop up */
+	volatile gsize queued_count, wakeups_count;
+	/*! \brief Batched egress context of the event loop this handle is in, if enabled */
+	janus_ice_egress_batch *egress;
+	/*! \brief Pool of packet buffers of the event loop this handle is in */
+	janus_ice_pool *pool;
+	/*! \brief Timer wheel of the event loop this handle is in */
+	janus_ice_timer_wheel *timers;
+	/*! \brief Pacer for the outgoing video of this handle, if pacing is enabled */
+	janus_ice_pacer *pacer;
+	/*! \brief Packets of this handle waiting for (or being protected by) a crypto worker, if enabled */
+	janus_ice_crypto_batch *crypto;
+	/*! \brief Static event loop this handle is in, if static loops are enabled */
+	janus_ice_static_event_loop *loop;
+	/*! \brief Static event loop this handle has been asked to move to, if any */
+	janus_ice_static_event_loop *migrate_to;
 	/*! \brief Count of the recent SRTP replay errors, in order to avoid spamming the logs */
 	guint srtp_errors_count;
 	/*! \brief Count of the recent SRTP replay errors, in order to avoid spamming the logs */
@@ -340,6 +453,41 @@ struct janus_ice_handle {
 	janus_refcount ref;
 };
 
+/*! \brief Maximum size of a precompiled RTP extensions block */
+#define JANUS_ICE_EXTENSIONS_TEMPLATE_SIZE	32
+/*! \brief Precompiled RTP extensions block we add to outgoing packets
+ * \details The extensions we add to the RTP packets we send only change
+ * when a new negotiation takes place, so we compile them once per stream
+ * and medium: relaying a packet then only means copying the right block
+ * and patching the values that change for each packet. Each template comes
+ * in two variants, without and with the optional element (audio level for
+ * audio, video orientation for video) plugins may ask us to add */
+typedef struct janus_ice_extensions_template {
+	/*! \brief The two variants of the block, RFC5285 header and padding included */
+	char buffer[2][JANUS_ICE_EXTENSIONS_TEMPLATE_SIZE];
+	/*! \brief Length of the two variants (0 if there's nothing to add) */
+	guint16 length[2];
+	/*! \brief Offset of the transport-wide sequence number in the block (0 if not negotiated) */
+	guint16 twcc_offset;
+	/*! \brief Offset of the value of the optional element in the second variant (0 if not negotiated) */
+	guint16 optional_offset;
+} janus_ice_extensions_template;
+/*! \brief RTP extensions negotiated for a stream, compiled once per negotiation
+ * \details Instances are never modified once published: a new negotiation
+ * compiles a new instance and swaps the pointer in the stream atomically, so
+ * that the threads sending and receiving packets never see a torn one. Those
+ * threads take a reference while they use an instance, and the stream only
+ * releases its own reference to the previous instance after a grace period,
+ * so that a thread that read the pointer before the swap can still take one */
+typedef struct janus_ice_extensions {
+	/*! \brief Precompiled extensions for outgoing audio (0) and video (1) packets */
+	janus_ice_extensions_template outgoing[2];
+	/*! \brief Map of the negotiated extension IDs, to parse incoming packets */
+	janus_rtp_extmap incoming;
+	/*! \brief Reference counter for this instance */
+	janus_refcount ref;
+} janus_ice_extensions;
+
 /*! \brief Janus ICE stream */
 struct janus_ice_stream {
 	/*! \brief Janus ICE handle this stream belongs to */
@@ -422,12 +570,22 @@ struct janus_ice_stream {
 	guint32 transport_wide_cc_last_seq_num;
 	/*! \brief Last transport wide seq num sent on feedback */
 	guint32 transport_wide_cc_last_feedback_seq_num;
+	/*! \brief Whether we sent any transport wide feedback yet (any seq num is valid after a wrap) */
+	gboolean transport_wide_cc_feedback_sent;
 	/*! \brief Transport wide cc transport seq num wrap cycles */
 	guint16 transport_wide_cc_cycles;
 	/*! \brief Transport wide cc rtp ext ID */
 	guint transport_wide_cc_feedback_count;
-	/*! \brief GLib list of transport wide cc stats in reverse received order */
-	GSList *transport_wide_received_seq_nums;
+	/*! \brief Ring of received transport wide cc stats (arrival times from the monotonic clock), indexed by extended seq num */
+	janus_rtcp_transport_wide_cc_stats *transport_wide_cc_ring;
+	/*! \brief Highest extended transport wide seq num received */
+	guint32 transport_wide_cc_highest_seq_num;
+	/*! \brief Whether we received any transport wide seq num at all */
+	gboolean transport_wide_cc_received;
+	/*! \brief Send-side bandwidth estimation context, fed by the transport wide cc feedback the peer sends us */
+	janus_bwe_context *bwe;
+	/*! \brief RTP extensions compiled at the latest negotiation (only swapped atomically) */
+	janus_ice_extensions *extensions;
 	/*! \brief DTLS role of the server for this stream */
 	janus_dtls_role dtls_role;
 	/*! \brief Hashing algorhitm used by the peer for the DTLS certificate (e.g., "SHA-256") */
@@ -452,7 +610,32 @@ struct janus_ice_stream {
 	janus_refcount ref;
 };
 
-#define LAST_SEQS_MAX_LEN 160
+/*! \brief Slot of a NACK ring: the packet we sent, when, and its sequence number */
+typedef struct janus_ice_nack_slot {
+	/*! \brief Packet we sent, if any */
+	janus_rtp_packet *packet;
+	/*! \brief Monotonic time of when we stored the packet */
+	gint64 created;
+	/*! \brief Sequence number of the packet */
+	guint16 seq;
+} janus_ice_nack_slot;
+/*! \brief Ring of previously sent packets, indexed by sequence number (seq & mask), in case we receive NACKs */
+typedef struct janus_ice_nack_ring {
+	/*! \brief Slots of the ring (the size is always a power of two) */
+	janus_ice_nack_slot *slots;
+	/*! \brief Size of the ring minus one, to get the slot for a sequence number */
+	guint mask;
+	/*! \brief Packets stored before this time are considered expired (e.g., after a keyframe) */
+	gint64 flushed;
+	/*! \brief When we last stored a packet in the ring */
+	gint64 last_stored;
+	/*! \brief Packets stored since we last evaluated the packet rate, and when that happened */
+	guint rate_count;
+	gint64 rate_ts;
+	/*! \brief Packet rate we observed, used to size the ring */
+	guint pps;
+} janus_ice_nack_ring;
+
 /*! \brief Janus ICE component */
 struct janus_ice_component {
 	/*! \brief Janus ICE stream this component belongs to */
@@ -473,6 +656,29 @@ struct janus_ice_component {
 	GSList *remote_candidates;
 	/*! \brief String representation of the selected pair as notified by libnice (foundations) */
 	gchar *selected_pair;
+	/*! \brief Socket of the selected pair, if we can use it for batched egress (UDP and not relayed) */
+	GSocket *egress_socket;
+	/*! \brief Address of the remote candidate in the selected pair, for batched egress */
+	struct sockaddr_storage egress_addr;
+	/*! \brief Size of the remote address in the selected pair */
+	socklen_t egress_addrlen;
+	/*! \brief Socket of the selected pair, if we took it over from libnice for batched ingress */
+	GSocket *ingress_socket;
+	/*! \brief Remote address of the selected pair, as we only accept media from there when reading the socket ourselves */
+	struct sockaddr_storage ingress_addr;
+	/*! \brief Source we read from that socket with */
+	GSource *ingress_source;
+	/*! \brief Batched ingress statistics (reads, datagrams, and largest batch) */
+	guint64 ingress_batches, ingress_packets;
+	guint ingress_max_batch;
+	/*! \brief Local ICE credentials, if media is multiplexed on a single port (libnice is bypassed) */
+	gchar *mux_ufrag, *mux_pwd;
+	/*! \brief Remote address the peer nominated, if media is multiplexed on a single port */
+	struct sockaddr_storage *mux_addr;
+	/*! \brief Monotonic time of the last connectivity check on the nominated address, for consent freshness */
+	gint64 mux_last_stun;
+	/*! \brief Pool of packet buffers to use for the NACK buffers */
+	janus_ice_pool *pool;
 	/*! \brief Whether the setup of remote candidates for this component has started or not */
 	gboolean process_started;
 	/*! \brief Timer to check when we should consider ICE as failed */
@@ -487,10 +693,8 @@ struct janus_ice_component {
 	gboolean do_audio_nacks;
 	/*! \brief Whether we should do NACKs (in or out) for video */
 	gboolean do_video_nacks;
-	/*! \brief List of previously sent janus_rtp_packet RTP packets, in case we receive NACKs */
-	GQueue *audio_retransmit_buffer, *video_retransmit_buffer;
-	/*! \brief HashTable of retransmittable sequence numbers, in case we receive NACKs */
-	GHashTable *audio_retransmit_seqs, *video_retransmit_seqs;
+	/*! \brief Rings of previously sent janus_rtp_packet RTP packets, in case we receive NACKs */
+	janus_ice_nack_ring audio_nack_ring, video_nack_ring;
 	/*! \brief Current sequence number for the RFC4588 rtx SSRC session */
 	guint16 rtx_seq_number;
 	/*! \brief Last time a log message about sending retransmits was printed */
@@ -501,10 +705,10 @@ struct janus_ice_component {
 	gint64 nack_sent_log_ts;
 	/*! \brief Number of NACKs sent since last log message */
 	guint nack_sent_recent_cnt;
-	/*! \brief List of recently received audio sequence numbers (as a support to NACK generation) */
-	janus_seq_info *last_seqs_audio;
-	/*! \brief List of recently received video sequence numbers (as a support to NACK generation, for each simulcast SSRC) */
-	janus_seq_info *last_seqs_video[3];
+	/*! \brief Window of recently received audio sequence numbers (as a support to NACK generation) */
+	janus_seq_window audio_seq_window;
+	/*! \brief Window of recently received video sequence numbers (as a support to NACK generation, for each simulcast SSRC) */
+	janus_seq_window video_seq_window[3];
 	/*! \brief Stats for incoming data (audio/video/data) */
 	janus_ice_stats in_stats;
 	/*! \brief Stats for outgoing data (audio/video/data) */
@@ -587,6 +791,10 @@ void janus_ice_component_destroy(janus_ice_component *component);
 /** @name Janus ICE media relaying callbacks
  */
 ///@{
+/*! \brief Method to (re)compile the RTP extensions we add to outgoing packets, and parse in incoming ones
+ * \note To be called, with the handle mutex held, whenever a negotiation changes the extension IDs or mids
+ * @param[in] stream The Janus ICE stream to compile the extensions for */
+void janus_ice_stream_compile_extensions(janus_ice_stream *stream);
 /*! \brief Core RTP callback, called when a plugin has an RTP packet to send to a peer
  * @param[in] handle The Janus ICE handle associated with the peer
  * @param[in] packet The RTP packet to send */
@@ -649,6 +857,22 @@ void janus_ice_setup_remote_candidates(janus_ice_handle *handle, guint stream_id
  * @param[in] handle The Janus ICE handle this callback refers to
  * @param[in] component The Janus ICE component that is now ready to be used */
 void janus_ice_dtls_handshake_done(janus_ice_handle *handle, janus_ice_component *component);
+/*! \brief Method to have the event loop of a handle take over its DTLS stack again, after a handshake worker is done with it
+ * @param[in] handle The Janus ICE handle this method refers to */
+void janus_ice_dtls_handshake_resume(janus_ice_handle *handle);
+/*! \brief Method to get the local ICE credentials of a handle, whether they come from libnice or not
+ * @param[in] handle The Janus ICE handle this method refers to
+ * @param[out] ufrag The local ICE ufrag (must be freed with g_free)
+ * @param[out] pwd The local ICE pwd (must be freed with g_free) */
+void janus_ice_get_local_credentials(janus_ice_handle *handle, gchar **ufrag, gchar **pwd);
+/*! \brief Method to send a packet on a component right away, bypassing the queue
+ * \note Uses the shared socket if media is multiplexed on a single port, libnice otherwise
+ * @param[in] handle The Janus ICE handle this method refers to
+ * @param[in] component The Janus ICE component to send the packet on
+ * @param[in] len The size of the packet
+ * @param[in] buf The packet to send
+ * @returns The number of bytes sent, or a negative integer in case of errors */
+int janus_ice_component_send_raw(janus_ice_handle *handle, janus_ice_component *component, int len, const gchar *buf);
 /*! \brief Method to restart ICE and the connectivity checks
  * @param[in] handle The Janus ICE handle this method refers to */
 void janus_ice_restart(janus_ice_handle *handle);
@@ -659,15 +883,64 @@ void janus_ice_resend_trickles(janus_ice_handle *handle);
 
 
 /*! \brief Method to configure the static event loops mechanism at startup
- * @note Check the \c event_loops property in the \c janus.jcfg configuration
+ * @note Check the \c event_loops, \c event_loops_placement and
+ * \c event_loops_affinity properties in the \c janus.jcfg configuration
  * for an explanation of this feature, and the possible impact on Janus and users
- * @param[in] loops The number of static event loops to start (0 to disable the feature) */
-void janus_ice_set_static_event_loops(int loops);
+ * @param[in] loops The number of static event loops to start (0 to disable the feature)
+ * @param[in] load_aware Whether new handles should be added to the least loaded loop, rather than round robin
+ * @param[in] affinity CPUs to pin the loops to, if any: either "auto", or a list of CPUs and ranges (e.g., "0-3,8") */
+void janus_ice_set_static_event_loops(int loops, gboolean load_aware, const char *affinity);
 /*! \brief Method to return the number of static event loops, if enabled
  * @returns The number of static event loops, if configured, or 0 if the feature is disabled */
 int janus_ice_get_static_event_loops(void);
 /*! \brief Method to stop all the static event loops, if enabled
  * @note This will wait for the related threads to exit, and so may delay the shutdown process */
 void janus_ice_stop_static_event_loops(void);
+/*! \brief Method to return a summary of the static event loops, if enabled
+ * @note This includes the batched egress statistics of each loop, if available,
+ * and the usage of its packet pool
+ * @returns A JSON array with info on each loop (empty if the feature is disabled) */
+json_t *janus_ice_static_event_loops_info(void);
+/*! \brief Method to return the batched egress statistics of the loop a handle is in
+ * @param[in] handle The Janus ICE handle to query
+ * @returns A JSON object with the statistics, or NULL if batched egress is disabled */
+json_t *janus_ice_handle_egress_summary(janus_ice_handle *handle);
+/*! \brief Method to schedule a short-lived timer for a handle, using the timer wheel of its event loop
+ * @note Timers have a 10ms granularity, and can't be longer than a couple of minutes.
+ * The callback is invoked in the thread of the event loop, without any lock held, so
+ * it can schedule other timers itself. Pending timers are cancelled when the PeerConnection goes away.
+ * @param[in] handle The Janus ICE handle to schedule the timer for
+ * @param[in] ms How many milliseconds from now the timer should fire
+ * @param[in] callback The callback to invoke when the timer fires
+ * @param[in] data Opaque data to pass to the callback
+ * @param[in] destroy Function to free the data when the timer fires or is cancelled, if needed
+ * @returns 0 in case of success, a negative integer otherwise */
+int janus_ice_handle_add_timer(janus_ice_handle *handle, guint ms,
+	janus_ice_timer_callback callback, gpointer data, GDestroyNotify destroy);
+/*! \brief Method to return the usage and high-water marks of the packet pool a handle uses
+ * @param[in] handle The Janus ICE handle to query
+ * @returns A JSON object with the statistics, or NULL if the handle has no pool */
+json_t *janus_ice_handle_pool_summary(janus_ice_handle *handle);
+/*! \brief Method to return the state and queue delay histogram of the pacer of a handle
+ * @param[in] handle The Janus ICE handle to query
+ * @returns A JSON object with the statistics, or NULL if the handle has no pacer */
+json_t *janus_ice_handle_pacer_summary(janus_ice_handle *handle);
+/*! \brief Method to return how many packets of a handle crypto workers protected, and in how many batches
+ * @param[in] handle The Janus ICE handle to query
+ * @returns A JSON object with the statistics, or NULL if crypto workers never protected packets for this handle */
+json_t *janus_ice_handle_crypto_summary(janus_ice_handle *handle);
+/*! \brief Method to return the static event loop a handle is in
+ * @param[in] handle The Janus ICE handle to query
+ * @returns The ID of the loop, or -1 if static event loops are disabled */
+int janus_ice_handle_get_loop(janus_ice_handle *handle);
+/*! \brief Method to move a handle to a different static event loop
+ * @note The migration is asynchronous, as it's performed by the loop the handle
+ * is currently in, in order not to disrupt the media: the libnice agent keeps
+ * running its connectivity checks and keepalives in the original loop, though
+ * @param[in] handle The Janus ICE handle to move
+ * @param[in] loop_id The ID of the static event loop to move the handle to
+ * @returns 0 in case of success, -1 if static event loops are disabled, -2 if the
+ * loop doesn't exist, and -3 if the handle is already being moved */
+int janus_ice_handle_migrate(janus_ice_handle *handle, int loop_id);
 
 #endif
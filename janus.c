@@ -147,6 +147,10 @@ static struct janus_json_parameter queryhandler_parameters[] = {
 	{"handler", JSON_STRING, JANUS_JSON_PARAM_REQUIRED},
 	{"request", JSON_OBJECT, 0}
 };
+static struct janus_json_parameter querytransport_parameters[] = {
+	{"transport", JSON_STRING, JANUS_JSON_PARAM_REQUIRED},
+	{"request", JSON_OBJECT, 0}
+};
 static struct janus_json_parameter querylogger_parameters[] = {
 	{"handler", JSON_STRING, JANUS_JSON_PARAM_REQUIRED},
 	{"request", JSON_OBJECT, 0}
@@ -168,6 +172,9 @@ static struct janus_json_parameter text2pcap_parameters[] = {
 	{"filename", JSON_STRING, 0},
 	{"truncate", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE}
 };
+static struct janus_json_parameter migrate_parameters[] = {
+	{"loop", JSON_INTEGER, JANUS_JSON_PARAM_REQUIRED | JANUS_JSON_PARAM_POSITIVE}
+};
 static struct janus_json_parameter handleinfo_parameters[] = {
 	{"plugin_only", JANUS_JSON_BOOL, 0}
 };
@@ -265,6 +272,24 @@ gboolean janus_is_webrtc_encryption_enabled(void) {
 	return webrtc_encryption;
 }
 
+/* Incoming requests are handled by one or more dispatcher threads (see the
+ * request_dispatchers property): requests for the same session always go to
+ * the same dispatcher, so that they're processed in order, while requests for
+ * different sessions can be processed in parallel by different dispatchers.
+ * Plugin messages are still handed to the tasks thread pool, as before */
+typedef struct janus_request_dispatcher {
+	guint id;
+	GAsyncQueue *queue;
+	GThread *thread;
+	/* Statistics (only updated by the dispatcher thread) */
+	guint64 processed;
+	gint64 wait_total, wait_max;
+} janus_request_dispatcher;
+static janus_request_dispatcher *dispatchers = NULL;
+static guint dispatchers_count = 1;
+static volatile gint dispatchers_next = 0;
+static json_t *janus_request_dispatchers_info(void);
+
 /* Information */
 static json_t *janus_info(const char *transaction) {
 	/* Prepare a summary on the Janus instance */
@@ -309,6 +334,21 @@ static json_t *janus_info(const char *transaction) {
 		json_object_set_new(info, "turn-server", json_string(server));
 	}
 	json_object_set_new(info, "static-event-loops", json_integer(janus_ice_get_static_event_loops()));
+	json_object_set_new(info, "egress-batching", janus_ice_is_egress_batching_enabled() ? json_true() : json_false());
+	json_object_set_new(info, "ingress-batching", janus_ice_is_ingress_batching_enabled() ? json_true() : json_false());
+	if(janus_ice_is_pacing_enabled()) {
+		json_t *pacing = json_object();
+		json_object_set_new(pacing, "multiplier", json_real(janus_ice_get_pacing_multiplier()));
+		json_object_set_new(pacing, "max-queue", json_integer(janus_ice_get_pacing_max_queue()));
+		json_object_set_new(info, "pacing", pacing);
+	} else {
+		json_object_set_new(info, "pacing", json_false());
+	}
+	json_object_set_new(info, "request-dispatchers", json_integer(dispatchers_count));
+	json_object_set_new(info, "srtp-workers", json_integer(janus_ice_get_srtp_workers()));
+	json_object_set_new(info, "dtls-key", json_string(janus_dtls_get_key_type()));
+	json_object_set_new(info, "dtls-workers", json_integer(janus_dtls_get_handshake_workers()));
+	json_object_set_new(info, "mux-port", json_integer(janus_ice_get_mux_port()));
 	json_object_set_new(info, "api_secret", api_secret ? json_true() : json_false());
 	json_object_set_new(info, "auth_token", janus_auth_is_enabled() ? json_true() : json_false());
 	json_object_set_new(info, "event_handlers", janus_events_is_enabled() ? json_true() : json_false());
@@ -506,7 +546,6 @@ static janus_transport_callbacks janus_handler_transport =
 		.events_is_enabled = janus_events_is_enabled,
 		.notify_event = janus_transport_notify_event,
 	};
-static GAsyncQueue *requests = NULL;
 static janus_request exit_message;
 static GThreadPool *tasks = NULL;
 void janus_transport_task(gpointer data, gpointer user_data);
@@ -520,6 +559,7 @@ void janus_transport_task(gpointer data, gpointer user_data);
  */
 ///@{
 int janus_plugin_push_event(janus_plugin_session *plugin_session, janus_plugin *plugin, const char *transaction, json_t *message, json_t *jsep);
+int janus_plugin_push_event_text(janus_plugin_session *plugin_session, janus_plugin *plugin, const char *transaction, janus_json_text *message);
 json_t *janus_plugin_handle_sdp(janus_plugin_session *plugin_session, janus_plugin *plugin, const char *sdp_type, const char *sdp, gboolean restart);
 void janus_plugin_relay_rtp(janus_plugin_session *plugin_session, janus_plugin_rtp *packet);
 void janus_plugin_relay_rtcp(janus_plugin_session *plugin_session, janus_plugin_rtcp *packet);
@@ -534,6 +574,7 @@ gboolean janus_plugin_auth_signature_contains(janus_plugin *plugin, const char *
 static janus_callbacks janus_handler_plugin =
 	{
 		.push_event = janus_plugin_push_event,
+		.push_event_text = janus_plugin_push_event_text,
 		.relay_rtp = janus_plugin_relay_rtp,
 		.relay_rtcp = janus_plugin_relay_rtcp,
 		.relay_data = janus_plugin_relay_data,
@@ -549,11 +590,162 @@ static janus_callbacks janus_handler_plugin =
 ///@}
 
 
-/* Core Sessions */
-static janus_mutex sessions_mutex;
-static GHashTable *sessions = NULL;
+/* Core Sessions: rather than having all lookups (e.g., keepalives), creations
+ * and removals serialize on a single lock, sessions are spread across a few
+ * shards, each with its own table and read/write lock. Lookups only need the
+ * read lock of a shard, and so can happen in parallel, while we keep track of
+ * how often a shard was found locked, to check whether that's still a problem */
+#define JANUS_SESSIONS_SHARDS	32
+typedef struct janus_sessions_shard {
+	/* Sessions in this shard, indexed by ID */
+	GHashTable *table;
+	GRWLock lock;
+	/* Lookups and updates, and how many of them had to wait for the lock */
+	volatile gsize lookups, lookups_contended, updates, updates_contended;
+} janus_sessions_shard;
+static janus_sessions_shard sessions[JANUS_SESSIONS_SHARDS];
 static GMainContext *sessions_watchdog_context = NULL;
 
+static janus_sessions_shard *janus_sessions_shard_get(guint64 session_id) {
+	/* Session IDs are usually random, but they may be picked by users too */
+	return &sessions[(session_id ^ (session_id >> 32)) % JANUS_SESSIONS_SHARDS];
+}
+static void janus_sessions_shard_lookup_lock(janus_sessions_shard *shard) {
+	g_atomic_pointer_add(&shard->lookups, 1);
+	if(!g_rw_lock_reader_trylock(&shard->lock)) {
+		g_atomic_pointer_add(&shard->lookups_contended, 1);
+		g_rw_lock_reader_lock(&shard->lock);
+	}
+}
+static void janus_sessions_shard_update_lock(janus_sessions_shard *shard) {
+	g_atomic_pointer_add(&shard->updates, 1);
+	if(!g_rw_lock_writer_trylock(&shard->lock)) {
+		g_atomic_pointer_add(&shard->updates_contended, 1);
+		g_rw_lock_writer_lock(&shard->lock);
+	}
+}
+static void janus_sessions_remove(janus_session *session) {
+	janus_sessions_shard *shard = janus_sessions_shard_get(session->session_id);
+	janus_sessions_shard_update_lock(shard);
+	g_hash_table_remove(shard->table, &session->session_id);
+	g_rw_lock_writer_unlock(&shard->lock);
+}
+/* Sessions expiry: rather than checking all sessions at each tick of the
+ * watchdog, sessions are bucketed in a hashed timer wheel according to when
+ * they'd expire, so that each tick only looks at the sessions in the slots
+ * that are due. As requests and keepalives only update last_activity, the
+ * wheel is updated lazily: when its slot comes, a session that turns out to
+ * be still active is just moved to the slot of its new expiry time */
+#define JANUS_SESSIONS_WHEEL_TICK	2	/* seconds, same as the watchdog */
+#define JANUS_SESSIONS_WHEEL_SLOTS	64
+static janus_session *sessions_wheel[JANUS_SESSIONS_WHEEL_SLOTS];
+static guint64 sessions_wheel_current = 0;
+static gint64 sessions_wheel_start = 0;
+static guint64 sessions_wheel_visited = 0, sessions_wheel_rescheduled = 0, sessions_wheel_expired = 0;
+static janus_mutex sessions_wheel_mutex = JANUS_MUTEX_INITIALIZER;
+
+/* When a session would expire, according to its last activity and to whether its transport is gone */
+static gint64 janus_session_deadline(janus_session *session) {
+	gint64 deadline = session->last_activity + (gint64)session_timeout * G_USEC_PER_SEC;
+	if(g_atomic_int_get(&session->transport_gone)) {
+		gint64 reclaim = session->last_activity + (gint64)reclaim_session_timeout * G_USEC_PER_SEC;
+		if(reclaim < deadline)
+			deadline = reclaim;
+	}
+	return deadline;
+}
+/* Put a session in the slot it's due in, or unlink it (called with the lock) */
+static void janus_sessions_wheel_link(janus_session *session) {
+	gint64 tick_us = (gint64)JANUS_SESSIONS_WHEEL_TICK * G_USEC_PER_SEC;
+	gint64 deadline = janus_session_deadline(session);
+	guint64 tick = 0;
+	if(deadline > sessions_wheel_start)
+		tick = (deadline - sessions_wheel_start + tick_us - 1) / tick_us;
+	if(tick <= sessions_wheel_current)
+		tick = sessions_wheel_current + 1;
+	session->wheel_slot = tick % JANUS_SESSIONS_WHEEL_SLOTS;
+	session->wheel_prev = NULL;
+	session->wheel_next = sessions_wheel[session->wheel_slot];
+	if(session->wheel_next != NULL)
+		session->wheel_next->wheel_prev = session;
+	sessions_wheel[session->wheel_slot] = session;
+}
+static void janus_sessions_wheel_unlink(janus_session *session) {
+	if(session->wheel_slot < 0)
+		return;
+	if(session->wheel_prev != NULL)
+		session->wheel_prev->wheel_next = session->wheel_next;
+	else
+		sessions_wheel[session->wheel_slot] = session->wheel_next;
+	if(session->wheel_next != NULL)
+		session->wheel_next->wheel_prev = session->wheel_prev;
+	session->wheel_prev = session->wheel_next = NULL;
+	session->wheel_slot = -1;
+}
+/* (Re)schedule the expiry of a session, e.g., because it's new or its transport is gone */
+static void janus_sessions_wheel_schedule(janus_session *session) {
+	janus_mutex_lock(&sessions_wheel_mutex);
+	if(!g_atomic_int_get(&session->destroyed)) {
+		janus_sessions_wheel_unlink(session);
+		janus_sessions_wheel_link(session);
+	}
+	janus_mutex_unlock(&sessions_wheel_mutex);
+}
+/* Reschedule all sessions, e.g., because the session timeout changed */
+static void janus_sessions_wheel_reschedule_all(void) {
+	int i = 0;
+	for(i=0; i<JANUS_SESSIONS_SHARDS; i++) {
+		janus_sessions_shard *shard = &sessions[i];
+		janus_sessions_shard_lookup_lock(shard);
+		GHashTableIter iter;
+		gpointer value;
+		g_hash_table_iter_init(&iter, shard->table);
+		while(g_hash_table_iter_next(&iter, NULL, &value))
+			janus_sessions_wheel_schedule((janus_session *)value);
+		g_rw_lock_reader_unlock(&shard->lock);
+	}
+}
+
+static json_t *janus_sessions_info(void) {
+	json_t *info = json_object();
+	json_t *list = json_array();
+	guint64 total = 0, lookups = 0, lookups_contended = 0, updates = 0, updates_contended = 0;
+	int i = 0;
+	for(i=0; i<JANUS_SESSIONS_SHARDS; i++) {
+		janus_sessions_shard *shard = &sessions[i];
+		janus_sessions_shard_lookup_lock(shard);
+		guint count = shard->table ? g_hash_table_size(shard->table) : 0;
+		g_rw_lock_reader_unlock(&shard->lock);
+		json_t *s = json_object();
+		json_object_set_new(s, "sessions", json_integer(count));
+		json_object_set_new(s, "lookups", json_integer((gsize)g_atomic_pointer_get(&shard->lookups)));
+		json_object_set_new(s, "lookups-contended", json_integer((gsize)g_atomic_pointer_get(&shard->lookups_contended)));
+		json_object_set_new(s, "updates", json_integer((gsize)g_atomic_pointer_get(&shard->updates)));
+		json_object_set_new(s, "updates-contended", json_integer((gsize)g_atomic_pointer_get(&shard->updates_contended)));
+		json_array_append_new(list, s);
+		total += count;
+		lookups += (gsize)g_atomic_pointer_get(&shard->lookups);
+		lookups_contended += (gsize)g_atomic_pointer_get(&shard->lookups_contended);
+		updates += (gsize)g_atomic_pointer_get(&shard->updates);
+		updates_contended += (gsize)g_atomic_pointer_get(&shard->updates_contended);
+	}
+	json_object_set_new(info, "sessions", json_integer(total));
+	json_object_set_new(info, "lookups", json_integer(lookups));
+	json_object_set_new(info, "lookups-contended", json_integer(lookups_contended));
+	json_object_set_new(info, "updates", json_integer(updates));
+	json_object_set_new(info, "updates-contended", json_integer(updates_contended));
+	json_object_set_new(info, "shards", list);
+	json_t *expiry = json_object();
+	janus_mutex_lock(&sessions_wheel_mutex);
+	json_object_set_new(expiry, "tick", json_integer(sessions_wheel_current));
+	json_object_set_new(expiry, "visited", json_integer(sessions_wheel_visited));
+	json_object_set_new(expiry, "rescheduled", json_integer(sessions_wheel_rescheduled));
+	json_object_set_new(expiry, "expired", json_integer(sessions_wheel_expired));
+	janus_mutex_unlock(&sessions_wheel_mutex);
+	json_object_set_new(info, "expiry", expiry);
+	return info;
+}
+
 
 static void janus_ice_handle_dereference(janus_ice_handle *handle) {
 	if(handle)
@@ -577,44 +769,71 @@ static void janus_session_free(const janus_refcount *session_ref) {
 static gboolean janus_check_sessions(gpointer user_data) {
 	if(session_timeout < 1)		/* Session timeouts are disabled */
 		return G_SOURCE_CONTINUE;
-	janus_mutex_lock(&sessions_mutex);
-	if(sessions && g_hash_table_size(sessions) > 0) {
-		GHashTableIter iter;
-		gpointer value;
-		g_hash_table_iter_init(&iter, sessions);
-		while (g_hash_table_iter_next(&iter, NULL, &value)) {
-			janus_session *session = (janus_session *) value;
-			if (!session || g_atomic_int_get(&session->destroyed)) {
-				continue;
-			}
-			gint64 now = janus_get_monotonic_time();
-			if ((now - session->last_activity >= (gint64)session_timeout * G_USEC_PER_SEC &&
-					!g_atomic_int_compare_and_exchange(&session->timeout, 0, 1)) ||
-					((g_atomic_int_get(&session->transport_gone) && now - session->last_activity >= (gint64)reclaim_session_timeout * G_USEC_PER_SEC) &&
-							!g_atomic_int_compare_and_exchange(&session->timeout, 0, 1))) {
-				JANUS_LOG(LOG_INFO, "Timeout expired for session %"SCNu64"...\n", session->session_id);
-				/* Mark the session as over, we'll deal with it later */
-				janus_session_handles_clear(session);
-				/* Notify the transport */
-				if(session->source) {
-					json_t *event = janus_create_message("timeout", session->session_id, NULL);
-					/* Send this to the transport client and notify the session's over */
-					session->source->transport->send_message(session->source->instance, NULL, FALSE, event);
-					session->source->transport->session_over(session->source->instance, session->session_id, TRUE, FALSE);
-				}
-				/* Notify event handlers as well */
-				if(janus_events_is_enabled())
-					janus_events_notify_handlers(JANUS_EVENT_TYPE_SESSION, JANUS_EVENT_SUBTYPE_NONE,
-						session->session_id, "timeout", NULL);
-
-				/* FIXME Is this safe? apparently it causes hash table errors on the console */
-				g_hash_table_iter_remove(&iter);
-
-				janus_session_destroy(session);
-			}
+	/* Take all the sessions in the slots that are due (at most a whole round) */
+	gint64 now = janus_get_monotonic_time();
+	guint64 now_tick = (now - sessions_wheel_start) / ((gint64)JANUS_SESSIONS_WHEEL_TICK * G_USEC_PER_SEC);
+	GSList *due = NULL;
+	int slots = 0;
+	janus_mutex_lock(&sessions_wheel_mutex);
+	while(sessions_wheel_current < now_tick) {
+		sessions_wheel_current++;
+		if(slots == JANUS_SESSIONS_WHEEL_SLOTS)
+			continue;
+		slots++;
+		janus_session *session = sessions_wheel[sessions_wheel_current % JANUS_SESSIONS_WHEEL_SLOTS];
+		while(session != NULL) {
+			janus_session *next = session->wheel_next;
+			janus_sessions_wheel_unlink(session);
+			janus_refcount_increase(&session->ref);
+			due = g_slist_prepend(due, session);
+			sessions_wheel_visited++;
+			session = next;
+		}
+	}
+	janus_mutex_unlock(&sessions_wheel_mutex);
+	GSList *l = due;
+	while(l) {
+		janus_session *session = (janus_session *)l->data;
+		l = l->next;
+		if(g_atomic_int_get(&session->destroyed)) {
+			janus_refcount_decrease(&session->ref);
+			continue;
+		}
+		/* As before, a session that's due is first marked as timed out, and
+		 * then actually gotten rid of at the next tick, if nothing changed */
+		if(janus_session_deadline(session) > now || g_atomic_int_compare_and_exchange(&session->timeout, 0, 1)) {
+			/* Move it to the slot it's due in now, unless someone did that already */
+			janus_mutex_lock(&sessions_wheel_mutex);
+			if(!g_atomic_int_get(&session->destroyed) && session->wheel_slot < 0) {
+				janus_sessions_wheel_link(session);
+				sessions_wheel_rescheduled++;
+			}
+			janus_mutex_unlock(&sessions_wheel_mutex);
+			janus_refcount_decrease(&session->ref);
+			continue;
 		}
+		JANUS_LOG(LOG_INFO, "Timeout expired for session %"SCNu64"...\n", session->session_id);
+		/* Mark the session as over, we'll deal with it later */
+		janus_session_handles_clear(session);
+		/* Notify the transport */
+		if(session->source) {
+			json_t *event = janus_create_message("timeout", session->session_id, NULL);
+			/* Send this to the transport client and notify the session's over */
+			session->source->transport->send_message(session->source->instance, NULL, FALSE, event);
+			session->source->transport->session_over(session->source->instance, session->session_id, TRUE, FALSE);
+		}
+		/* Notify event handlers as well */
+		if(janus_events_is_enabled())
+			janus_events_notify_handlers(JANUS_EVENT_TYPE_SESSION, JANUS_EVENT_SUBTYPE_NONE,
+				session->session_id, "timeout", NULL);
+		janus_sessions_remove(session);
+		janus_session_destroy(session);
+		janus_mutex_lock(&sessions_wheel_mutex);
+		sessions_wheel_expired++;
+		janus_mutex_unlock(&sessions_wheel_mutex);
+		janus_refcount_decrease(&session->ref);
 	}
-	janus_mutex_unlock(&sessions_mutex);
+	g_slist_free(due);
 
 	return G_SOURCE_CONTINUE;
 }
@@ -640,44 +859,57 @@ static gpointer janus_sessions_watchdog(gpointer user_data) {
 
 
 janus_session *janus_session_create(guint64 session_id) {
-	janus_session *session = NULL;
-	if(session_id == 0) {
-		while(session_id == 0) {
-			session_id = janus_random_uint64();
-			session = janus_session_find(session_id);
-			if(session != NULL) {
-				/* Session ID already taken, try another one */
-				janus_refcount_decrease(&session->ref);
-				session_id = 0;
-			}
-		}
-	}
-	session = (janus_session *)g_malloc(sizeof(janus_session));
-	JANUS_LOG(LOG_INFO, "Creating new session: %"SCNu64"; %p\n", session_id, session);
-	session->session_id = session_id;
-	janus_refcount_init(&session->ref, janus_session_free);
+	gboolean random_id = (session_id == 0);
+	janus_session *session = (janus_session *)g_malloc(sizeof(janus_session));
 	session->source = NULL;
 	g_atomic_int_set(&session->destroyed, 0);
 	g_atomic_int_set(&session->timeout, 0);
 	g_atomic_int_set(&session->transport_gone, 0);
 	session->last_activity = janus_get_monotonic_time();
 	session->ice_handles = NULL;
+	session->wheel_slot = -1;
+	session->wheel_prev = session->wheel_next = NULL;
 	janus_mutex_init(&session->mutex);
-	janus_mutex_lock(&sessions_mutex);
-	g_hash_table_insert(sessions, janus_uint64_dup(session->session_id), session);
-	janus_mutex_unlock(&sessions_mutex);
+	/* Requests may be handled by different dispatchers at the same time, so we
+	 * check whether the ID is taken and insert the session with the same lock */
+	janus_sessions_shard *shard = NULL;
+	while(TRUE) {
+		while(random_id && session_id == 0)
+			session_id = janus_random_uint64();
+		shard = janus_sessions_shard_get(session_id);
+		janus_sessions_shard_update_lock(shard);
+		if(!g_hash_table_contains(shard->table, &session_id))
+			break;
+		g_rw_lock_writer_unlock(&shard->lock);
+		if(!random_id) {
+			/* The ID the application asked for is already in use */
+			JANUS_LOG(LOG_WARN, "Session ID %"SCNu64" already in use\n", session_id);
+			janus_mutex_destroy(&session->mutex);
+			g_free(session);
+			return NULL;
+		}
+		/* Session ID already taken, try another one */
+		session_id = 0;
+	}
+	JANUS_LOG(LOG_INFO, "Creating new session: %"SCNu64"; %p\n", session_id, session);
+	session->session_id = session_id;
+	janus_refcount_init(&session->ref, janus_session_free);
+	g_hash_table_insert(shard->table, janus_uint64_dup(session->session_id), session);
+	g_rw_lock_writer_unlock(&shard->lock);
+	janus_sessions_wheel_schedule(session);
 	return session;
 }
 
 janus_session *janus_session_find(guint64 session_id) {
-	janus_mutex_lock(&sessions_mutex);
-	janus_session *session = g_hash_table_lookup(sessions, &session_id);
+	janus_sessions_shard *shard = janus_sessions_shard_get(session_id);
+	janus_sessions_shard_lookup_lock(shard);
+	janus_session *session = g_hash_table_lookup(shard->table, &session_id);
 	if(session != NULL) {
 		/* A successful find automatically increases the reference counter:
 		 * it's up to the caller to decrease it again when done */
 		janus_refcount_increase(&session->ref);
 	}
-	janus_mutex_unlock(&sessions_mutex);
+	g_rw_lock_reader_unlock(&shard->lock);
 	return session;
 }
 
@@ -699,6 +931,10 @@ gint janus_session_destroy(janus_session *session) {
 	JANUS_LOG(LOG_INFO, "Destroying session %"SCNu64"; %p\n", session_id, session);
 	if(!g_atomic_int_compare_and_exchange(&session->destroyed, 0, 1))
 		return 0;
+	/* Nothing to expire anymore */
+	janus_mutex_lock(&sessions_wheel_mutex);
+	janus_sessions_wheel_unlink(session);
+	janus_mutex_unlock(&sessions_wheel_mutex);
 	janus_session_handles_clear(session);
 	/* The session will actually be destroyed when the counter gets to 0 */
 	janus_refcount_decrease(&session->ref);
@@ -782,6 +1018,7 @@ janus_request *janus_request_new(janus_transport *transport, janus_transport_ses
 	request->request_id = request_id;
 	request->admin = admin;
 	request->message = message;
+	request->received = janus_get_monotonic_time();
 	return request;
 }
 
@@ -961,10 +1198,13 @@ int janus_process_incoming_request(janus_request *request) {
 				goto jsondone;
 			}
 		}
-		/* Handle it */
+		/* Handle it: if another request took the same ID in the meanwhile, this fails */
 		session = janus_session_create(session_id);
 		if(session == NULL) {
-			ret = janus_process_error(request, session_id, transaction_text, JANUS_ERROR_UNKNOWN, "Memory error");
+			if(session_id > 0)
+				ret = janus_process_error(request, session_id, transaction_text, JANUS_ERROR_SESSION_CONFLICT, "Session ID already in use");
+			else
+				ret = janus_process_error(request, session_id, transaction_text, JANUS_ERROR_UNKNOWN, "Memory error");
 			goto jsondone;
 		}
 		session_id = session->session_id;
@@ -1104,9 +1344,7 @@ int janus_process_incoming_request(janus_request *request) {
 			ret = janus_process_error(request, session_id, transaction_text, JANUS_ERROR_INVALID_REQUEST_PATH, "Unhandled request '%s' at this path", message_text);
 			goto jsondone;
 		}
-		janus_mutex_lock(&sessions_mutex);
-		g_hash_table_remove(sessions, &session->session_id);
-		janus_mutex_unlock(&sessions_mutex);
+		janus_sessions_remove(session);
 		/* Notify the source that the session has been destroyed */
 		if(session->source && session->source->transport) {
 			session->source->transport->session_over(session->source->instance, session->session_id, FALSE, FALSE);
@@ -1406,6 +1644,8 @@ int janus_process_incoming_request(janus_request *request) {
 				}
 #endif
 			}
+			/* The negotiated extensions may have changed: recompile the ones we add to outgoing packets */
+			janus_ice_stream_compile_extensions(handle->stream);
 			char *tmp = handle->remote_sdp;
 			handle->remote_sdp = g_strdup(jsep_sdp);
 			g_free(tmp);
@@ -1853,6 +2093,8 @@ int janus_process_incoming_admin_request(janus_request *request) {
 				goto jsondone;
 			}
 			session_timeout = timeout_num;
+			/* Sessions were put in the expiry wheel according to the previous timeout */
+			janus_sessions_wheel_reschedule_all();
 			/* Prepare JSON reply */
 			json_t *reply = json_object();
 			json_object_set_new(reply, "janus", json_string("success"));
@@ -2121,6 +2363,40 @@ int janus_process_incoming_admin_request(janus_request *request) {
 			/* Send the success reply */
 			ret = janus_process_success(request, reply);
 			goto jsondone;
+		} else if(!strcasecmp(message_text, "query_transport")) {
+			/* Contact a transport and expect a response */
+			JANUS_VALIDATE_JSON_OBJECT(root, querytransport_parameters,
+				error_code, error_cause, FALSE,
+				JANUS_ERROR_MISSING_MANDATORY_ELEMENT, JANUS_ERROR_INVALID_ELEMENT_TYPE);
+			if(error_code != 0) {
+				ret = janus_process_error_string(request, session_id, transaction_text, error_code, error_cause);
+				goto jsondone;
+			}
+			json_t *transport = json_object_get(root, "transport");
+			const char *transport_value = json_string_value(transport);
+			janus_transport *t = g_hash_table_lookup(transports, transport_value);
+			if(t == NULL) {
+				/* No such transport... */
+				g_snprintf(error_cause, sizeof(error_cause), "%s", "Invalid transport");
+				ret = janus_process_error_string(request, session_id, transaction_text, JANUS_ERROR_PLUGIN_NOT_FOUND, error_cause);
+				goto jsondone;
+			}
+			if(t->query_transport == NULL) {
+				/* Transport doesn't implement the hook... */
+				g_snprintf(error_cause, sizeof(error_cause), "%s", "Transport doesn't support queries");
+				ret = janus_process_error_string(request, session_id, transaction_text, JANUS_ERROR_UNKNOWN, error_cause);
+				goto jsondone;
+			}
+			json_t *query = json_object_get(root, "request");
+			json_t *response = t->query_transport(query);
+			/* Prepare JSON reply */
+			json_t *reply = json_object();
+			json_object_set_new(reply, "janus", json_string("success"));
+			json_object_set_new(reply, "transaction", json_string(transaction_text));
+			json_object_set_new(reply, "response", response ? response : json_object());
+			/* Send the success reply */
+			ret = janus_process_success(request, reply);
+			goto jsondone;
 		} else if(!strcasecmp(message_text, "query_logger")) {
 			/* Contact a logger and expect a response */
 			JANUS_VALIDATE_JSON_OBJECT(root, querylogger_parameters,
@@ -2210,11 +2486,13 @@ int janus_process_incoming_admin_request(janus_request *request) {
 			/* List sessions */
 			session_id = 0;
 			json_t *list = json_array();
-			if(sessions != NULL && g_hash_table_size(sessions) > 0) {
-				janus_mutex_lock(&sessions_mutex);
+			int i = 0;
+			for(i=0; i<JANUS_SESSIONS_SHARDS; i++) {
+				janus_sessions_shard *shard = &sessions[i];
+				janus_sessions_shard_lookup_lock(shard);
 				GHashTableIter iter;
 				gpointer value;
-				g_hash_table_iter_init(&iter, sessions);
+				g_hash_table_iter_init(&iter, shard->table);
 				while (g_hash_table_iter_next(&iter, NULL, &value)) {
 					janus_session *session = value;
 					if(session == NULL) {
@@ -2222,7 +2500,7 @@ int janus_process_incoming_admin_request(janus_request *request) {
 					}
 					json_array_append_new(list, json_integer(session->session_id));
 				}
-				janus_mutex_unlock(&sessions_mutex);
+				g_rw_lock_reader_unlock(&shard->lock);
 			}
 			/* Prepare JSON reply */
 			json_t *reply = janus_create_message("success", 0, transaction_text);
@@ -2337,6 +2615,27 @@ int janus_process_incoming_admin_request(janus_request *request) {
 			/* Send the success reply */
 			ret = janus_process_success(request, reply);
 			goto jsondone;
+		} else if(!strcasecmp(message_text, "sessions_info")) {
+			/* Return some info on the sessions registry, e.g., to check whether its locks are contended */
+			json_t *reply = janus_create_message("success", 0, transaction_text);
+			json_object_set_new(reply, "info", janus_sessions_info());
+			/* Send the success reply */
+			ret = janus_process_success(request, reply);
+			goto jsondone;
+		} else if(!strcasecmp(message_text, "dispatchers_info")) {
+			/* Return some info on the request dispatchers, e.g., how long requests wait in their queue */
+			json_t *reply = janus_create_message("success", 0, transaction_text);
+			json_object_set_new(reply, "dispatchers", janus_request_dispatchers_info());
+			/* Send the success reply */
+			ret = janus_process_success(request, reply);
+			goto jsondone;
+		} else if(!strcasecmp(message_text, "loops_info")) {
+			/* Return some info on the static event loops, if any */
+			json_t *reply = janus_create_message("success", 0, transaction_text);
+			json_object_set_new(reply, "loops", janus_ice_static_event_loops_info());
+			/* Send the success reply */
+			ret = janus_process_success(request, reply);
+			goto jsondone;
 		} else if(!strcasecmp(message_text, "test_stun")) {
 			/* Helper method to evaluate whether this instance can use STUN with a specific server */
 			JANUS_VALIDATE_JSON_OBJECT(root, teststun_parameters,
@@ -2436,9 +2735,7 @@ int janus_process_incoming_admin_request(janus_request *request) {
 	if(handle == NULL) {
 		/* Session-related */
 		if(!strcasecmp(message_text, "destroy_session")) {
-			janus_mutex_lock(&sessions_mutex);
-			g_hash_table_remove(sessions, &session->session_id);
-			janus_mutex_unlock(&sessions_mutex);
+			janus_sessions_remove(session);
 			/* Notify the source that the session has been destroyed */
 			if(session->source && session->source->transport) {
 				session->source->transport->session_over(session->source->instance, session->session_id, FALSE, FALSE);
@@ -2488,6 +2785,34 @@ int janus_process_incoming_admin_request(janus_request *request) {
 			/* Send the success reply */
 			ret = janus_process_success(request, reply);
 			goto jsondone;
+		} else if(!strcasecmp(message_text, "migrate_handle")) {
+			/* Move the handle to a different static event loop */
+			JANUS_VALIDATE_JSON_OBJECT(root, migrate_parameters,
+				error_code, error_cause, FALSE,
+				JANUS_ERROR_MISSING_MANDATORY_ELEMENT, JANUS_ERROR_INVALID_ELEMENT_TYPE);
+			if(error_code != 0) {
+				ret = janus_process_error_string(request, session_id, transaction_text, error_code, error_cause);
+				goto jsondone;
+			}
+			if(janus_ice_get_static_event_loops() < 1) {
+				ret = janus_process_error(request, session_id, transaction_text, JANUS_ERROR_UNKNOWN, "Static event loops are disabled");
+				goto jsondone;
+			}
+			int loop = json_integer_value(json_object_get(root, "loop"));
+			int error = janus_ice_handle_migrate(handle, loop);
+			if(error == -2) {
+				ret = janus_process_error(request, session_id, transaction_text, JANUS_ERROR_INVALID_ELEMENT_TYPE, "No such loop %d", loop);
+				goto jsondone;
+			} else if(error < 0) {
+				ret = janus_process_error(request, session_id, transaction_text, JANUS_ERROR_UNKNOWN,
+					error == -3 ? "Handle is already being migrated" : "Couldn't migrate handle");
+				goto jsondone;
+			}
+			/* Prepare JSON reply */
+			json_t *reply = janus_create_message("success", session_id, transaction_text);
+			/* Send the success reply */
+			ret = janus_process_success(request, reply);
+			goto jsondone;
 		} else if(!strcasecmp(message_text, "hangup_webrtc")) {
 			if(handle->app == NULL || handle->app_handle == NULL) {
 				ret = janus_process_error(request, session_id, transaction_text, JANUS_ERROR_PLUGIN_DETACH, "No plugin attached");
@@ -2576,6 +2901,9 @@ int janus_process_incoming_admin_request(janus_request *request) {
 			json_object_set_new(info, "opaque_id", json_string(handle->opaque_id));
 		json_object_set_new(info, "loop-running", (handle->mainloop != NULL &&
 			g_main_loop_is_running(handle->mainloop)) ? json_true() : json_false());
+		int loop = janus_ice_handle_get_loop(handle);
+		if(loop >= 0)
+			json_object_set_new(info, "loop", json_integer(loop));
 		json_object_set_new(info, "created", json_integer(handle->created));
 		json_object_set_new(info, "current_time", json_integer(janus_get_monotonic_time()));
 		if(handle->app && janus_plugin_session_is_alive(handle->app_handle)) {
@@ -2636,6 +2964,22 @@ int janus_process_incoming_admin_request(janus_request *request) {
 			json_object_set_new(info, "pending-trickles", json_integer(g_list_length(handle->pending_trickles)));
 		if(handle->queued_packets)
 			json_object_set_new(info, "queued-packets", json_integer(g_async_queue_length(handle->queued_packets)));
+		json_t *wakeups = json_object();
+		json_object_set_new(wakeups, "packets", json_integer((gsize)g_atomic_pointer_get(&handle->queued_count)));
+		json_object_set_new(wakeups, "wakeups", json_integer((gsize)g_atomic_pointer_get(&handle->wakeups_count)));
+		json_object_set_new(info, "queue-wakeups", wakeups);
+		json_t *egress = janus_ice_handle_egress_summary(handle);
+		if(egress)
+			json_object_set_new(info, "egress-batching", egress);
+		json_t *pool = janus_ice_handle_pool_summary(handle);
+		if(pool)
+			json_object_set_new(info, "packet-pool", pool);
+		json_t *pacer = janus_ice_handle_pacer_summary(handle);
+		if(pacer)
+			json_object_set_new(info, "pacer", pacer);
+		json_t *crypto = janus_ice_handle_crypto_summary(handle);
+		if(crypto)
+			json_object_set_new(info, "crypto-workers", crypto);
 		if(g_atomic_int_get(&handle->dump_packets) && handle->text2pcap) {
 			if(handle->text2pcap->text) {
 				json_object_set_new(info, "dump-to-text2pcap", json_true());
@@ -2800,6 +3144,15 @@ json_t *janus_admin_stream_summary(janus_ice_stream *stream) {
 	json_object_set_new(bwe, "twcc", stream->do_transport_wide_cc ? json_true() : json_false());
 	if(stream->transport_wide_cc_ext_id > 0)
 		json_object_set_new(bwe, "twcc-ext-id", json_integer(stream->transport_wide_cc_ext_id));
+	if(stream->bwe) {
+		json_object_set_new(bwe, "estimate", json_integer(stream->bwe->estimate));
+		json_object_set_new(bwe, "delay-estimate", json_integer(stream->bwe->delay_estimate));
+		json_object_set_new(bwe, "loss-estimate", json_integer(stream->bwe->loss_estimate));
+		json_object_set_new(bwe, "acked-bitrate", json_integer(stream->bwe->acked_bitrate));
+		json_object_set_new(bwe, "usage", json_string(janus_bwe_usage_description(stream->bwe->usage)));
+		json_object_set_new(bwe, "state", json_string(janus_bwe_state_description(stream->bwe->state)));
+		json_object_set_new(bwe, "threshold", json_real(stream->bwe->threshold));
+	}
 	json_object_set_new(s, "bwe", bwe);
 	json_object_set_new(s, "nack-queue-ms", json_integer(stream->nack_queue_ms));
 	json_t *components = json_array();
@@ -2891,6 +3244,14 @@ json_t *janus_admin_component_summary(janus_ice_component *component) {
 	if(component->selected_pair) {
 		json_object_set_new(c, "selected-pair", json_string(component->selected_pair));
 	}
+	if(component->ingress_source != NULL || component->ingress_batches > 0) {
+		json_t *ingress = json_object();
+		json_object_set_new(ingress, "active", component->ingress_source != NULL ? json_true() : json_false());
+		json_object_set_new(ingress, "batches", json_integer(component->ingress_batches));
+		json_object_set_new(ingress, "packets", json_integer(component->ingress_packets));
+		json_object_set_new(ingress, "max-batch", json_integer(component->ingress_max_batch));
+		json_object_set_new(c, "ingress-batching", ingress);
+	}
 	json_t *d = json_object();
 	json_t *in_stats = json_object();
 	json_t *out_stats = json_object();
@@ -2954,12 +3315,16 @@ json_t *janus_admin_component_summary(janus_ice_component *component) {
 			json_object_set_new(out_stats, "audio_bytes", json_integer(component->out_stats.audio.bytes));
 			json_object_set_new(out_stats, "audio_bytes_lastsec", json_integer(component->out_stats.audio.bytes_lastsec));
 			json_object_set_new(out_stats, "audio_nacks", json_integer(component->out_stats.audio.nacks));
+			if(component->audio_nack_ring.slots != NULL)
+				json_object_set_new(out_stats, "audio_nack_ring_size", json_integer(component->audio_nack_ring.mask+1));
 		}
 		if(handle && janus_flags_is_set(&handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_HAS_VIDEO)) {
 			json_object_set_new(out_stats, "video_packets", json_integer(component->out_stats.video[0].packets));
 			json_object_set_new(out_stats, "video_bytes", json_integer(component->out_stats.video[0].bytes));
 			json_object_set_new(out_stats, "video_bytes_lastsec", json_integer(component->out_stats.video[0].bytes_lastsec));
 			json_object_set_new(out_stats, "video_nacks", json_integer(component->out_stats.video[0].nacks));
+			if(component->video_nack_ring.slots != NULL)
+				json_object_set_new(out_stats, "video_nack_ring_size", json_integer(component->video_nack_ring.mask+1));
 		}
 		json_object_set_new(out_stats, "data_packets", json_integer(component->out_stats.data.packets));
 		json_object_set_new(out_stats, "data_bytes", json_integer(component->out_stats.data.bytes));
@@ -2996,18 +3361,34 @@ void janus_transport_incoming_request(janus_transport *plugin, janus_transport_s
 	JANUS_LOG(LOG_VERB, "Got %s API request from %s (%p)\n", admin ? "an admin" : "a Janus", plugin->get_package(), transport);
 	/* Create a janus_request instance to handle the request */
 	janus_request *request = janus_request_new(plugin, transport, request_id, admin, message);
-	/* Enqueue the request, the thread will pick it up */
-	g_async_queue_push(requests, request);
+	/* Enqueue the request, the dispatcher of its session will pick it up: requests
+	 * with no session (e.g., create) can go to any dispatcher, so we spread them */
+	guint64 session_id = 0;
+	json_t *s = json_object_get(message, "session_id");
+	if(json_is_integer(s) && json_integer_value(s) > 0)
+		session_id = json_integer_value(s);
+	guint index = 0;
+	if(session_id > 0)
+		index = (session_id ^ (session_id >> 32)) % dispatchers_count;
+	else
+		index = (guint)g_atomic_int_add(&dispatchers_next, 1) % dispatchers_count;
+	g_async_queue_push(dispatchers[index].queue, request);
 }
 
 void janus_transport_gone(janus_transport *plugin, janus_transport_session *transport) {
 	/* Get rid of sessions this transport was handling */
 	JANUS_LOG(LOG_VERB, "A %s transport instance has gone away (%p)\n", plugin->get_package(), transport);
-	janus_mutex_lock(&sessions_mutex);
-	if(sessions && g_hash_table_size(sessions) > 0) {
+	int i = 0;
+	for(i=0; i<JANUS_SESSIONS_SHARDS; i++) {
+		janus_sessions_shard *shard = &sessions[i];
+		janus_sessions_shard_update_lock(shard);
+		if(shard->table == NULL || g_hash_table_size(shard->table) == 0) {
+			g_rw_lock_writer_unlock(&shard->lock);
+			continue;
+		}
 		GHashTableIter iter;
 		gpointer value;
-		g_hash_table_iter_init(&iter, sessions);
+		g_hash_table_iter_init(&iter, shard->table);
 		while(g_hash_table_iter_next(&iter, NULL, &value)) {
 			janus_session *session = (janus_session *) value;
 			if(!session || g_atomic_int_get(&session->destroyed) || g_atomic_int_get(&session->timeout) || session->last_activity == 0)
@@ -3022,11 +3403,13 @@ void janus_transport_gone(janus_transport *plugin, janus_transport_session *tran
 				} else {
 					/* Set flag for transport_gone. The Janus sessions watchdog will clean this up if not reclaimed*/
 					g_atomic_int_set(&session->transport_gone, 1);
+					/* The reclaim timeout may be shorter than what's left of the session timeout */
+					janus_sessions_wheel_schedule(session);
 				}
 			}
 		}
+		g_rw_lock_writer_unlock(&shard->lock);
 	}
-	janus_mutex_unlock(&sessions_mutex);
 }
 
 gboolean janus_transport_is_api_secret_needed(janus_transport *plugin) {
@@ -3080,13 +3463,20 @@ void janus_transport_task(gpointer data, gpointer user_data) {
 
 /* Thread to handle incoming requests: may involve an asynchronous task for plugin messaging */
 static void *janus_transport_requests(void *data) {
-	JANUS_LOG(LOG_INFO, "Joining Janus requests handler thread\n");
+	janus_request_dispatcher *dispatcher = (janus_request_dispatcher *)data;
+	JANUS_LOG(LOG_INFO, "Joining Janus requests handler thread #%u\n", dispatcher->id);
 	janus_request *request = NULL;
 	gboolean destroy = FALSE;
 	while(!g_atomic_int_get(&stop)) {
-		request = g_async_queue_pop(requests);
+		request = g_async_queue_pop(dispatcher->queue);
 		if(request == &exit_message)
 			break;
+		/* How long did the request wait in the queue? */
+		gint64 wait = janus_get_monotonic_time() - request->received;
+		dispatcher->processed++;
+		dispatcher->wait_total += wait;
+		if(wait > dispatcher->wait_max)
+			dispatcher->wait_max = wait;
 		/* Should we process the request synchronously or with a task from the thread pool? */
 		destroy = TRUE;
 		/* Process the request synchronously only it's not a message for a plugin */
@@ -3116,10 +3506,26 @@ static void *janus_transport_requests(void *data) {
 		if(destroy)
 			janus_request_destroy(request);
 	}
-	JANUS_LOG(LOG_INFO, "Leaving Janus requests handler thread\n");
+	JANUS_LOG(LOG_INFO, "Leaving Janus requests handler thread #%u\n", dispatcher->id);
 	return NULL;
 }
 
+static json_t *janus_request_dispatchers_info(void) {
+	json_t *list = json_array();
+	guint i = 0;
+	for(i=0; i<dispatchers_count; i++) {
+		janus_request_dispatcher *dispatcher = &dispatchers[i];
+		json_t *info = json_object();
+		json_object_set_new(info, "id", json_integer(dispatcher->id));
+		json_object_set_new(info, "queued", json_integer(g_async_queue_length(dispatcher->queue)));
+		json_object_set_new(info, "processed", json_integer(dispatcher->processed));
+		json_object_set_new(info, "wait-avg", json_integer(dispatcher->processed ? (dispatcher->wait_total / (gint64)dispatcher->processed) : 0));
+		json_object_set_new(info, "wait-max", json_integer(dispatcher->wait_max));
+		json_array_append_new(list, info);
+	}
+	return list;
+}
+
 
 /* Event handlers */
 void janus_eventhandler_close(gpointer key, gpointer value, gpointer user_data) {
@@ -3261,6 +3667,61 @@ int janus_plugin_push_event(janus_plugin_session *plugin_session, janus_plugin *
 	return JANUS_OK;
 }
 
+int janus_plugin_push_event_text(janus_plugin_session *plugin_session, janus_plugin *plugin, const char *transaction, janus_json_text *message) {
+	if(!plugin || !message || !message->message)
+		return -1;
+	if(!janus_plugin_session_is_alive(plugin_session))
+		return -2;
+	janus_refcount_increase(&plugin_session->ref);
+	janus_ice_handle *ice_handle = (janus_ice_handle *)plugin_session->gateway_handle;
+	if(!ice_handle || janus_flags_is_set(&ice_handle->webrtc_flags, JANUS_ICE_HANDLE_WEBRTC_STOP)) {
+		janus_refcount_decrease(&plugin_session->ref);
+		return JANUS_ERROR_SESSION_NOT_FOUND;
+	}
+	janus_refcount_increase(&ice_handle->ref);
+	janus_session *session = ice_handle->session;
+	if(!session || g_atomic_int_get(&session->destroyed)) {
+		janus_refcount_decrease(&plugin_session->ref);
+		janus_refcount_decrease(&ice_handle->ref);
+		return JANUS_ERROR_SESSION_NOT_FOUND;
+	}
+	/* Make sure this is a JSON object */
+	if(!json_is_object(message->message)) {
+		JANUS_LOG(LOG_ERR, "[%"SCNu64"] Cannot push event (JSON error: not an object)\n", ice_handle->handle_id);
+		janus_refcount_decrease(&plugin_session->ref);
+		janus_refcount_decrease(&ice_handle->ref);
+		return JANUS_ERROR_INVALID_JSON_OBJECT;
+	}
+	/* Prepare the JSON event: we only serialize the envelope, which
+	 * is different for each recipient, and splice the message in it */
+	json_t *event = janus_create_message("event", session->session_id, transaction);
+	json_object_set_new(event, "sender", json_integer(ice_handle->handle_id));
+	if(janus_is_opaqueid_in_api_enabled() && ice_handle->opaque_id != NULL)
+		json_object_set_new(event, "opaque_id", json_string(ice_handle->opaque_id));
+	json_t *plugin_data = json_object();
+	json_object_set_new(plugin_data, "plugin", json_string(plugin->get_package()));
+	json_object_set_new(event, "plugindata", plugin_data);
+	/* Send the event */
+	JANUS_LOG(LOG_VERB, "[%"SCNu64"] Sending event to transport...\n", ice_handle->handle_id);
+	janus_transport *transport = (!g_atomic_int_get(&session->destroyed) && session->source) ? session->source->transport : NULL;
+	janus_json_text *text = NULL;
+	if(transport != NULL && transport->send_text != NULL)
+		text = janus_json_text_splice(event, plugin_data, "data", message, janus_json_get_shared_format());
+	if(text != NULL) {
+		JANUS_LOG(LOG_HUGE, "Sending event to %s (%p)\n", transport->get_package(), session->source->instance);
+		json_decref(event);
+		transport->send_text(session->source->instance, NULL, FALSE, text);
+	} else {
+		/* The transport can't send serialized events, give it the JSON message */
+		json_object_set(plugin_data, "data", message->message);
+		janus_session_notify_event(session, event);
+	}
+
+	janus_refcount_decrease(&plugin_session->ref);
+	janus_refcount_decrease(&ice_handle->ref);
+	return JANUS_OK;
+}
+
 json_t *janus_plugin_handle_sdp(janus_plugin_session *plugin_session, janus_plugin *plugin, const char *sdp_type, const char *sdp, gboolean restart) {
 	if(!janus_plugin_session_is_alive(plugin_session) ||
 			plugin == NULL || sdp_type == NULL || sdp == NULL) {
@@ -3460,6 +3921,10 @@ json_t *janus_plugin_handle_sdp(janus_plugin_session *plugin_session, janus_plug
 		if(!do_repaired_rid && ice_handle->stream)
 			ice_handle->stream->ridrtx_ext_id = 0;
 	}
+	/* Recompile the extensions we add to outgoing packets, as they may have changed */
+	janus_mutex_lock(&ice_handle->mutex);
+	janus_ice_stream_compile_extensions(ice_handle->stream);
+	janus_mutex_unlock(&ice_handle->mutex);
 	if(!updating && !janus_ice_is_full_trickle_enabled()) {
 		/* Wait for candidates-done callback */
 		while(ice_handle->cdone < 1) {
@@ -4392,6 +4857,17 @@ gint main(int argc, char *argv[])
 	if(item && item->value && janus_is_true(item->value))
 		janus_enable_opaqueid_in_api();
 
+	/* Check how transports and plugins should serialize JSON by default */
+	item = janus_config_get(config, config_general, janus_config_type_item, "json");
+	if(item && item->value) {
+		size_t format = janus_json_format_parse(item->value);
+		if(format == 0) {
+			JANUS_LOG(LOG_WARN, "Unsupported JSON format option '%s', using default (indented)\n", item->value);
+		} else {
+			janus_json_set_format(format);
+		}
+	}
+
 	/* Initialize the recorder code */
 	item = janus_config_get(config, config_general, janus_config_type_item, "recordings_tmp_ext");
 	if(item && item->value) {
@@ -4504,12 +4980,89 @@ gint main(int argc, char *argv[])
 	if(item && item->value)
 		turn_rest_api_method = (char *)item->value;
 #endif
+	/* Should we batch outgoing packets? This needs to be known before we spawn any event loop */
+	item = janus_config_get(config, config_media, janus_config_type_item, "egress_batching");
+	if(item && item->value && janus_is_true(item->value))
+		janus_ice_enable_egress_batching();
+	/* Should we read incoming media in batches? */
+	item = janus_config_get(config, config_media, janus_config_type_item, "ingress_batching");
+	if(item && item->value && janus_is_true(item->value))
+		janus_ice_enable_ingress_batching();
+	/* Should we pace outgoing video? */
+	item = janus_config_get(config, config_media, janus_config_type_item, "pacing");
+	if(item && item->value && janus_is_true(item->value)) {
+		double multiplier = DEFAULT_PACING_MULTIPLIER;
+		int max_queue = DEFAULT_PACING_MAX_QUEUE;
+		item = janus_config_get(config, config_media, janus_config_type_item, "pacing_multiplier");
+		if(item && item->value) {
+			multiplier = atof(item->value);
+			if(multiplier < 1.0) {
+				JANUS_LOG(LOG_WARN, "Invalid pacing multiplier (%s), using default (%.1f)\n", item->value, DEFAULT_PACING_MULTIPLIER);
+				multiplier = DEFAULT_PACING_MULTIPLIER;
+			}
+		}
+		item = janus_config_get(config, config_media, janus_config_type_item, "pacing_max_queue");
+		if(item && item->value) {
+			max_queue = atoi(item->value);
+			if(max_queue <= 0) {
+				JANUS_LOG(LOG_WARN, "Invalid pacing queue cap (%s), using default (%dms)\n", item->value, DEFAULT_PACING_MAX_QUEUE);
+				max_queue = DEFAULT_PACING_MAX_QUEUE;
+			}
+		}
+		janus_ice_enable_pacing(multiplier, max_queue);
+	}
+	/* Should we offload SRTP encryption to a pool of crypto workers? */
+	item = janus_config_get(config, config_media, janus_config_type_item, "srtp_workers");
+	if(item && item->value) {
+		int workers = atoi(item->value);
+		if(workers < 0) {
+			JANUS_LOG(LOG_WARN, "Invalid number of SRTP crypto workers (%s), disabling them\n", item->value);
+			workers = 0;
+		}
+		janus_ice_set_srtp_workers(workers);
+	}
 	/* Do we need a limited number of static event loops, or is it ok to have one per handle (the default)? */
 	item = janus_config_get(config, config_general, janus_config_type_item, "event_loops");
-	if(item && item->value)
-		janus_ice_set_static_event_loops(atoi(item->value));
+	if(item && item->value) {
+		int loops = atoi(item->value);
+		/* Should new handles go to the least loaded loop (the default), or round robin? */
+		gboolean load_aware = TRUE;
+		item = janus_config_get(config, config_general, janus_config_type_item, "event_loops_placement");
+		if(item && item->value) {
+			if(!strcasecmp(item->value, "round-robin")) {
+				load_aware = FALSE;
+			} else if(strcasecmp(item->value, "load")) {
+				JANUS_LOG(LOG_WARN, "Invalid event loops placement '%s', falling back to 'load'\n", item->value);
+			}
+		}
+		/* Should the loops be pinned to specific CPUs? */
+		const char *affinity = NULL;
+		item = janus_config_get(config, config_general, janus_config_type_item, "event_loops_affinity");
+		if(item && item->value)
+			affinity = item->value;
+		janus_ice_set_static_event_loops(loops, load_aware, affinity);
+	}
 	/* Initialize the ICE stack now */
 	janus_ice_init(ice_lite, ice_tcp, full_trickle, ipv6, rtp_min_port, rtp_max_port);
+	/* Should we multiplex the media of all PeerConnections on a single port? (ICE-Lite only) */
+	item = janus_config_get(config, config_media, janus_config_type_item, "mux_port");
+	if(item && item->value) {
+		uint16_t mux_port = 0;
+		if(janus_string_to_uint16(item->value, &mux_port) < 0) {
+			JANUS_LOG(LOG_WARN, "Invalid port for media multiplexing: %s (disabling it)\n", item->value);
+		} else if(mux_port > 0 && janus_ice_enable_mux(mux_port) < 0) {
+			JANUS_LOG(LOG_ERR, "Couldn't multiplex media on port %"SCNu16", falling back to a port per PeerConnection\n", mux_port);
+		}
+	}
+	item = janus_config_get(config, config_media, janus_config_type_item, "mux_consent_timeout");
+	if(item && item->value) {
+		int mct = atoi(item->value);
+		if(mct < 0) {
+			JANUS_LOG(LOG_WARN, "Ignoring mux_consent_timeout value as it's not a positive integer\n");
+		} else {
+			janus_ice_set_mux_consent_timeout(mct);
+		}
+	}
 	if(janus_ice_set_stun_server(stun_server, stun_port) < 0) {
 		if(!ignore_unreachable_ice_server) {
 			JANUS_LOG(LOG_FATAL, "Invalid STUN address %s:%u\n", stun_server, stun_port);
@@ -4634,6 +5187,11 @@ gint main(int argc, char *argv[])
 	} else {
 		password = item->value;
 	}
+	/* If we need to autogenerate a certificate, should the key be RSA rather than ECDSA? */
+	gboolean rsa_private_key = FALSE;
+	item = janus_config_get(config, config_certs, janus_config_type_item, "rsa_private_key");
+	if(item && item->value)
+		rsa_private_key = janus_is_true(item->value);
 	JANUS_LOG(LOG_VERB, "Using certificates:\n\t%s\n\t%s\n", server_pem, server_key);
 
 	SSL_library_init();
@@ -4646,9 +5204,19 @@ gint main(int argc, char *argv[])
 		JANUS_LOG(LOG_WARN, "Invalid DTLS timeout: %s (falling back to default)\n", item->value);
 		dtls_timeout = 1000;
 	}
-	if(janus_dtls_srtp_init(server_pem, server_key, password, dtls_timeout) < 0) {
+	if(janus_dtls_srtp_init(server_pem, server_key, password, rsa_private_key, dtls_timeout) < 0) {
 		exit(1);
 	}
+	/* Should we offload DTLS handshakes to a pool of workers? */
+	item = janus_config_get(config, config_media, janus_config_type_item, "dtls_workers");
+	if(item && item->value) {
+		int workers = atoi(item->value);
+		if(workers < 0) {
+			JANUS_LOG(LOG_WARN, "Invalid number of DTLS handshake workers (%s), disabling them\n", item->value);
+			workers = 0;
+		}
+		janus_dtls_set_handshake_workers(workers);
+	}
 	/* Check if there's any custom value for the starting MTU to use in the BIO filter */
 	item = janus_config_get(config, config_media, janus_config_type_item, "dtls_mtu");
 	if(item && item->value)
@@ -4664,9 +5232,13 @@ gint main(int argc, char *argv[])
 #endif
 
 	/* Sessions */
-	sessions = g_hash_table_new_full(g_int64_hash, g_int64_equal, (GDestroyNotify)g_free, NULL);
-	janus_mutex_init(&sessions_mutex);
+	int shard = 0;
+	for(shard=0; shard<JANUS_SESSIONS_SHARDS; shard++) {
+		g_rw_lock_init(&sessions[shard].lock);
+		sessions[shard].table = g_hash_table_new_full(g_int64_hash, g_int64_equal, (GDestroyNotify)g_free, NULL);
+	}
 	/* Start the sessions timeout watchdog */
+	sessions_wheel_start = janus_get_monotonic_time();
 	sessions_watchdog_context = g_main_context_new();
 	GMainLoop *watchdog_loop = g_main_loop_new(sessions_watchdog_context, FALSE);
 	GError *error = NULL;
@@ -4675,13 +5247,34 @@ gint main(int argc, char *argv[])
 		JANUS_LOG(LOG_FATAL, "Got error %d (%s) trying to start sessions timeout watchdog...\n", error->code, error->message ? error->message : "??");
 		exit(1);
 	}
-	/* Start the thread that will dispatch incoming requests */
-	requests = g_async_queue_new_full((GDestroyNotify) janus_request_destroy);
-	GThread *requests_thread = g_thread_try_new("sessions requests", &janus_transport_requests, NULL, &error);
-	if(error != NULL) {
-		JANUS_LOG(LOG_FATAL, "Got error %d (%s) trying to start requests thread...\n", error->code, error->message ? error->message : "??");
-		exit(1);
+	/* Start the thread(s) that will dispatch incoming requests */
+	item = janus_config_get(config, config_general, janus_config_type_item, "request_dispatchers");
+	if(item && item->value) {
+		int count = atoi(item->value);
+		if(count < 1) {
+			JANUS_LOG(LOG_WARN, "Invalid number of request dispatchers (%s), using 1\n", item->value);
+			count = 1;
+		}
+		dispatchers_count = count;
+	}
+	dispatchers = g_malloc0(dispatchers_count * sizeof(janus_request_dispatcher));
+	guint d = 0;
+	for(d=0; d<dispatchers_count; d++) {
+		dispatchers[d].id = d;
+		dispatchers[d].queue = g_async_queue_new_full((GDestroyNotify) janus_request_destroy);
+		char tname[16];
+		if(dispatchers_count == 1)
+			g_snprintf(tname, sizeof(tname), "sessions requests");
+		else
+			g_snprintf(tname, sizeof(tname), "requests #%u", d);
+		dispatchers[d].thread = g_thread_try_new(tname, &janus_transport_requests, &dispatchers[d], &error);
+		if(error != NULL) {
+			JANUS_LOG(LOG_FATAL, "Got error %d (%s) trying to start requests thread...\n", error->code, error->message ? error->message : "??");
+			exit(1);
+		}
 	}
+	if(dispatchers_count > 1)
+		JANUS_LOG(LOG_INFO, "Using %u request dispatchers\n", dispatchers_count);
 	/* Create a thread pool to handle asynchronous requests, no matter what the transport */
 	error = NULL;
 	tasks = g_thread_pool_new(janus_transport_task, NULL, -1, FALSE, &error);
@@ -5151,13 +5744,20 @@ gint main(int argc, char *argv[])
 	/* Get rid of requests tasks and thread too */
 	g_thread_pool_free(tasks, FALSE, FALSE);
 	JANUS_LOG(LOG_INFO, "Ending requests thread...\n");
-	g_async_queue_push(requests, &exit_message);
-	g_thread_join(requests_thread);
-	requests_thread = NULL;
-	g_async_queue_unref(requests);
+	for(d=0; d<dispatchers_count; d++) {
+		g_async_queue_push(dispatchers[d].queue, &exit_message);
+		g_thread_join(dispatchers[d].thread);
+		dispatchers[d].thread = NULL;
+		g_async_queue_unref(dispatchers[d].queue);
+	}
+	g_free(dispatchers);
+	dispatchers = NULL;
 
 	JANUS_LOG(LOG_INFO, "Destroying sessions...\n");
-	g_clear_pointer(&sessions, g_hash_table_destroy);
+	for(shard=0; shard<JANUS_SESSIONS_SHARDS; shard++) {
+		g_clear_pointer(&sessions[shard].table, g_hash_table_destroy);
+		g_rw_lock_clear(&sessions[shard].lock);
+	}
 	janus_ice_deinit();
 	JANUS_LOG(LOG_INFO, "Freeing crypto resources...\n");
 	janus_dtls_srtp_cleanup();
@@ -56,6 +56,9 @@ typedef struct janus_session {
 	volatile gint timeout;
 	/*! \brief Flag to notify that transport is gone */
 	volatile gint transport_gone;
+	/*! \brief Slot of the expiry timer wheel this session is in (-1 if none), and siblings in that slot */
+	gint wheel_slot;
+	struct janus_session *wheel_prev, *wheel_next;
 	/*! \brief Mutex to lock/unlock this session */
 	janus_mutex mutex;
 	/*! \brief Atomic flag to check if this instance has been destroyed */
@@ -69,8 +72,9 @@ typedef struct janus_session {
  */
 ///@{
 /*! \brief Method to create a new Janus Core-Client session
+ * \note The session is only added if no other session has the same ID
  * @param[in] session_id The desired Janus Core-Client session ID, or 0 if it needs to be generated randomly
- * @returns The created Janus Core-Client session if successful, NULL otherwise */
+ * @returns The created Janus Core-Client session if successful, NULL otherwise (e.g., if the ID is already in use) */
 janus_session *janus_session_create(guint64 session_id);
 /*! \brief Method to find an existing Janus Core-Client session from its ID
  * @param[in] session_id The Janus Core-Client session ID
@@ -127,6 +131,8 @@ struct janus_request {
 	gboolean admin;
 	/*! \brief Pointer to the original request, if available */
 	json_t *message;
+	/*! \brief Monotonic time of when the request was received */
+	gint64 received;
 };
 /*! \brief Helper to allocate a janus_request instance
  * @param[in] transport Pointer to the transport
@@ -1771,6 +1771,8 @@ void janus_audiobridge_destroy_session(janus_plugin_session *handle, int *error)
 
 static void janus_audiobridge_notify_participants(janus_audiobridge_participant *participant, json_t *msg) {
 	/* participant->room->participants_mutex has to be locked. */
+	/* The same event goes to everybody, so we serialize it only once */
+	janus_json_text *text = NULL;
 	GHashTableIter iter;
 	gpointer value;
 	g_hash_table_iter_init(&iter, participant->room->participants);
@@ -1778,10 +1780,14 @@ static void janus_audiobridge_notify_participants(janus_audiobridge_participant
 		janus_audiobridge_participant *p = value;
 		if(p && p->session && p != participant) {
 			JANUS_LOG(LOG_VERB, "Notifying participant %s (%s)\n", p->user_id_str, p->display ? p->display : "??");
-			int ret = gateway->push_event(p->session->handle, &janus_audiobridge_plugin, NULL, msg, NULL);
+			if(text == NULL)
+				text = janus_json_text_new(msg, janus_json_get_shared_format());
+			int ret = text ? gateway->push_event_text(p->session->handle, &janus_audiobridge_plugin, NULL, text) :
+				gateway->push_event(p->session->handle, &janus_audiobridge_plugin, NULL, msg, NULL);
 			JANUS_LOG(LOG_VERB, "  >> %d (%s)\n", ret, janus_get_api_error(ret));
 		}
 	}
+	janus_json_text_unref(text);
 }
 
 json_t *janus_audiobridge_query_session(janus_plugin_session *handle) {
@@ -868,21 +868,16 @@ int janus_textroom_init(janus_callbacks *callback, const char *config_path) {
 	/* Parse configuration to populate the rooms list */
 	if(config != NULL) {
 		janus_config_category *config_general = janus_config_get_create(config, NULL, janus_config_type_category, "general");
+		/* Unless configured otherwise, serialize JSON the way the core does */
+		json_format = janus_json_get_format();
 		janus_config_item *item = janus_config_get(config, config_general, janus_config_type_item, "json");
 		if(item && item->value) {
 			/* Check how we need to format/serialize the JSON output */
-			if(!strcasecmp(item->value, "indented")) {
-				/* Default: indented, we use three spaces for that */
-				json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
-			} else if(!strcasecmp(item->value, "plain")) {
-				/* Not indented and no new lines, but still readable */
-				json_format = JSON_INDENT(0) | JSON_PRESERVE_ORDER;
-			} else if(!strcasecmp(item->value, "compact")) {
-				/* Compact, so no spaces between separators */
-				json_format = JSON_COMPACT | JSON_PRESERVE_ORDER;
+			size_t format = janus_json_format_parse(item->value);
+			if(format == 0) {
+				JANUS_LOG(LOG_WARN, "Unsupported JSON format option '%s', using the core default\n", item->value);
 			} else {
-				JANUS_LOG(LOG_WARN, "Unsupported JSON format option '%s', using default (indented)\n", item->value);
-				json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
+				json_format = format;
 			}
 		}
 		/* Any admin key to limit who can "create"? */
@@ -1495,6 +1490,8 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 			json_object_set_new(msg, "whisper", json_true());
 		char *msg_text = json_dumps(msg, json_format);
 		json_decref(msg);
+		/* We send the same text to all recipients, so we only compute its length once */
+		size_t msg_len = strlen(msg_text);
 		/* Start preparing the response too */
 		reply = json_object();
 		json_object_set_new(reply, "textroom", json_string("success"));
@@ -1507,7 +1504,7 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 			janus_textroom_participant *top = g_hash_table_lookup(textroom->participants, to);
 			if(top) {
 				janus_refcount_increase(&top->ref);
-				janus_plugin_data data = { .label = NULL, .binary = FALSE, .buffer = msg_text, .length = strlen(msg_text) };
+				janus_plugin_data data = { .label = NULL, .binary = FALSE, .buffer = msg_text, .length = msg_len };
 				gateway->relay_data(top->session->handle, &data);
 				janus_refcount_decrease(&top->ref);
 				json_object_set_new(sent, to, json_true());
@@ -1527,7 +1524,7 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 				janus_textroom_participant *top = g_hash_table_lookup(textroom->participants, to);
 				if(top) {
 					janus_refcount_increase(&top->ref);
-					janus_plugin_data data = { .label = NULL, .binary = FALSE, .buffer = msg_text, .length = strlen(msg_text) };
+					janus_plugin_data data = { .label = NULL, .binary = FALSE, .buffer = msg_text, .length = msg_len };
 					gateway->relay_data(top->session->handle, &data);
 					janus_refcount_decrease(&top->ref);
 					json_object_set_new(sent, to, json_true());
@@ -1548,7 +1545,7 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 					janus_textroom_participant *top = value;
 					JANUS_LOG(LOG_VERB, "  >> To %s in %s: %s\n", top->username, room_id_str, message);
 					janus_refcount_increase(&top->ref);
-					janus_plugin_data data = { .label = NULL, .binary = FALSE, .buffer = msg_text, .length = strlen(msg_text) };
+					janus_plugin_data data = { .label = NULL, .binary = FALSE, .buffer = msg_text, .length = msg_len };
 					gateway->relay_data(top->session->handle, &data);
 					janus_refcount_decrease(&top->ref);
 				}
@@ -2116,6 +2113,8 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 			json_object_set_new(event, "username", json_string(participant->username));
 			char *event_text = json_dumps(event, json_format);
 			json_decref(event);
+			/* We send the same text to all recipients, so we only compute its length once */
+			size_t event_len = strlen(event_text);
 			/* Broadcast */
 			GHashTableIter iter;
 			gpointer value;
@@ -2123,7 +2122,7 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 			while(g_hash_table_iter_next(&iter, NULL, &value)) {
 				janus_textroom_participant *top = value;
 				JANUS_LOG(LOG_VERB, "  >> To %s in %s\n", top->username, room_id_str);
-				janus_plugin_data data = { .label = NULL, .binary = FALSE, .buffer = event_text, .length = strlen(event_text) };
+				janus_plugin_data data = { .label = NULL, .binary = FALSE, .buffer = event_text, .length = event_len };
 				gateway->relay_data(top->session->handle, &data);
 			}
 			free(event_text);
@@ -2216,6 +2215,8 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 		json_object_set_new(msg, "text", json_string(message));
 		char *msg_text = json_dumps(msg, json_format);
 		json_decref(msg);
+		/* We send the same text to all recipients, so we only compute its length once */
+		size_t msg_len = strlen(msg_text);
 		/* Send the announcement to everybody in the room */
 		if(textroom->participants) {
 			GHashTableIter iter;
@@ -2225,7 +2226,7 @@ janus_plugin_result *janus_textroom_handle_incoming_request(janus_plugin_session
 				janus_textroom_participant *top = value;
 				JANUS_LOG(LOG_VERB, "  >> To %s in %s: %s\n", top->username, room_id_str, message);
 				janus_refcount_increase(&top->ref);
-				janus_plugin_data data = { .label = NULL, .binary = FALSE, .buffer = msg_text, .length = strlen(msg_text) };
+				janus_plugin_data data = { .label = NULL, .binary = FALSE, .buffer = msg_text, .length = msg_len };
 				gateway->relay_data(top->session->handle, &data);
 				janus_refcount_decrease(&top->ref);
 			}
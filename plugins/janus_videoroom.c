@@ -855,6 +855,7 @@ room-<unique room ID>: {
 	"offer_data" : <true|false; whether or not datachannels should be negotiated; true by default if the publisher has datachannels>,
 	"substream" : <substream to receive (0-2), in case simulcasting is enabled; optional>,
 	"temporal" : <temporal layers to receive (0-2), in case simulcasting is enabled; optional>,
+	"auto_substream" : <true|false, whether the substream should be picked automatically according to the estimated bandwidth, in case simulcasting is enabled; optional>,
 	"spatial_layer" : <spatial layer to receive (0-2), in case VP9-SVC is enabled; optional>,
 	"temporal_layer" : <temporal layers to receive (0-2), in case VP9-SVC is enabled; optional>
 }
@@ -968,6 +969,7 @@ room-<unique room ID>: {
 	"data" : <true|false, depending on whether datachannel messages should be relayed or not; optional>,
 	"substream" : <substream to receive (0-2), in case simulcasting is enabled; optional>,
 	"temporal" : <temporal layers to receive (0-2), in case simulcasting is enabled; optional>,
+	"auto_substream" : <true|false, whether the substream should be picked automatically according to the estimated bandwidth, in case simulcasting is enabled; optional>,
 	"spatial_layer" : <spatial layer to receive (0-2), in case VP9-SVC is enabled; optional>,
 	"temporal_layer" : <temporal layers to receive (0-2), in case VP9-SVC is enabled; optional>
 }
@@ -980,6 +982,13 @@ room-<unique room ID>: {
  * when the mountpoint is configured with video simulcasting support, and
  * as such the viewer is interested in receiving a specific substream
  * or temporal layer, rather than any other of the available ones.
+ * When \c auto_substream is set to \c true (it's \c false by default, and
+ * can be set in the \c join request as well), the plugin picks the substream
+ * to send automatically instead, using the bandwidth the Janus core
+ * estimates is available towards the subscriber (which requires the
+ * transport-wide CC extension to be negotiated): in that case, \c substream
+ * is the highest substream the subscriber is interested in, and lower
+ * ones are picked when the publisher's substreams don't fit the estimate.
  * The \c spatial_layer and \c temporal_layer have exactly the same meaning,
  * but within the context of VP9-SVC publishers, and will have no effect
  * on subscriptions associated to regular publishers.
@@ -1073,6 +1082,9 @@ room-<unique room ID>: {
 #define JANUS_VIDEOROOM_AUTHOR			"Meetecho s.r.l."
 #define JANUS_VIDEOROOM_PACKAGE			"janus.plugin.videoroom"
 
+/* After going down a substream because of the estimated bandwidth, wait this long before going up again */
+#define JANUS_VIDEOROOM_AUTO_SUBSTREAM_BACKOFF	(10*G_USEC_PER_SEC)
+
 /* Plugin methods */
 janus_plugin *create(void);
 int janus_videoroom_init(janus_callbacks *callback, const char *config_path);
@@ -1092,6 +1104,7 @@ void janus_videoroom_incoming_rtp(janus_plugin_session *handle, janus_plugin_rtp
 void janus_videoroom_incoming_rtcp(janus_plugin_session *handle, janus_plugin_rtcp *packet);
 void janus_videoroom_incoming_data(janus_plugin_session *handle, janus_plugin_data *packet);
 void janus_videoroom_slow_link(janus_plugin_session *handle, int uplink, int video);
+void janus_videoroom_estimated_bandwidth(janus_plugin_session *handle, uint32_t estimate);
 void janus_videoroom_hangup_media(janus_plugin_session *handle);
 void janus_videoroom_destroy_session(janus_plugin_session *handle, int *error);
 json_t *janus_videoroom_query_session(janus_plugin_session *handle);
@@ -1118,6 +1131,7 @@ static janus_plugin janus_videoroom_plugin =
 		.incoming_rtcp = janus_videoroom_incoming_rtcp,
 		.incoming_data = janus_videoroom_incoming_data,
 		.slow_link = janus_videoroom_slow_link,
+		.estimated_bandwidth = janus_videoroom_estimated_bandwidth,
 		.hangup_media = janus_videoroom_hangup_media,
 		.destroy_session = janus_videoroom_destroy_session,
 		.query_session = janus_videoroom_query_session,
@@ -1282,6 +1296,7 @@ static struct janus_json_parameter configure_parameters[] = {
 	/* For VP8 (or H.264) simulcast */
 	{"substream", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"temporal", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
+	{"auto_substream", JANUS_JSON_BOOL, 0},
 	/* For VP9 SVC */
 	{"spatial_layer", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"temporal_layer", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
@@ -1300,6 +1315,7 @@ static struct janus_json_parameter subscriber_parameters[] = {
 	/* For VP8 (or H.264) simulcast */
 	{"substream", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"temporal", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
+	{"auto_substream", JANUS_JSON_BOOL, 0},
 	/* For VP9 SVC */
 	{"spatial_layer", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
 	{"temporal_layer", JSON_INTEGER, JANUS_JSON_PARAM_POSITIVE},
@@ -1488,6 +1504,9 @@ typedef struct janus_videoroom_publisher {
 	gboolean do_opusfec;	/* Whether this publisher is sending inband Opus FEC */
 	uint32_t ssrc[3];		/* Only needed in case VP8 (or H.264) simulcasting is involved */
 	char *rid[3];			/* Only needed if simulcasting is rid-based */
+	guint32 substream_bytes[3];		/* Bytes received for each simulcast substream in the current second */
+	guint32 substream_bitrate[3];	/* Bitrate of each simulcast substream (used to pick substreams automatically) */
+	gint64 substream_ts;			/* When we last computed the substream bitrates */
 	int rid_extmap_id;		/* rid extmap ID */
 	int framemarking_ext_id;			/* Frame marking extmap ID */
 	guint8 audio_level_extmap_id;		/* Audio level extmap ID */
@@ -1542,6 +1561,10 @@ typedef struct janus_videoroom_subscriber {
 	janus_rtp_switching_context context;	/* Needed in case there are publisher switches on this subscriber */
 	janus_rtp_simulcasting_context sim_context;
 	janus_vp8_simulcast_context vp8_context;
+	gboolean auto_substream;	/* Whether the simulcast substream should be picked according to the estimated bandwidth */
+	int substream_max;			/* Highest simulcast substream the subscriber is interested in */
+	guint32 estimated_bandwidth;	/* Latest bandwidth estimate the core notified us about */
+	gint64 auto_substream_ts;	/* When we last had to go down a substream because of the estimate */
 	gboolean audio, video, data;		/* Whether audio, video and/or data must be sent to this subscriber */
 	/* As above, but can't change dynamically (says whether something was negotiated at all in SDP) */
 	gboolean audio_offered, video_offered, data_offered;
@@ -1552,6 +1575,7 @@ typedef struct janus_videoroom_subscriber {
 	int spatial_layer, target_spatial_layer;
 	gint64 last_spatial_layer[3];
 	int temporal_layer, target_temporal_layer;
+	janus_mutex mutex;	/* Mutex to protect the feed and the automatic substream selection */
 	volatile gint destroyed;
 	janus_refcount ref;
 } janus_videoroom_subscriber;
@@ -1566,6 +1590,8 @@ typedef struct janus_videoroom_rtp_relay_packet {
 	uint16_t seq_number;
 	/* Extensions to add, if any */
 	janus_plugin_rtp_extensions extensions;
+	/* Payload shared with the core across subscribers, created the first time it's needed */
+	janus_plugin_rtp_payload *payload;
 	/* The following are only relevant if we're doing VP9 SVC*/
 	gboolean svc;
 	janus_vp9_svc_info svc_info;
@@ -1585,6 +1611,7 @@ static void janus_videoroom_subscriber_free(const janus_refcount *s_ref) {
 	/* This subscriber can be destroyed, free all the resources */
 	g_free(s->room_id_str);
 	janus_sdp_destroy(s->sdp);
+	janus_mutex_destroy(&s->mutex);
 	g_free(s);
 }
 
@@ -2431,6 +2458,8 @@ static void janus_videoroom_notify_participants(janus_videoroom_publisher *parti
 	/* participant->room->mutex has to be locked. */
 	if(participant->room == NULL)
 		return;
+	/* The same event goes to everybody, so we serialize it only once */
+	janus_json_text *text = NULL;
 	GHashTableIter iter;
 	gpointer value;
 	g_hash_table_iter_init(&iter, participant->room->participants);
@@ -2438,10 +2467,14 @@ static void janus_videoroom_notify_participants(janus_videoroom_publisher *parti
 		janus_videoroom_publisher *p = value;
 		if(p && p->session && p != participant) {
 			JANUS_LOG(LOG_VERB, "Notifying participant %s (%s)\n", p->user_id_str, p->display ? p->display : "??");
-			int ret = gateway->push_event(p->session->handle, &janus_videoroom_plugin, NULL, msg, NULL);
+			if(text == NULL)
+				text = janus_json_text_new(msg, janus_json_get_shared_format());
+			int ret = text ? gateway->push_event_text(p->session->handle, &janus_videoroom_plugin, NULL, text) :
+				gateway->push_event(p->session->handle, &janus_videoroom_plugin, NULL, msg, NULL);
 			JANUS_LOG(LOG_VERB, "  >> %d (%s)\n", ret, janus_get_api_error(ret));
 		}
 	}
+	janus_json_text_unref(text);
 }
 
 static void janus_videoroom_participant_joining(janus_videoroom_publisher *p) {
@@ -2642,12 +2675,17 @@ json_t *janus_videoroom_query_session(janus_plugin_session *handle) {
 				json_object_set_new(media, "data", participant->data ? json_true() : json_false());
 				json_object_set_new(media, "data-offered", participant->data_offered ? json_true() : json_false());
 				json_object_set_new(info, "media", media);
+				if(participant->estimated_bandwidth > 0)
+					json_object_set_new(info, "estimated-bandwidth", json_integer(participant->estimated_bandwidth));
 				if(feed && (feed->ssrc[0] != 0 || feed->rid[0] != NULL)) {
 					json_t *simulcast = json_object();
 					json_object_set_new(simulcast, "substream", json_integer(participant->sim_context.substream));
 					json_object_set_new(simulcast, "substream-target", json_integer(participant->sim_context.substream_target));
 					json_object_set_new(simulcast, "temporal-layer", json_integer(participant->sim_context.templayer));
 					json_object_set_new(simulcast, "temporal-layer-target", json_integer(participant->sim_context.templayer_target));
+					json_object_set_new(simulcast, "auto-substream", participant->auto_substream ? json_true() : json_false());
+					if(participant->auto_substream)
+						json_object_set_new(simulcast, "substream-max", json_integer(participant->substream_max));
 					json_object_set_new(info, "simulcast", simulcast);
 				}
 				if(participant->room && participant->room->do_svc) {
@@ -4690,9 +4728,9 @@ void janus_videoroom_incoming_rtp(janus_plugin_session *handle, janus_plugin_rtp
 			else if(ssrc == participant->ssrc[2])
 				sc = 2;
 			else if(participant->rid_extmap_id > 0) {
-				/* We may not know the SSRC yet, try the rid RTP extension */
-				char sdes_item[16];
-				if(janus_rtp_header_extension_parse_rid(buf, len, participant->rid_extmap_id, sdes_item, sizeof(sdes_item)) == 0) {
+				/* We may not know the SSRC yet, try the rid RTP extension (already parsed by the core) */
+				const char *sdes_item = pkt->extensions.rid;
+				if(*sdes_item != '\0') {
 					if(participant->rid[2] != NULL && !strcmp(participant->rid[2], sdes_item)) {
 						participant->ssrc[0] = ssrc;
 						sc = 0;
@@ -4705,6 +4743,20 @@ void janus_videoroom_incoming_rtp(janus_plugin_session *handle, janus_plugin_rtp
 					}
 				}
 			}
+			/* Keep track of the bitrate of each substream, in case subscribers need to pick one automatically */
+			gint64 now = janus_get_monotonic_time();
+			if(participant->substream_ts == 0)
+				participant->substream_ts = now;
+			participant->substream_bytes[sc] += len;
+			if(now - participant->substream_ts >= G_USEC_PER_SEC) {
+				int i=0;
+				for(i=0; i<3; i++) {
+					participant->substream_bitrate[i] = (guint32)(((guint64)participant->substream_bytes[i] * 8 * G_USEC_PER_SEC) /
+						(now - participant->substream_ts));
+					participant->substream_bytes[i] = 0;
+				}
+				participant->substream_ts = now;
+			}
 		}
 		/* Forward RTP to the appropriate port for the rtp_forwarders associated with this publisher, if there are any */
 		janus_mutex_lock(&participant->rtp_forwarders_mutex);
@@ -4817,6 +4869,7 @@ void janus_videoroom_incoming_rtp(janus_plugin_session *handle, janus_plugin_rtp
 		packet.data = rtp;
 		packet.length = len;
 		packet.extensions = pkt->extensions;
+		packet.payload = NULL;
 		packet.is_rtp = TRUE;
 		packet.is_video = video;
 		packet.svc = FALSE;
@@ -4842,6 +4895,7 @@ void janus_videoroom_incoming_rtp(janus_plugin_session *handle, janus_plugin_rtp
 		janus_mutex_lock_nodebug(&participant->subscribers_mutex);
 		g_slist_foreach(participant->subscribers, janus_videoroom_relay_rtp_packet, &packet);
 		janus_mutex_unlock_nodebug(&participant->subscribers_mutex);
+		janus_plugin_rtp_payload_unref(packet.payload);
 
 		/* Check if we need to send any REMB, FIR or PLI back to this publisher */
 		if(video && participant->video_active) {
@@ -5037,6 +5091,75 @@ void janus_videoroom_slow_link(janus_plugin_session *handle, int uplink, int vid
 	janus_refcount_decrease(&session->ref);
 }
 
+void janus_videoroom_estimated_bandwidth(janus_plugin_session *handle, uint32_t estimate) {
+	/* The core is telling us how much bandwidth is available towards a peer */
+	if(handle == NULL || g_atomic_int_get(&handle->stopped) || g_atomic_int_get(&stopping) || !g_atomic_int_get(&initialized) || !gateway)
+		return;
+	janus_mutex_lock(&sessions_mutex);
+	janus_videoroom_session *session = janus_videoroom_lookup_session(handle);
+	if(!session || g_atomic_int_get(&session->destroyed) || !session->participant ||
+			session->participant_type != janus_videoroom_p_type_subscriber) {
+		janus_mutex_unlock(&sessions_mutex);
+		return;
+	}
+	janus_videoroom_subscriber *subscriber = (janus_videoroom_subscriber *)session->participant;
+	if(g_atomic_int_get(&subscriber->destroyed)) {
+		janus_mutex_unlock(&sessions_mutex);
+		return;
+	}
+	janus_refcount_increase(&subscriber->ref);
+	janus_mutex_unlock(&sessions_mutex);
+	/* The core only notifies us when the estimate changes significantly, and
+	 * not more than a few times per second, so we can afford locking here */
+	janus_mutex_lock(&subscriber->mutex);
+	subscriber->estimated_bandwidth = estimate;
+	janus_videoroom_publisher *publisher = subscriber->feed;
+	if(!subscriber->auto_substream || publisher == NULL || g_atomic_int_get(&publisher->destroyed) ||
+			(publisher->ssrc[0] == 0 && publisher->rid[0] == NULL)) {
+		janus_mutex_unlock(&subscriber->mutex);
+		janus_refcount_decrease(&subscriber->ref);
+		return;
+	}
+	janus_refcount_increase(&publisher->ref);
+	/* Pick the highest substream (up to the one the subscriber asked for) that
+	 * fits in the estimate: we're more conservative when going up, and if we
+	 * had to go down recently, we wait a bit before trying to go up again */
+	gint64 now = janus_get_monotonic_time();
+	int current = subscriber->sim_context.substream_target;
+	int substream = 0, i = 0;
+	for(i=subscriber->substream_max; i>0; i--) {
+		guint32 bitrate = publisher->substream_bitrate[i];
+		if(bitrate == 0) {
+			/* The publisher is not sending this substream */
+			continue;
+		}
+		if(i <= current && bitrate <= estimate) {
+			substream = i;
+			break;
+		}
+		if(i > current && (guint64)bitrate*12 <= (guint64)estimate*10 &&
+				now - subscriber->auto_substream_ts >= JANUS_VIDEOROOM_AUTO_SUBSTREAM_BACKOFF) {
+			substream = i;
+			break;
+		}
+	}
+	if(substream != current) {
+		JANUS_LOG(LOG_VERB, "Estimated bandwidth is %"SCNu32", switching to simulcast substream %d (was %d)\n",
+			estimate, substream, current);
+		if(substream < current)
+			subscriber->auto_substream_ts = now;
+		/* The relay may update the target too, and does that with this lock held */
+		janus_mutex_lock(&publisher->subscribers_mutex);
+		subscriber->sim_context.substream_target = substream;
+		janus_mutex_unlock(&publisher->subscribers_mutex);
+	}
+	janus_mutex_unlock(&subscriber->mutex);
+	if(substream != current)
+		janus_videoroom_reqpli(publisher, "Simulcasting substream change");
+	janus_refcount_decrease(&publisher->ref);
+	janus_refcount_decrease(&subscriber->ref);
+}
+
 static void janus_videoroom_recorder_create(janus_videoroom_publisher *participant, gboolean audio, gboolean video, gboolean data) {
 	char filename[255];
 	gint64 now = janus_get_real_time();
@@ -5158,8 +5281,10 @@ static void janus_videoroom_hangup_subscriber(janus_videoroom_subscriber * s) {
 		janus_mutex_unlock(&s->room->mutex);
 	}
 	/* TODO: are we sure this is okay as other handlers use feed directly without synchronization */
+	janus_mutex_lock(&s->mutex);
 	if(s->feed)
 		g_clear_pointer(&s->feed, janus_videoroom_publisher_dereference_by_subscriber);
+	janus_mutex_unlock(&s->mutex);
 	/* Only "leave" the room if we're closing the PeerConnection at this point */
 	if(s->close_pc) {
 		if(s->room)
@@ -5678,6 +5803,7 @@ static void *janus_videoroom_handler(void *data) {
 				}
 				json_t *temporal = json_object_get(root, "temporal_layer");
 				json_t *sc_temporal = json_object_get(root, "temporal");
+				json_t *auto_substream = json_object_get(root, "auto_substream");
 				if(json_integer_value(temporal) < 0 || json_integer_value(temporal) > 2 ||
 						json_integer_value(sc_temporal) < 0 || json_integer_value(sc_temporal) > 2) {
 					JANUS_LOG(LOG_ERR, "Invalid element (temporal/temporal_layer should be 0, 1 or 2)\n");
@@ -5723,6 +5849,7 @@ static void *janus_videoroom_handler(void *data) {
 					subscriber->room_id_str = videoroom->room_id_str ? g_strdup(videoroom->room_id_str) : NULL;
 					subscriber->room = videoroom;
 					videoroom = NULL;
+					janus_mutex_init(&subscriber->mutex);
 					subscriber->feed = publisher;
 					subscriber->pvt_id = pvt_id;
 					subscriber->close_pc = close_pc;
@@ -5765,6 +5892,8 @@ static void *janus_videoroom_handler(void *data) {
 					subscriber->sim_context.rid_ext_id = publisher->rid_extmap_id;
 					subscriber->sim_context.substream_target = sc_substream ? json_integer_value(sc_substream) : 2;
 					subscriber->sim_context.templayer_target = sc_temporal ? json_integer_value(sc_temporal) : 2;
+					subscriber->substream_max = subscriber->sim_context.substream_target;
+					subscriber->auto_substream = auto_substream ? json_is_true(auto_substream) : FALSE;
 					janus_vp8_simulcast_context_reset(&subscriber->vp8_context);
 					/* Check if a VP9 SVC-related request is involved */
 					if(subscriber->room->do_svc) {
@@ -6173,6 +6302,7 @@ static void *janus_videoroom_handler(void *data) {
 				}
 				json_t *temporal = json_object_get(root, "temporal_layer");
 				json_t *sc_temporal = json_object_get(root, "temporal");
+				json_t *auto_substream = json_object_get(root, "auto_substream");
 				if(json_integer_value(temporal) < 0 || json_integer_value(temporal) > 2 ||
 						json_integer_value(sc_temporal) < 0 || json_integer_value(sc_temporal) > 2) {
 					JANUS_LOG(LOG_ERR, "Invalid element (temporal/temporal_layer should be 0, 1 or 2)\n");
@@ -6207,9 +6337,29 @@ static void *janus_videoroom_handler(void *data) {
 					}
 					if(data && publisher->data && subscriber->data_offered)
 						subscriber->data = json_is_true(data);
-					/* Check if a simulcasting-related request is involved */
+					/* Check if a simulcasting-related request is involved: the substream
+					 * target is also updated by the relay and the bandwidth estimate */
+					janus_mutex_lock(&subscriber->mutex);
+					janus_mutex_lock(&publisher->subscribers_mutex);
+					gboolean substream_changed = FALSE;
+					if(auto_substream) {
+						subscriber->auto_substream = json_is_true(auto_substream);
+						if(!subscriber->auto_substream && !sc_substream && (publisher->ssrc[0] != 0 || publisher->rid[0] != NULL) &&
+								subscriber->sim_context.substream_target != subscriber->substream_max) {
+							/* Go back to the substream the subscriber asked for */
+							subscriber->sim_context.substream_target = subscriber->substream_max;
+							substream_changed = TRUE;
+						}
+					}
 					if(sc_substream && (publisher->ssrc[0] != 0 || publisher->rid[0] != NULL)) {
 						subscriber->sim_context.substream_target = json_integer_value(sc_substream);
+						subscriber->substream_max = subscriber->sim_context.substream_target;
+					}
+					janus_mutex_unlock(&publisher->subscribers_mutex);
+					janus_mutex_unlock(&subscriber->mutex);
+					if(substream_changed)
+						janus_videoroom_reqpli(publisher, "Simulcasting substream change");
+					if(sc_substream && (publisher->ssrc[0] != 0 || publisher->rid[0] != NULL)) {
 						JANUS_LOG(LOG_VERB, "Setting video SSRC to let through (simulcast): %"SCNu32" (index %d, was %d)\n",
 							publisher->ssrc[subscriber->sim_context.substream],
 							subscriber->sim_context.substream_target,
@@ -6467,7 +6617,9 @@ static void *janus_videoroom_handler(void *data) {
 					prev_feed->subscribers = g_slist_remove(prev_feed->subscribers, subscriber);
 					janus_mutex_unlock(&prev_feed->subscribers_mutex);
 					janus_refcount_decrease(&prev_feed->session->ref);
+					janus_mutex_lock(&subscriber->mutex);
 					g_clear_pointer(&subscriber->feed, janus_videoroom_publisher_dereference);
+					janus_mutex_unlock(&subscriber->mutex);
 				}
 				/* Subscribe to the new one */
 				subscriber->audio = audio ? json_is_true(audio) : TRUE;	/* True by default */
@@ -6493,7 +6645,9 @@ static void *janus_videoroom_handler(void *data) {
 				janus_mutex_lock(&publisher->subscribers_mutex);
 				publisher->subscribers = g_slist_append(publisher->subscribers, subscriber);
 				janus_mutex_unlock(&publisher->subscribers_mutex);
+				janus_mutex_lock(&subscriber->mutex);
 				subscriber->feed = publisher;
+				janus_mutex_unlock(&subscriber->mutex);
 				/* Send a FIR to the new publisher */
 				janus_videoroom_reqpli(publisher, "Switching existing subscriber to new publisher");
 				/* Done */
@@ -6900,6 +7054,18 @@ error:
 	return NULL;
 }
 
+/* Helper to get the payload to share with the core for all subscribers */
+static janus_plugin_rtp_payload *janus_videoroom_rtp_relay_packet_payload(janus_videoroom_rtp_relay_packet *packet) {
+	if(packet->payload == NULL) {
+		int plen = 0;
+		char *payload = janus_rtp_payload((char *)packet->data, packet->length, &plen);
+		if(payload == NULL || plen < 1)
+			return NULL;
+		packet->payload = janus_plugin_rtp_payload_create(payload, plen);
+	}
+	return packet->payload;
+}
+
 /* Helper to quickly relay RTP packets from publishers to subscribers */
 static void janus_videoroom_relay_rtp_packet(gpointer data, gpointer user_data) {
 	janus_videoroom_rtp_relay_packet *packet = (janus_videoroom_rtp_relay_packet *)user_data;
@@ -7069,7 +7235,7 @@ static void janus_videoroom_relay_rtp_packet(gpointer data, gpointer user_data)
 			}
 			if(gateway != NULL) {
 				janus_plugin_rtp rtp = { .video = packet->is_video, .buffer = (char *)packet->data, .length = packet->length,
-					.extensions = packet->extensions };
+					.extensions = packet->extensions, .payload = janus_videoroom_rtp_relay_packet_payload(packet) };
 				gateway->relay_rtp(session->handle, &rtp);
 			}
 			if(override_mark_bit && !has_marker_bit) {
@@ -7128,6 +7294,9 @@ static void janus_videoroom_relay_rtp_packet(gpointer data, gpointer user_data)
 			if(gateway != NULL) {
 				janus_plugin_rtp rtp = { .video = packet->is_video, .buffer = (char *)packet->data, .length = packet->length,
 					.extensions = packet->extensions };
+				/* The VP8 payload descriptor is rewritten for each subscriber, so we can only share other codecs */
+				if(subscriber->feed == NULL || subscriber->feed->vcodec != JANUS_VIDEOCODEC_VP8)
+					rtp.payload = janus_videoroom_rtp_relay_packet_payload(packet);
 				gateway->relay_rtp(session->handle, &rtp);
 			}
 			/* Restore the timestamp and sequence number to what the publisher set them to */
@@ -7143,7 +7312,7 @@ static void janus_videoroom_relay_rtp_packet(gpointer data, gpointer user_data)
 			/* Send the packet */
 			if(gateway != NULL) {
 				janus_plugin_rtp rtp = { .video = packet->is_video, .buffer = (char *)packet->data, .length = packet->length,
-					.extensions = packet->extensions };
+					.extensions = packet->extensions, .payload = janus_videoroom_rtp_relay_packet_payload(packet) };
 				gateway->relay_rtp(session->handle, &rtp);
 			}
 			/* Restore the timestamp and sequence number to what the publisher set them to */
@@ -7161,7 +7330,7 @@ static void janus_videoroom_relay_rtp_packet(gpointer data, gpointer user_data)
 		/* Send the packet */
 		if(gateway != NULL) {
 			janus_plugin_rtp rtp = { .video = packet->is_video, .buffer = (char *)packet->data, .length = packet->length,
-				.extensions = packet->extensions };
+				.extensions = packet->extensions, .payload = janus_videoroom_rtp_relay_packet_payload(packet) };
 			gateway->relay_rtp(session->handle, &rtp);
 		}
 		/* Restore the timestamp and sequence number to what the publisher set them to */
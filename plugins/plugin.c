@@ -44,6 +44,10 @@ void janus_plugin_rtp_extensions_reset(janus_plugin_rtp_extensions *extensions)
 		extensions->video_rotation = -1;
 		extensions->video_back_camera = FALSE;
 		extensions->video_flipped = FALSE;
+		extensions->transport_seq_num = -1;
+		extensions->framemarking_tid = -1;
+		extensions->mid[0] = '\0';
+		extensions->rid[0] = '\0';
 	}
 }
 void janus_plugin_rtp_reset(janus_plugin_rtp *packet) {
@@ -52,6 +56,24 @@ void janus_plugin_rtp_reset(janus_plugin_rtp *packet) {
 		janus_plugin_rtp_extensions_reset(&packet->extensions);
 	}
 }
+static void janus_plugin_rtp_payload_free(const janus_refcount *payload_ref) {
+	janus_plugin_rtp_payload *payload = janus_refcount_containerof(payload_ref, janus_plugin_rtp_payload, ref);
+	/* The data is part of the same allocation */
+	g_free(payload);
+}
+janus_plugin_rtp_payload *janus_plugin_rtp_payload_create(const char *buffer, uint16_t length) {
+	janus_plugin_rtp_payload *payload = g_malloc(sizeof(janus_plugin_rtp_payload) + length);
+	payload->buffer = (char *)payload + sizeof(janus_plugin_rtp_payload);
+	payload->length = length;
+	if(buffer != NULL && length > 0)
+		memcpy(payload->buffer, buffer, length);
+	janus_refcount_init(&payload->ref, janus_plugin_rtp_payload_free);
+	return payload;
+}
+void janus_plugin_rtp_payload_unref(janus_plugin_rtp_payload *payload) {
+	if(payload)
+		janus_refcount_decrease(&payload->ref);
+}
 void janus_plugin_rtcp_reset(janus_plugin_rtcp *packet) {
 	if(packet)
 		memset(packet, 0, sizeof(janus_plugin_rtcp));
@@ -18,6 +18,9 @@
  * the syntax of the message/event is completely up to you, the only
  * important thing is that it MUST be a JSON object, as it will be included
  * as such within the Janus session/handle protocol;
+ * - \c push_event_text(): to send a JSON message/event that was serialized
+ * in advance (see janus_json_text_new), which is useful when the same
+ * message needs to be sent to many peers, as it's only serialized once;
  * - \c relay_rtp(): to send/relay the peer an RTP packet;
  * - \c relay_rtcp(): to send/relay the peer an RTCP message.
  * - \c relay_data(): to send/relay the peer a SCTP DataChannel message.
@@ -66,12 +69,14 @@ janus_plugin *create(void) {
  * - \c incoming_rtcp(): a callback to notify you a peer has sent you a RTCP message;
  * - \c incoming_data(): a callback to notify you a peer has sent you a message on a SCTP DataChannel;
  * - \c slow_link(): a callback to notify you a peer has sent a lot of NACKs recently, and the media path may be slow;
+ * - \c estimated_bandwidth(): a callback to notify you about how much bandwidth Janus estimates is available towards a peer;
  * - \c hangup_media(): a callback to notify you the peer PeerConnection has been closed (e.g., after a DTLS alert);
  * - \c query_session(): this method is called by the core to get plugin-specific info on a session between you and a peer;
  * - \c destroy_session(): this method is called by the core to destroy a session between you and a peer.
  *
  * All the above methods and callbacks, except for \c incoming_rtp ,
- * \c incoming_rtcp , \c incoming_data and \c slow_link , are mandatory:
+ * \c incoming_rtcp , \c incoming_data , \c slow_link and \c estimated_bandwidth ,
+ * are mandatory:
  * the Janus core will reject a plugin that doesn't implement any of the
  * mandatory callbacks. The previously mentioned ones, instead, are
  * optional, so you're free to implement only those you care about. If
@@ -79,9 +84,9 @@ janus_plugin *create(void) {
  * sense to not implement the \c incoming_data callback at all. At the
  * same time, if your plugin is ONLY going to use data channels and
  * can't care less about RTP or RTCP, \c incoming_rtp and \c incoming_rtcp
- * can be left out. Finally, \c slow_link is just there as a helper, some
- * additional information you may be interested about, but you're not
- * forced to receive it if you don't care.
+ * can be left out. Finally, \c slow_link and \c estimated_bandwidth are
+ * just there as helpers, some additional information you may be interested
+ * about, but you're not forced to receive it if you don't care.
  *
  * The Janus core \c janus_callbacks interface is provided to a plugin, together
  * with the path to the configurations files folder, in the \c init() method.
@@ -160,6 +165,9 @@ janus_plugin *create(void) {
 
 #include "refcount.h"
 
+/* Serialized JSON messages (see utils.h) */
+struct janus_json_text;
+
 
 /*! \brief Version of the API, to match the one plugins were compiled against
  *
@@ -170,7 +178,7 @@ janus_plugin *create(void) {
  * Janus instance or it will crash.
  *
  */
-#define JANUS_PLUGIN_API_VERSION	14
+#define JANUS_PLUGIN_API_VERSION	18
 
 /*! \brief Initialization of all plugin properties to NULL
  *
@@ -206,6 +214,7 @@ static janus_plugin janus_echotest_plugin =
 		.incoming_rtcp = NULL,			\
 		.incoming_data = NULL,			\
 		.slow_link = NULL,				\
+		.estimated_bandwidth = NULL,	\
 		.hangup_media = NULL,			\
 		.destroy_session = NULL,		\
 		.query_session = NULL, 			\
@@ -225,6 +234,8 @@ typedef struct janus_plugin_result janus_plugin_result;
 typedef struct janus_plugin_rtp janus_plugin_rtp;
 /*! \brief RTP extensions parsed in an RTP packet */
 typedef struct janus_plugin_rtp_extensions janus_plugin_rtp_extensions;
+/*! \brief Immutable RTP payload that can be shared by many RTP packets */
+typedef struct janus_plugin_rtp_payload janus_plugin_rtp_payload;
 /*! \brief RTCP message exchanged with the core */
 typedef struct janus_plugin_rtcp janus_plugin_rtcp;
 /*! \brief Data message exchanged with the core */
@@ -327,6 +338,18 @@ struct janus_plugin {
 	 * or downlink (peer to Janus)
 	 * @param[in] video Whether this is related to an audio or a video stream */
 	void (* const slow_link)(janus_plugin_session *handle, gboolean uplink, gboolean video);
+	/*! \brief Method to be notified by the core about the bandwidth it estimates
+	 * is available for sending media to a peer
+	 * \note The estimate is computed by the core out of the transport-wide CC
+	 * feedback the peer sends for the video packets it receives, and so is only
+	 * available when the transport-wide CC extension was negotiated and video
+	 * is being sent to the peer. Decreases in the estimate are notified as soon
+	 * as they're detected, while increases are notified at most once per second.
+	 * This callback is invoked from the thread handling the media for the peer,
+	 * so avoid doing anything expensive in it.
+	 * @param[in] handle The plugin/gateway session used for this peer
+	 * @param[in] estimate The estimated bandwidth towards the peer, in bits per second */
+	void (* const estimated_bandwidth)(janus_plugin_session *handle, uint32_t estimate);
 	/*! \brief Callback to be notified about DTLS alerts from a peer (i.e., the PeerConnection is not valid any more)
 	 * @param[in] handle The plugin/gateway session used for this peer */
 	void (* const hangup_media)(janus_plugin_session *handle);
@@ -355,6 +378,17 @@ struct janus_callbacks {
 	 * @param[in] message The json_t object containing the JSON message
 	 * @param[in] jsep The json_t object containing the JSEP type, the SDP attached to the message/event, if any (offer/answer), and whether this is an update */
 	int (* const push_event)(janus_plugin_session *handle, janus_plugin *plugin, const char *transaction, json_t *message, json_t *jsep);
+	/*! \brief Callback to push an already serialized event/message to a peer
+	 * @note Unlike push_event, no JSEP can be attached: this is meant for events
+	 * that are sent to many peers at the same time (e.g., notifications to all
+	 * participants of a room), which can be serialized only once this way. The
+	 * Janus core takes its own references to the text, so you'll have to release
+	 * yours with a \c janus_json_text_unref when you're done pushing it.
+	 * @param[in] handle The plugin/gateway session used for this peer
+	 * @param[in] plugin The plugin instance that is sending the message/event
+	 * @param[in] transaction The transaction identifier this message refers to
+	 * @param[in] message The serialized JSON message, as returned by janus_json_text_new */
+	int (* const push_event_text)(janus_plugin_session *handle, janus_plugin *plugin, const char *transaction, struct janus_json_text *message);
 
 	/*! \brief Callback to relay RTP packets to a peer
 	 * @param[in] handle The plugin/gateway session used for this peer
@@ -501,7 +535,8 @@ void janus_plugin_result_destroy(janus_plugin_result *result);
  * while this list of extensions is mostly a commodity when receiving a
  * packet, making it easier to access their values (the RTP extensions
  * will still be part of the incoming RTP packet, so plugins are still free
- * to parse them manually), they're very important when it comes to
+ * to parse them manually, but since the core already parsed all of them in
+ * a single pass there should be no need to), they're very important when it comes to
  * outgoing packets instead: in fact, since the Janus core may needs to
  * terminate its own extensions with the peer, all RTP extensions that
  * are in an RTP packet sent by a plugin are stripped when relay_rtp is
@@ -548,6 +583,19 @@ struct janus_plugin_rtp_extensions {
 	/*! \brief Whether the video orientation extension says it's flipped horizontally
 	 * @note Will be ignored if no rotation value is set */
 	gboolean video_flipped;
+	/*! \brief Transport wide sequence number; -1 means no extension
+	 * @note Only set on incoming packets: the core adds its own when relaying packets */
+	int32_t transport_seq_num;
+	/*! \brief Temporal layer ID, from the frame marking extension; -1 means no extension
+	 * @note Only set on incoming packets: ignored when relaying packets */
+	int8_t framemarking_tid;
+	/*! \brief Media ID (mid); an empty string means no extension
+	 * @note Only set on incoming packets: ignored when relaying packets */
+	char mid[17];
+	/*! \brief RTP stream ID (rid), also for retransmissions (repaired-rtp-stream-id);
+	 * an empty string means no extension
+	 * @note Only set on incoming packets: ignored when relaying packets */
+	char rid[17];
 };
 /*! \brief Helper method to initialise/reset the RTP extensions field
  * @note This is important because each of the supported extensions may
@@ -557,6 +605,31 @@ struct janus_plugin_rtp_extensions {
 */
 void janus_plugin_rtp_extensions_reset(janus_plugin_rtp_extensions *extensions);
 
+/*! \brief Janus plugin shared RTP payload
+ * \details When the same RTP packet is relayed to many peers (e.g., a publisher
+ * with many subscribers), plugins can wrap its payload in one of these and
+ * reference it in the janus_plugin_rtp packet they pass to relay_rtp: the
+ * core will then hold a reference to the payload, rather than copying it for
+ * each peer, and will only put the actual packet together when encrypting it.
+ * The payload MUST be the same as the one in the packet buffer, and MUST NOT
+ * be modified after it has been created */
+struct janus_plugin_rtp_payload {
+	/*! \brief The payload data */
+	char *buffer;
+	/*! \brief The payload length */
+	uint16_t length;
+	/*! \brief Reference counter for this instance */
+	janus_refcount ref;
+};
+/*! \brief Helper method to create a shared RTP payload, copying the provided data
+ * @param[in] buffer The RTP payload to copy
+ * @param[in] length The RTP payload length
+ * @returns A new janus_plugin_rtp_payload instance with a single reference */
+janus_plugin_rtp_payload *janus_plugin_rtp_payload_create(const char *buffer, uint16_t length);
+/*! \brief Helper method to release a reference to a shared RTP payload
+ * @param[in] payload The janus_plugin_rtp_payload instance to unref */
+void janus_plugin_rtp_payload_unref(janus_plugin_rtp_payload *payload);
+
 /*! \brief Janus plugin RTP packet */
 struct janus_plugin_rtp {
 	/*! \brief Whether this is an audio or video RTP packet */
@@ -567,6 +640,8 @@ struct janus_plugin_rtp {
 	uint16_t length;
 	/*! \brief RTP extensions */
 	janus_plugin_rtp_extensions extensions;
+	/*! \brief Shared copy of the payload in buffer, if any (only used when sending packets) */
+	janus_plugin_rtp_payload *payload;
 };
 /*! \brief Helper method to initialise/reset the RTP packet
  * @note The main motivation for this method comes from the presence of the
@@ -215,9 +215,9 @@ static void janus_rtcp_incoming_transport_cc(janus_rtcp_context *ctx, janus_rtcp
 		} else {
 			/* Status vector */
 			ss = (chunk & 0x4000) >> 14;
-			length = (s ? 7 : 14);
+			length = (ss ? 7 : 14);
 			JANUS_LOG(LOG_HUGE, "  [%"SCNu16"] t=status-vector, ss=%s, l=%"SCNu8"\n", num,
-				s ? "2-bit" : "bit", length);
+				ss ? "2-bit" : "bit", length);
 			while(length > 0 && psc > 0) {
 				if(!ss)
 					s = (chunk & (1 << (length-1))) ? janus_rtp_packet_status_smalldelta : janus_rtp_packet_status_notreceived;
@@ -240,15 +240,20 @@ static void janus_rtcp_incoming_transport_cc(janus_rtcp_context *ctx, janus_rtcp
 	/* Iterate on all recv deltas */
 	JANUS_LOG(LOG_HUGE, "[TWCC] Recv Deltas (%d/%"SCNu16"):\n", g_list_length(list), status_count);
 	num = 0;
-	uint16_t delta = 0;
-	uint32_t delta_us = 0;
+	int16_t delta = 0;
+	int32_t delta_us = 0;
+	/* The reference time is a signed 24-bit value in multiples of 64ms,
+	 * and deltas are relative to the previous packet that was received */
+	int64_t arrival = (int64_t)((reference & 0x800000) ? (int32_t)(reference | 0xFF000000) : (int32_t)reference) * 64000;
 	GList *iter = list;
-	while(iter != NULL && total > 0) {
+	while(iter != NULL) {
 		num++;
 		delta = 0;
 		s = GPOINTER_TO_UINT(iter->data);
 		if(s == janus_rtp_packet_status_smalldelta) {
 			/* Small delta = 1 byte */
+			if(total < 1)
+				break;
 			delta = *data;
 			total--;
 			data++;
@@ -256,18 +261,24 @@ static void janus_rtcp_incoming_transport_cc(janus_rtcp_context *ctx, janus_rtcp
 			/* Large or negative delta = 2 bytes */
 			if(total < 2)
 				break;
-			memcpy(&delta, data, sizeof(uint16_t));
-			delta = ntohs(delta);
+			uint16_t large = 0;
+			memcpy(&large, data, sizeof(uint16_t));
+			delta = (int16_t)ntohs(large);
 			total -= 2;
 			data += 2;
 		}
 		delta_us = delta*250;
 		/* Print summary */
-		JANUS_LOG(LOG_HUGE, "  [%02"SCNu16"][%"SCNu16"] %s (%"SCNu32"us)\n", num, base_seq+num-1,
+		JANUS_LOG(LOG_HUGE, "  [%02"SCNu16"][%"SCNu16"] %s (%"SCNd32"us)\n", num, base_seq+num-1,
 			janus_rtp_packet_status_description(s), delta_us);
+		/* Pass the packet to whoever is interested in the feedback */
+		gboolean received = (s == janus_rtp_packet_status_smalldelta || s == janus_rtp_packet_status_largeornegativedelta);
+		if(received)
+			arrival += delta_us;
+		if(ctx->twcc_callback != NULL)
+			ctx->twcc_callback(ctx->twcc_callback_data, base_seq+num-1, received, arrival);
 		iter = iter->next;
 	}
-	/* TODO Update the context with the feedback we got */
 	g_list_free(list);
 }
 
@@ -1496,8 +1507,9 @@ int janus_rtcp_nacks(char *packet, int len, GSList *nacks) {
 	return words*4+4;
 }
 
-int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssrc, guint32 media, guint8 feedback_packet_count, GQueue *transport_wide_cc_stats) {
-	if(packet == NULL || size < sizeof(janus_rtcp_header) || transport_wide_cc_stats == NULL || g_queue_is_empty(transport_wide_cc_stats))
+int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssrc, guint32 media, guint8 feedback_packet_count,
+		janus_rtcp_transport_wide_cc_stats *transport_wide_cc_stats, guint count) {
+	if(packet == NULL || size < sizeof(janus_rtcp_header) || transport_wide_cc_stats == NULL || count == 0)
 		return -1;
 
 	memset(packet, 0, size);
@@ -1512,12 +1524,13 @@ int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssr
 	rtcpfb->media = htonl(media);
 
 	/* Get first packet */
-	janus_rtcp_transport_wide_cc_stats *stat = (janus_rtcp_transport_wide_cc_stats *) g_queue_pop_head (transport_wide_cc_stats);
+	guint index = 0;
+	janus_rtcp_transport_wide_cc_stats *stat = &transport_wide_cc_stats[index++];
 	/* Calculate temporal info */
 	guint16 base_seq_num = stat->transport_seq_num;
 	gboolean first_received	= FALSE;
 	guint64 reference_time = 0;
-	guint packet_status_count = g_queue_get_length(transport_wide_cc_stats) + 1;
+	guint packet_status_count = count;
 
 	/*
 		0                   1                   2                   3
@@ -1547,9 +1560,12 @@ int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssr
 	/* Initial time in us */
 	guint64 timestamp = 0;
 
-	/* Store delta array */
-	GQueue *deltas = g_queue_new();
-	GQueue *statuses = g_queue_new();
+	/* Store delta array, and the statuses we haven't written yet (no
+	 * allocation needed, as there can't be more than count of each) */
+	gint deltas[count];
+	guint deltas_len = 0;
+	janus_rtp_packet_status statuses[count];
+	guint statuses_head = 0, statuses_tail = 0;
 	janus_rtp_packet_status last_status = janus_rtp_packet_status_reserved;
 	janus_rtp_packet_status max_status = janus_rtp_packet_status_notreceived;
 	gboolean all_same = TRUE;
@@ -1589,7 +1605,7 @@ int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssr
 			}
 			/* Store delta */
 			/* Overflows are possible here */
-			g_queue_push_tail(deltas, GINT_TO_POINTER(delta));
+			deltas[deltas_len++] = delta;
 			/* Set last time */
 			timestamp = stat->timestamp;
 		}
@@ -1597,7 +1613,7 @@ int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssr
 		/* Check if all previoues ones were equal and this one the first different */
 		if (all_same && last_status!=janus_rtp_packet_status_reserved && status!=last_status) {
 			/* How big was the same run */
-			if (g_queue_get_length(statuses)>7) {
+			if ((statuses_tail - statuses_head)>7) {
 				guint32 word = 0;
 				/* Write run! */
 				/*
@@ -1610,12 +1626,12 @@ int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssr
 				 */
 				word = janus_push_bits(word, 1, 0);
 				word = janus_push_bits(word, 2, last_status);
-				word = janus_push_bits(word, 13, g_queue_get_length(statuses));
+				word = janus_push_bits(word, 13, (statuses_tail - statuses_head));
 				/* Write word */
 				janus_set2(data, len, word);
 				len += 2;
 				/* Remove all statuses */
-				g_queue_clear(statuses);
+				statuses_head = statuses_tail = 0;
 				/* Reset status */
 				last_status = janus_rtp_packet_status_reserved;
 				max_status = janus_rtp_packet_status_notreceived;
@@ -1627,7 +1643,7 @@ int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssr
 		}
 
 		/* Push back statuses, it will be handled later */
-		g_queue_push_tail(statuses, GUINT_TO_POINTER(status));
+		statuses[statuses_tail++] = status;
 
 		/* If it is bigger */
 		if (status>max_status) {
@@ -1640,7 +1656,7 @@ int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssr
 		/* Check if we can still be enqueuing for a run */
 		if (!all_same) {
 			/* Check  */
-			if (!all_same && max_status==janus_rtp_packet_status_largeornegativedelta && g_queue_get_length(statuses)>6) {
+			if (!all_same && max_status==janus_rtp_packet_status_largeornegativedelta && (statuses_tail - statuses_head)>6) {
 				guint32 word = 0;
 				/*
 					0                   1
@@ -1657,7 +1673,7 @@ int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssr
 				size_t i = 0;
 				for (i=0;i<7;++i) {
 					/* Get status */
-					janus_rtp_packet_status status = (janus_rtp_packet_status) GPOINTER_TO_UINT(g_queue_pop_head (statuses));
+					janus_rtp_packet_status status = statuses[statuses_head++];
 					/* Write */
 					word = janus_push_bits(word, 2, (guint8)status);
 				}
@@ -1670,9 +1686,9 @@ int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssr
 				all_same = TRUE;
 
 				/* We need to restore the values, as there may be more elements on the buffer */
-				for (i=0; i<g_queue_get_length(statuses); ++i) {
+				for (i=0; i<(statuses_tail - statuses_head); ++i) {
 					/* Get status */
-					status = (janus_rtp_packet_status) GPOINTER_TO_UINT(g_queue_peek_nth(statuses, i));
+					status = statuses[statuses_head+i];
 					/* If it is bigger */
 					if (status>max_status) {
 						/* Store it */
@@ -1686,7 +1702,7 @@ int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssr
 					/* Store las status */
 					last_status = status;
 				}
-			} else if (!all_same && g_queue_get_length(statuses)>13) {
+			} else if (!all_same && (statuses_tail - statuses_head)>13) {
 				guint32 word = 0;
 				/*
 					0                   1
@@ -1703,7 +1719,7 @@ int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssr
 				guint32 i = 0;
 				for (i=0;i<14;++i) {
 					/* Get status */
-					janus_rtp_packet_status status = (janus_rtp_packet_status) GPOINTER_TO_UINT(g_queue_pop_head (statuses));
+					janus_rtp_packet_status status = statuses[statuses_head++];
 					/* Write */
 					word = janus_push_bits(word, 1, (guint8)status);
 				}
@@ -1716,15 +1732,12 @@ int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssr
 				all_same = TRUE;
 			}
 		}
-		/* Free mem */
-		g_free(stat);
-
 		/* Get next packet stat */
-		stat = (janus_rtcp_transport_wide_cc_stats *) g_queue_pop_head (transport_wide_cc_stats);
+		stat = (index < count) ? &transport_wide_cc_stats[index++] : NULL;
 	}
 
 	/* Get status len */
-	size_t statuses_len = g_queue_get_length(statuses);
+	size_t statuses_len = (statuses_tail - statuses_head);
 
 	/* If not finished yet */
 	if (statuses_len>0) {
@@ -1747,7 +1760,7 @@ int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssr
 			unsigned int i = 0;
 			for (i=0;i<statuses_len;i++) {
 				/* Get each status */
-				janus_rtp_packet_status status = (janus_rtp_packet_status) GPOINTER_TO_UINT(g_queue_pop_head (statuses));
+				janus_rtp_packet_status status = statuses[statuses_head++];
 				/* Write */
 				word = janus_push_bits(word, 2, (guint8)status);
 			}
@@ -1765,7 +1778,7 @@ int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssr
 			unsigned int i = 0;
 			for (i=0;i<statuses_len;i++) {
 				/* Get each status */
-				janus_rtp_packet_status status = (janus_rtp_packet_status) GPOINTER_TO_UINT(g_queue_pop_head (statuses));
+				janus_rtp_packet_status status = statuses[statuses_head++];
 				/* Write */
 				word = janus_push_bits(word, 1, (guint8)status);
 			}
@@ -1778,9 +1791,10 @@ int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssr
 	}
 
 	/* Write now the deltas */
-	while (!g_queue_is_empty(deltas)) {
+	guint d = 0;
+	for (d=0; d<deltas_len; d++) {
 		/* Get next delta */
-		gint delta = GPOINTER_TO_INT(g_queue_pop_head (deltas));
+		gint delta = deltas[d];
 		/* Check size */
 		if (delta<0 || delta>255) {
 			short reported_delta = (short)delta;
@@ -1801,10 +1815,6 @@ int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t size, guint32 ssr
 		}
 	}
 
-	/* Clean mem */
-	g_queue_free(statuses);
-	g_queue_free(deltas);
-
 	/* Add zero padding */
 	while (len%4) {
 		/* Add padding */
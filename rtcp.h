@@ -222,6 +222,13 @@ typedef struct rtcp_xr
 typedef rtcp_xr janus_rtcp_xr;
 
 
+/*! \brief Callback to be notified about the packets reported in incoming transport-wide CC feedback
+ * @param[in] data Opaque pointer that was set in the RTCP context
+ * @param[in] seq The transport-wide sequence number of the packet
+ * @param[in] received Whether the peer received this packet or not
+ * @param[in] arrival If received, the arrival time of the packet according to the peer's clock (in microseconds) */
+typedef void (*janus_rtcp_transport_wide_cc_callback)(void *data, uint16_t seq, gboolean received, int64_t arrival);
+
 /*! \brief Internal RTCP state context (for RR/SR) */
 typedef struct rtcp_context
 {
@@ -277,7 +284,10 @@ typedef struct rtcp_context
 	double out_link_quality;
 	double out_media_link_quality;
 
-	/* TODO Incoming transport-wide CC feedback*/
+	/* Incoming transport-wide CC feedback: if a callback is set, all the
+	 * packets reported in the feedback we receive are passed to it */
+	janus_rtcp_transport_wide_cc_callback twcc_callback;
+	void *twcc_callback_data;
 
 } rtcp_context;
 typedef rtcp_context janus_rtcp_context;
@@ -537,8 +547,10 @@ int janus_rtcp_nacks(char *packet, int len, GSList *nacks);
  * @param[in] ssrc SSRC of the origin stream
  * @param[in] media SSRC of the destination stream
  * @param[in] feedback_packet_count Feedback paccket count
- * @param[in] transport_wide_cc_stats List of rtp packet reception stats
+ * @param[in] transport_wide_cc_stats Array of rtp packet reception stats, ordered by transport sequence number
+ * @param[in] count Number of items in the array
  * @returns The message data length in bytes, if successful, -1 on errors */
-int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t len, guint32 ssrc, guint32 media, guint8 feedback_packet_count, GQueue *transport_wide_cc_stats);
+int janus_rtcp_transport_wide_cc_feedback(char *packet, size_t len, guint32 ssrc, guint32 media, guint8 feedback_packet_count,
+	janus_rtcp_transport_wide_cc_stats *transport_wide_cc_stats, guint count);
 
 #endif
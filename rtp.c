@@ -367,6 +367,118 @@ int janus_rtp_header_extension_replace_id(char *buf, int len, int id, int new_id
 	return -3;
 }
 
+void janus_rtp_extmap_reset(janus_rtp_extmap *extmap) {
+	if(extmap)
+		memset(extmap, 0, sizeof(*extmap));
+}
+
+void janus_rtp_extmap_set(janus_rtp_extmap *extmap, int id, janus_rtp_extension_type type) {
+	if(extmap == NULL || id < 1 || id > 14)
+		return;
+	extmap->type[id] = type;
+}
+
+/* Static helper to copy an SDES item (mid or rid) from an extension */
+static void janus_rtp_header_extension_copy_sdes(char *dst, const char *data, int len) {
+	if(len > 16)
+		len = 16;
+	memcpy(dst, data, len);
+	dst[len] = '\0';
+}
+
+int janus_rtp_header_extensions_parse(char *buf, int len, const janus_rtp_extmap *extmap, janus_rtp_extension_values *values) {
+	if(!buf || len < 12 || !extmap || !values)
+		return -1;
+	values->found = 0;
+	janus_rtp_header *rtp = (janus_rtp_header *)buf;
+	if(rtp->version != 2)
+		return -1;
+	if(!rtp->extension)
+		return 0;
+	int hlen = 12;
+	if(rtp->csrccount)	/* Skip CSRC if needed */
+		hlen += rtp->csrccount*4;
+	if(len < hlen + 4)
+		return -1;
+	janus_rtp_header_extension *ext = (janus_rtp_header_extension *)(buf+hlen);
+	int extlen = ntohs(ext->length)*4;
+	hlen += 4;
+	/* Only 1-Byte extensions are supported, as in the other helpers */
+	if(len <= (hlen + extlen) || ntohs(ext->type) != 0xBEDE)
+		return 0;
+	const uint8_t padding = 0x00, reserved = 0xF;
+	int found = 0, i = 0;
+	while(i < extlen) {
+		uint8_t extid = (uint8_t)buf[hlen+i] >> 4;
+		if(extid == reserved) {
+			break;
+		} else if(extid == padding) {
+			i++;
+			continue;
+		}
+		int idlen = ((uint8_t)buf[hlen+i] & 0xF)+1;
+		/* Make sure the data is within the extensions block */
+		if(i + 1 + idlen > extlen)
+			break;
+		const char *data = buf+hlen+i+1;
+		uint8_t type = extmap->type[extid];
+		switch(type) {
+			case JANUS_RTP_EXTENSION_AUDIO_LEVEL:
+				values->audio_level_vad = ((uint8_t)data[0] & 0x80) >> 7;
+				values->audio_level = (uint8_t)data[0] & 0x7F;
+				break;
+			case JANUS_RTP_EXTENSION_VIDEO_ORIENTATION: {
+				uint8_t byte = (uint8_t)data[0];
+				gboolean r1 = (byte & 0x02) >> 1, r0 = byte & 0x01;
+				values->video_back_camera = (byte & 0x08) >> 3;
+				values->video_flipped = (byte & 0x04) >> 2;
+				values->video_rotation = (r1 && r0) ? 270 : (r1 ? 180 : (r0 ? 90 : 0));
+				break;
+			}
+			case JANUS_RTP_EXTENSION_PLAYOUT_DELAY:
+				if(idlen < 3) {
+					type = JANUS_RTP_EXTENSION_NONE;
+					break;
+				}
+				values->min_delay = ((uint8_t)data[0] << 4) | ((uint8_t)data[1] >> 4);
+				values->max_delay = (((uint8_t)data[1] & 0x0F) << 8) | (uint8_t)data[2];
+				break;
+			case JANUS_RTP_EXTENSION_TRANSPORT_WIDE_CC:
+				if(idlen < 2) {
+					type = JANUS_RTP_EXTENSION_NONE;
+					break;
+				}
+				values->transport_seq_num = ((uint8_t)data[0] << 8) | (uint8_t)data[1];
+				break;
+			case JANUS_RTP_EXTENSION_MID:
+				janus_rtp_header_extension_copy_sdes(values->mid, data, idlen);
+				break;
+			case JANUS_RTP_EXTENSION_RID:
+				janus_rtp_header_extension_copy_sdes(values->rid, data, idlen);
+				break;
+			case JANUS_RTP_EXTENSION_REPAIRED_RID:
+				janus_rtp_header_extension_copy_sdes(values->repaired_rid, data, idlen);
+				break;
+			case JANUS_RTP_EXTENSION_FRAMEMARKING:
+				if(idlen < 2) {
+					type = JANUS_RTP_EXTENSION_NONE;
+					break;
+				}
+				values->framemarking_tid = (uint8_t)data[0] & 0x07;
+				break;
+			default:
+				type = JANUS_RTP_EXTENSION_NONE;
+				break;
+		}
+		if(type != JANUS_RTP_EXTENSION_NONE) {
+			values->found |= (1 << type);
+			found++;
+		}
+		i += 1 + idlen;
+	}
+	return found;
+}
+
 /* RTP context related methods */
 void janus_rtp_switching_context_reset(janus_rtp_switching_context *context) {
 	if(context == NULL)
@@ -60,6 +60,8 @@ typedef struct janus_rtp_packet {
 	gint length;
 	gint64 created;
 	gint64 last_retransmit;
+	/* Pool the packet was allocated from, if any (only used by the core) */
+	void *pool;
 } janus_rtp_packet;
 
 /*! \brief RTP extension */
@@ -229,6 +231,67 @@ int janus_rtp_header_extension_set_transport_wide_cc(char *buf, int len, int id,
  * @returns 0 if found, a negative integer otherwise */
 int janus_rtp_header_extension_replace_id(char *buf, int len, int id, int new_id);
 
+/*! \brief RTP extensions janus_rtp_header_extensions_parse can parse in a single pass */
+typedef enum janus_rtp_extension_type {
+	JANUS_RTP_EXTENSION_NONE = 0,
+	JANUS_RTP_EXTENSION_AUDIO_LEVEL,
+	JANUS_RTP_EXTENSION_VIDEO_ORIENTATION,
+	JANUS_RTP_EXTENSION_PLAYOUT_DELAY,
+	JANUS_RTP_EXTENSION_TRANSPORT_WIDE_CC,
+	JANUS_RTP_EXTENSION_MID,
+	JANUS_RTP_EXTENSION_RID,
+	JANUS_RTP_EXTENSION_REPAIRED_RID,
+	JANUS_RTP_EXTENSION_FRAMEMARKING
+} janus_rtp_extension_type;
+/*! \brief Helper to check whether an extension was found by janus_rtp_header_extensions_parse */
+#define janus_rtp_extension_found(values, type) (((values)->found & (1 << (type))) != 0)
+
+/*! \brief Map of the negotiated (one-byte header) RTP extension IDs to what they are */
+typedef struct janus_rtp_extmap {
+	/*! \brief Type of each extension ID (1-14), as a janus_rtp_extension_type */
+	uint8_t type[16];
+} janus_rtp_extmap;
+/*! \brief Helper to reset an extension map, so that no ID is associated to any extension
+ * @param[in] extmap The janus_rtp_extmap instance to reset */
+void janus_rtp_extmap_reset(janus_rtp_extmap *extmap);
+/*! \brief Helper to associate an extension ID with an extension type
+ * @note Invalid IDs (e.g., -1 for extensions that weren't negotiated) are ignored
+ * @param[in] extmap The janus_rtp_extmap instance to update
+ * @param[in] id The extension ID
+ * @param[in] type The extension type */
+void janus_rtp_extmap_set(janus_rtp_extmap *extmap, int id, janus_rtp_extension_type type);
+
+/*! \brief Values of all the known RTP extensions in a packet, as parsed by janus_rtp_header_extensions_parse */
+typedef struct janus_rtp_extension_values {
+	/*! \brief Mask of the extensions that were found (check with janus_rtp_extension_found) */
+	uint16_t found;
+	/*! \brief Audio level, in dBov (0=max, 127=min), and voice activity */
+	int8_t audio_level;
+	gboolean audio_level_vad;
+	/*! \brief Video orientation rotation (0, 90, 180, 270), camera and flip bits */
+	int16_t video_rotation;
+	gboolean video_back_camera, video_flipped;
+	/*! \brief Minimum and maximum playout delay */
+	uint16_t min_delay, max_delay;
+	/*! \brief Transport wide sequence number */
+	uint16_t transport_seq_num;
+	/*! \brief Temporal layer ID of the frame, from the frame marking extension */
+	uint8_t framemarking_tid;
+	/*! \brief mid, RTP stream ID and repaired RTP stream ID (null terminated) */
+	char mid[17], rid[17], repaired_rid[17];
+} janus_rtp_extension_values;
+/*! \brief Helper to parse all the known RTP extensions in a packet in a single pass
+ * \details Rather than looking for each extension separately, as the specific
+ * parsers above do (which means going through the extensions block again each
+ * time), this walks the extensions block once and, for each ID that is in the
+ * provided map, decodes its value in the related field of the values struct
+ * @param[in] buf The packet data
+ * @param[in] len The packet data length in bytes
+ * @param[in] extmap The map of negotiated extension IDs
+ * @param[out] values The values of the extensions that were found
+ * @returns The number of extensions found, or -1 in case of errors */
+int janus_rtp_header_extensions_parse(char *buf, int len, const janus_rtp_extmap *extmap, janus_rtp_extension_values *values);
+
 /*! \brief RTP context, in order to make sure SSRC changes result in coherent seq/ts increases */
 typedef struct janus_rtp_switching_context {
 	uint32_t a_last_ssrc, a_last_ts, a_base_ts, a_base_ts_prev, a_prev_ts, a_target_ts, a_start_ts,
@@ -27,6 +27,7 @@ int srtp_crypto_get_random(uint8_t *key, int len);
 #define srtp_err_status_ok err_status_ok
 #define srtp_err_status_replay_fail err_status_replay_fail
 #define srtp_err_status_replay_old err_status_replay_old
+#define srtp_err_status_no_ctx err_status_no_ctx
 #define srtp_crypto_policy_set_rtp_default crypto_policy_set_rtp_default
 #define srtp_crypto_policy_set_rtcp_default crypto_policy_set_rtcp_default
 #define srtp_crypto_policy_set_aes_cm_128_hmac_sha1_32 crypto_policy_set_aes_cm_128_hmac_sha1_32
@@ -567,8 +567,7 @@ int janus_sdp_process(void *ice_handle, janus_sdp *remote_sdp, gboolean update)
 						memset(stream->audio_rtcp_ctx, 0, sizeof(*stream->audio_rtcp_ctx));
 						stream->audio_rtcp_ctx->tb = 48000;	/* May change later */
 					}
-					if(component->last_seqs_audio)
-						janus_seq_list_free(&component->last_seqs_audio);
+					janus_seq_window_reset(&component->audio_seq_window);
 					janus_mutex_unlock(&component->mutex);
 				}
 				stream->audio_ssrc_peer = stream->audio_ssrc_peer_new;
@@ -589,8 +588,7 @@ int janus_sdp_process(void *ice_handle, janus_sdp *remote_sdp, gboolean update)
 								memset(stream->video_rtcp_ctx[vindex], 0, sizeof(*stream->video_rtcp_ctx[vindex]));
 								stream->video_rtcp_ctx[vindex]->tb = 90000;
 							}
-							if(component->last_seqs_video[vindex])
-								janus_seq_list_free(&component->last_seqs_video[vindex]);
+							janus_seq_window_reset(&component->video_seq_window[vindex]);
 							janus_mutex_unlock(&component->mutex);
 						}
 					}
@@ -1395,7 +1393,7 @@ char *janus_sdp_merge(void *ice_handle, janus_sdp *anon, gboolean offer) {
 		/* ICE ufrag and pwd, DTLS fingerprint setup and connection a= */
 		gchar *ufrag = NULL;
 		gchar *password = NULL;
-		nice_agent_get_local_credentials(handle->agent, stream->stream_id, &ufrag, &password);
+		janus_ice_get_local_credentials(handle, &ufrag, &password);
 		a = janus_sdp_attribute_create("ice-ufrag", "%s", ufrag);
 		m->attributes = g_list_insert_before(m->attributes, first, a);
 		a = janus_sdp_attribute_create("ice-pwd", "%s", password);
@@ -1475,8 +1473,9 @@ char *janus_sdp_merge(void *ice_handle, janus_sdp *anon, gboolean offer) {
 			}
 			m->attributes = g_list_append(m->attributes, a);
 		}
-		if(!janus_ice_is_full_trickle_enabled()) {
-			/* And now the candidates (but only if we're half-trickling) */
+		if(!janus_ice_is_full_trickle_enabled() || janus_ice_is_mux_enabled()) {
+			/* And now the candidates (but only if we're half-trickling, or
+			 * multiplexing media on a single port, as there's nothing to trickle) */
 			janus_ice_candidates_to_sdp(handle, m, stream->stream_id, 1);
 			/* Since we're half-trickling, we need to notify the peer that these are all the
 			 * candidates we have for this media stream, via an end-of-candidates attribute:
@@ -66,6 +66,7 @@ const char *janus_http_get_package(void);
 gboolean janus_http_is_janus_api_enabled(void);
 gboolean janus_http_is_admin_api_enabled(void);
 int janus_http_send_message(janus_transport_session *transport, void *request_id, gboolean admin, json_t *message);
+int janus_http_send_text(janus_transport_session *transport, void *request_id, gboolean admin, janus_json_text *text);
 void janus_http_session_created(janus_transport_session *transport, guint64 session_id);
 void janus_http_session_over(janus_transport_session *transport, guint64 session_id, gboolean timeout, gboolean claimed);
 void janus_http_session_claimed(janus_transport_session *transport, guint64 session_id);
@@ -89,6 +90,7 @@ static janus_transport janus_http_transport =
 		.is_admin_api_enabled = janus_http_is_admin_api_enabled,
 
 		.send_message = janus_http_send_message,
+		.send_text = janus_http_send_text,
 		.session_created = janus_http_session_created,
 		.session_over = janus_http_session_over,
 		.session_claimed = janus_http_session_claimed,
@@ -126,6 +128,7 @@ typedef struct janus_http_msg {
 	gboolean got_response;				/* Whether this message got a response from the core */
 	json_t *response;					/* The response from the core */
 	volatile gint timeout;				/* Whether the request to the core timed out */
+	gboolean sse;						/* Whether the client accepts a Server-Sent Events stream (text/event-stream) */
 } janus_http_msg;
 static GHashTable *messages = NULL;
 static janus_mutex messages_mutex = JANUS_MUTEX_INITIALIZER;
@@ -149,7 +152,7 @@ static void janus_http_msg_destroy(void *msg) {
 /* Helper for long poll: HTTP events to push per session */
 typedef struct janus_http_session {
 	guint64 session_id;			/* Core session identifier */
-	GAsyncQueue *events;		/* Events to notify for this session */
+	GAsyncQueue *events;		/* Events to notify for this session (janus_json_text) */
 	volatile gint destroyed;	/* Whether this session has been destroyed */
 	janus_refcount ref;			/* Reference counter for this session */
 } janus_http_session;
@@ -163,13 +166,31 @@ static void janus_http_session_destroy(janus_http_session *session) {
 		janus_refcount_decrease(&session->ref);
 }
 
+/* Server-Sent Events: rather than a long poll per batch of events, a client
+ * can ask for a text/event-stream response to the session endpoint, which
+ * we keep open and write events to as soon as the core pushes them */
+static gboolean http_sse = TRUE;
+/* How often we send a heartbeat on open streams (a comment for the client,
+ * and a keepalive for the core on the client's behalf), in seconds */
+#define JANUS_HTTP_SSE_HEARTBEAT	15
+static gint64 sse_heartbeat = JANUS_HTTP_SSE_HEARTBEAT*G_USEC_PER_SEC;
+typedef struct janus_http_sse {
+	janus_transport_session *ts;		/* Transport session of the request that opened the stream */
+	janus_http_session *session;		/* Session whose events we stream */
+	gchar *secret, *token;				/* Credentials to pass in the keepalives we send to the core */
+	gint64 last_heartbeat;				/* When we last sent a heartbeat */
+	gchar *buffer;						/* Event (or heartbeat) we're writing */
+	size_t buflen, bufoffset;			/* Length of the buffer, and how much of it we wrote already */
+} janus_http_sse;
+static int janus_http_sse_start(janus_transport_session *ts, janus_http_session *session, const char *secret, const char *token);
+
 static void janus_http_session_free(const janus_refcount *session_ref) {
 	janus_http_session *session = janus_refcount_containerof(session_ref, janus_http_session, ref);
 	/* This session can be destroyed, free all the resources */
 	if(session->events) {
-		json_t *event = NULL;
+		janus_json_text *event = NULL;
 		while((event = g_async_queue_try_pop(session->events)) != NULL)
-			json_decref(event);
+			janus_json_text_unref(event);
 		g_async_queue_unref(session->events);
 	}
 	g_free(session);
@@ -642,25 +663,34 @@ int janus_http_init(janus_transport_callbacks *callback, const char *config_path
 		janus_config_category *config_cors = janus_config_get_create(config, NULL, janus_config_type_category, "cors");
 		janus_config_category *config_certs = janus_config_get_create(config, NULL, janus_config_type_category, "certificates");
 
-		/* Handle configuration */
+		/* Handle configuration: unless configured otherwise, serialize JSON the way the core does */
+		json_format = janus_json_get_format();
 		janus_config_item *item = janus_config_get(config, config_general, janus_config_type_item, "json");
 		if(item && item->value) {
 			/* Check how we need to format/serialize the JSON output */
-			if(!strcasecmp(item->value, "indented")) {
-				/* Default: indented, we use three spaces for that */
-				json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
-			} else if(!strcasecmp(item->value, "plain")) {
-				/* Not indented and no new lines, but still readable */
-				json_format = JSON_INDENT(0) | JSON_PRESERVE_ORDER;
-			} else if(!strcasecmp(item->value, "compact")) {
-				/* Compact, so no spaces between separators */
-				json_format = JSON_COMPACT | JSON_PRESERVE_ORDER;
+			size_t format = janus_json_format_parse(item->value);
+			if(format == 0) {
+				JANUS_LOG(LOG_WARN, "Unsupported JSON format option '%s', using the core default\n", item->value);
 			} else {
-				JANUS_LOG(LOG_WARN, "Unsupported JSON format option '%s', using default (indented)\n", item->value);
-				json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
+				json_format = format;
 			}
 		}
 
+		/* Can clients ask for Server-Sent Events streams, and how often should we send heartbeats on them? */
+		item = janus_config_get(config, config_general, janus_config_type_item, "sse");
+		if(item && item->value)
+			http_sse = janus_is_true(item->value);
+		item = janus_config_get(config, config_general, janus_config_type_item, "sse_heartbeat");
+		if(item && item->value) {
+			int heartbeat = atoi(item->value);
+			if(heartbeat < 1) {
+				JANUS_LOG(LOG_WARN, "Invalid SSE heartbeat (%s), using default (%d seconds)\n", item->value, JANUS_HTTP_SSE_HEARTBEAT);
+			} else {
+				sse_heartbeat = (gint64)heartbeat*G_USEC_PER_SEC;
+			}
+		}
+		JANUS_LOG(LOG_VERB, "Server-Sent Events %s\n", http_sse ? "enabled" : "disabled");
+
 		/* Check if we need to send events to handlers */
 		janus_config_item *events = janus_config_get(config, config_general, janus_config_type_item, "events");
 		if(events != NULL && events->value != NULL)
@@ -763,6 +793,12 @@ int janus_http_init(janus_transport_callbacks *callback, const char *config_path
 				}
 			}
 		}
+		if(threads > 0 && http_sse) {
+			/* Streams are served by a blocking reader, which would keep a thread of the
+			 * pool busy for as long as they're open: clients will get long polls instead */
+			JANUS_LOG(LOG_WARN, "Server-Sent Events need a thread per connection, disabling them (clients will use long polls)\n");
+			http_sse = FALSE;
+		}
 		item = janus_config_get(config, config_general, janus_config_type_item, "http");
 		if(!item || !item->value || !janus_is_true(item->value)) {
 			JANUS_LOG(LOG_WARN, "HTTP webserver disabled\n");
@@ -1017,24 +1053,14 @@ int janus_http_send_message(janus_transport_session *transport, void *request_id
 		return -1;
 	}
 	if(request_id == NULL) {
-		/* This is an event, add to the session queue */
-		json_t *s = json_object_get(message, "session_id");
-		if(!s || !json_is_integer(s)) {
-			JANUS_LOG(LOG_ERR, "Can't notify event, no session_id...\n");
-			json_decref(message);
+		/* This is an event: serialize it now, as that's what we queue */
+		janus_json_text *text = janus_json_text_new(message, json_format);
+		json_decref(message);
+		if(text == NULL) {
+			JANUS_LOG(LOG_ERR, "Can't notify event, serialization failed...\n");
 			return -1;
 		}
-		guint64 session_id = json_integer_value(s);
-		janus_mutex_lock(&sessions_mutex);
-		janus_http_session *session = g_hash_table_lookup(sessions, &session_id);
-		if(session == NULL || g_atomic_int_get(&session->destroyed)) {
-			JANUS_LOG(LOG_ERR, "Can't notify event, no session object...\n");
-			janus_mutex_unlock(&sessions_mutex);
-			json_decref(message);
-			return -1;
-		}
-		g_async_queue_push(session->events, message);
-		janus_mutex_unlock(&sessions_mutex);
+		return janus_http_send_text(transport, request_id, admin, text);
 	} else {
 		if(request_id == keepalive_id) {
 			/* It's a response from our fake long-poll related keepalive, ignore */
@@ -1077,6 +1103,68 @@ int janus_http_send_message(janus_transport_session *transport, void *request_id
 	return 0;
 }
 
+int janus_http_send_text(janus_transport_session *transport, void *request_id, gboolean admin, janus_json_text *text) {
+	if(text == NULL) {
+		JANUS_LOG(LOG_ERR, "No message...\n");
+		return -1;
+	}
+	if(request_id != NULL) {
+		/* Responses are serialized when the request is completed */
+		json_t *message = json_incref(text->message);
+		janus_json_text_unref(text);
+		return janus_http_send_message(transport, request_id, admin, message);
+	}
+	/* This is an event, add to the session queue: the text may be
+	 * shared with other sessions, so we just keep a reference */
+	json_t *s = json_object_get(text->message, "session_id");
+	if(!s || !json_is_integer(s)) {
+		JANUS_LOG(LOG_ERR, "Can't notify event, no session_id...\n");
+		janus_json_text_unref(text);
+		return -1;
+	}
+	guint64 session_id = json_integer_value(s);
+	janus_mutex_lock(&sessions_mutex);
+	janus_http_session *session = g_hash_table_lookup(sessions, &session_id);
+	if(session == NULL || g_atomic_int_get(&session->destroyed)) {
+		JANUS_LOG(LOG_ERR, "Can't notify event, no session object...\n");
+		janus_mutex_unlock(&sessions_mutex);
+		janus_json_text_unref(text);
+		return -1;
+	}
+	g_async_queue_push(session->events, text);
+	janus_mutex_unlock(&sessions_mutex);
+	return 0;
+}
+
+/* Helper to turn queued events in the payload of a long poll response: if the
+ * client is willing to receive more events at the same time, we pop as many
+ * as we can and return an array, which we build from the serialized events */
+static char *janus_http_events_payload(janus_http_session *session, janus_json_text *event, int max_events) {
+	if(max_events == 1) {
+		/* Payloads are freed with free() when the response is sent */
+		char *payload = malloc(event->length+1);
+		memcpy(payload, event->text, event->length+1);
+		janus_json_text_unref(event);
+		return payload;
+	}
+	GString *list = g_string_sized_new(event->length+2);
+	g_string_append_c(list, '[');
+	int events = 0;
+	while(event != NULL) {
+		if(events > 0)
+			g_string_append_c(list, ',');
+		g_string_append_len(list, event->text, event->length);
+		janus_json_text_unref(event);
+		events++;
+		event = (events < max_events) ? g_async_queue_try_pop(session->events) : NULL;
+	}
+	g_string_append_c(list, ']');
+	char *payload = malloc(list->len+1);
+	memcpy(payload, list->str, list->len+1);
+	g_string_free(list, TRUE);
+	return payload;
+}
+
 void janus_http_session_created(janus_transport_session *transport, guint64 session_id) {
 	if(transport == NULL || transport->transport_p == NULL)
 		return;
@@ -1404,6 +1492,14 @@ int janus_http_handler(void *cls, struct MHD_Connection *connection, const char
 		}
 		janus_refcount_increase(&ts->ref);
 		janus_refcount_increase(&session->ref);
+		if(msg->sse && http_sse) {
+			/* The client wants a stream of events rather than a long poll */
+			JANUS_LOG(LOG_VERB, "Session %"SCNu64" found... streaming events\n", session_id);
+			ret = janus_http_sse_start(ts, session, secret, token);
+			janus_refcount_decrease(&session->ref);
+			janus_refcount_decrease(&ts->ref);
+			goto done;
+		}
 		/* How many messages can we send back in a single response? (just one by default) */
 		int max_events = 1;
 		const char *maxev = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "maxev");
@@ -1416,30 +1512,10 @@ int janus_http_handler(void *cls, struct MHD_Connection *connection, const char
 		}
 		JANUS_LOG(LOG_VERB, "Session %"SCNu64" found... returning up to %d messages\n", session_id, max_events);
 		/* Handle GET, taking the first message from the list */
-		json_t *event = g_async_queue_try_pop(session->events);
+		janus_json_text *event = g_async_queue_try_pop(session->events);
 		if(event != NULL) {
-			if(max_events == 1) {
-				/* Return just this message and leave */
-				gchar *event_text = json_dumps(event, json_format);
-				json_decref(event);
-				ret = janus_http_return_success(ts, event_text);
-			} else {
-				/* The application is willing to receive more events at the same time, anything to report? */
-				json_t *list = json_array();
-				json_array_append_new(list, event);
-				int events = 1;
-				while(events < max_events) {
-					event = g_async_queue_try_pop(session->events);
-					if(event == NULL)
-						break;
-					json_array_append_new(list, event);
-					events++;
-				}
-				/* Return the array of messages and leave */
-				gchar *list_text = json_dumps(list, json_format);
-				json_decref(list);
-				ret = janus_http_return_success(ts, list_text);
-			}
+			/* Return the message(s) and leave */
+			ret = janus_http_return_success(ts, janus_http_events_payload(session, event, max_events));
 		} else {
 			/* Still no message, wait */
 			ret = janus_http_notifier(ts, session, max_events);
@@ -1806,6 +1882,9 @@ int janus_http_headers(void *cls, enum MHD_ValueKind kind, const char *key, cons
 	} else if(!strcasecmp(key, "Access-Control-Request-Headers")) {
 		if(request)
 			request->acrh = strdup(value);
+	} else if(!strcasecmp(key, MHD_HTTP_HEADER_ACCEPT)) {
+		if(request && value && strstr(value, "text/event-stream"))
+			request->sse = TRUE;
 	}
 	return MHD_YES;
 }
@@ -1833,60 +1912,37 @@ int janus_http_notifier(janus_transport_session *ts, janus_http_session *session
 	int ret = MHD_NO;
 	gint64 start = janus_get_monotonic_time();
 	gint64 end = 0;
-	json_t *event = NULL, *list = NULL;
-	gboolean found = FALSE;
+	janus_json_text *event = NULL;
 	/* We have a timeout for the long poll: 30 seconds */
 	while(end-start < 30*G_USEC_PER_SEC) {
 		if(g_atomic_int_get(&session->destroyed))
 			break;
 		event = g_async_queue_try_pop(session->events);
 		if(g_atomic_int_get(&session->destroyed) || g_atomic_int_get(&stopping) || event != NULL) {
-			if(event == NULL)
-				break;
 			/* Gotcha! */
-			found = TRUE;
-			if(max_events == 1) {
-				break;
-			} else {
-				/* The application is willing to receive more events at the same time, anything to report? */
-				if(list == NULL)
-					list = json_array();
-				json_array_append_new(list, event);
-				int events = 1;
-				while(events < max_events) {
-					event = g_async_queue_try_pop(session->events);
-					if(event == NULL)
-						break;
-					json_array_append_new(list, event);
-					events++;
-				}
-				break;
-			}
+			break;
 		}
 		/* Sleep 100ms */
 		g_usleep(100000);
 		end = janus_get_monotonic_time();
 	}
-	if((max_events == 1 && event == NULL) || (max_events > 1 && list == NULL))
-		found = FALSE;
-	if(!found) {
+	char *payload_text = NULL;
+	if(event != NULL) {
+		payload_text = janus_http_events_payload(session, event, max_events);
+	} else {
 		JANUS_LOG(LOG_VERB, "Long poll time out for session %"SCNu64"...\n", session->session_id);
 		/* Turn this into a "keepalive" response */
-		char tr[12];
-		janus_http_random_string(12, (char *)&tr);
-		if(max_events == 1) {
-			event = json_object();
-			json_object_set_new(event, "janus", json_string("keepalive"));
-		} else {
-			list = json_array();
-			event = json_object();
-			json_object_set_new(event, "janus", json_string("keepalive"));
-			json_array_append_new(list, event);
+		json_t *keepalive = json_object();
+		json_object_set_new(keepalive, "janus", json_string("keepalive"));
+		if(max_events > 1) {
+			json_t *list = json_array();
+			json_array_append_new(list, keepalive);
+			keepalive = list;
 		}
 		/* FIXME Improve the Janus protocol keep-alive mechanism in JavaScript */
+		payload_text = json_dumps(keepalive, json_format);
+		json_decref(keepalive);
 	}
-	char *payload_text = json_dumps(max_events == 1 ? event : list, json_format);
-	json_decref(max_events == 1 ? event : list);
 	/* Finish the request by sending the response */
 	JANUS_LOG(LOG_HUGE, "We have a message to serve...\n\t%s\n", payload_text);
 	/* Send event */
@@ -1894,6 +1950,119 @@ int janus_http_notifier(janus_transport_session *ts, janus_http_session *session
 	return ret;
 }
 
+/* Server-Sent Events helpers */
+static void janus_http_sse_keepalive(janus_http_sse *sse) {
+	/* As for long polls, we're bypassing the core for events, so we send
+	 * keepalives on behalf of the client to avoid undesirable timeouts */
+	char tr[12];
+	janus_http_random_string(12, (char *)&tr);
+	json_t *root = json_object();
+	json_object_set_new(root, "janus", json_string("keepalive"));
+	json_object_set_new(root, "session_id", json_integer(sse->session->session_id));
+	json_object_set_new(root, "transaction", json_string(tr));
+	if(sse->secret)
+		json_object_set_new(root, "apisecret", json_string(sse->secret));
+	if(sse->token)
+		json_object_set_new(root, "token", json_string(sse->token));
+	gateway->incoming_request(&janus_http_transport, sse->ts, (void *)keepalive_id, FALSE, root, NULL);
+}
+
+static ssize_t janus_http_sse_reader(void *cls, uint64_t pos, char *buf, size_t max) {
+	janus_http_sse *sse = (janus_http_sse *)cls;
+	/* Wait for the next event to write, unless we're still writing one: notice
+	 * that we can block here, since each connection has its own thread (we
+	 * don't enable Server-Sent Events when the web server uses a thread pool) */
+	while(sse->buffer == NULL) {
+		if(g_atomic_int_get(&stopping) || g_atomic_int_get(&sse->session->destroyed))
+			return MHD_CONTENT_READER_END_OF_STREAM;
+		gint64 now = janus_get_monotonic_time();
+		if(now - sse->last_heartbeat >= sse_heartbeat) {
+			/* Time for a heartbeat */
+			sse->last_heartbeat = now;
+			janus_http_sse_keepalive(sse);
+			sse->buffer = g_strdup(": keepalive\n\n");
+			break;
+		}
+		/* We wake up at least once per second, to check if we should stop */
+		gint64 wait = sse->last_heartbeat + sse_heartbeat - now;
+		janus_json_text *event = g_async_queue_timeout_pop(sse->session->events, MIN(wait, G_USEC_PER_SEC));
+		if(event == NULL)
+			continue;
+		/* Events may be indented, in which case each line gets its own
+		 * data field: clients will join them back with a newline */
+		GString *data = g_string_sized_new(event->length+16);
+		const char *line = event->text, *end = event->text + event->length;
+		while(line < end) {
+			const char *newline = memchr(line, '\n', end - line);
+			size_t len = newline ? (size_t)(newline - line) : (size_t)(end - line);
+			g_string_append_len(data, "data: ", 6);
+			g_string_append_len(data, line, len);
+			g_string_append_c(data, '\n');
+			line += len + 1;
+		}
+		g_string_append_c(data, '\n');
+		janus_json_text_unref(event);
+		sse->buffer = g_string_free(data, FALSE);
+	}
+	if(sse->bufoffset == 0)
+		sse->buflen = strlen(sse->buffer);
+	/* Write as much as we can */
+	size_t towrite = sse->buflen - sse->bufoffset;
+	if(towrite > max)
+		towrite = max;
+	memcpy(buf, sse->buffer + sse->bufoffset, towrite);
+	sse->bufoffset += towrite;
+	if(sse->bufoffset == sse->buflen) {
+		g_free(sse->buffer);
+		sse->buffer = NULL;
+		sse->buflen = 0;
+		sse->bufoffset = 0;
+	}
+	return towrite;
+}
+
+static void janus_http_sse_free(void *cls) {
+	janus_http_sse *sse = (janus_http_sse *)cls;
+	if(sse == NULL)
+		return;
+	JANUS_LOG(LOG_VERB, "Events stream for session %"SCNu64" closed\n", sse->session->session_id);
+	g_free(sse->buffer);
+	g_free(sse->secret);
+	g_free(sse->token);
+	janus_refcount_decrease(&sse->session->ref);
+	janus_refcount_decrease(&sse->ts->ref);
+	g_free(sse);
+}
+
+static int janus_http_sse_start(janus_transport_session *ts, janus_http_session *session, const char *secret, const char *token) {
+	janus_http_msg *msg = (janus_http_msg *)ts->transport_p;
+	if(!msg || !msg->connection)
+		return MHD_NO;
+	janus_http_sse *sse = g_malloc0(sizeof(janus_http_sse));
+	janus_refcount_increase(&ts->ref);
+	sse->ts = ts;
+	janus_refcount_increase(&session->ref);
+	sse->session = session;
+	sse->secret = g_strdup(secret);
+	sse->token = g_strdup(token);
+	/* The request that opened the stream acted as a keepalive already */
+	sse->last_heartbeat = janus_get_monotonic_time();
+	struct MHD_Response *response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN,
+		32*1024, &janus_http_sse_reader, sse, &janus_http_sse_free);
+	if(response == NULL) {
+		janus_http_sse_free(sse);
+		return MHD_NO;
+	}
+	MHD_add_response_header(response, "Content-Type", "text/event-stream");
+	MHD_add_response_header(response, "Cache-Control", "no-cache");
+	/* Ask reverse proxies (e.g., nginx) not to buffer the stream */
+	MHD_add_response_header(response, "X-Accel-Buffering", "no");
+	janus_http_add_cors_headers(msg, response);
+	int ret = MHD_queue_response(msg->connection, MHD_HTTP_OK, response);
+	MHD_destroy_response(response);
+	return ret;
+}
+
 /* Helper to quickly send a success response */
 int janus_http_return_success(janus_transport_session *ts, char *payload) {
 	if(!ts) {
@@ -56,6 +56,7 @@ const char *janus_mqtt_get_package(void);
 gboolean janus_mqtt_is_janus_api_enabled(void);
 gboolean janus_mqtt_is_admin_api_enabled(void);
 int janus_mqtt_send_message(janus_transport_session *transport, void *request_id, gboolean admin, json_t *message);
+int janus_mqtt_send_text(janus_transport_session *transport, void *request_id, gboolean admin, janus_json_text *text);
 void janus_mqtt_session_created(janus_transport_session *transport, guint64 session_id);
 void janus_mqtt_session_over(janus_transport_session *transport, guint64 session_id, gboolean timeout, gboolean claimed);
 void janus_mqtt_session_claimed(janus_transport_session *transport, guint64 session_id);
@@ -85,6 +86,7 @@ static janus_transport janus_mqtt_transport_ =
 		.is_admin_api_enabled = janus_mqtt_is_admin_api_enabled,
 
 		.send_message = janus_mqtt_send_message,
+		.send_text = janus_mqtt_send_text,
 		.session_created = janus_mqtt_session_created,
 		.session_over = janus_mqtt_session_over,
 		.session_claimed = janus_mqtt_session_claimed,
@@ -276,21 +278,16 @@ int janus_mqtt_init(janus_transport_callbacks *callback, const char *config_path
 	janus_config_item *password_item = janus_config_get(config, config_general, janus_config_type_item, "password");
 	ctx->connect.password = g_strdup((password_item && password_item->value) ? password_item->value : "guest");
 
+	/* Unless configured otherwise, serialize JSON the way the core does */
+	json_format_ = janus_json_get_format();
 	janus_config_item *json_item = janus_config_get(config, config_general, janus_config_type_item, "json");
 	if(json_item && json_item->value) {
 		/* Check how we need to format/serialize the JSON output */
-		if(!strcasecmp(json_item->value, "indented")) {
-			/* Default: indented, we use three spaces for that */
-			json_format_ = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
-		} else if(!strcasecmp(json_item->value, "plain")) {
-			/* Not indented and no new lines, but still readable */
-			json_format_ = JSON_INDENT(0) | JSON_PRESERVE_ORDER;
-		} else if(!strcasecmp(json_item->value, "compact")) {
-			/* Compact, so no spaces between separators */
-			json_format_ = JSON_COMPACT | JSON_PRESERVE_ORDER;
+		size_t format = janus_json_format_parse(json_item->value);
+		if(format == 0) {
+			JANUS_LOG(LOG_WARN, "Unsupported JSON format option '%s', using the core default\n", json_item->value);
 		} else {
-			JANUS_LOG(LOG_WARN, "Unsupported JSON format option '%s', using default (indented)\n", json_item->value);
-			json_format_ = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
+			json_format_ = format;
 		}
 	}
 
@@ -666,6 +663,29 @@ int janus_mqtt_send_message(janus_transport_session *transport, void *request_id
 	return 0;
 }
 
+int janus_mqtt_send_text(janus_transport_session *transport, void *request_id, gboolean admin, janus_json_text *text) {
+	if(text == NULL || transport == NULL) {
+		janus_json_text_unref(text);
+		return -1;
+	}
+	/* Not really needed as we always only have a single context, but that's fine */
+	janus_mqtt_context *ctx = (janus_mqtt_context *)transport->transport_p;
+	if(ctx == NULL) {
+		janus_json_text_unref(text);
+		return -1;
+	}
+
+	/* The text may be shared with other recipients, but publishing copies it */
+	JANUS_LOG(LOG_HUGE, "Sending %s API message via MQTT: %s\n", admin ? "admin" : "Janus", text->text);
+	int rc = janus_mqtt_client_publish_message(ctx, text->text, admin);
+	if(rc != MQTTASYNC_SUCCESS) {
+		JANUS_LOG(LOG_ERR, "Can't publish to MQTT topic: %s, return code: %d\n", admin ? ctx->admin.publish.topic : ctx->publish.topic, rc);
+	}
+	janus_json_text_unref(text);
+
+	return 0;
+}
+
 void janus_mqtt_session_created(janus_transport_session *transport, guint64 session_id) {
 	/* We don't care */
 }
@@ -51,6 +51,7 @@ const char *janus_nanomsg_get_package(void);
 gboolean janus_nanomsg_is_janus_api_enabled(void);
 gboolean janus_nanomsg_is_admin_api_enabled(void);
 int janus_nanomsg_send_message(janus_transport_session *transport, void *request_id, gboolean admin, json_t *message);
+int janus_nanomsg_send_text(janus_transport_session *transport, void *request_id, gboolean admin, janus_json_text *text);
 void janus_nanomsg_session_created(janus_transport_session *transport, guint64 session_id);
 void janus_nanomsg_session_over(janus_transport_session *transport, guint64 session_id, gboolean timeout, gboolean claimed);
 void janus_nanomsg_session_claimed(janus_transport_session *transport, guint64 session_id);
@@ -74,6 +75,7 @@ static janus_transport janus_nanomsg_transport =
 		.is_admin_api_enabled = janus_nanomsg_is_admin_api_enabled,
 
 		.send_message = janus_nanomsg_send_message,
+		.send_text = janus_nanomsg_send_text,
 		.session_created = janus_nanomsg_session_created,
 		.session_over = janus_nanomsg_session_over,
 		.session_claimed = janus_nanomsg_session_claimed,
@@ -108,7 +110,7 @@ static int write_nfd[2];
 /* Nanomsg client session */
 typedef struct janus_nanomsg_client {
 	gboolean admin;					/* Whether this client is for the Admin or Janus API */
-	GAsyncQueue *messages;			/* Queue of outgoing messages to push */
+	GAsyncQueue *messages;			/* Queue of outgoing messages to push (janus_json_text) */
 	janus_transport_session *ts;	/* Janus core-transport session */
 } janus_nanomsg_client;
 /* We only handle a single client per API, since we use NN_PAIR and we bind locally */
@@ -145,21 +147,16 @@ int janus_nanomsg_init(janus_transport_callbacks *callback, const char *config_p
 		janus_config_print(config);
 		janus_config_category *config_general = janus_config_get_create(config, NULL, janus_config_type_category, "general");
 
+		/* Unless configured otherwise, serialize JSON the way the core does */
+		json_format = janus_json_get_format();
 		janus_config_item *item = janus_config_get(config, config_general, janus_config_type_item, "json");
 		if(item && item->value) {
 			/* Check how we need to format/serialize the JSON output */
-			if(!strcasecmp(item->value, "indented")) {
-				/* Default: indented, we use three spaces for that */
-				json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
-			} else if(!strcasecmp(item->value, "plain")) {
-				/* Not indented and no new lines, but still readable */
-				json_format = JSON_INDENT(0) | JSON_PRESERVE_ORDER;
-			} else if(!strcasecmp(item->value, "compact")) {
-				/* Compact, so no spaces between separators */
-				json_format = JSON_COMPACT | JSON_PRESERVE_ORDER;
+			size_t format = janus_json_format_parse(item->value);
+			if(format == 0) {
+				JANUS_LOG(LOG_WARN, "Unsupported JSON format option '%s', using the core default\n", item->value);
 			} else {
-				JANUS_LOG(LOG_WARN, "Unsupported JSON format option '%s', using default (indented)\n", item->value);
-				json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
+				json_format = format;
 			}
 		}
 
@@ -379,10 +376,18 @@ int janus_nanomsg_send_message(janus_transport_session *transport, void *request
 	if(message == NULL)
 		return -1;
 	/* Convert to string */
-	char *payload = json_dumps(message, json_format);
+	janus_json_text *text = janus_json_text_new(message, json_format);
 	json_decref(message);
+	if(text == NULL)
+		return -1;
+	return janus_nanomsg_send_text(transport, request_id, admin, text);
+}
+
+int janus_nanomsg_send_text(janus_transport_session *transport, void *request_id, gboolean admin, janus_json_text *text) {
+	if(text == NULL)
+		return -1;
 	/* Enqueue the packet and have poll tell us when it's time to send it */
-	g_async_queue_push(admin ? admin_client.messages : client.messages, payload);
+	g_async_queue_push(admin ? admin_client.messages : client.messages, text);
 	/* Notify the thread there's data to send */
 	(void)nn_send(write_nfd[1], "x", 1, 0);
 	return 0;
@@ -451,12 +456,12 @@ void *janus_nanomsg_thread(void *data) {
 			if(poll_nfds[i].revents & NN_POLLOUT) {
 				/* Find the client from its file descriptor */
 				if(poll_nfds[i].fd == nfd || poll_nfds[i].fd == admin_nfd) {
-					char *payload = NULL;
+					janus_json_text *payload = NULL;
 					while((payload = g_async_queue_try_pop(poll_nfds[i].fd == nfd ? client.messages : admin_client.messages)) != NULL) {
-						int res = nn_send(poll_nfds[i].fd, payload, strlen(payload), 0);
+						int res = nn_send(poll_nfds[i].fd, payload->text, payload->length, 0);
 						/* FIXME Should we check if sent everything? */
-						JANUS_LOG(LOG_HUGE, "Written %d/%zu bytes on %d\n", res, strlen(payload), poll_nfds[i].fd);
-						g_free(payload);
+						JANUS_LOG(LOG_HUGE, "Written %d/%zu bytes on %d\n", res, payload->length, poll_nfds[i].fd);
+						janus_json_text_unref(payload);
 					}
 				}
 			}
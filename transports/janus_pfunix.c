@@ -21,6 +21,11 @@
  * the events related to it is done automatically, so no need for an
  * explicit request as the GET in the plain HTTP API. Closing a client
  * Unix Socket will also destroy all the sessions it created.
+ * \note If \c cbor is enabled in the configuration, clients can also send
+ * requests encoded as CBOR (RFC 8949) rather than JSON: the same Janus
+ * API messages are used, just with a binary encoding. Whenever a client
+ * sends a CBOR request, responses and events are sent back as CBOR too,
+ * until the client sends a JSON request again.
  *
  * \ingroup transports
  * \ref transports
@@ -66,6 +71,7 @@ const char *janus_pfunix_get_package(void);
 gboolean janus_pfunix_is_janus_api_enabled(void);
 gboolean janus_pfunix_is_admin_api_enabled(void);
 int janus_pfunix_send_message(janus_transport_session *transport, void *request_id, gboolean admin, json_t *message);
+int janus_pfunix_send_text(janus_transport_session *transport, void *request_id, gboolean admin, janus_json_text *text);
 void janus_pfunix_session_created(janus_transport_session *transport, guint64 session_id);
 void janus_pfunix_session_over(janus_transport_session *transport, guint64 session_id, gboolean timeout, gboolean claimed);
 void janus_pfunix_session_claimed(janus_transport_session *transport, guint64 session_id);
@@ -89,6 +95,7 @@ static janus_transport janus_pfunix_transport =
 		.is_admin_api_enabled = janus_pfunix_is_admin_api_enabled,
 
 		.send_message = janus_pfunix_send_message,
+		.send_text = janus_pfunix_send_text,
 		.session_created = janus_pfunix_session_created,
 		.session_over = janus_pfunix_session_over,
 		.session_claimed = janus_pfunix_session_claimed,
@@ -108,6 +115,8 @@ static gboolean notify_events = TRUE;
 
 /* JSON serialization options */
 static size_t json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
+/* Whether clients can talk CBOR rather than JSON */
+static gboolean cbor_enabled = FALSE;
 
 #define BUFFER_SIZE		8192
 
@@ -134,7 +143,8 @@ typedef struct janus_pfunix_client {
 	int fd;							/* Client socket (in case SOCK_SEQPACKET is used) */
 	struct sockaddr_un addr;		/* Client address (in case SOCK_DGRAM is used) */
 	gboolean admin;					/* Whether this client is for the Admin or Janus API */
-	GAsyncQueue *messages;			/* Queue of outgoing messages to push */
+	GAsyncQueue *messages;			/* Queue of outgoing messages to push (GBytes) */
+	volatile gint cbor;				/* Whether the client's last request was CBOR, and so our responses should be too (atomic) */
 	gboolean session_timeout;		/* Whether a Janus session timeout occurred in the core */
 	janus_transport_session *ts;	/* Janus core-transport session */
 } janus_pfunix_client;
@@ -147,15 +157,27 @@ static void janus_pfunix_client_free(void *client_ref) {
 	JANUS_LOG(LOG_WARN, "Freeing unix sockets client\n");
 	janus_pfunix_client *client = (janus_pfunix_client *) client_ref;
 	if(client->messages != NULL) {
-		char *response = NULL;
+		GBytes *response = NULL;
 		while((response = g_async_queue_try_pop(client->messages)) != NULL) {
-			g_free(response);
+			g_bytes_unref(response);
 		}
 		g_async_queue_unref(client->messages);
 	}
 	g_free(client);
 }
 
+/* Helper to parse an incoming message: if CBOR is enabled and the client
+ * sent us a CBOR map rather than a JSON object, we answer in CBOR too */
+static json_t *janus_pfunix_parse(janus_pfunix_client *client, char *buffer, int length, json_error_t *error) {
+	/* Responses are sent by other threads, so we update this atomically */
+	gboolean cbor = cbor_enabled && janus_cbor_is_message(buffer, length);
+	g_atomic_int_set(&client->cbor, cbor);
+	if(cbor)
+		return janus_cbor_decode(buffer, length, error);
+	JANUS_LOG(LOG_HUGE, "%s\n", buffer);
+	return json_loads(buffer, 0, error);
+}
+
 
 /* Helper to create a named Unix Socket out of the path to link to */
 static int janus_pfunix_create_socket(char *pfname, gboolean use_dgram) {
@@ -229,24 +251,24 @@ int janus_pfunix_init(janus_transport_callbacks *callback, const char *config_pa
 		janus_config_category *config_general = janus_config_get_create(config, NULL, janus_config_type_category, "general");
 		janus_config_category *config_admin = janus_config_get_create(config, NULL, janus_config_type_category, "admin");
 
+		/* Unless configured otherwise, serialize JSON the way the core does */
+		json_format = janus_json_get_format();
 		janus_config_item *item = janus_config_get(config, config_general, janus_config_type_item, "json");
 		if(item && item->value) {
 			/* Check how we need to format/serialize the JSON output */
-			if(!strcasecmp(item->value, "indented")) {
-				/* Default: indented, we use three spaces for that */
-				json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
-			} else if(!strcasecmp(item->value, "plain")) {
-				/* Not indented and no new lines, but still readable */
-				json_format = JSON_INDENT(0) | JSON_PRESERVE_ORDER;
-			} else if(!strcasecmp(item->value, "compact")) {
-				/* Compact, so no spaces between separators */
-				json_format = JSON_COMPACT | JSON_PRESERVE_ORDER;
+			size_t format = janus_json_format_parse(item->value);
+			if(format == 0) {
+				JANUS_LOG(LOG_WARN, "Unsupported JSON format option '%s', using the core default\n", item->value);
 			} else {
-				JANUS_LOG(LOG_WARN, "Unsupported JSON format option '%s', using default (indented)\n", item->value);
-				json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
+				json_format = format;
 			}
 		}
 
+		/* Check if clients can use CBOR instead of JSON */
+		item = janus_config_get(config, config_general, janus_config_type_item, "cbor");
+		if(item && item->value)
+			cbor_enabled = janus_is_true(item->value);
+
 		/* Check if we need to send events to handlers */
 		janus_config_item *events = janus_config_get(config, config_general, janus_config_type_item, "events");
 		if(events != NULL && events->value != NULL)
@@ -408,30 +430,28 @@ gboolean janus_pfunix_is_admin_api_enabled(void) {
 	return admin_pfd > -1;
 }
 
-int janus_pfunix_send_message(janus_transport_session *transport, void *request_id, gboolean admin, json_t *message) {
-	if(message == NULL)
-		return -1;
-	if(transport == NULL || transport->transport_p == NULL) {
-		json_decref(message);
-		return -1;
-	}
-	/* Make sure this is related to a still valid Unix Sockets session */
+/* Helper to make sure a transport session is related to a still valid Unix Sockets session */
+static janus_pfunix_client *janus_pfunix_client_get(janus_transport_session *transport) {
+	if(transport == NULL || transport->transport_p == NULL)
+		return NULL;
 	janus_pfunix_client *client = (janus_pfunix_client *)transport->transport_p;
 	janus_mutex_lock(&clients_mutex);
 	if(g_hash_table_lookup(clients, client) == NULL) {
 		janus_mutex_unlock(&clients_mutex);
 		JANUS_LOG(LOG_WARN, "Outgoing message for invalid client %p\n", client);
-		json_decref(message);
-		message = NULL;
-		return -1;
+		return NULL;
 	}
 	janus_mutex_unlock(&clients_mutex);
-	/* Convert to string */
-	char *payload = json_dumps(message, json_format);
-	json_decref(message);
+	return client;
+}
+
+/* Helper to send serialized data to a client (takes ownership of the bytes) */
+static void janus_pfunix_send_bytes(janus_pfunix_client *client, GBytes *bytes) {
+	gsize length = 0;
+	const void *payload = g_bytes_get_data(bytes, &length);
 	if(client->fd != -1) {
 		/* SOCK_SEQPACKET, enqueue the packet and have poll tell us when it's time to send it */
-		g_async_queue_push(client->messages, payload);
+		g_async_queue_push(client->messages, bytes);
 		/* Notify the thread there's data to send */
 		int res = 0;
 		do {
@@ -441,10 +461,62 @@ int janus_pfunix_send_message(janus_transport_session *transport, void *request_
 		/* SOCK_DGRAM, send it right away */
 		int res = 0;
 		do {
-			res = sendto(client->admin ? admin_pfd : pfd, payload, strlen(payload), 0, (struct sockaddr *)&client->addr, sizeof(struct sockaddr_un));
+			res = sendto(client->admin ? admin_pfd : pfd, payload, length, 0, (struct sockaddr *)&client->addr, sizeof(struct sockaddr_un));
 		} while(res == -1 && errno == EINTR);
-		free(payload);
+		g_bytes_unref(bytes);
+	}
+}
+
+int janus_pfunix_send_message(janus_transport_session *transport, void *request_id, gboolean admin, json_t *message) {
+	if(message == NULL)
+		return -1;
+	janus_pfunix_client *client = janus_pfunix_client_get(transport);
+	if(client == NULL) {
+		json_decref(message);
+		return -1;
+	}
+	/* Convert to string, or to CBOR if that's what the client is using */
+	char *payload = NULL;
+	size_t length = 0;
+	GBytes *bytes = NULL;
+	if(g_atomic_int_get(&client->cbor)) {
+		payload = janus_cbor_encode(message, &length);
+		if(payload != NULL)
+			bytes = g_bytes_new_take(payload, length);
+	} else {
+		payload = json_dumps(message, json_format);
+		if(payload != NULL) {
+			length = strlen(payload);
+			bytes = g_bytes_new_with_free_func(payload, length, free, payload);
+		}
+	}
+	json_decref(message);
+	if(bytes == NULL) {
+		JANUS_LOG(LOG_ERR, "Failed to serialize outgoing message for client %p\n", client);
+		return -1;
+	}
+	janus_pfunix_send_bytes(client, bytes);
+	return 0;
+}
+
+int janus_pfunix_send_text(janus_transport_session *transport, void *request_id, gboolean admin, janus_json_text *text) {
+	if(text == NULL)
+		return -1;
+	janus_pfunix_client *client = janus_pfunix_client_get(transport);
+	if(client == NULL) {
+		janus_json_text_unref(text);
+		return -1;
+	}
+	if(g_atomic_int_get(&client->cbor)) {
+		/* The client is using CBOR, so we can't use the text as it is */
+		json_t *message = json_incref(text->message);
+		janus_json_text_unref(text);
+		return janus_pfunix_send_message(transport, request_id, admin, message);
 	}
+	/* The text may be shared with other clients, so we just keep a reference */
+	GBytes *bytes = g_bytes_new_with_free_func(text->text, text->length,
+		(GDestroyNotify)janus_json_text_unref, text);
+	janus_pfunix_send_bytes(client, bytes);
 	return 0;
 }
 
@@ -605,17 +677,19 @@ void *janus_pfunix_thread(void *data) {
 				janus_mutex_lock(&clients_mutex);
 				janus_pfunix_client *client = g_hash_table_lookup(clients_by_fd, GINT_TO_POINTER(poll_fds[i].fd));
 				if(client != NULL) {
-					char *payload = NULL;
-					while((payload = g_async_queue_try_pop(client->messages)) != NULL) {
+					GBytes *bytes = NULL;
+					while((bytes = g_async_queue_try_pop(client->messages)) != NULL) {
+						gsize length = 0;
+						const void *payload = g_bytes_get_data(bytes, &length);
 						int res = 0;
 						do {
 							if(client->fd < 0)
 								break;
-							res = write(client->fd, payload, strlen(payload));
+							res = write(client->fd, payload, length);
 						} while(res == -1 && errno == EINTR);
 						/* FIXME Should we check if sent everything? */
-						JANUS_LOG(LOG_HUGE, "Written %d/%zu bytes on %d\n", res, strlen(payload), client->fd);
-						g_free(payload);
+						JANUS_LOG(LOG_HUGE, "Written %d/%zu bytes on %d\n", res, length, client->fd);
+						g_bytes_unref(bytes);
 					}
 					if(client->session_timeout) {
 						/* We should actually get rid of this connection, now */
@@ -626,9 +700,9 @@ void *janus_pfunix_thread(void *data) {
 						g_hash_table_remove(clients_by_fd, GINT_TO_POINTER(poll_fds[i].fd));
 						g_hash_table_remove(clients, client);
 						if(client->messages != NULL) {
-							char *response = NULL;
+							GBytes *response = NULL;
 							while((response = g_async_queue_try_pop(client->messages)) != NULL) {
-								g_free(response);
+								g_bytes_unref(response);
 							}
 							g_async_queue_unref(client->messages);
 						}
@@ -657,6 +731,7 @@ void *janus_pfunix_thread(void *data) {
 							memset(&client->addr, 0, sizeof(client->addr));
 							client->admin = (poll_fds[i].fd == admin_pfd);	/* API client type */
 							client->messages = g_async_queue_new();
+							g_atomic_int_set(&client->cbor, 0);
 							client->session_timeout = FALSE;
 							/* Create a transport instance as well */
 							client->ts = janus_transport_session_create(client, janus_pfunix_client_free);
@@ -704,6 +779,7 @@ void *janus_pfunix_thread(void *data) {
 							memcpy(&client->addr, uaddr, sizeof(struct sockaddr_un));
 							client->admin = (poll_fds[i].fd == admin_pfd);	/* API client type */
 							client->messages = g_async_queue_new();
+							g_atomic_int_set(&client->cbor, 0);
 							client->session_timeout = FALSE;
 							/* Create a transport instance as well */
 							client->ts = janus_transport_session_create(client, janus_pfunix_client_free);
@@ -722,10 +798,9 @@ void *janus_pfunix_thread(void *data) {
 						}
 						janus_mutex_unlock(&clients_mutex);
 						JANUS_LOG(LOG_VERB, "Message from client %s (%d bytes)\n", uaddr->sun_path, res);
-						JANUS_LOG(LOG_HUGE, "%s\n", buffer);
-						/* Parse the JSON payload */
+						/* Parse the JSON (or CBOR) payload */
 						json_error_t error;
-						json_t *root = json_loads(buffer, 0, &error);
+						json_t *root = janus_pfunix_parse(client, buffer, res, &error);
 						/* Notify the core, passing both the object and, since it may be needed, the error */
 						gateway->incoming_request(&janus_pfunix_transport, client->ts, NULL, client->admin, root, &error);
 					}
@@ -781,10 +856,9 @@ void *janus_pfunix_thread(void *data) {
 					/* If we got here, there's data to handle */
 					buffer[res] = '\0';
 					JANUS_LOG(LOG_VERB, "Message from client %d (%d bytes)\n", poll_fds[i].fd, res);
-					JANUS_LOG(LOG_HUGE, "%s\n", buffer);
-					/* Parse the JSON payload */
+					/* Parse the JSON (or CBOR) payload */
 					json_error_t error;
-					json_t *root = json_loads(buffer, 0, &error);
+					json_t *root = janus_pfunix_parse(client, buffer, res, &error);
 					/* Notify the core, passing both the object and, since it may be needed, the error */
 					gateway->incoming_request(&janus_pfunix_transport, client->ts, NULL, client->admin, root, &error);
 				}
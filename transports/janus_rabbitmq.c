@@ -67,6 +67,7 @@ const char *janus_rabbitmq_get_package(void);
 gboolean janus_rabbitmq_is_janus_api_enabled(void);
 gboolean janus_rabbitmq_is_admin_api_enabled(void);
 int janus_rabbitmq_send_message(janus_transport_session *transport, void *request_id, gboolean admin, json_t *message);
+int janus_rabbitmq_send_text(janus_transport_session *transport, void *request_id, gboolean admin, janus_json_text *text);
 void janus_rabbitmq_session_created(janus_transport_session *transport, guint64 session_id);
 void janus_rabbitmq_session_over(janus_transport_session *transport, guint64 session_id, gboolean timeout, gboolean claimed);
 void janus_rabbitmq_session_claimed(janus_transport_session *transport, guint64 session_id);
@@ -90,6 +91,7 @@ static janus_transport janus_rabbitmq_transport =
 		.is_admin_api_enabled = janus_rabbitmq_is_admin_api_enabled,
 
 		.send_message = janus_rabbitmq_send_message,
+		.send_text = janus_rabbitmq_send_text,
 		.session_created = janus_rabbitmq_session_created,
 		.session_over = janus_rabbitmq_session_over,
 		.session_claimed = janus_rabbitmq_session_claimed,
@@ -138,7 +140,7 @@ typedef struct janus_rabbitmq_client {
 typedef struct janus_rabbitmq_response {
 	gboolean admin;			/* Whether this is a Janus or Admin API response */
 	char *correlation_id;	/* Correlation ID, if any */
-	char *payload;			/* Payload to send to the client */
+	janus_json_text *payload;	/* Payload to send to the client (may be shared) */
 } janus_rabbitmq_response;
 static janus_rabbitmq_response exit_message;
 
@@ -187,21 +189,16 @@ int janus_rabbitmq_init(janus_transport_callbacks *callback, const char *config_
 	janus_config_category *config_general = janus_config_get_create(config, NULL, janus_config_type_category, "general");
 	janus_config_category *config_admin = janus_config_get_create(config, NULL, janus_config_type_category, "admin");
 
+	/* Unless configured otherwise, serialize JSON the way the core does */
+	json_format = janus_json_get_format();
 	janus_config_item *item = janus_config_get(config, config_general, janus_config_type_item, "json");
 	if(item && item->value) {
 		/* Check how we need to format/serialize the JSON output */
-		if(!strcasecmp(item->value, "indented")) {
-			/* Default: indented, we use three spaces for that */
-			json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
-		} else if(!strcasecmp(item->value, "plain")) {
-			/* Not indented and no new lines, but still readable */
-			json_format = JSON_INDENT(0) | JSON_PRESERVE_ORDER;
-		} else if(!strcasecmp(item->value, "compact")) {
-			/* Compact, so no spaces between separators */
-			json_format = JSON_COMPACT | JSON_PRESERVE_ORDER;
+		size_t format = janus_json_format_parse(item->value);
+		if(format == 0) {
+			JANUS_LOG(LOG_WARN, "Unsupported JSON format option '%s', using the core default\n", item->value);
 		} else {
-			JANUS_LOG(LOG_WARN, "Unsupported JSON format option '%s', using default (indented)\n", item->value);
-			json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
+			json_format = format;
 		}
 	}
 
@@ -616,16 +613,27 @@ int janus_rabbitmq_send_message(janus_transport_session *transport, void *reques
 		return -1;
 	if(message == NULL)
 		return -1;
+	janus_json_text *text = janus_json_text_new(message, json_format);
+	json_decref(message);
+	if(text == NULL)
+		return -1;
+	return janus_rabbitmq_send_text(transport, request_id, admin, text);
+}
+
+int janus_rabbitmq_send_text(janus_transport_session *transport, void *request_id, gboolean admin, janus_json_text *text) {
+	if(rmq_client == NULL || text == NULL) {
+		janus_json_text_unref(text);
+		return -1;
+	}
 	if(transport == NULL || transport->transport_p == NULL || g_atomic_int_get(&transport->destroyed)) {
-		json_decref(message);
+		janus_json_text_unref(text);
 		return -1;
 	}
 	JANUS_LOG(LOG_HUGE, "Sending %s API %s via RabbitMQ\n", admin ? "admin" : "Janus", request_id ? "response" : "event");
 	/* FIXME Add to the queue of outgoing messages */
 	janus_rabbitmq_response *response = g_malloc(sizeof(janus_rabbitmq_response));
 	response->admin = admin;
-	response->payload = json_dumps(message, json_format);
-	json_decref(message);
+	response->payload = text;
 	response->correlation_id = (char *)request_id;
 	g_async_queue_push(rmq_client->messages, response);
 	return 0;
@@ -752,10 +760,10 @@ void *janus_rmq_out_thread(void *data) {
 			break;
 		if(!rmq_client->destroy && !g_atomic_int_get(&stopping) && response->payload) {
 			janus_mutex_lock(&rmq_client->mutex);
-			/* Gotcha! Convert json_t to string */
-			char *payload_text = response->payload;
-			JANUS_LOG(LOG_VERB, "Sending %s API message to RabbitMQ (%zu bytes)...\n", response->admin ? "Admin" : "Janus", strlen(payload_text));
-			JANUS_LOG(LOG_VERB, "%s\n", payload_text);
+			/* Gotcha! */
+			janus_json_text *payload = response->payload;
+			JANUS_LOG(LOG_VERB, "Sending %s API message to RabbitMQ (%zu bytes)...\n", response->admin ? "Admin" : "Janus", payload->length);
+			JANUS_LOG(LOG_VERB, "%s\n", payload->text);
 			amqp_basic_properties_t props;
 			props._flags = 0;
 			props._flags |= AMQP_BASIC_REPLY_TO_FLAG;
@@ -766,7 +774,9 @@ void *janus_rmq_out_thread(void *data) {
 			}
 			props._flags |= AMQP_BASIC_CONTENT_TYPE_FLAG;
 			props.content_type = amqp_cstring_bytes("application/json");
-			amqp_bytes_t message = amqp_cstring_bytes(payload_text);
+			amqp_bytes_t message;
+			message.len = payload->length;
+			message.bytes = payload->text;
 			int status = amqp_basic_publish(rmq_client->rmq_conn, rmq_client->rmq_channel, rmq_client->janus_exchange,
 				response->admin ? rmq_client->from_janus_admin_queue : rmq_client->from_janus_queue,
 				0, 0, &props, message);
@@ -778,8 +788,7 @@ void *janus_rmq_out_thread(void *data) {
 		/* Free the message */
 		g_free(response->correlation_id);
 		response->correlation_id = NULL;
-		if(response->payload != NULL)
-			free(response->payload);
+		janus_json_text_unref(response->payload);
 		response->payload = NULL;
 		g_free(response);
 		response = NULL;
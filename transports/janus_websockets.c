@@ -63,9 +63,11 @@ const char *janus_websockets_get_package(void);
 gboolean janus_websockets_is_janus_api_enabled(void);
 gboolean janus_websockets_is_admin_api_enabled(void);
 int janus_websockets_send_message(janus_transport_session *transport, void *request_id, gboolean admin, json_t *message);
+int janus_websockets_send_text(janus_transport_session *transport, void *request_id, gboolean admin, janus_json_text *text);
 void janus_websockets_session_created(janus_transport_session *transport, guint64 session_id);
 void janus_websockets_session_over(janus_transport_session *transport, guint64 session_id, gboolean timeout, gboolean claimed);
 void janus_websockets_session_claimed(janus_transport_session *transport, guint64 session_id);
+json_t *janus_websockets_query_transport(json_t *request);
 
 
 /* Transport setup */
@@ -86,9 +88,12 @@ static janus_transport janus_websockets_transport =
 		.is_admin_api_enabled = janus_websockets_is_admin_api_enabled,
 
 		.send_message = janus_websockets_send_message,
+		.send_text = janus_websockets_send_text,
 		.session_created = janus_websockets_session_created,
 		.session_over = janus_websockets_session_over,
 		.session_claimed = janus_websockets_session_claimed,
+
+		.query_transport = janus_websockets_query_transport,
 	);
 
 /* Transport creator */
@@ -114,6 +119,21 @@ static janus_mutex writable_mutex;
 /* JSON serialization options */
 static size_t json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
 
+/* How many bytes we can write to a client in a single writable callback:
+ * when events pile up, we send more than one per callback (0 disables this) */
+#define JANUS_WEBSOCKETS_WRITE_BUDGET	65536
+static int ws_write_budget = JANUS_WEBSOCKETS_WRITE_BUDGET;
+
+/* permessage-deflate support, if enabled and available in libwebsockets */
+static gboolean ws_deflate = FALSE;
+static int ws_deflate_level = 0;
+#ifndef LWS_WITHOUT_EXTENSIONS
+static const struct lws_extension ws_extensions[] = {
+	{ "permessage-deflate", lws_extension_callback_pm_deflate, "permessage-deflate; client_no_context_takeover; client_max_window_bits" },
+	{ NULL, NULL, NULL }
+};
+#endif
+
 
 /* Logging */
 static int ws_log_level = 0;
@@ -154,15 +174,17 @@ static void janus_websockets_log_emit_function(int level, const char *line) {
 	JANUS_LOG(LOG_INFO, "[libwebsockets][%s] %s", janus_websockets_get_level_str(level), line);
 }
 
-/* WebSockets service thread */
-static GThread *ws_thread = NULL;
+/* WebSockets service thread(s): on libwebsockets >= 3.x we can use more
+ * than one, in which case each client is served by a single one of them */
+static GThread **ws_threads = NULL;
+static int ws_threads_num = 1;
 void *janus_websockets_thread(void *data);
 
 
 /* WebSocket client session */
 typedef struct janus_websockets_client {
 	struct lws *wsi;						/* The libwebsockets client instance */
-	GAsyncQueue *messages;					/* Queue of outgoing messages to push */
+	GAsyncQueue *messages;					/* Queue of outgoing messages to push (janus_json_text) */
 	char *incoming;							/* Buffer containing the incoming message to process (in case there are fragments) */
 	unsigned char *buffer;					/* Buffer containing the message to send */
 	int buflen;								/* Length of the buffer (may be resized after re-allocations) */
@@ -170,6 +192,10 @@ typedef struct janus_websockets_client {
 	int bufoffset;							/* Offset from where the interrupted previous write should resume */
 	volatile gint destroyed;				/* Whether this libwebsockets client instance has been closed */
 	janus_transport_session *ts;			/* Janus core-transport session */
+	char *ip;								/* Address of the client */
+	volatile gint queued_max;				/* Highest number of messages that were ever queued (atomic) */
+	volatile gsize messages_out, bytes_out;	/* How many messages and bytes we sent to this client (atomic) */
+	GThread *thread;						/* The service thread this client belongs to */
 } janus_websockets_client;
 
 
@@ -388,22 +414,16 @@ int janus_websockets_init(janus_transport_callbacks *callback, const char *confi
 		janus_config_category *config_admin = janus_config_get_create(config, NULL, janus_config_type_category, "admin");
 		janus_config_category *config_certs = janus_config_get_create(config, NULL, janus_config_type_category, "certificates");
 
-		/* Handle configuration */
+		/* Handle configuration: unless configured otherwise, serialize JSON the way the core does */
+		json_format = janus_json_get_format();
 		janus_config_item *item = janus_config_get(config, config_general, janus_config_type_item, "json");
 		if(item && item->value) {
 			/* Check how we need to format/serialize the JSON output */
-			if(!strcasecmp(item->value, "indented")) {
-				/* Default: indented, we use three spaces for that */
-				json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
-			} else if(!strcasecmp(item->value, "plain")) {
-				/* Not indented and no new lines, but still readable */
-				json_format = JSON_INDENT(0) | JSON_PRESERVE_ORDER;
-			} else if(!strcasecmp(item->value, "compact")) {
-				/* Compact, so no spaces between separators */
-				json_format = JSON_COMPACT | JSON_PRESERVE_ORDER;
+			size_t format = janus_json_format_parse(item->value);
+			if(format == 0) {
+				JANUS_LOG(LOG_WARN, "Unsupported JSON format option '%s', using the core default\n", item->value);
 			} else {
-				JANUS_LOG(LOG_WARN, "Unsupported JSON format option '%s', using default (indented)\n", item->value);
-				json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
+				json_format = format;
 			}
 		}
 
@@ -536,8 +556,61 @@ int janus_websockets_init(janus_transport_callbacks *callback, const char *confi
 			wscinfo.timeout_secs = pingpong_timeout;
 		}
 #endif
-		/* Force single-thread server */
-		wscinfo.count_threads = 1;
+		/* How much can we write to a client per writable callback? */
+		item = janus_config_get(config, config_general, janus_config_type_item, "ws_write_budget");
+		if(item && item->value) {
+			int budget = atoi(item->value);
+			if(budget < 0) {
+				JANUS_LOG(LOG_WARN, "Invalid write budget (%s), using default (%d bytes)\n", item->value, JANUS_WEBSOCKETS_WRITE_BUDGET);
+			} else {
+				ws_write_budget = budget;
+			}
+		}
+		/* Should we negotiate permessage-deflate? */
+		item = janus_config_get(config, config_general, janus_config_type_item, "ws_deflate");
+		if(item && item->value && janus_is_true(item->value)) {
+#ifndef LWS_WITHOUT_EXTENSIONS
+			ws_deflate = TRUE;
+			item = janus_config_get(config, config_general, janus_config_type_item, "ws_deflate_level");
+			if(item && item->value) {
+				ws_deflate_level = atoi(item->value);
+				if(ws_deflate_level < 1 || ws_deflate_level > 9) {
+					JANUS_LOG(LOG_WARN, "Invalid compression level (%s), using the libwebsockets default\n", item->value);
+					ws_deflate_level = 0;
+				}
+			}
+#else
+			JANUS_LOG(LOG_WARN, "permessage-deflate not supported, libwebsockets was built without extensions\n");
+#endif
+		}
+		JANUS_LOG(LOG_INFO, "WebSockets write budget: %d bytes, permessage-deflate %s\n",
+			ws_write_budget, ws_deflate ? "enabled" : "disabled");
+
+		/* How many service threads should we use? */
+		item = janus_config_get(config, config_general, janus_config_type_item, "ws_threads");
+		if(item && item->value) {
+			int threads = atoi(item->value);
+			if(threads < 1) {
+				JANUS_LOG(LOG_WARN, "Invalid number of service threads (%s), using 1\n", item->value);
+				threads = 1;
+			}
+#if (LWS_LIBRARY_VERSION_MAJOR >= 3)
+#ifdef LWS_MAX_SMP
+			if(threads > LWS_MAX_SMP) {
+				JANUS_LOG(LOG_WARN, "libwebsockets was built with support for at most %d service threads, using %d\n",
+					LWS_MAX_SMP, LWS_MAX_SMP);
+				threads = LWS_MAX_SMP;
+			}
+#endif
+#else
+			if(threads > 1) {
+				JANUS_LOG(LOG_WARN, "Multiple service threads only supported in libwebsockets >= 3.0, using 1\n");
+				threads = 1;
+			}
+#endif
+			ws_threads_num = threads;
+		}
+		wscinfo.count_threads = ws_threads_num;
 
 		/* Create the base context */
 		wsc = lws_create_context(&wscinfo);
@@ -546,6 +619,11 @@ int janus_websockets_init(janus_transport_callbacks *callback, const char *confi
 			janus_config_destroy(config);
 			return -1;	/* No point in keeping the plugin loaded */
 		}
+#if (LWS_LIBRARY_VERSION_MAJOR >= 3)
+		/* libwebsockets may have created less service threads than we asked for */
+		if(lws_get_count_threads(wsc) < ws_threads_num)
+			ws_threads_num = lws_get_count_threads(wsc);
+#endif
 
 		/* Setup the Janus API WebSockets server(s) */
 		item = janus_config_get(config, config_general, janus_config_type_item, "ws");
@@ -578,7 +656,11 @@ int janus_websockets_init(janus_transport_callbacks *callback, const char *confi
 			info.port = wsport;
 			info.iface = ip ? ip : interface;
 			info.protocols = ws_protocols;
+#ifndef LWS_WITHOUT_EXTENSIONS
+			info.extensions = ws_deflate ? ws_extensions : NULL;
+#else
 			info.extensions = NULL;
+#endif
 			info.ssl_cert_filepath = NULL;
 			info.ssl_private_key_filepath = NULL;
 			info.ssl_private_key_password = NULL;
@@ -638,7 +720,11 @@ int janus_websockets_init(janus_transport_callbacks *callback, const char *confi
 				info.port = wsport;
 				info.iface = ip ? ip : interface;
 				info.protocols = sws_protocols;
+#ifndef LWS_WITHOUT_EXTENSIONS
+				info.extensions = ws_deflate ? ws_extensions : NULL;
+#else
 				info.extensions = NULL;
+#endif
 				info.ssl_cert_filepath = server_pem;
 				info.ssl_private_key_filepath = server_key;
 				info.ssl_private_key_password = password;
@@ -690,7 +776,11 @@ int janus_websockets_init(janus_transport_callbacks *callback, const char *confi
 			info.port = wsport;
 			info.iface = ip ? ip : interface;
 			info.protocols = admin_ws_protocols;
+#ifndef LWS_WITHOUT_EXTENSIONS
+			info.extensions = ws_deflate ? ws_extensions : NULL;
+#else
 			info.extensions = NULL;
+#endif
 			info.ssl_cert_filepath = NULL;
 			info.ssl_private_key_filepath = NULL;
 			info.ssl_private_key_password = NULL;
@@ -750,7 +840,11 @@ int janus_websockets_init(janus_transport_callbacks *callback, const char *confi
 				info.port = wsport;
 				info.iface = ip ? ip : interface;
 				info.protocols = admin_sws_protocols;
+#ifndef LWS_WITHOUT_EXTENSIONS
+				info.extensions = ws_deflate ? ws_extensions : NULL;
+#else
 				info.extensions = NULL;
+#endif
 				info.ssl_cert_filepath = server_pem;
 				info.ssl_private_key_filepath = server_key;
 				info.ssl_private_key_password = password;
@@ -791,14 +885,25 @@ int janus_websockets_init(janus_transport_callbacks *callback, const char *confi
 	g_atomic_int_set(&initialized, 1);
 
 	GError *error = NULL;
-	/* Start the WebSocket service thread */
+	/* Start the WebSocket service thread(s) */
 	if(ws_janus_api_enabled || ws_admin_api_enabled) {
-		ws_thread = g_thread_try_new("ws thread", &janus_websockets_thread, wsc, &error);
-		if(!ws_thread) {
-			g_atomic_int_set(&initialized, 0);
-			JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the WebSockets thread...\n", error->code, error->message ? error->message : "??");
-			return -1;
+		ws_threads = g_malloc0(ws_threads_num * sizeof(GThread *));
+		int i = 0;
+		for(i=0; i<ws_threads_num; i++) {
+			char tname[16];
+			if(ws_threads_num == 1)
+				g_snprintf(tname, sizeof(tname), "ws thread");
+			else
+				g_snprintf(tname, sizeof(tname), "ws thread #%d", i);
+			ws_threads[i] = g_thread_try_new(tname, &janus_websockets_thread, GINT_TO_POINTER(i), &error);
+			if(!ws_threads[i]) {
+				g_atomic_int_set(&initialized, 0);
+				JANUS_LOG(LOG_ERR, "Got error %d (%s) trying to launch the WebSockets thread...\n", error->code, error->message ? error->message : "??");
+				return -1;
+			}
 		}
+		if(ws_threads_num > 1)
+			JANUS_LOG(LOG_INFO, "Using %d WebSockets service threads\n", ws_threads_num);
 	}
 
 	/* Done */
@@ -812,9 +917,14 @@ void janus_websockets_destroy(void) {
 	g_atomic_int_set(&stopping, 1);
 
 	/* Stop the service thread */
-	if(ws_thread != NULL) {
-		g_thread_join(ws_thread);
-		ws_thread = NULL;
+	if(ws_threads != NULL) {
+		int i = 0;
+		for(i=0; i<ws_threads_num; i++) {
+			if(ws_threads[i] != NULL)
+				g_thread_join(ws_threads[i]);
+		}
+		g_free(ws_threads);
+		ws_threads = NULL;
 	}
 
 	/* Destroy the context */
@@ -866,13 +976,15 @@ static void janus_websockets_destroy_client(
 	ws_client->ts->transport_p = NULL;
 	/* Remove messages queue too, if needed */
 	if(ws_client->messages != NULL) {
-		char *response = NULL;
+		janus_json_text *response = NULL;
 		while((response = g_async_queue_try_pop(ws_client->messages)) != NULL) {
-			g_free(response);
+			janus_json_text_unref(response);
 		}
 		g_async_queue_unref(ws_client->messages);
 	}
 	/* ... and the shared buffers */
+	g_free(ws_client->ip);
+	ws_client->ip = NULL;
 	g_free(ws_client->incoming);
 	ws_client->incoming = NULL;
 	g_free(ws_client->buffer);
@@ -926,20 +1038,35 @@ gboolean janus_websockets_is_admin_api_enabled(void) {
 int janus_websockets_send_message(janus_transport_session *transport, void *request_id, gboolean admin, json_t *message) {
 	if(message == NULL)
 		return -1;
+	/* Convert to string and enqueue */
+	janus_json_text *text = janus_json_text_new(message, json_format);
+	json_decref(message);
+	if(text == NULL)
+		return -1;
+	return janus_websockets_send_text(transport, request_id, admin, text);
+}
+
+int janus_websockets_send_text(janus_transport_session *transport, void *request_id, gboolean admin, janus_json_text *text) {
+	if(text == NULL)
+		return -1;
 	if(transport == NULL || g_atomic_int_get(&transport->destroyed)) {
-		json_decref(message);
+		janus_json_text_unref(text);
 		return -1;
 	}
 	janus_mutex_lock(&transport->mutex);
 	janus_websockets_client *client = (janus_websockets_client *)transport->transport_p;
 	if(!client || !client->wsi || g_atomic_int_get(&client->destroyed)) {
-		json_decref(message);
+		janus_json_text_unref(text);
 		janus_mutex_unlock(&transport->mutex);
 		return -1;
 	}
-	/* Convert to string and enqueue */
-	char *payload = json_dumps(message, json_format);
-	g_async_queue_push(client->messages, payload);
+	/* Enqueue the text: it may be shared with other clients, so we just keep a reference */
+	g_async_queue_push(client->messages, text);
+	/* Keep track of the highest queue length: we may be racing with other threads */
+	gint queued = g_async_queue_length(client->messages);
+	gint queued_max = g_atomic_int_get(&client->queued_max);
+	while(queued > queued_max && !g_atomic_int_compare_and_exchange(&client->queued_max, queued_max, queued))
+		queued_max = g_atomic_int_get(&client->queued_max);
 #if (LWS_LIBRARY_VERSION_MAJOR >= 3)
 	/* On libwebsockets >= 3.x we use lws_cancel_service */
 	janus_mutex_lock(&writable_mutex);
@@ -954,7 +1081,6 @@ int janus_websockets_send_message(janus_transport_session *transport, void *requ
 	janus_mutex_unlock(&writable_mutex);
 #endif
 	janus_mutex_unlock(&transport->mutex);
-	json_decref(message);
 	return 0;
 }
 
@@ -971,26 +1097,64 @@ void janus_websockets_session_claimed(janus_transport_session *transport, guint6
 	/* FIXME Is the above statement accurate? Should we care? Unlike the HTTP transport, there is no hashtable to update */
 }
 
+json_t *janus_websockets_query_transport(json_t *request) {
+	if(g_atomic_int_get(&stopping) || !g_atomic_int_get(&initialized))
+		return NULL;
+	/* Return some statistics on the connected clients: for each of them, how
+	 * many messages are queued (and at most were), and how much we sent */
+	json_t *response = json_object();
+	json_object_set_new(response, "write_budget", json_integer(ws_write_budget));
+	json_object_set_new(response, "deflate", ws_deflate ? json_true() : json_false());
+#if (LWS_LIBRARY_VERSION_MAJOR >= 3)
+	json_t *list = json_array();
+	janus_mutex_lock(&writable_mutex);
+	GHashTableIter iter;
+	gpointer value;
+	g_hash_table_iter_init(&iter, clients);
+	while(g_hash_table_iter_next(&iter, NULL, &value)) {
+		janus_websockets_client *client = value;
+		if(client == NULL || g_atomic_int_get(&client->destroyed))
+			continue;
+		json_t *info = json_object();
+		if(client->ip)
+			json_object_set_new(info, "ip", json_string(client->ip));
+		json_object_set_new(info, "queued", json_integer(client->messages ? g_async_queue_length(client->messages) : 0));
+		json_object_set_new(info, "queued_max", json_integer(g_atomic_int_get(&client->queued_max)));
+		json_object_set_new(info, "messages_out", json_integer((gsize)g_atomic_pointer_get(&client->messages_out)));
+		json_object_set_new(info, "bytes_out", json_integer((gsize)g_atomic_pointer_get(&client->bytes_out)));
+		json_array_append_new(list, info);
+	}
+	janus_mutex_unlock(&writable_mutex);
+	json_object_set_new(response, "clients", list);
+#else
+	/* On libwebsockets < 3.x we don't keep track of the connected clients */
+	json_object_set_new(response, "clients", json_null());
+	json_object_set_new(response, "clients_unavailable", json_string("Clients are not tracked with libwebsockets < 3.0"));
+#endif
+	return response;
+}
+
 
 /* Thread */
 void *janus_websockets_thread(void *data) {
-	struct lws_context *service = (struct lws_context *)data;
+	struct lws_context *service = wsc;
 	if(service == NULL) {
 		JANUS_LOG(LOG_ERR, "Invalid service\n");
 		return NULL;
 	}
+	int tsi = GPOINTER_TO_INT(data);
 
-	JANUS_LOG(LOG_INFO, "WebSockets thread started\n");
+	JANUS_LOG(LOG_INFO, "WebSockets thread #%d started\n", tsi);
 
 	while(g_atomic_int_get(&initialized) && !g_atomic_int_get(&stopping)) {
-		/* libwebsockets is single thread, we cycle through events here */
-		lws_service(service, 50);
+		/* Each service thread cycles through the events of its own clients here */
+		lws_service_tsi(service, 50, tsi);
 	}
 
 	/* Get rid of the WebSockets server */
 	lws_cancel_service(service);
 	/* Done */
-	JANUS_LOG(LOG_INFO, "WebSockets thread ended\n");
+	JANUS_LOG(LOG_INFO, "WebSockets thread #%d ended\n", tsi);
 	return NULL;
 }
 
@@ -1069,12 +1233,26 @@ static int janus_websockets_common_callback(
 			ws_client->buflen = 0;
 			ws_client->bufpending = 0;
 			ws_client->bufoffset = 0;
+			ws_client->ip = g_strdup(ip);
+			g_atomic_int_set(&ws_client->queued_max, 0);
+			g_atomic_pointer_set(&ws_client->messages_out, 0);
+			g_atomic_pointer_set(&ws_client->bytes_out, 0);
+			/* Callbacks for this client will always be invoked on the same service thread */
+			ws_client->thread = g_thread_self();
 			g_atomic_int_set(&ws_client->destroyed, 0);
 			ws_client->ts = janus_transport_session_create(ws_client, NULL);
 #if (LWS_LIBRARY_VERSION_MAJOR >= 3)
 			janus_mutex_lock(&writable_mutex);
 			g_hash_table_insert(clients, ws_client, ws_client);
 			janus_mutex_unlock(&writable_mutex);
+#endif
+#ifndef LWS_WITHOUT_EXTENSIONS
+			if(ws_deflate && ws_deflate_level > 0) {
+				/* Use the compression level we've been configured with, in case the client negotiated permessage-deflate */
+				char level[3];
+				g_snprintf(level, sizeof(level), "%d", ws_deflate_level);
+				lws_set_extension_option(wsi, "permessage-deflate", "compression_level", level);
+			}
 #endif
 			/* Let us know when the WebSocket channel becomes writeable */
 			lws_callback_on_writable(wsi);
@@ -1132,17 +1310,21 @@ static int janus_websockets_common_callback(
 		/* On libwebsockets >= 3.x, we use this event to mark connections as writable in the event loop */
 		case LWS_CALLBACK_EVENT_WAIT_CANCELLED: {
 			janus_mutex_lock(&writable_mutex);
-			/* We iterate on all the clients we marked as writable and act on them */
+			/* We iterate on all the clients we marked as writable and act on them: since
+			 * all service threads are woken up, each only takes care of its own clients,
+			 * as lws_callback_on_writable can't be called on other threads' connections */
 			GHashTableIter iter;
 			gpointer value;
+			GThread *self = g_thread_self();
 			g_hash_table_iter_init(&iter, writable_clients);
 			while(g_hash_table_iter_next(&iter, NULL, &value)) {
 				janus_websockets_client *client = value;
-				if(client == NULL || client->wsi == NULL)
+				if(client != NULL && client->thread != self)
 					continue;
-				lws_callback_on_writable(client->wsi);
+				if(client != NULL && client->wsi != NULL)
+					lws_callback_on_writable(client->wsi);
+				g_hash_table_iter_remove(&iter);
 			}
-			g_hash_table_remove_all(writable_clients);
 			janus_mutex_unlock(&writable_mutex);
 			return 0;
 		}
@@ -1161,6 +1343,8 @@ static int janus_websockets_common_callback(
 						log_prefix, wsi, ws_client->bufpending);
 					int sent = lws_write(wsi, ws_client->buffer + ws_client->bufoffset, ws_client->bufpending, LWS_WRITE_TEXT);
 					JANUS_LOG(LOG_HUGE, "[%s-%p]   -- Sent %d/%d bytes\n", log_prefix, wsi, sent, ws_client->bufpending);
+					if(sent > 0)
+						g_atomic_pointer_add(&ws_client->bytes_out, sent);
 					if(sent > -1 && sent < ws_client->bufpending) {
 						/* We still couldn't send everything that was left, we'll try and complete this in the next round */
 						ws_client->bufpending -= sent;
@@ -1175,34 +1359,59 @@ static int janus_websockets_common_callback(
 					janus_mutex_unlock(&ws_client->ts->mutex);
 					return 0;
 				}
-				/* Shoot all the pending messages */
-				char *response = g_async_queue_try_pop(ws_client->messages);
-				if(response && !g_atomic_int_get(&ws_client->destroyed) && !g_atomic_int_get(&stopping)) {
+				/* Shoot all the pending messages: as long as the connection isn't choked,
+				 * we keep on writing until we exhaust the write budget for this round,
+				 * so that bursts of events don't need a writable callback each. Notice
+				 * that libwebsockets rejects a write while a previous one is still
+				 * buffered (e.g., with TLS or compression), so we stop there too */
+				int count = 0, written = 0;
+				janus_json_text *response = NULL;
+				while(!g_atomic_int_get(&ws_client->destroyed) && !g_atomic_int_get(&stopping)) {
+					if(count > 0 && (written >= ws_write_budget || lws_send_pipe_choked(wsi) || lws_partial_buffered(wsi)))
+						break;
+					response = g_async_queue_try_pop(ws_client->messages);
+					if(response == NULL)
+						break;
 					/* Gotcha! */
-					int buflen = LWS_SEND_BUFFER_PRE_PADDING + strlen(response) + LWS_SEND_BUFFER_POST_PADDING;
+					int resplen = response->length;
+					int buflen = LWS_SEND_BUFFER_PRE_PADDING + resplen + LWS_SEND_BUFFER_POST_PADDING;
 					if (buflen > ws_client->buflen) {
 						/* We need a larger shared buffer */
-						JANUS_LOG(LOG_HUGE, "[%s-%p] Re-allocating to %d bytes (was %d, response is %zu bytes)\n", log_prefix, wsi, buflen, ws_client->buflen, strlen(response));
+						JANUS_LOG(LOG_HUGE, "[%s-%p] Re-allocating to %d bytes (was %d, response is %d bytes)\n", log_prefix, wsi, buflen, ws_client->buflen, resplen);
 						ws_client->buflen = buflen;
 						ws_client->buffer = g_realloc(ws_client->buffer, buflen);
 					}
-					memcpy(ws_client->buffer + LWS_SEND_BUFFER_PRE_PADDING, response, strlen(response));
-					JANUS_LOG(LOG_HUGE, "[%s-%p] Sending WebSocket message (%zu bytes)...\n", log_prefix, wsi, strlen(response));
-					int sent = lws_write(wsi, ws_client->buffer + LWS_SEND_BUFFER_PRE_PADDING, strlen(response), LWS_WRITE_TEXT);
-					JANUS_LOG(LOG_HUGE, "[%s-%p]   -- Sent %d/%zu bytes\n", log_prefix, wsi, sent, strlen(response));
-					if(sent > -1 && sent < (int)strlen(response)) {
+					memcpy(ws_client->buffer + LWS_SEND_BUFFER_PRE_PADDING, response->text, resplen);
+					JANUS_LOG(LOG_HUGE, "[%s-%p] Sending WebSocket message (%d bytes)...\n", log_prefix, wsi, resplen);
+					int sent = lws_write(wsi, ws_client->buffer + LWS_SEND_BUFFER_PRE_PADDING, resplen, LWS_WRITE_TEXT);
+					JANUS_LOG(LOG_HUGE, "[%s-%p]   -- Sent %d/%d bytes\n", log_prefix, wsi, sent, resplen);
+					count++;
+					if(sent < 0) {
+						/* The write was refused: put the message back, we'll try again next round */
+#if GLIB_CHECK_VERSION(2, 46, 0)
+						g_async_queue_push_front(ws_client->messages, response);
+#else
+						g_async_queue_push(ws_client->messages, response);
+#endif
+						break;
+					}
+					/* We can get rid of our reference to the message */
+					janus_json_text_unref(response);
+					written += sent;
+					g_atomic_pointer_add(&ws_client->messages_out, 1);
+					g_atomic_pointer_add(&ws_client->bytes_out, sent);
+					if(sent < resplen) {
 						/* We couldn't send everything in a single write, we'll complete this in the next round */
-						ws_client->bufpending = strlen(response) - sent;
+						ws_client->bufpending = resplen - sent;
 						ws_client->bufoffset = LWS_SEND_BUFFER_PRE_PADDING + sent;
 						JANUS_LOG(LOG_HUGE, "[%s-%p]   -- Couldn't write all bytes (%d missing), setting offset %d\n",
 							log_prefix, wsi, ws_client->bufpending, ws_client->bufoffset);
+						break;
 					}
-					/* We can get rid of the message */
-					free(response);
+				}
+				if(count > 0) {
 					/* Done for this round, check the next response/notification later */
 					lws_callback_on_writable(wsi);
-					janus_mutex_unlock(&ws_client->ts->mutex);
-					return 0;
 				}
 				janus_mutex_unlock(&ws_client->ts->mutex);
 			}
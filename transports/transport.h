@@ -61,7 +61,14 @@ janus_transport *create(void) {
  *
  * All the above methods and callbacks are mandatory: the Janus core will
  * reject a transport plugin that doesn't implement any of the
- * mandatory callbacks.
+ * mandatory callbacks. The following one, instead, is optional:
+ *
+ * - \c query_transport(): this method allows the Admin API to send a request
+ * to the transport and get a response back (e.g., to retrieve statistics);
+ * - \c send_text(): this method asks the transport to send an event that
+ * has already been serialized, which the core uses for events plugins send
+ * to many recipients at the same time (transports that don't implement it
+ * will get the same event via \c send_message() instead).
  *
  * The Janus core \c janus_transport_callbacks interface is provided to a
  * transport plugin, together with the path to the configurations files
@@ -95,9 +102,12 @@ janus_transport *create(void) {
 
 #include "refcount.h"
 
+/* Serialized JSON messages (see utils.h) */
+struct janus_json_text;
+
 
 /*! \brief Version of the API, to match the one transport plugins were compiled against */
-#define JANUS_TRANSPORT_API_VERSION		7
+#define JANUS_TRANSPORT_API_VERSION		9
 
 /*! \brief Initialization of all transport plugin properties to NULL
  *
@@ -230,6 +240,25 @@ struct janus_transport {
 	 * @param[in] session_id The session ID that was claimed (if the transport cares) */
 	void (* const session_claimed)(janus_transport_session *transport, guint64 session_id);
 
+	/*! \brief Method to send a request to the transport plugin via the Admin API, and get a response
+	 * \note This method is optional: the core will return an error to Admin API
+	 * requests addressing transports that don't implement it
+	 * @param[in] request The request to process, if any
+	 * @returns A JSON object with the response, or NULL if there's nothing to return */
+	json_t *(* const query_transport)(json_t *request);
+
+	/*! \brief Method to send an already serialized event to a client over a transport session
+	 * \note This method is optional: the core will use send_message for transports
+	 * that don't implement it. The same text may be shared by many recipients,
+	 * and so must not be modified: the transport plugin owns a reference to it,
+	 * and must release it with janus_json_text_unref when done.
+	 * @param[in] transport Pointer to the transport session instance
+	 * @param[in] request_id Will be not-NULL in case this is a response to a previous request
+	 * @param[in] admin Whether this is an admin API or a Janus API message
+	 * @param[in] text The serialized message
+	 * @returns 0 on success, a negative integer otherwise */
+	int (* const send_text)(janus_transport_session *transport, void *request_id, gboolean admin, struct janus_json_text *text);
+
 };
 
 /*! \brief Callbacks to contact the Janus core */
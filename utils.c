@@ -19,6 +19,7 @@
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <inttypes.h>
+#include <math.h>
 
 #include <zlib.h>
 
@@ -611,6 +612,441 @@ gboolean janus_json_is_valid(json_t *val, json_type jtype, unsigned int flags) {
 	return is_valid;
 }
 
+size_t janus_json_format_parse(const char *value) {
+	if(value == NULL)
+		return 0;
+	if(!strcasecmp(value, "indented")) {
+		/* Indented, we use three spaces for that */
+		return JSON_INDENT(3) | JSON_PRESERVE_ORDER;
+	} else if(!strcasecmp(value, "plain")) {
+		/* Not indented and no new lines, but still readable */
+		return JSON_INDENT(0) | JSON_PRESERVE_ORDER;
+	} else if(!strcasecmp(value, "compact")) {
+		/* Compact, so no spaces between separators */
+		return JSON_COMPACT | JSON_PRESERVE_ORDER;
+	}
+	return 0;
+}
+
+static size_t json_format = JSON_INDENT(3) | JSON_PRESERVE_ORDER;
+void janus_json_set_format(size_t format) {
+	json_format = format;
+}
+size_t janus_json_get_format(void) {
+	return json_format;
+}
+size_t janus_json_get_shared_format(void) {
+	return json_format & ~JSON_INDENT(JSON_MAX_INDENT);
+}
+
+janus_json_text *janus_json_text_new(json_t *message, size_t format) {
+	if(message == NULL)
+		return NULL;
+	char *serialized = json_dumps(message, format);
+	if(serialized == NULL)
+		return NULL;
+	janus_json_text *text = g_malloc(sizeof(janus_json_text));
+	text->message = json_incref(message);
+	text->text = serialized;
+	text->length = strlen(serialized);
+	text->ref = 1;
+	return text;
+}
+
+janus_json_text *janus_json_text_ref(janus_json_text *text) {
+	if(text != NULL)
+		g_atomic_int_inc(&text->ref);
+	return text;
+}
+
+void janus_json_text_unref(janus_json_text *text) {
+	if(text == NULL || !g_atomic_int_dec_and_test(&text->ref))
+		return;
+	if(text->message != NULL)
+		json_decref(text->message);
+	free(text->text);
+	g_free(text);
+}
+
+/* The placeholder is random, so that nobody can inject it in other strings
+ * of an envelope (e.g., a transaction) and have the message spliced there */
+static gchar json_text_placeholder[40];
+static const gchar *janus_json_text_placeholder(void) {
+	static gsize initialized = 0;
+	if(g_once_init_enter(&initialized)) {
+		g_snprintf(json_text_placeholder, sizeof(json_text_placeholder),
+			"janus-json-text-%016"G_GINT64_MODIFIER"x", janus_random_uint64());
+		g_once_init_leave(&initialized, 1);
+	}
+	return json_text_placeholder;
+}
+
+janus_json_text *janus_json_text_splice(json_t *envelope, json_t *parent, const char *key, janus_json_text *body, size_t format) {
+	if(envelope == NULL || !json_is_object(parent) || key == NULL || body == NULL || body->message == NULL)
+		return NULL;
+	/* Serialize the envelope with a placeholder where the message should be */
+	json_object_set_new(parent, key, json_string(janus_json_text_placeholder()));
+	char *serialized = json_dumps(envelope, format);
+	json_object_set(parent, key, body->message);
+	if(serialized == NULL)
+		return NULL;
+	/* Look for the placeholder, quotes included */
+	char quoted[sizeof(json_text_placeholder)+2];
+	g_snprintf(quoted, sizeof(quoted), "\"%s\"", janus_json_text_placeholder());
+	char *start = strstr(serialized, quoted);
+	if(start == NULL) {
+		free(serialized);
+		return NULL;
+	}
+	size_t slen = strlen(serialized), qlen = strlen(quoted), prefix = start - serialized;
+	janus_json_text *text = g_malloc(sizeof(janus_json_text));
+	text->message = json_incref(envelope);
+	text->length = slen - qlen + body->length;
+	/* Transports free the text with free(), as if it came from json_dumps */
+	text->text = malloc(text->length + 1);
+	memcpy(text->text, serialized, prefix);
+	memcpy(text->text + prefix, body->text, body->length);
+	memcpy(text->text + prefix + body->length, start + qlen, slen - prefix - qlen + 1);
+	text->ref = 1;
+	free(serialized);
+	return text;
+}
+
+/* CBOR (RFC 8949) encoding and decoding of JSON messages */
+#define JANUS_CBOR_MAX_DEPTH	512
+gboolean janus_cbor_is_message(const char *data, size_t length) {
+	/* Major type 5 (map), whatever the length */
+	return (data != NULL && length > 0 && ((guint8)data[0] & 0xE0) == 0xA0);
+}
+
+static void janus_cbor_encode_head(GByteArray *buffer, guint8 major, guint64 value) {
+	guint8 head[9];
+	guint len = 0;
+	if(value < 24) {
+		head[0] = (major << 5) | (guint8)value;
+		len = 1;
+	} else if(value <= 0xFF) {
+		head[0] = (major << 5) | 24;
+		len = 2;
+	} else if(value <= 0xFFFF) {
+		head[0] = (major << 5) | 25;
+		len = 3;
+	} else if(value <= 0xFFFFFFFF) {
+		head[0] = (major << 5) | 26;
+		len = 5;
+	} else {
+		head[0] = (major << 5) | 27;
+		len = 9;
+	}
+	guint i = 0;
+	for(i = len-1; i > 0; i--) {
+		head[i] = value & 0xFF;
+		value >>= 8;
+	}
+	g_byte_array_append(buffer, head, len);
+}
+
+static gboolean janus_cbor_encode_value(GByteArray *buffer, json_t *value, int depth) {
+	if(value == NULL || depth > JANUS_CBOR_MAX_DEPTH)
+		return FALSE;
+	guint8 simple = 0;
+	switch(json_typeof(value)) {
+		case JSON_OBJECT: {
+			janus_cbor_encode_head(buffer, 5, json_object_size(value));
+			const char *key = NULL;
+			json_t *item = NULL;
+			json_object_foreach(value, key, item) {
+				size_t klen = strlen(key);
+				janus_cbor_encode_head(buffer, 3, klen);
+				g_byte_array_append(buffer, (const guint8 *)key, klen);
+				if(!janus_cbor_encode_value(buffer, item, depth+1))
+					return FALSE;
+			}
+			return TRUE;
+		}
+		case JSON_ARRAY: {
+			janus_cbor_encode_head(buffer, 4, json_array_size(value));
+			size_t i = 0;
+			json_t *item = NULL;
+			json_array_foreach(value, i, item) {
+				if(!janus_cbor_encode_value(buffer, item, depth+1))
+					return FALSE;
+			}
+			return TRUE;
+		}
+		case JSON_STRING: {
+			const char *text = json_string_value(value);
+			size_t tlen = strlen(text);
+			janus_cbor_encode_head(buffer, 3, tlen);
+			g_byte_array_append(buffer, (const guint8 *)text, tlen);
+			return TRUE;
+		}
+		case JSON_INTEGER: {
+			json_int_t number = json_integer_value(value);
+			if(number >= 0)
+				janus_cbor_encode_head(buffer, 0, (guint64)number);
+			else
+				janus_cbor_encode_head(buffer, 1, (guint64)(-1 - number));
+			return TRUE;
+		}
+		case JSON_REAL: {
+			/* We always use double precision floats */
+			double number = json_real_value(value);
+			guint64 bits = 0;
+			memcpy(&bits, &number, sizeof(bits));
+			guint8 real[9];
+			real[0] = 0xFB;
+			int i = 0;
+			for(i = 8; i > 0; i--) {
+				real[i] = bits & 0xFF;
+				bits >>= 8;
+			}
+			g_byte_array_append(buffer, real, sizeof(real));
+			return TRUE;
+		}
+		case JSON_TRUE:
+			simple = 0xF5;
+			break;
+		case JSON_FALSE:
+			simple = 0xF4;
+			break;
+		case JSON_NULL:
+			simple = 0xF6;
+			break;
+		default:
+			return FALSE;
+	}
+	g_byte_array_append(buffer, &simple, 1);
+	return TRUE;
+}
+
+char *janus_cbor_encode(json_t *message, size_t *length) {
+	if(message == NULL || length == NULL)
+		return NULL;
+	GByteArray *buffer = g_byte_array_sized_new(512);
+	if(!janus_cbor_encode_value(buffer, message, 0)) {
+		g_byte_array_free(buffer, TRUE);
+		return NULL;
+	}
+	*length = buffer->len;
+	return (char *)g_byte_array_free(buffer, FALSE);
+}
+
+typedef struct janus_cbor_decoder {
+	const guint8 *data;
+	size_t length, offset;
+	json_error_t *error;
+} janus_cbor_decoder;
+
+static json_t *janus_cbor_decode_error(janus_cbor_decoder *dec, const char *reason) {
+	if(dec->error != NULL) {
+		memset(dec->error, 0, sizeof(*dec->error));
+		g_snprintf(dec->error->text, JSON_ERROR_TEXT_LENGTH, "%s", reason);
+		g_snprintf(dec->error->source, JSON_ERROR_SOURCE_LENGTH, "<cbor>");
+		dec->error->line = -1;
+		dec->error->column = -1;
+		dec->error->position = (int)dec->offset;
+	}
+	return NULL;
+}
+
+/* Returns FALSE (with the error already set) if the head can't be parsed;
+ * for indefinite lengths (additional info 31) the value is left to 0 */
+static gboolean janus_cbor_decode_head(janus_cbor_decoder *dec, guint8 *major, guint8 *info, guint64 *value) {
+	if(dec->offset >= dec->length) {
+		janus_cbor_decode_error(dec, "Unexpected end of data");
+		return FALSE;
+	}
+	guint8 byte = dec->data[dec->offset++];
+	*major = byte >> 5;
+	*info = byte & 0x1F;
+	*value = 0;
+	if(*info < 24) {
+		*value = *info;
+	} else if(*info <= 27) {
+		size_t len = 1 << (*info - 24);
+		if(dec->length - dec->offset < len) {
+			janus_cbor_decode_error(dec, "Unexpected end of data");
+			return FALSE;
+		}
+		size_t i = 0;
+		for(i = 0; i < len; i++)
+			*value = (*value << 8) | dec->data[dec->offset++];
+	} else if(*info != 31 || *major == 0 || *major == 1 || *major == 6) {
+		janus_cbor_decode_error(dec, "Invalid additional information");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static gboolean janus_cbor_decode_break(janus_cbor_decoder *dec) {
+	if(dec->offset < dec->length && dec->data[dec->offset] == 0xFF) {
+		dec->offset++;
+		return TRUE;
+	}
+	return FALSE;
+}
+
+static json_t *janus_cbor_decode_value(janus_cbor_decoder *dec, int depth) {
+	if(depth > JANUS_CBOR_MAX_DEPTH)
+		return janus_cbor_decode_error(dec, "Maximum nesting depth reached");
+	guint8 major = 0, info = 0;
+	guint64 value = 0;
+	if(!janus_cbor_decode_head(dec, &major, &info, &value))
+		return NULL;
+	switch(major) {
+		case 0:
+			if(value > (guint64)G_MAXINT64)
+				return janus_cbor_decode_error(dec, "Integer out of range");
+			return json_integer((json_int_t)value);
+		case 1:
+			if(value > (guint64)G_MAXINT64)
+				return janus_cbor_decode_error(dec, "Integer out of range");
+			return json_integer(-1 - (json_int_t)value);
+		case 2:
+			return janus_cbor_decode_error(dec, "Byte strings are not supported");
+		case 3: {
+			GString *text = g_string_new(NULL);
+			if(info != 31) {
+				if(value > dec->length - dec->offset) {
+					g_string_free(text, TRUE);
+					return janus_cbor_decode_error(dec, "Unexpected end of data");
+				}
+				g_string_append_len(text, (const char *)dec->data + dec->offset, value);
+				dec->offset += value;
+			} else {
+				/* Indefinite length, made of definite length chunks */
+				while(!janus_cbor_decode_break(dec)) {
+					guint8 cmajor = 0, cinfo = 0;
+					guint64 clen = 0;
+					if(!janus_cbor_decode_head(dec, &cmajor, &cinfo, &clen)) {
+						g_string_free(text, TRUE);
+						return NULL;
+					}
+					if(cmajor != 3 || cinfo == 31 || clen > dec->length - dec->offset) {
+						g_string_free(text, TRUE);
+						return janus_cbor_decode_error(dec, "Invalid text string chunk");
+					}
+					g_string_append_len(text, (const char *)dec->data + dec->offset, clen);
+					dec->offset += clen;
+				}
+			}
+			if(memchr(text->str, '\0', text->len) != NULL) {
+				g_string_free(text, TRUE);
+				return janus_cbor_decode_error(dec, "Text strings with NUL characters are not supported");
+			}
+			/* This also validates the string is UTF-8 */
+			json_t *string = json_string(text->str);
+			g_string_free(text, TRUE);
+			if(string == NULL)
+				return janus_cbor_decode_error(dec, "Invalid UTF-8 text string");
+			return string;
+		}
+		case 4: {
+			/* Each item needs at least a byte */
+			if(info != 31 && value > dec->length - dec->offset)
+				return janus_cbor_decode_error(dec, "Unexpected end of data");
+			json_t *array = json_array();
+			guint64 i = 0;
+			while(info == 31 ? !janus_cbor_decode_break(dec) : i < value) {
+				json_t *item = janus_cbor_decode_value(dec, depth+1);
+				if(item == NULL) {
+					json_decref(array);
+					return NULL;
+				}
+				json_array_append_new(array, item);
+				i++;
+			}
+			return array;
+		}
+		case 5: {
+			/* Each pair needs at least two bytes */
+			if(info != 31 && value > (dec->length - dec->offset)/2)
+				return janus_cbor_decode_error(dec, "Unexpected end of data");
+			json_t *object = json_object();
+			guint64 i = 0;
+			while(info == 31 ? !janus_cbor_decode_break(dec) : i < value) {
+				json_t *key = janus_cbor_decode_value(dec, depth+1);
+				if(key == NULL) {
+					json_decref(object);
+					return NULL;
+				}
+				if(!json_is_string(key)) {
+					json_decref(key);
+					json_decref(object);
+					return janus_cbor_decode_error(dec, "Map keys must be text strings");
+				}
+				json_t *item = janus_cbor_decode_value(dec, depth+1);
+				if(item == NULL) {
+					json_decref(key);
+					json_decref(object);
+					return NULL;
+				}
+				json_object_set_new(object, json_string_value(key), item);
+				json_decref(key);
+				i++;
+			}
+			return object;
+		}
+		case 6:
+			/* Tags have no JSON equivalent, just decode what they wrap */
+			return janus_cbor_decode_value(dec, depth+1);
+		default:
+			break;
+	}
+	/* Major type 7: simple values and floats */
+	double number = 0;
+	if(info == 20) {
+		return json_false();
+	} else if(info == 21) {
+		return json_true();
+	} else if(info == 22 || info == 23) {
+		/* Undefined has no JSON equivalent, treat it as null */
+		return json_null();
+	} else if(info == 25) {
+		/* Half precision float */
+		int exp = (value >> 10) & 0x1F, mant = value & 0x3FF;
+		if(exp == 0)
+			number = ldexp(mant, -24);
+		else if(exp != 31)
+			number = ldexp(mant + 1024, exp - 25);
+		else
+			return janus_cbor_decode_error(dec, "Infinity and NaN are not supported");
+		if(value & 0x8000)
+			number = -number;
+	} else if(info == 26) {
+		guint32 bits = (guint32)value;
+		float single = 0;
+		memcpy(&single, &bits, sizeof(single));
+		number = single;
+	} else if(info == 27) {
+		memcpy(&number, &value, sizeof(number));
+	} else if(info == 31) {
+		return janus_cbor_decode_error(dec, "Unexpected break");
+	} else {
+		return janus_cbor_decode_error(dec, "Unsupported simple value");
+	}
+	json_t *real = json_real(number);
+	if(real == NULL)
+		return janus_cbor_decode_error(dec, "Infinity and NaN are not supported");
+	return real;
+}
+
+json_t *janus_cbor_decode(const char *data, size_t length, json_error_t *error) {
+	janus_cbor_decoder dec = {
+		.data = (const guint8 *)data,
+		.length = data ? length : 0,
+		.offset = 0,
+		.error = error
+	};
+	json_t *message = janus_cbor_decode_value(&dec, 0);
+	if(message != NULL && dec.offset != dec.length) {
+		json_decref(message);
+		return janus_cbor_decode_error(&dec, "Trailing data after message");
+	}
+	return message;
+}
+
 /* The following code is more related to codec specific helpers */
 #if defined(__ppc__) || defined(__ppc64__)
 	# define swap2(d)  \
@@ -185,6 +185,85 @@ void janus_get_json_type_name(int jtype, unsigned int flags, char *type_name);
  * @returns TRUE if the value is valid */
 gboolean janus_json_is_valid(json_t *val, json_type jtype, unsigned int flags);
 
+/*! \brief Helper to parse a JSON format configuration value
+ * @param value The configuration value to parse ("indented", "plain" or "compact")
+ * @returns The jansson flags to pass to json_dumps, or 0 if the value is not supported */
+size_t janus_json_format_parse(const char *value);
+/*! \brief Set the default format transports and plugins should serialize JSON with
+ * \note Transports and plugins can still override this in their own configuration
+ * @param format The jansson flags to pass to json_dumps */
+void janus_json_set_format(size_t format);
+/*! \brief Get the default format transports and plugins should serialize JSON with
+ * @returns The jansson flags to pass to json_dumps */
+size_t janus_json_get_format(void);
+/*! \brief Get the format JSON messages shared by many recipients are serialized with
+ * \note This is the default format without any indentation, as shared texts are
+ * spliced in per-recipient envelopes (see janus_json_text_splice)
+ * @returns The jansson flags to pass to json_dumps */
+size_t janus_json_get_shared_format(void);
+
+/*! \brief JSON message serialized once, that can be shared by many recipients */
+typedef struct janus_json_text {
+	/*! \brief The JSON message, for who needs that rather than the text */
+	json_t *message;
+	/*! \brief The serialized message */
+	char *text;
+	/*! \brief Length of the serialized message */
+	size_t length;
+	/*! \brief Reference counter */
+	volatile gint ref;
+} janus_json_text;
+/*! \brief Serialize a JSON message once, so that it can be sent to many recipients
+ * \note A reference to the JSON message is kept, so the caller can unref its own
+ * @param message The JSON message to serialize
+ * @param format The jansson flags to pass to json_dumps
+ * @returns A new janus_json_text instance, with a reference already taken, or NULL on error */
+janus_json_text *janus_json_text_new(json_t *message, size_t format);
+/*! \brief Take a reference to a serialized JSON message
+ * @param text The janus_json_text instance to reference
+ * @returns The same janus_json_text instance */
+janus_json_text *janus_json_text_ref(janus_json_text *text);
+/*! \brief Release a reference to a serialized JSON message, freeing it when it's the last one
+ * @param text The janus_json_text instance to release */
+void janus_json_text_unref(janus_json_text *text);
+/*! \brief Serialize a JSON envelope that contains an already serialized message
+ * \note This way, the (usually larger) message only needs to be serialized once, even
+ * though each recipient gets a different envelope (e.g., with its own session ID). The
+ * message is added to the envelope as well, so that the JSON message of the result
+ * matches its text; a reference to the envelope is kept, so the caller can unref its own
+ * @param envelope The JSON envelope to serialize
+ * @param parent The JSON object in the envelope the message must be added to
+ * @param key The name the message must be added with
+ * @param body The serialized message to add
+ * @param format The jansson flags to pass to json_dumps for the envelope
+ * @returns A new janus_json_text instance, with a reference already taken, or NULL on error */
+janus_json_text *janus_json_text_splice(json_t *envelope, json_t *parent, const char *key, janus_json_text *body, size_t format);
+
+/*! \brief Check whether a buffer looks like a CBOR (RFC 8949) encoded Janus message
+ * \note Janus messages are always objects, so this only checks whether
+ * the first byte is a CBOR map: a JSON text can never start with it
+ * @param data The buffer to check
+ * @param length The size of the buffer
+ * @returns TRUE if the buffer starts with a CBOR map, FALSE otherwise */
+gboolean janus_cbor_is_message(const char *data, size_t length);
+/*! \brief Encode a JSON message as CBOR (RFC 8949)
+ * \note Objects are encoded as maps with text keys, integers as (negative)
+ * integers, reals as double precision floats and strings as text strings,
+ * so that the result can be decoded back to the same JSON message
+ * @param message The JSON message to encode
+ * @param[out] length The size of the encoded message
+ * @returns A buffer with the encoded message, to be freed with g_free, or NULL on error */
+char *janus_cbor_encode(json_t *message, size_t *length);
+/*! \brief Decode a CBOR (RFC 8949) message to a JSON message
+ * \note Byte strings, map keys that are not text strings and integers
+ * that don't fit in a json_int_t are not supported, since they can't
+ * be mapped to JSON, while tags are ignored
+ * @param data The buffer to decode
+ * @param length The size of the buffer
+ * @param[out] error Where to store the reason why decoding failed, like json_loadb does
+ * @returns A new JSON message, or NULL on error */
+json_t *janus_cbor_decode(const char *data, size_t length, json_error_t *error);
+
 /*! \brief Validates the JSON object against the description of its parameters
  * @param missing_format printf format to indicate a missing required parameter; needs one %s for the parameter name
  * @param invalid_format printf format to indicate an invalid parameter; needs two %s for parameter name and type description from janus_get_json_type_name